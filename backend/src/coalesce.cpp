@@ -0,0 +1,91 @@
+#include "coalesce.hpp"
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+#include "stats.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct TargetState {
+  bool writing = false;
+  Clock::time_point last_write = Clock::time_point::min();
+};
+
+std::mutex coalesce_mutex;
+// Woken on every claim, so superseded writes stop waiting at once, and after
+// every write.
+std::condition_variable coalesce_cv;
+uint64_t next_ticket = 1;
+std::map<std::string, TargetState, std::less<>> targets;
+std::map<std::pair<uint64_t, std::string>, uint64_t> latest_claims;
+
+bool superseded(uint64_t client_id, std::string_view target, uint64_t ticket) {
+  if (ticket == 0)
+    return false;
+  auto it = latest_claims.find({client_id, std::string(target)});
+  return it == latest_claims.end() || it->second != ticket;
+}
+
+} // namespace
+
+uint64_t coalesce_claim(uint64_t client_id, std::string_view target) {
+  uint64_t ticket;
+  {
+    std::lock_guard<std::mutex> lock(coalesce_mutex);
+    ticket = next_ticket++;
+    latest_claims[{client_id, std::string(target)}] = ticket;
+  }
+  coalesce_cv.notify_all();
+  return ticket;
+}
+
+std::string coalesce_write(uint64_t client_id, std::string_view target,
+                           uint64_t ticket,
+                           const std::function<std::string()> &write) {
+  std::optional<StatsLockWait> waiting(std::in_place);
+  std::unique_lock<std::mutex> lock(coalesce_mutex);
+  auto it = targets.find(target);
+  if (it == targets.end())
+    it = targets.emplace(std::string(target), TargetState{}).first;
+  TargetState &state = it->second;
+
+  while (true) {
+    if (superseded(client_id, target, ticket))
+      return std::string(kMergedReply);
+    if (state.writing) {
+      coalesce_cv.wait(lock);
+      continue;
+    }
+    auto ready_at = state.last_write + kMinWriteInterval;
+    if (Clock::now() >= ready_at)
+      break;
+    coalesce_cv.wait_until(lock, ready_at);
+  }
+  waiting.reset();
+
+  state.writing = true;
+  lock.unlock();
+  std::string result = write();
+  lock.lock();
+  state.writing = false;
+  state.last_write = Clock::now();
+  lock.unlock();
+  coalesce_cv.notify_all();
+  return result;
+}
+
+void coalesce_forget_client(uint64_t client_id) {
+  {
+    std::lock_guard<std::mutex> lock(coalesce_mutex);
+    auto it = latest_claims.lower_bound({client_id, std::string()});
+    while (it != latest_claims.end() && it->first.first == client_id)
+      it = latest_claims.erase(it);
+  }
+  coalesce_cv.notify_all();
+}
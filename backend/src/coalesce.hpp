@@ -0,0 +1,36 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+#include "victus_commands.hpp"
+
+// Latest-wins coalescing for hardware writes. A target names the one thing a
+// write changes ("fan1", "zone2", "brightness", ...).
+//
+// A slider drag turns into a burst of SET commands, each of which would fork
+// the sudo helpers. The event loop claims a ticket for every SET in arrival
+// order; when a write finally runs, a newer ticket from the same client for
+// the same target means it has been superseded, and it is answered with
+// kMergedReply without touching the hardware. Writes to one target run one at
+// a time and at most once per kMinWriteInterval, whichever client sent them.
+// Untagged frames run one at a time and BATCH items take no ticket, so the
+// event loop and handle_batch() merge those by looking ahead instead.
+
+constexpr std::string_view kMergedReply = kVictusMergedReply;
+constexpr std::chrono::milliseconds kMinWriteInterval{100};
+
+// Returns the ticket for the client's newest write to `target`; never 0.
+uint64_t coalesce_claim(uint64_t client_id, std::string_view target);
+
+// Runs `write` unless a later claim superseded `ticket`. Ticket 0 is never
+// superseded but still waits its turn and the rate limit.
+std::string coalesce_write(uint64_t client_id, std::string_view target,
+                           uint64_t ticket,
+                           const std::function<std::string()> &write);
+
+// Drops the client's claims; writes it still has queued are merged away.
+void coalesce_forget_client(uint64_t client_id);
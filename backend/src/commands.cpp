@@ -0,0 +1,319 @@
+#include "commands.hpp"
+
+#include <algorithm>
+#include <array>
+#include <optional>
+#include <string>
+
+#include "coalesce.hpp"
+#include "fan.hpp"
+#include "keyboard.hpp"
+#include "log.hpp"
+#include "selfstat.hpp"
+#include "state.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
+#include "util.hpp"
+#include "validation.hpp"
+#include "victus_commands.hpp"
+
+namespace {
+
+constexpr std::string_view kBatchPrefix = "BATCH\n";
+constexpr size_t kMaxBatchItems = kVictusMaxBatchItems;
+
+std::string handle_single_command(std::string_view command_str,
+                                  WriteTicket ticket);
+
+// A batch frame is "BATCH\n" followed by one command per line. The reply is
+// "BATCH <n>\n" followed by one "OK\t<response>" or "ERR\t<response>" line
+// per item, in request order. All items run back to back on this thread
+// under one LookupCacheScope, so the hwmon and keyboard layout is resolved
+// once for the whole batch. A SET followed by another SET to the same target
+// in the same batch is answered "OK: MERGED" without being applied.
+std::string handle_batch(std::string_view command_str) {
+  std::array<std::string_view, kMaxBatchItems> items;
+  size_t item_count = 0;
+
+  std::string_view lines = command_str.substr(kBatchPrefix.size());
+  while (!lines.empty()) {
+    size_t newline = lines.find('\n');
+    std::string_view line = trim_whitespace(lines.substr(0, newline));
+    lines.remove_prefix(newline == std::string_view::npos ? lines.size()
+                                                          : newline + 1);
+    if (line.empty())
+      continue;
+    if (item_count == kMaxBatchItems)
+      return "ERROR: Too many BATCH items";
+    items[item_count++] = line;
+  }
+
+  if (item_count == 0)
+    return "ERROR: Empty BATCH command";
+
+  std::array<std::string, kMaxBatchItems> targets;
+  for (size_t i = 0; i < item_count; ++i)
+    targets[i] = command_write_target(items[i]);
+
+  LookupCacheScope lookup_cache;
+  std::string reply = "BATCH " + std::to_string(item_count);
+  for (size_t i = 0; i < item_count; ++i) {
+    bool superseded =
+        !targets[i].empty() &&
+        std::find(targets.begin() + i + 1, targets.begin() + item_count,
+                  targets[i]) != targets.begin() + item_count;
+    std::string response = superseded ? std::string(kMergedReply)
+                                      : handle_single_command(items[i], {});
+    for (char &ch : response) {
+      if (ch == '\n' || ch == '\r')
+        ch = ' ';
+    }
+
+    reply += response.rfind("ERROR", 0) == 0 ? "\nERR\t" : "\nOK\t";
+    reply += response;
+  }
+  return reply;
+}
+
+// Arguments of one command after the schema checks: the raw token (or the
+// rest of the line for a Text argument) and, for Integer arguments, its value.
+// Omitted optional arguments have an empty token and a value of 0.
+struct CommandArgs {
+  std::array<std::string_view, kVictusMaxCommandArgs> text;
+  std::array<int, kVictusMaxCommandArgs> value;
+};
+
+using CommandHandler = std::string (*)(const CommandArgs &args);
+
+std::string rgb_string(const CommandArgs &args, size_t first) {
+  return std::to_string(args.value[first]) + " " +
+         std::to_string(args.value[first + 1]) + " " +
+         std::to_string(args.value[first + 2]);
+}
+
+// Indexed by VictusCommand; the schema in victus_commands.hpp owns names,
+// arity and argument bounds.
+constexpr std::array<CommandHandler, VICTUS_COMMAND_COUNT> kHandlers = [] {
+  std::array<CommandHandler, VICTUS_COMMAND_COUNT> handlers = {};
+  handlers[GET_FAN_SPEED] = [](const CommandArgs &args) {
+    return get_fan_speed(std::string(args.text[0]));
+  };
+  handlers[GET_FAN_MAX_SPEED] = [](const CommandArgs &args) {
+    return get_fan_max_speed(std::string(args.text[0]));
+  };
+  handlers[SET_FAN_SPEED] = [](const CommandArgs &args) {
+    return set_fan_speed(std::string(args.text[0]),
+                         std::to_string(args.value[1]), true, true);
+  };
+  handlers[GET_FAN_MODE] = [](const CommandArgs &) { return get_fan_mode(); };
+  handlers[SET_FAN_MODE] = [](const CommandArgs &args) {
+    std::string mode = normalize_mode(args.text[0]);
+    std::string response = set_fan_mode(mode);
+    if (response == "OK")
+      fan_mode_trigger(mode);
+    return response;
+  };
+  handlers[GET_CPU_TEMP] = [](const CommandArgs &) {
+    return get_cpu_temperature();
+  };
+  handlers[GET_KEYBOARD_TYPE] = [](const CommandArgs &) {
+    return get_keyboard_type();
+  };
+  handlers[GET_KEYBOARD_COLOR] = [](const CommandArgs &) {
+    return get_keyboard_color();
+  };
+  handlers[SET_KEYBOARD_COLOR] = [](const CommandArgs &args) {
+    return set_keyboard_color(rgb_string(args, 0));
+  };
+  handlers[GET_KEYBOARD_ZONE_COLOR] = [](const CommandArgs &args) {
+    return get_keyboard_zone_color(args.value[0]);
+  };
+  handlers[SET_KEYBOARD_ZONE_COLOR] = [](const CommandArgs &args) {
+    return set_keyboard_zone_color(args.value[0], rgb_string(args, 1));
+  };
+  handlers[GET_KBD_BRIGHTNESS] = [](const CommandArgs &) {
+    return get_keyboard_brightness();
+  };
+  handlers[SET_KBD_BRIGHTNESS] = [](const CommandArgs &args) {
+    return set_keyboard_brightness(std::to_string(args.value[0]));
+  };
+  // Waiting is done by the server (see state_wait_request); here, and inside
+  // a BATCH, the request is answered immediately.
+  handlers[GET_STATE_SINCE] = [](const CommandArgs &args) {
+    return state_since(static_cast<uint64_t>(args.value[0]));
+  };
+  handlers[STATS] = [](const CommandArgs &) { return stats_report(); };
+  handlers[SET_LOG_LEVEL] = [](const CommandArgs &args) -> std::string {
+    auto level = parse_log_level(args.text[0]);
+    if (!level)
+      return "ERROR: Invalid log level";
+    log_set_level(*level);
+    return "OK";
+  };
+  handlers[SELFSTAT] = [](const CommandArgs &) { return selfstat_report(); };
+  handlers[TRACE] = [](const CommandArgs &args) -> std::string {
+    if (!trace_compiled_in())
+      return "ERROR: Tracing not built in";
+    if (args.text[0] == "dump")
+      return trace_dump_json();
+    if (args.text[0] != "on" && args.text[0] != "off")
+      return "ERROR: Invalid trace action";
+    trace_set_enabled(args.text[0] == "on");
+    return "OK";
+  };
+  return handlers;
+}();
+
+constexpr bool every_command_has_a_handler() {
+  for (CommandHandler handler : kHandlers) {
+    if (!handler)
+      return false;
+  }
+  return true;
+}
+static_assert(every_command_has_a_handler(),
+              "every command in victus_commands.hpp needs a handler");
+
+std::string format_error(const VictusCommandSpec &spec) {
+  return "ERROR: Invalid " + std::string(spec.name) + " command format";
+}
+
+// Tokens are views into the frame; only arguments handed to the hardware
+// layer are copied into strings. Returns the command, or nullopt with the
+// error reply in *error.
+std::optional<VictusCommand> parse_single_command(std::string_view command_str,
+                                                  CommandArgs *args,
+                                                  std::string *error) {
+  std::string_view rest = command_str;
+  auto command = victus_find_command(next_token(&rest));
+  if (!command) {
+    *error = "ERROR: Unknown command";
+    return std::nullopt;
+  }
+
+  const VictusCommandSpec &spec = kVictusCommands[*command];
+  const size_t required = spec.arg_count - spec.optional_args;
+  size_t given = 0;
+  for (; given < spec.arg_count; ++given) {
+    if (spec.args[given].kind == VictusArgKind::Text) {
+      args->text[given] = trim_whitespace(rest);
+      rest = {};
+    } else {
+      args->text[given] = next_token(&rest);
+    }
+    if (args->text[given].empty())
+      break;
+  }
+  if (given < required || !trim_whitespace(rest).empty()) {
+    *error = format_error(spec);
+    return std::nullopt;
+  }
+
+  for (size_t i = 0; i < given; ++i) {
+    const VictusArgSpec &arg = spec.args[i];
+    if (arg.kind != VictusArgKind::Integer)
+      continue;
+    if (!parse_bounded_int(args->text[i], arg.min_value, arg.max_value,
+                           &args->value[i])) {
+      *error = arg.invalid_error.empty() ? format_error(spec)
+                                         : std::string(arg.invalid_error);
+      return std::nullopt;
+    }
+  }
+  return command;
+}
+
+// The hardware target a coalescable SET command writes, or empty.
+std::string write_target(VictusCommand command, const CommandArgs &args) {
+  switch (command) {
+  case SET_FAN_SPEED:
+    return "fan" + std::to_string(args.value[0]);
+  case SET_KEYBOARD_COLOR:
+    return "color";
+  case SET_KEYBOARD_ZONE_COLOR:
+    return "zone" + std::to_string(args.value[0]);
+  case SET_KBD_BRIGHTNESS:
+    return "brightness";
+  default:
+    return {};
+  }
+}
+
+std::string handle_single_command(std::string_view command_str,
+                                  WriteTicket ticket) {
+  CommandArgs args = {};
+  std::string error;
+  auto parse_start = StatsClock::now();
+  auto command = parse_single_command(command_str, &args, &error);
+  // BATCH items leave the row and parse time to the batch.
+  CommandTiming *timing = stats_current_command();
+  if (timing && timing->slot == kStatsUnknownSlot) {
+    timing->parse = StatsClock::now() - parse_start;
+    if (command)
+      timing->slot = *command;
+  }
+  if (!command)
+    return error;
+
+  std::string target = write_target(*command, args);
+  if (target.empty())
+    return kHandlers[*command](args);
+  return coalesce_write(ticket.client_id, target, ticket.sequence,
+                        [&] { return kHandlers[*command](args); });
+}
+
+} // namespace
+
+std::string handle_command(std::string_view command_str, WriteTicket ticket) {
+  if (command_str.substr(0, kBatchPrefix.size()) == kBatchPrefix) {
+    if (CommandTiming *timing = stats_current_command())
+      timing->slot = kStatsBatchSlot;
+    return handle_batch(command_str);
+  }
+
+  return handle_single_command(command_str, ticket);
+}
+
+std::string command_write_target(std::string_view command) {
+  CommandArgs args = {};
+  std::string error;
+  auto id = parse_single_command(command, &args, &error);
+  return id ? write_target(*id, args) : std::string();
+}
+
+WriteTicket claim_write_ticket(uint64_t client_id, std::string_view command) {
+  std::string target = command_write_target(command);
+  if (target.empty())
+    return {};
+  return {client_id, coalesce_claim(client_id, target)};
+}
+
+bool command_may_block(std::string_view command) {
+  auto line_may_block = [](std::string_view line) {
+    auto id = victus_find_command(next_token(&line));
+    return id && kVictusCommands[*id].may_block;
+  };
+
+  if (command.substr(0, kBatchPrefix.size()) != kBatchPrefix)
+    return line_may_block(command);
+
+  std::string_view lines = command.substr(kBatchPrefix.size());
+  while (!lines.empty()) {
+    size_t newline = lines.find('\n');
+    if (line_may_block(lines.substr(0, newline)))
+      return true;
+    lines.remove_prefix(newline == std::string_view::npos ? lines.size()
+                                                          : newline + 1);
+  }
+  return false;
+}
+
+std::optional<StateWaitRequest> state_wait_request(std::string_view command) {
+  CommandArgs args = {};
+  std::string error;
+  if (parse_single_command(command, &args, &error) != GET_STATE_SINCE ||
+      args.value[1] <= 0)
+    return std::nullopt;
+  return StateWaitRequest{static_cast<uint64_t>(args.value[0]),
+                          std::chrono::milliseconds(args.value[1])};
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Where a SET command stands in its client's latest-wins queue for the
+// target it writes (see coalesce.hpp). The default is never superseded.
+struct WriteTicket {
+  uint64_t client_id = 0;
+  uint64_t sequence = 0;
+};
+
+// Parses one text command (or a BATCH frame of several) and runs it.
+// Blocking: may touch sysfs or spawn the sudo helpers, so the event loop only
+// calls this from a worker thread.
+// A SET whose ticket was superseded is answered "OK: MERGED" instead of
+// being applied. BATCH items take the default ticket; inside one BATCH a
+// later SET to the same target merges the earlier ones.
+std::string handle_command(std::string_view command_str,
+                           WriteTicket ticket = {});
+
+// The target a coalescable SET command writes ("fan1", "zone2", ...), or
+// empty for every other command and for BATCH frames.
+std::string command_write_target(std::string_view command);
+
+// Claims the ticket for a coalescable SET command in arrival order; other
+// commands get the default ticket. Called by the event loop.
+WriteTicket claim_write_ticket(uint64_t client_id, std::string_view command);
+
+// True for commands the schema marks as running the sudo helpers, alone or
+// inside a BATCH; they can take seconds, so the server keeps them off the
+// lane that serves reads.
+bool command_may_block(std::string_view command);
+
+// "GET_STATE_SINCE <version> <wait_ms>" with a non-zero wait. The server
+// holds such a request until the state moves past `since` or the wait runs
+// out, instead of handing it to a worker.
+struct StateWaitRequest {
+  uint64_t since;
+  std::chrono::milliseconds timeout;
+};
+std::optional<StateWaitRequest> state_wait_request(std::string_view command);
@@ -4,14 +4,15 @@
 #include <array>
 #include <algorithm>
 #include <cerrno>
+#include <charconv>
 #include <chrono>
 #include <cmath>
 #include <cctype>
 #include <cstring>
 #include <dirent.h>
 #include <exception>
+#include <functional>
 #include <fstream>
-#include <iostream>
 #include <mutex>
 #include <optional>
 #include <sstream>
@@ -21,6 +22,13 @@
 #include <vector>
 
 #include "fan.hpp"
+#include "log.hpp"
+#include "metrics.hpp"
+#include "selfstat.hpp"
+#include "state.hpp"
+#include "stats.hpp"
+#include "telemetry_page.hpp"
+#include "trace.hpp"
 #include "util.hpp"
 #include "validation.hpp"
 
@@ -34,15 +42,35 @@ static std::string requested_mode = "AUTO";
 static std::atomic<bool> fan_mode_requires_root(false);
 
 static std::atomic<bool> better_auto_running(false);
+static std::atomic<int> better_auto_level(0);
 static std::thread better_auto_thread;
 static std::chrono::steady_clock::time_point better_auto_last_manual_assert;
 
-static std::once_flag cpu_sensor_once;
-static std::once_flag gpu_sensor_once;
-static std::once_flag gpu_usage_once;
-static std::optional<std::string> cpu_temp_path;
-static std::optional<std::string> gpu_temp_path;
-static std::optional<std::string> gpu_busy_path;
+// Control loop state. The worker owns it while it runs; it outlives a stop so
+// an upgrade handoff can pass it on and the next daemon resumes warm.
+struct BetterAutoControl {
+    int current_level = 3;
+    int sensor_level = 3;
+    std::chrono::steady_clock::time_point last_apply = std::chrono::steady_clock::time_point::min();
+    std::chrono::steady_clock::time_point cooldown_until = std::chrono::steady_clock::time_point::min();
+    int cooldown_level = 0;
+};
+static BetterAutoControl better_auto_control;
+static std::atomic<bool> better_auto_resuming(false);
+// Set once the fan state was exported to a new daemon; this one must no
+// longer drive the fans.
+static std::atomic<bool> fan_control_handed_off(false);
+
+// A sensor path and the device generation (util.hpp) it was found in; found
+// again once the uevent listener reports the devices changed.
+struct SensorPath {
+    std::mutex mutex;
+    std::optional<uint64_t> generation;
+    std::optional<std::string> path;
+};
+static SensorPath cpu_temp_sensor;
+static SensorPath gpu_temp_sensor;
+static SensorPath gpu_busy_sensor;
 static std::atomic<bool> cpu_sensor_warned(false);
 static std::atomic<bool> gpu_sensor_warned(false);
 static std::atomic<bool> gpu_usage_warned(false);
@@ -62,9 +90,9 @@ static constexpr std::chrono::seconds kBetterAutoReapply{90};
 static constexpr int kBetterAutoCooldownLevel = 5;
 static constexpr std::chrono::seconds kBetterAutoCooldown{90};
 static constexpr std::chrono::seconds kFanApplyGap{10};
-static constexpr const char *kSudoPath = "/usr/bin/sudo";
-static constexpr const char *kFanModeHelperPath = "/usr/bin/set-fan-mode.sh";
-static constexpr const char *kFanSpeedHelperPath = "/usr/bin/set-fan-speed.sh";
+static constexpr const char *kFanModeHelper = "set-fan-mode.sh";
+static constexpr const char *kFanSpeedHelper = "set-fan-speed.sh";
+static constexpr const char *kHpWmiHwmonPath = "/sys/devices/platform/hp-wmi/hwmon";
 
 static std::array<std::once_flag, 2> fan_max_once;
 static std::array<int, 2> fan_max_cache = kBetterAutoMaxFallback;
@@ -74,12 +102,8 @@ static std::array<std::chrono::steady_clock::time_point, 2> fan_last_apply = {
     std::chrono::steady_clock::time_point::min()
 };
 
-struct ThermalSnapshot {
-    std::optional<double> cpu_temp_c;
-    std::optional<double> gpu_temp_c;
-    std::optional<double> cpu_usage_pct;
-    std::optional<double> gpu_usage_pct;
-};
+static std::mutex fan_state_listener_mutex;
+static std::vector<std::function<void()>> fan_state_listeners;
 
 static std::string to_lower_copy(const std::string &input)
 {
@@ -92,7 +116,7 @@ static std::string to_lower_copy(const std::string &input)
 
 static std::optional<std::string> find_thermal_zone_by_type(const std::vector<std::string> &hints)
 {
-    DIR *dir = opendir("/sys/class/thermal");
+    DIR *dir = opendir(sysfs_path("/sys/class/thermal").c_str());
     if (!dir) {
         return std::nullopt;
     }
@@ -105,7 +129,7 @@ static std::optional<std::string> find_thermal_zone_by_type(const std::vector<st
             continue;
         }
 
-        std::string base_path = std::string("/sys/class/thermal/") + entry->d_name;
+        std::string base_path = sysfs_path("/sys/class/thermal/") + entry->d_name;
         std::ifstream type_file(base_path + "/type");
         if (!type_file) {
             continue;
@@ -134,7 +158,7 @@ static std::optional<std::string> find_thermal_zone_by_type(const std::vector<st
 static std::optional<std::string> find_hwmon_temp_sensor(const std::vector<std::string> &name_hints,
                                                          const std::vector<std::string> &label_hints)
 {
-    DIR *dir = opendir("/sys/class/hwmon");
+    DIR *dir = opendir(sysfs_path("/sys/class/hwmon").c_str());
     if (!dir) {
         return std::nullopt;
     }
@@ -147,7 +171,7 @@ static std::optional<std::string> find_hwmon_temp_sensor(const std::vector<std::
             continue;
         }
 
-        std::string base_path = std::string("/sys/class/hwmon/") + entry->d_name;
+        std::string base_path = sysfs_path("/sys/class/hwmon/") + entry->d_name;
         std::string name_path = base_path + "/name";
         std::ifstream name_file(name_path);
         std::string name_value;
@@ -218,12 +242,23 @@ static std::optional<std::string> find_hwmon_temp_sensor(const std::vector<std::
     return fallback;
 }
 
+static std::optional<std::string> resolve_sensor_path(SensorPath &sensor, std::optional<std::string> (*locate)())
+{
+    uint64_t generation = device_generation();
+    std::lock_guard<std::mutex> lock(sensor.mutex);
+    if (sensor.generation != generation) {
+        sensor.path = locate();
+        sensor.generation = generation;
+    }
+    return sensor.path;
+}
+
 static std::optional<std::string> locate_cpu_temp_sensor()
 {
-    std::call_once(cpu_sensor_once, []() {
+    return resolve_sensor_path(cpu_temp_sensor, []() {
         const std::vector<std::string> hwmon_name_hints = {"k10temp", "coretemp", "zenpower", "cpu", "package", "soc"};
         const std::vector<std::string> hwmon_label_hints = {"cpu", "package", "soc"};
-        cpu_temp_path = find_hwmon_temp_sensor(hwmon_name_hints, hwmon_label_hints);
+        auto cpu_temp_path = find_hwmon_temp_sensor(hwmon_name_hints, hwmon_label_hints);
 
         if (!cpu_temp_path) {
             const std::vector<std::string> zone_hints = {"x86_pkg", "tctl", "cpu", "soc"};
@@ -231,18 +266,18 @@ static std::optional<std::string> locate_cpu_temp_sensor()
         }
 
         if (!cpu_temp_path && !cpu_sensor_warned.exchange(true)) {
-            std::cerr << "better-auto: CPU thermal sensor not found; automatic mode will use default fan steps" << std::endl;
+            LOG_WARNING << "better-auto: CPU thermal sensor not found; automatic mode will use default fan steps";
         }
+        return cpu_temp_path;
     });
-    return cpu_temp_path;
 }
 
 static std::optional<std::string> locate_gpu_temp_sensor()
 {
-    std::call_once(gpu_sensor_once, []() {
+    return resolve_sensor_path(gpu_temp_sensor, []() {
         const std::vector<std::string> hwmon_name_hints = {"amdgpu", "radeon", "nvidia", "gpu"};
         const std::vector<std::string> hwmon_label_hints = {"edge", "gpu", "junction", "hotspot"};
-        gpu_temp_path = find_hwmon_temp_sensor(hwmon_name_hints, hwmon_label_hints);
+        auto gpu_temp_path = find_hwmon_temp_sensor(hwmon_name_hints, hwmon_label_hints);
 
         if (!gpu_temp_path) {
             const std::vector<std::string> zone_hints = {"gpu", "amdgpu", "nvidia"};
@@ -250,23 +285,24 @@ static std::optional<std::string> locate_gpu_temp_sensor()
         }
 
         if (!gpu_temp_path && !gpu_sensor_warned.exchange(true)) {
-            std::cerr << "better-auto: GPU thermal sensor not found; automatic mode will rely on CPU temperature" << std::endl;
+            LOG_WARNING << "better-auto: GPU thermal sensor not found; automatic mode will rely on CPU temperature";
         }
+        return gpu_temp_path;
     });
-    return gpu_temp_path;
 }
 
 static std::optional<std::string> locate_gpu_busy_file()
 {
-    std::call_once(gpu_usage_once, []() {
-        DIR *dir = opendir("/sys/class/drm");
+    return resolve_sensor_path(gpu_busy_sensor, []() -> std::optional<std::string> {
+        DIR *dir = opendir(sysfs_path("/sys/class/drm").c_str());
         if (!dir) {
             if (!gpu_usage_warned.exchange(true)) {
-                std::cerr << "better-auto: /sys/class/drm unavailable; GPU usage tracking disabled" << std::endl;
+                LOG_WARNING << "better-auto: /sys/class/drm unavailable; GPU usage tracking disabled";
             }
-            return;
+            return std::nullopt;
         }
 
+        std::optional<std::string> gpu_busy_path;
         struct dirent *entry;
         while ((entry = readdir(dir)) != nullptr)
         {
@@ -274,7 +310,7 @@ static std::optional<std::string> locate_gpu_busy_file()
                 continue;
             }
 
-            std::string candidate = std::string("/sys/class/drm/") + entry->d_name + "/device/gpu_busy_percent";
+            std::string candidate = sysfs_path("/sys/class/drm/") + entry->d_name + "/device/gpu_busy_percent";
             std::ifstream test(candidate);
             if (test)
             {
@@ -285,10 +321,10 @@ static std::optional<std::string> locate_gpu_busy_file()
 
         closedir(dir);
         if (!gpu_busy_path && !gpu_usage_warned.exchange(true)) {
-            std::cerr << "better-auto: GPU usage source not found; automatic mode will use temperature only" << std::endl;
+            LOG_WARNING << "better-auto: GPU usage source not found; automatic mode will use temperature only";
         }
+        return gpu_busy_path;
     });
-    return gpu_busy_path;
 }
 
 static std::optional<double> read_temperature_celsius(const std::optional<std::string> &path)
@@ -297,37 +333,55 @@ static std::optional<double> read_temperature_celsius(const std::optional<std::s
         return std::nullopt;
     }
 
-    std::ifstream file(*path);
-    if (!file) {
+    auto value = read_attribute_integer(*path);
+    if (!value) {
         return std::nullopt;
     }
 
-    long value = 0;
-    file >> value;
-    if (file.fail()) {
-        return std::nullopt;
+    return static_cast<double>(*value) / 1000.0;
+}
+
+// "cpu  user nice system idle iowait irq softirq steal ..."; older kernels
+// stop before steal, which then stays 0.
+static bool parse_cpu_line(const char *line, std::array<unsigned long long, 8> &fields)
+{
+    if (std::strncmp(line, "cpu ", 4) != 0) {
+        return false;
     }
 
-    return static_cast<double>(value) / 1000.0;
+    const char *at = line + 3;
+    size_t parsed = 0;
+    for (auto &field : fields) {
+        while (*at == ' ') {
+            ++at;
+        }
+        if (*at < '0' || *at > '9') {
+            break;
+        }
+        unsigned long long value = 0;
+        for (; *at >= '0' && *at <= '9'; ++at) {
+            value = value * 10 + static_cast<unsigned long long>(*at - '0');
+        }
+        field = value;
+        ++parsed;
+    }
+    return parsed >= 4;
 }
 
-static std::optional<double> read_cpu_usage_pct()
+std::optional<double> read_cpu_usage_pct()
 {
-    std::ifstream stat_file("/proc/stat");
-    if (!stat_file) {
+    static const std::string stat_path = sysfs_path("/proc/stat");
+    // Only the aggregate "cpu" line, which comes first.
+    char buffer[256];
+    if (read_attribute(stat_path, buffer, sizeof(buffer)) <= 0) {
         return std::nullopt;
     }
 
-    std::string line;
-    std::getline(stat_file, line);
-    std::istringstream iss(line);
-
-    std::string label;
-    unsigned long long user = 0, nice = 0, system = 0, idle = 0, iowait = 0, irq = 0, softirq = 0, steal = 0;
-    iss >> label >> user >> nice >> system >> idle >> iowait >> irq >> softirq >> steal;
-    if (label != "cpu") {
+    std::array<unsigned long long, 8> fields{};
+    if (!parse_cpu_line(buffer, fields)) {
         return std::nullopt;
     }
+    auto [user, nice, system, idle, iowait, irq, softirq, steal] = fields;
 
     unsigned long long idle_all = idle + iowait;
     unsigned long long non_idle = user + nice + system + irq + softirq + steal;
@@ -358,21 +412,15 @@ static std::optional<double> read_gpu_usage_pct()
         return std::nullopt;
     }
 
-    std::ifstream file(*path);
-    if (!file) {
+    auto value = read_attribute_integer(*path);
+    if (!value) {
         return std::nullopt;
     }
 
-    double value = 0.0;
-    file >> value;
-    if (file.fail()) {
-        return std::nullopt;
-    }
-
-    return value;
+    return static_cast<double>(*value);
 }
 
-static ThermalSnapshot collect_snapshot()
+ThermalSnapshot collect_snapshot()
 {
     ThermalSnapshot snapshot;
     snapshot.cpu_temp_c = read_temperature_celsius(locate_cpu_temp_sensor());
@@ -385,9 +433,10 @@ static ThermalSnapshot collect_snapshot()
 static int fan_max_for_index(size_t index)
 {
     std::call_once(fan_max_once[index], [index]() {
-        std::string hwmon_path = find_hwmon_directory("/sys/devices/platform/hp-wmi/hwmon");
+        std::string hwmon_path = find_hwmon_directory(sysfs_path(kHpWmiHwmonPath));
         if (!hwmon_path.empty()) {
             std::string path = hwmon_path + "/fan" + std::to_string(index + 1) + "_max";
+            TRACE_SPAN("sysfs", "read", path);
             std::ifstream file(path);
             if (file) {
                 int value = 0;
@@ -443,7 +492,7 @@ static std::array<int, 2> rpm_for_level(int level)
     return {rpm_for_level_for_fan(level, 0), rpm_for_level_for_fan(level, 1)};
 }
 
-static int level_from_snapshot(const ThermalSnapshot &snapshot, int previous_level)
+int level_from_snapshot(const ThermalSnapshot &snapshot, int previous_level)
 {
     const std::array<double, 7> temp_thresholds = {45.0, 55.0, 65.0, 70.0, 75.0, 80.0, 84.0};
     const std::array<double, 7> usage_thresholds = {15.0, 20.0, 25.0, 35.0, 45.0, 55.0, 65.0};
@@ -485,8 +534,38 @@ static int level_from_snapshot(const ThermalSnapshot &snapshot, int previous_lev
     return target_level;
 }
 
+// mode_mutex is taken from the event loop's workers, Better Auto and the
+// fan state listeners; the trace shows who waits on whom.
+static std::unique_lock<std::mutex> lock_mode_mutex()
+{
+    TRACE_SPAN("lock", "mode_mutex");
+    return std::unique_lock<std::mutex>(mode_mutex);
+}
+
+static void notify_fan_state_listener()
+{
+    std::string mode;
+    {
+        auto lock = lock_mode_mutex();
+        mode = requested_mode;
+    }
+    int level = better_auto_level.load(std::memory_order_acquire);
+    state_publish(StateField::Mode, mode);
+    state_publish(StateField::BetterAutoLevel, std::to_string(level));
+    metrics_record_mode(mode, level);
+
+    std::vector<std::function<void()>> listeners;
+    {
+        std::lock_guard<std::mutex> lock(fan_state_listener_mutex);
+        listeners = fan_state_listeners;
+    }
+    for (const auto &listener : listeners) {
+        listener();
+    }
+}
+
 static void stop_better_auto();
-static std::string start_better_auto();
+static std::string start_better_auto(bool resume);
 static void better_auto_worker();
 
 static bool encode_pwm_mode(const std::string &mode, std::string &encoded)
@@ -511,12 +590,9 @@ static bool encode_pwm_mode(const std::string &mode, std::string &encoded)
 	return false;
 }
 
-static int run_helper_command(const std::vector<std::string> &args)
+static int run_helper_command(const char *helper, const std::vector<std::string> &helper_args)
 {
-	if (args.empty()) {
-		errno = EINVAL;
-		return -1;
-	}
+	std::vector<std::string> args = helper_command(helper, helper_args);
 
 	std::vector<char *> argv;
 	argv.reserve(args.size() + 1);
@@ -525,8 +601,15 @@ static int run_helper_command(const std::vector<std::string> &args)
 	}
 	argv.push_back(nullptr);
 
-	pid_t pid = fork();
+	TRACE_SPAN("helper", helper);
+	auto started = std::chrono::steady_clock::now();
+	pid_t pid;
+	{
+		TRACE_SPAN("helper", "fork");
+		pid = fork();
+	}
 	if (pid < 0) {
+		metrics_record_helper(helper, std::chrono::steady_clock::now() - started, false);
 		return -1;
 	}
 
@@ -534,59 +617,74 @@ static int run_helper_command(const std::vector<std::string> &args)
 		execv(args.front().c_str(), argv.data());
 		_exit(127);
 	}
+	selfstat_record_fork();
 
+	TRACE_SPAN("helper", "wait");
 	int status = 0;
 	while (waitpid(pid, &status, 0) < 0) {
 		if (errno != EINTR) {
+			metrics_record_helper(helper, std::chrono::steady_clock::now() - started, false);
 			return -1;
 		}
 	}
 
+	metrics_record_helper(helper, std::chrono::steady_clock::now() - started, status == 0);
 	return status;
 }
 
+// The fan helpers take the resolved "hwmonN" as a last argument so they
+// skip their own find over the hp-wmi hwmon directory.
+static std::vector<std::string> with_hwmon_name(std::vector<std::string> helper_args)
+{
+	std::string hwmon_path = find_hwmon_directory(sysfs_path(kHpWmiHwmonPath));
+	if (!hwmon_path.empty())
+		helper_args.push_back(hwmon_path.substr(hwmon_path.rfind('/') + 1));
+	return helper_args;
+}
+
 static std::string apply_fan_mode_with_sudo(const std::string &mode)
 {
 	std::string encoded_mode;
 	if (!encode_pwm_mode(mode, encoded_mode)) {
-		return "ERROR: Invalid fan mode";
+		return error_reply(ErrorKind::InvalidArgument, "ERROR: Invalid fan mode");
 	}
 	(void)encoded_mode;
 
-	int result = run_helper_command({kSudoPath, kFanModeHelperPath, mode});
+	int result = run_helper_command(kFanModeHelper, with_hwmon_name({mode}));
 
 	if (result == 0) {
 		return "OK";
 	}
 
 	if (result == -1) {
-		std::cerr << "set-fan-mode.sh invocation failed: " << strerror(errno) << std::endl;
-		return "ERROR: Unable to set fan mode";
+		LOG_ERROR << "set-fan-mode.sh invocation failed: " << strerror(errno);
+		return error_reply(ErrorKind::Failed, "ERROR: Unable to set fan mode");
 	}
 
 	if (WIFEXITED(result)) {
-		std::cerr << "set-fan-mode.sh failed with exit code: " << WEXITSTATUS(result) << std::endl;
+		LOG_ERROR << "set-fan-mode.sh failed with exit code: " << WEXITSTATUS(result);
 	} else {
-		std::cerr << "set-fan-mode.sh terminated abnormally when setting mode " << mode << std::endl;
+		LOG_ERROR << "set-fan-mode.sh terminated abnormally when setting mode " << mode;
 	}
 
-	return "ERROR: Unable to set fan mode";
+	return error_reply(ErrorKind::Failed, "ERROR: Unable to set fan mode");
 }
 
 static std::string write_hw_fan_mode(const std::string &mode)
 {
-	std::string hwmon_path = find_hwmon_directory("/sys/devices/platform/hp-wmi/hwmon");
+	std::string hwmon_path = find_hwmon_directory(sysfs_path(kHpWmiHwmonPath));
 
 	if (!hwmon_path.empty())
 	{
 		bool use_sudo = fan_mode_requires_root.load(std::memory_order_acquire);
 		std::string encoded_mode;
 		if (!encode_pwm_mode(mode, encoded_mode)) {
-			return "ERROR: Invalid fan mode: " + mode;
+			return error_reply(ErrorKind::InvalidArgument, "ERROR: Invalid fan mode: " + mode);
 		}
 
 		if (!use_sudo) {
 			std::string control_path = hwmon_path + "/pwm1_enable";
+			TRACE_SPAN("sysfs", "write", control_path);
 			errno = 0;
 			std::ofstream fan_ctrl(control_path);
 
@@ -598,17 +696,17 @@ static std::string write_hw_fan_mode(const std::string &mode)
 				}
 
 				int write_errno = errno;
-				std::cerr << "Failed to write fan mode via sysfs: " << strerror(write_errno) << std::endl;
+				LOG_ERROR << "Failed to write fan mode via sysfs: " << strerror(write_errno);
 				if (write_errno != EACCES && write_errno != EPERM) {
-					return "ERROR: Failed to write fan mode";
+					return error_reply(ErrorKind::Failed, "ERROR: Failed to write fan mode");
 				}
 				fan_mode_requires_root.store(true, std::memory_order_release);
 				use_sudo = true;
 			} else {
 				int open_errno = errno;
-				std::cerr << "Failed to open fan mode control (" << control_path << "): " << strerror(open_errno) << std::endl;
+				LOG_ERROR << "Failed to open fan mode control (" << control_path << "): " << strerror(open_errno);
 				if (open_errno != EACCES && open_errno != EPERM) {
-					return "ERROR: Unable to set fan mode";
+					return error_reply(ErrorKind::Failed, "ERROR: Unable to set fan mode");
 				}
 				fan_mode_requires_root.store(true, std::memory_order_release);
 				use_sudo = true;
@@ -619,24 +717,32 @@ static std::string write_hw_fan_mode(const std::string &mode)
 			return apply_fan_mode_with_sudo(mode);
 		}
 
-		return "ERROR: Unable to set fan mode";
+		return error_reply(ErrorKind::Failed, "ERROR: Unable to set fan mode");
 	}
 
-	return "ERROR: Hwmon directory not found";
+	return error_reply(ErrorKind::DeviceUnavailable, "ERROR: Hwmon directory not found");
 }
 
 static void better_auto_worker()
 {
-    std::cout << "better-auto: control loop started" << std::endl;
-    int current_level = 3;
-    int sensor_level = 3;
-    auto last_apply = std::chrono::steady_clock::time_point::min();
-    better_auto_last_manual_assert = std::chrono::steady_clock::time_point::min();
-    auto cooldown_until = std::chrono::steady_clock::time_point::min();
-    int cooldown_level = 0;
+    LOG_INFO << "better-auto: control loop started";
+    if (!better_auto_resuming.exchange(false, std::memory_order_acq_rel)) {
+        better_auto_control = BetterAutoControl{};
+        better_auto_last_manual_assert = std::chrono::steady_clock::time_point::min();
+    }
+    int &current_level = better_auto_control.current_level;
+    int &sensor_level = better_auto_control.sensor_level;
+    auto &last_apply = better_auto_control.last_apply;
+    auto &cooldown_until = better_auto_control.cooldown_until;
+    int &cooldown_level = better_auto_control.cooldown_level;
 
     while (better_auto_running.load(std::memory_order_acquire)) {
+        // One span per iteration, including the idle wait at the end.
+        TRACE_SPAN("better_auto", "tick");
         ThermalSnapshot snapshot = collect_snapshot();
+        telemetry_page_publish_thermal(snapshot.cpu_temp_c, snapshot.gpu_temp_c,
+                                       snapshot.cpu_usage_pct, snapshot.gpu_usage_pct);
+        metrics_record_snapshot(snapshot);
         sensor_level = level_from_snapshot(snapshot, sensor_level);
         int target_level = sensor_level;
         auto now = std::chrono::steady_clock::now();
@@ -654,8 +760,9 @@ static void better_auto_worker()
                                  (now - better_auto_last_manual_assert >= std::chrono::seconds(80));
         if (need_mode_refresh) {
             auto refresh_result = write_hw_fan_mode("MANUAL");
+            metrics_record_mode_reassert(refresh_result == "OK");
             if (refresh_result != "OK") {
-                std::cerr << "better-auto: failed to keep manual mode active: " << refresh_result << std::endl;
+                LOG_ERROR << "better-auto: failed to keep manual mode active: " << refresh_result;
             }
             better_auto_last_manual_assert = now;
         }
@@ -675,7 +782,7 @@ static void better_auto_worker()
 
             auto result1 = set_fan_speed("1", rpm_str_fan1, false, true);
             if (result1 != "OK") {
-                std::cerr << "better-auto: failed to set fan 1 speed: " << result1 << std::endl;
+                LOG_ERROR << "better-auto: failed to set fan 1 speed: " << result1;
             }
 
             const int gap_seconds = static_cast<int>(kFanApplyGap.count());
@@ -692,17 +799,21 @@ static void better_auto_worker()
 
             auto result2 = set_fan_speed("2", rpm_str_fan2, false, true);
             if (result2 != "OK") {
-                std::cerr << "better-auto: failed to set fan 2 speed: " << result2 << std::endl;
+                LOG_ERROR << "better-auto: failed to set fan 2 speed: " << result2;
             }
 
             current_level = target_level;
             last_apply = now;
+            if (better_auto_level.exchange(current_level, std::memory_order_acq_rel) != current_level) {
+                notify_fan_state_listener();
+            }
         }
 
         if (sensor_level >= kBetterAutoCooldownLevel) {
             cooldown_level = std::max(cooldown_level, current_level);
             cooldown_until = now + kBetterAutoCooldown;
         }
+        metrics_record_cooldown(cooldown_level);
 
         const int tick_seconds = static_cast<int>(kBetterAutoTick.count());
         for (int i = 0; i < tick_seconds; ++i) {
@@ -713,7 +824,9 @@ static void better_auto_worker()
         }
     }
 
-    std::cout << "better-auto: control loop stopped" << std::endl;
+    better_auto_level.store(0, std::memory_order_release);
+    metrics_record_cooldown(0);
+    LOG_INFO << "better-auto: control loop stopped";
 }
 
 static void stop_better_auto()
@@ -728,14 +841,18 @@ static void stop_better_auto()
     better_auto_thread = std::thread();
 }
 
-static std::string start_better_auto()
+static std::string start_better_auto(bool resume)
 {
     stop_better_auto();
 
-    auto result = write_hw_fan_mode("MANUAL");
-    if (result != "OK") {
-        return result;
+    // A resumed loop inherits manual mode and its refresh schedule.
+    if (!resume) {
+        auto result = write_hw_fan_mode("MANUAL");
+        if (result != "OK") {
+            return result;
+        }
     }
+    better_auto_resuming.store(resume, std::memory_order_release);
 
     {
         std::lock_guard<std::mutex> lock(cpu_usage_mutex);
@@ -747,12 +864,14 @@ static std::string start_better_auto()
         better_auto_thread = std::thread(better_auto_worker);
     } catch (const std::exception &ex) {
         better_auto_running.store(false, std::memory_order_release);
-        std::cerr << "better-auto: failed to start worker thread: " << ex.what() << std::endl;
-        return "ERROR: Unable to start better auto control thread";
+        LOG_ERROR << "better-auto: failed to start worker thread: " << ex.what();
+        return error_reply(ErrorKind::Failed,
+                           "ERROR: Unable to start better auto control thread");
     } catch (...) {
         better_auto_running.store(false, std::memory_order_release);
-        std::cerr << "better-auto: failed to start worker thread (unknown error)" << std::endl;
-        return "ERROR: Unable to start better auto control thread";
+        LOG_ERROR << "better-auto: failed to start worker thread (unknown error)";
+        return error_reply(ErrorKind::Failed,
+                           "ERROR: Unable to start better auto control thread");
     }
 
     return "OK";
@@ -787,19 +906,19 @@ void reapply_fan_settings() {
             log_message << (has_detail ? ", " : ": ") << "fan2=" << *fan2_speed;
         }
 
-        std::cout << log_message.str() << std::endl;
+        LOG_INFO << log_message.str();
 
         if (fan1_speed) {
             auto result = set_fan_speed("1", *fan1_speed, false, false);
             if (result != "OK") {
-                std::cerr << "Failed to reapply fan 1 speed: " << result << std::endl;
+                LOG_ERROR << "Failed to reapply fan 1 speed: " << result;
             }
         }
 
         if (fan2_speed) {
             auto result = set_fan_speed("2", *fan2_speed, false, false);
             if (result != "OK") {
-                std::cerr << "Failed to reapply fan 2 speed: " << result << std::endl;
+                LOG_ERROR << "Failed to reapply fan 2 speed: " << result;
             }
         }
     }
@@ -817,8 +936,9 @@ void fan_mode_trigger(const std::string mode) {
         while (fan_thread_generation == gen) {
             // Reapply the fan mode directly via hwmon
             auto result = write_hw_fan_mode(mode);
+            metrics_record_mode_reassert(result == "OK");
             if (result != "OK") {
-                std::cerr << "fan_mode_trigger: failed to assert mode " << mode << ": " << result << std::endl;
+                LOG_ERROR << "fan_mode_trigger: failed to assert mode " << mode << ": " << result;
             }
 
             // Reapply fan settings if in manual mode
@@ -838,24 +958,22 @@ void fan_mode_trigger(const std::string mode) {
 std::string get_fan_mode()
 {
 	{
-		std::lock_guard<std::mutex> lock(mode_mutex);
+		auto lock = lock_mode_mutex();
 		if (requested_mode == "BETTER_AUTO") {
 			return requested_mode;
 		}
 	}
 
-	std::string hwmon_path = find_hwmon_directory("/sys/devices/platform/hp-wmi/hwmon");
+	std::string hwmon_path = find_hwmon_directory(sysfs_path(kHpWmiHwmonPath));
 
 	if (!hwmon_path.empty())
 	{
 		std::string pwm_path = hwmon_path + "/pwm1_enable";
-		std::ifstream fan_ctrl(pwm_path);
+		char buffer[16];
 
-		if (fan_ctrl)
+		if (read_attribute(pwm_path, buffer, sizeof(buffer)) >= 0)
 		{
-			std::stringstream buffer;
-			buffer << fan_ctrl.rdbuf();
-			std::string fan_mode = buffer.str();
+			std::string fan_mode = buffer;
 
 			fan_mode.erase(fan_mode.find_last_not_of(" \n\r\t") + 1);
 
@@ -866,35 +984,43 @@ std::string get_fan_mode()
 			else if (fan_mode == "0")
 				return "MAX";
 			else
-				return "ERROR: Unknown fan mode " + fan_mode;
+				return error_reply(ErrorKind::Failed, "ERROR: Unknown fan mode " + fan_mode);
 		}
 		else
 		{
-			std::cerr << "Failed to open fan control file. Error: " << strerror(errno) << std::endl;
-			return "ERROR: Unable to read fan mode";
+			LOG_ERROR << "Failed to open fan control file. Error: " << strerror(errno);
+			return error_reply(ErrorKind::Failed, "ERROR: Unable to read fan mode");
 		}
 	}
 	else
 	{
-		std::cerr << "Hwmon directory not found" << std::endl;
-		return "ERROR: Hwmon directory not found";
+		LOG_ERROR << "Hwmon directory not found";
+		return error_reply(ErrorKind::DeviceUnavailable, "ERROR: Hwmon directory not found");
 	}
 }
 
 std::string set_fan_mode(const std::string &mode)
 {
+    if (fan_control_handed_off.load(std::memory_order_acquire)) {
+        return error_reply(ErrorKind::Failed,
+                           "ERROR: Fan control was handed off");
+    }
+
     std::string previous_mode;
     {
-        std::lock_guard<std::mutex> lock(mode_mutex);
+        auto lock = lock_mode_mutex();
         previous_mode = requested_mode;
     }
     bool entering_manual = (mode == "MANUAL" && previous_mode != "MANUAL");
 
     if (mode == "BETTER_AUTO") {
-        auto result = start_better_auto();
+        auto result = start_better_auto(false);
         if (result == "OK") {
-            std::lock_guard<std::mutex> lock(mode_mutex);
-            requested_mode = "BETTER_AUTO";
+            {
+                auto lock = lock_mode_mutex();
+                requested_mode = "BETTER_AUTO";
+            }
+            notify_fan_state_listener();
         }
         return result;
     }
@@ -903,13 +1029,20 @@ std::string set_fan_mode(const std::string &mode)
 
     auto result = write_hw_fan_mode(mode);
     if (result == "OK") {
-        std::lock_guard<std::mutex> lock(mode_mutex);
-        requested_mode = mode;
+        {
+            auto lock = lock_mode_mutex();
+            requested_mode = mode;
+            if (entering_manual) {
+                std::lock_guard<std::mutex> speed_lock(fan_state_mutex);
+                last_fan1_speed.reset();
+                last_fan2_speed.reset();
+            }
+        }
         if (entering_manual) {
-            std::lock_guard<std::mutex> speed_lock(fan_state_mutex);
-            last_fan1_speed.reset();
-            last_fan2_speed.reset();
+            state_publish(StateField::Fan1Target, "NA");
+            state_publish(StateField::Fan2Target, "NA");
         }
+        notify_fan_state_listener();
     }
     return result;
 }
@@ -918,7 +1051,7 @@ std::string ensure_better_auto_mode()
 {
     bool needs_force = false;
     {
-        std::lock_guard<std::mutex> lock(mode_mutex);
+        auto lock = lock_mode_mutex();
         if (requested_mode != "BETTER_AUTO") {
             needs_force = true;
         } else if (!better_auto_running.load(std::memory_order_acquire)) {
@@ -930,7 +1063,7 @@ std::string ensure_better_auto_mode()
         return "OK";
     }
 
-    std::cout << "Enforcing BETTER_AUTO mode" << std::endl;
+    LOG_INFO << "Enforcing BETTER_AUTO mode";
     auto result = set_fan_mode("BETTER_AUTO");
     if (result == "OK") {
         fan_mode_trigger("BETTER_AUTO");
@@ -938,87 +1071,271 @@ std::string ensure_better_auto_mode()
     return result;
 }
 
+int get_better_auto_level()
+{
+    return better_auto_level.load(std::memory_order_acquire);
+}
+
+void add_fan_state_listener(std::function<void()> listener)
+{
+    std::lock_guard<std::mutex> lock(fan_state_listener_mutex);
+    fan_state_listeners.push_back(std::move(listener));
+}
+
 void shutdown_fan_controller()
 {
     fan_thread_generation++;
     stop_better_auto();
 }
 
-std::string get_fan_speed(const std::string &fan_num)
+static long long encode_time(std::chrono::steady_clock::time_point time)
 {
-	auto fan_index = fan_index_from_string(fan_num);
-	if (!fan_index) {
-		return "ERROR: Invalid fan number";
+    return static_cast<long long>(time.time_since_epoch().count());
+}
+
+static bool decode_time(std::string_view text, std::chrono::steady_clock::time_point *time)
+{
+    long long ticks = 0;
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), ticks);
+    if (ec != std::errc() || end != text.data() + text.size()) {
+        return false;
+    }
+    *time = std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(ticks));
+    return true;
+}
+
+std::string export_fan_controller_state()
+{
+    fan_control_handed_off.store(true, std::memory_order_release);
+    fan_thread_generation++;
+    stop_better_auto();
+
+    std::ostringstream out;
+    {
+        auto lock = lock_mode_mutex();
+        out << "mode=" << requested_mode << "\n";
+    }
+    {
+        std::lock_guard<std::mutex> lock(fan_state_mutex);
+        out << "fan1=" << last_fan1_speed.value_or("") << "\n";
+        out << "fan2=" << last_fan2_speed.value_or("") << "\n";
+    }
+    {
+        std::lock_guard<std::mutex> lock(fan_apply_mutex);
+        out << "fan1_applied=" << encode_time(fan_last_apply[0]) << "\n";
+        out << "fan2_applied=" << encode_time(fan_last_apply[1]) << "\n";
+    }
+    out << "level=" << better_auto_control.current_level << "\n";
+    out << "sensor_level=" << better_auto_control.sensor_level << "\n";
+    out << "last_apply=" << encode_time(better_auto_control.last_apply) << "\n";
+    out << "cooldown_level=" << better_auto_control.cooldown_level << "\n";
+    out << "cooldown_until=" << encode_time(better_auto_control.cooldown_until) << "\n";
+    out << "manual_assert=" << encode_time(better_auto_last_manual_assert) << "\n";
+    return out.str();
+}
+
+std::string resume_fan_controller(std::string_view state)
+{
+    std::string mode;
+    std::optional<std::string> fan1_speed;
+    std::optional<std::string> fan2_speed;
+    std::array<std::chrono::steady_clock::time_point, 2> applied = fan_last_apply;
+    BetterAutoControl control;
+    auto manual_assert = std::chrono::steady_clock::time_point::min();
+
+    while (!state.empty()) {
+        size_t newline = state.find('\n');
+        std::string_view line = state.substr(0, newline);
+        state.remove_prefix(newline == std::string_view::npos ? state.size() : newline + 1);
+
+        size_t equals = line.find('=');
+        if (equals == std::string_view::npos) {
+            continue;
+        }
+        std::string_view key = line.substr(0, equals);
+        std::string_view value = line.substr(equals + 1);
+
+        bool valid = true;
+        if (key == "mode") {
+            mode = normalize_mode(value);
+        } else if (key == "fan1" || key == "fan2") {
+            auto &speed = key == "fan1" ? fan1_speed : fan2_speed;
+            if (!value.empty()) {
+                speed = std::string(value);
+            }
+        } else if (key == "fan1_applied") {
+            valid = decode_time(value, &applied[0]);
+        } else if (key == "fan2_applied") {
+            valid = decode_time(value, &applied[1]);
+        } else if (key == "level") {
+            valid = parse_bounded_int(value, 1, kBetterAutoSteps, &control.current_level);
+        } else if (key == "sensor_level") {
+            valid = parse_bounded_int(value, 1, kBetterAutoSteps, &control.sensor_level);
+        } else if (key == "last_apply") {
+            valid = decode_time(value, &control.last_apply);
+        } else if (key == "cooldown_level") {
+            valid = parse_bounded_int(value, 0, kBetterAutoSteps, &control.cooldown_level);
+        } else if (key == "cooldown_until") {
+            valid = decode_time(value, &control.cooldown_until);
+        } else if (key == "manual_assert") {
+            valid = decode_time(value, &manual_assert);
+        }
+        if (!valid) {
+            return "ERROR: Invalid fan controller state: " + std::string(key);
+        }
+    }
+
+    if (mode != "AUTO" && mode != "MANUAL" && mode != "MAX" && mode != "BETTER_AUTO") {
+        return "ERROR: Invalid fan controller state: mode";
+    }
+
+    {
+        auto lock = lock_mode_mutex();
+        requested_mode = mode;
+    }
+    {
+        std::lock_guard<std::mutex> lock(fan_state_mutex);
+        last_fan1_speed = fan1_speed;
+        last_fan2_speed = fan2_speed;
+    }
+    {
+        std::lock_guard<std::mutex> lock(fan_apply_mutex);
+        fan_last_apply = applied;
+    }
+    fan_control_handed_off.store(false, std::memory_order_release);
+
+    LOG_INFO << "Resuming " << mode << " fan control";
+    if (mode == "BETTER_AUTO") {
+        better_auto_control = control;
+        better_auto_last_manual_assert = manual_assert;
+        better_auto_level.store(control.current_level, std::memory_order_release);
+        auto result = start_better_auto(true);
+        if (result != "OK") {
+            return result;
+        }
+    } else {
+        fan_mode_trigger(mode);
+    }
+    notify_fan_state_listener();
+    return "OK";
+}
+
+bool read_fan_speed_rpm(size_t fan_index, int *rpm, std::string *error)
+{
+	if (fan_index > 1 || !rpm) {
+		if (error) *error = error_reply(ErrorKind::InvalidArgument, "ERROR: Invalid fan number");
+		return false;
 	}
 
-	std::string hwmon_path = find_hwmon_directory("/sys/devices/platform/hp-wmi/hwmon");
+	std::string hwmon_path = find_hwmon_directory(sysfs_path(kHpWmiHwmonPath));
 
-	if (!hwmon_path.empty())
+	if (hwmon_path.empty())
 	{
-		std::string fan_path =
-		    hwmon_path + "/fan" + std::to_string(*fan_index + 1) + "_input";
-		std::ifstream fan_file(fan_path);
+		LOG_ERROR << "Hwmon directory not found";
+		if (error) *error = error_reply(ErrorKind::DeviceUnavailable, "ERROR: Hwmon directory not found");
+		return false;
+	}
 
-		if (fan_file)
-		{
-			std::stringstream buffer;
-			buffer << fan_file.rdbuf();
+	std::string fan_path =
+	    hwmon_path + "/fan" + std::to_string(fan_index + 1) + "_input";
+	char buffer[32];
 
-			std::string fan_speed = buffer.str();
+	if (read_attribute(fan_path, buffer, sizeof(buffer)) < 0)
+	{
+		LOG_ERROR << "Failed to open fan speed file. Error: " << strerror(errno);
+		if (error) *error = error_reply(ErrorKind::Failed, "ERROR: Unable to read fan speed");
+		return false;
+	}
 
-			fan_speed.erase(fan_speed.find_last_not_of(" \n\r\t") + 1);
+	auto value = parse_attribute_integer(buffer);
+	if (!value)
+	{
+		if (error) *error = error_reply(ErrorKind::Failed, "ERROR: Unable to read fan speed");
+		return false;
+	}
 
-			return fan_speed;
-		}
-		else
-		{
-			std::cerr << "Failed to open fan speed file. Error: " << strerror(errno) << std::endl;
-			return "ERROR: Unable to read fan speed";
-		}
+	*rpm = static_cast<int>(*value);
+	metrics_record_fan_rpm(fan_index, *rpm);
+	return true;
+}
+
+std::string get_fan_speed(const std::string &fan_num)
+{
+	auto fan_index = fan_index_from_string(fan_num);
+	if (!fan_index) {
+		return error_reply(ErrorKind::InvalidArgument, "ERROR: Invalid fan number");
 	}
-	else
-	{
-		std::cerr << "Hwmon directory not found" << std::endl;
-		return "ERROR: Hwmon directory not found";
+
+	int rpm = 0;
+	std::string error;
+	if (!read_fan_speed_rpm(*fan_index, &rpm, &error)) {
+		return error;
 	}
+
+	return std::to_string(rpm);
+}
+
+int fan_max_rpm(size_t fan_index)
+{
+	return fan_max_for_index(std::min<size_t>(fan_index, 1));
 }
 
 std::string get_fan_max_speed(const std::string &fan_num)
 {
 	auto fan_index = fan_index_from_string(fan_num);
 	if (!fan_index) {
-		return "ERROR: Invalid fan number";
+		return error_reply(ErrorKind::InvalidArgument, "ERROR: Invalid fan number");
 	}
 
 	return std::to_string(fan_max_for_index(*fan_index));
 }
 
+bool read_cpu_temperature_millicelsius(int *millicelsius)
+{
+	auto cpu_temp = read_temperature_celsius(locate_cpu_temp_sensor());
+	if (!cpu_temp || !millicelsius) {
+		return false;
+	}
+
+	*millicelsius = static_cast<int>(std::lround(*cpu_temp * 1000.0));
+	metrics_record_cpu_temp(*millicelsius);
+	return true;
+}
+
 std::string get_cpu_temperature()
 {
 	auto cpu_temp = read_temperature_celsius(locate_cpu_temp_sensor());
 	if (!cpu_temp) {
-		return "ERROR: CPU temperature unavailable";
+		return error_reply(ErrorKind::DeviceUnavailable, "ERROR: CPU temperature unavailable");
 	}
 
+	metrics_record_cpu_temp(static_cast<int>(std::lround(*cpu_temp * 1000.0)));
 	return std::to_string(static_cast<int>(std::lround(*cpu_temp)));
 }
 
 std::string set_fan_speed(const std::string &fan_num, const std::string &speed, bool trigger_mode, bool update_cache)
 {
+    if (fan_control_handed_off.load(std::memory_order_acquire)) {
+        return error_reply(ErrorKind::Failed,
+                           "ERROR: Fan control was handed off");
+    }
+
     auto fan_index = fan_index_from_string(fan_num);
     if (!fan_index) {
-        return "ERROR: Invalid fan number";
+        return error_reply(ErrorKind::InvalidArgument,
+                           "ERROR: Invalid fan number");
     }
 
     int parsed_speed = 0;
     if (!parse_strict_int(speed, &parsed_speed) || parsed_speed < 0) {
-        return "ERROR: Invalid fan speed";
+        return error_reply(ErrorKind::InvalidArgument,
+                           "ERROR: Invalid fan speed");
     }
 
     size_t index = *fan_index;
     int clamped_speed = clamp_to_fan_limits(index, parsed_speed);
     if (clamped_speed != parsed_speed) {
-        std::cout << "set_fan_speed: clamped fan " << fan_num << " target from " << parsed_speed << " to " << clamped_speed << std::endl;
+        LOG_INFO << "set_fan_speed: clamped fan " << fan_num << " target from " << parsed_speed << " to " << clamped_speed;
     }
     std::string clamped_str = std::to_string(clamped_speed);
     if (update_cache) {
@@ -1030,24 +1347,37 @@ std::string set_fan_speed(const std::string &fan_num, const std::string &speed,
         }
     }
 
-    std::unique_lock<std::mutex> apply_lock(fan_apply_mutex);
-    auto now = std::chrono::steady_clock::now();
-    if (index == 1 && fan_last_apply[0] != std::chrono::steady_clock::time_point::min()) {
-        auto elapsed = now - fan_last_apply[0];
-        if (elapsed < kFanApplyGap) {
-            auto wait_duration = kFanApplyGap - elapsed;
-            apply_lock.unlock();
-            std::this_thread::sleep_for(wait_duration);
-            apply_lock.lock();
+    std::unique_lock<std::mutex> apply_lock(fan_apply_mutex, std::defer_lock);
+    {
+        // Shows up as lock_wait in STATS and as one span in the trace; the
+        // gap alone can take 10 s.
+        StatsLockWait waiting;
+        TRACE_SPAN("lock", "fan_apply_mutex");
+        apply_lock.lock();
+        auto now = std::chrono::steady_clock::now();
+        if (index == 1 && fan_last_apply[0] != std::chrono::steady_clock::time_point::min()) {
+            auto elapsed = now - fan_last_apply[0];
+            if (elapsed < kFanApplyGap) {
+                auto wait_duration = kFanApplyGap - elapsed;
+                apply_lock.unlock();
+                std::this_thread::sleep_for(wait_duration);
+                apply_lock.lock();
+            }
         }
     }
 
-    int result = run_helper_command({kSudoPath, kFanSpeedHelperPath, fan_num, clamped_str});
+    int result = run_helper_command(kFanSpeedHelper, with_hwmon_name({fan_num, clamped_str}));
     fan_last_apply[index] = std::chrono::steady_clock::now();
     apply_lock.unlock();
 
     if (result == 0)
     {
+        telemetry_page_publish_fan_target(index, clamped_speed);
+        metrics_record_fan_target(index, clamped_speed);
+        if (update_cache) {
+            state_publish(index == 0 ? StateField::Fan1Target : StateField::Fan2Target,
+                          clamped_str);
+        }
         // Only trigger fan_mode_trigger if requested and not already reapplying
         if (trigger_mode && !is_reapplying.load(std::memory_order_acquire) && get_fan_mode() == "MANUAL") {
             fan_mode_trigger("MANUAL");
@@ -1055,18 +1385,18 @@ std::string set_fan_speed(const std::string &fan_num, const std::string &speed,
         return "OK";
     }
     if (result == -1) {
-        std::cerr << "Failed to execute set-fan-speed.sh for fan " << fan_num
-                  << ": " << strerror(errno) << std::endl;
-        return "ERROR: Failed to set fan speed";
+        LOG_ERROR << "Failed to execute set-fan-speed.sh for fan " << fan_num
+                  << ": " << strerror(errno);
+        return error_reply(ErrorKind::Failed, "ERROR: Failed to set fan speed");
     }
 
     if (WIFEXITED(result)) {
-        std::cerr << "Failed to execute set-fan-speed.sh for fan " << fan_num
-                  << ". Exit code: " << WEXITSTATUS(result) << std::endl;
+        LOG_ERROR << "Failed to execute set-fan-speed.sh for fan " << fan_num
+                  << ". Exit code: " << WEXITSTATUS(result);
     } else {
-        std::cerr << "set-fan-speed.sh terminated abnormally for fan "
-                  << fan_num << std::endl;
+        LOG_ERROR << "set-fan-speed.sh terminated abnormally for fan "
+                  << fan_num;
     }
 
-    return "ERROR: Failed to set fan speed";
+    return error_reply(ErrorKind::Failed, "ERROR: Failed to set fan speed");
 }
@@ -1,4 +1,10 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <optional>
 #include <string>
+#include <string_view>
 
 void fan_mode_trigger(const std::string mode);
 std::string set_fan_mode(const std::string &value);
@@ -8,5 +14,40 @@ std::string get_fan_speed(const std::string &fan_num);
 std::string get_fan_max_speed(const std::string &fan_num);
 std::string set_fan_speed(const std::string &fan_num, const std::string &speed, bool trigger_mode = true, bool update_cache = true);
 std::string get_cpu_temperature();
+
+// Typed variants for the binary protocol. fan_index is 0-based. On failure
+// the string API's "ERROR: ..." text is stored in *error when given.
+bool read_fan_speed_rpm(size_t fan_index, int *rpm, std::string *error = nullptr);
+int fan_max_rpm(size_t fan_index);
+bool read_cpu_temperature_millicelsius(int *millicelsius);
+
+// Better Auto level currently applied to the fans, 0 while it is inactive.
+int get_better_auto_level();
+// Listeners run after the fan mode or the Better Auto level changes, on the
+// thread that made the change, and must not block.
+void add_fan_state_listener(std::function<void()> listener);
+
 std::string ensure_better_auto_mode();
 void shutdown_fan_controller();
+
+// Upgrade handoff. Exporting stops the control loops and keeps this process
+// off the fans; the text carries the requested mode, cached targets and the
+// Better Auto loop state so the next daemon resumes without a cold start.
+// Resuming restarts the exported mode and returns "OK" or an "ERROR: ..."
+// reply; it also undoes an export when a handoff fails.
+std::string export_fan_controller_state();
+std::string resume_fan_controller(std::string_view state);
+
+// One Better Auto sample and the level it maps to; public so the sampling
+// path can be benchmarked (backend/tests/hot_paths_benchmark.cpp).
+struct ThermalSnapshot {
+    std::optional<double> cpu_temp_c;
+    std::optional<double> gpu_temp_c;
+    std::optional<double> cpu_usage_pct;
+    std::optional<double> gpu_usage_pct;
+};
+
+ThermalSnapshot collect_snapshot();
+// Busy share of all CPUs since the previous call; empty on the first one.
+std::optional<double> read_cpu_usage_pct();
+int level_from_snapshot(const ThermalSnapshot &snapshot, int previous_level);
@@ -0,0 +1,334 @@
+#include "handoff.hpp"
+
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <poll.h>
+#include <string_view>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "log.hpp"
+
+namespace {
+
+constexpr std::string_view kHello = "VICTUS-HANDOFF 1";
+constexpr std::string_view kClientTag = "CLIENT";
+constexpr std::string_view kPageTag = "PAGE";
+constexpr std::string_view kFanTag = "FAN";
+constexpr std::string_view kDocumentTag = "DOCUMENT";
+constexpr std::string_view kEndTag = "END";
+constexpr std::string_view kAck = "ACK";
+// The old daemon may first have to wait out a slow SET command.
+constexpr int kReceiveTimeoutSeconds = 30;
+
+bool fill_address(sockaddr_un *addr) {
+  std::memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  if (std::strlen(kHandoffSocketPath) >= sizeof(addr->sun_path))
+    return false;
+  std::strncpy(addr->sun_path, kHandoffSocketPath, sizeof(addr->sun_path) - 1);
+  return true;
+}
+
+// One SOCK_SEQPACKET message, optionally carrying a descriptor.
+bool send_message(int channel, std::string_view payload, int fd = -1) {
+  iovec iov = {const_cast<char *>(payload.data()), payload.size()};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+
+  msghdr msg = {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  if (fd >= 0) {
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+  }
+
+  ssize_t sent;
+  do {
+    sent = sendmsg(channel, &msg, MSG_NOSIGNAL);
+  } while (sent < 0 && errno == EINTR);
+  return sent == static_cast<ssize_t>(payload.size());
+}
+
+bool receive_message(int channel, std::string *payload, int *fd) {
+  *fd = -1;
+  ssize_t length;
+  do {
+    length = recv(channel, nullptr, 0, MSG_PEEK | MSG_TRUNC);
+  } while (length < 0 && errno == EINTR);
+  if (length <= 0)
+    return false;
+
+  payload->resize(static_cast<size_t>(length));
+  iovec iov = {payload->data(), payload->size()};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+  msghdr msg = {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  ssize_t received;
+  do {
+    received = recvmsg(channel, &msg, MSG_CMSG_CLOEXEC);
+  } while (received < 0 && errno == EINTR);
+
+  for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg;
+       cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+      std::memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+  }
+  if (received != length || (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC))) {
+    if (*fd >= 0)
+      close(*fd);
+    *fd = -1;
+    return false;
+  }
+  return true;
+}
+
+// Splits "<tag> <n> <n> ...\n<body>" into its numbers and body.
+bool parse_header(std::string_view message, std::string_view tag,
+                  std::vector<uint64_t> *numbers, std::string_view *body) {
+  size_t newline = message.find('\n');
+  std::string_view header = message.substr(0, newline);
+  *body = newline == std::string_view::npos ? std::string_view()
+                                            : message.substr(newline + 1);
+  if (header.substr(0, tag.size()) != tag)
+    return false;
+  header.remove_prefix(tag.size());
+
+  numbers->clear();
+  while (!header.empty()) {
+    if (header[0] != ' ')
+      return false;
+    header.remove_prefix(1);
+    uint64_t value = 0;
+    auto [end, ec] =
+        std::from_chars(header.data(), header.data() + header.size(), value);
+    if (ec != std::errc())
+      return false;
+    header.remove_prefix(static_cast<size_t>(end - header.data()));
+    numbers->push_back(value);
+  }
+  return true;
+}
+
+std::string client_message(const HandoffClient &client) {
+  std::string message = std::string(kClientTag) + " " +
+                        std::to_string(client.protocol_version) + " " +
+                        std::to_string(client.subscription.size()) + " " +
+                        std::to_string(client.input.size()) + " " +
+                        std::to_string(client.output.size()) + "\n";
+  message += client.subscription;
+  message += client.input;
+  message += client.output;
+  return message;
+}
+
+bool parse_client(std::string_view message, int fd, HandoffClient *client) {
+  std::vector<uint64_t> numbers;
+  std::string_view body;
+  if (fd < 0 || !parse_header(message, kClientTag, &numbers, &body) ||
+      numbers.size() != 4 || numbers[0] > UINT8_MAX ||
+      numbers[1] + numbers[2] + numbers[3] != body.size())
+    return false;
+
+  client->fd = fd;
+  client->protocol_version = static_cast<uint8_t>(numbers[0]);
+  client->subscription = std::string(body.substr(0, numbers[1]));
+  client->input = std::string(body.substr(numbers[1], numbers[2]));
+  client->output = std::string(body.substr(numbers[1] + numbers[2]));
+  return true;
+}
+
+} // namespace
+
+int handoff_listen() {
+  sockaddr_un addr;
+  if (!fill_address(&addr))
+    return -1;
+
+  int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    LOG_ERROR << "handoff: socket failed: " << strerror(errno);
+    return -1;
+  }
+
+  // Only the daemon's own user may take it over, whatever the directory
+  // allows.
+  unlink(kHandoffSocketPath);
+  mode_t old_umask = umask(0077);
+  int bound = bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+  umask(old_umask);
+  if (bound < 0 || listen(fd, 1) < 0) {
+    LOG_ERROR << "handoff: failed to listen on " << kHandoffSocketPath << ": "
+              << strerror(errno);
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+bool handoff_send(int channel, const HandoffState &state,
+                  std::vector<size_t> *skipped_clients) {
+  std::vector<std::string> client_messages;
+  for (size_t i = 0; i < state.clients.size(); ++i)
+    client_messages.push_back(client_message(state.clients[i]));
+
+  // A datagram larger than the send buffer fails with EMSGSIZE; such a
+  // client stopped reading long ago and is dropped rather than failing the
+  // whole upgrade.
+  int send_buffer = 0;
+  socklen_t option_length = sizeof(send_buffer);
+  getsockopt(channel, SOL_SOCKET, SO_SNDBUF, &send_buffer, &option_length);
+  size_t sendable = 0;
+  for (size_t i = 0; i < client_messages.size(); ++i) {
+    if (client_messages[i].size() > static_cast<size_t>(send_buffer) / 2)
+      skipped_clients->push_back(i);
+    else
+      ++sendable;
+  }
+
+  std::string hello = std::string(kHello) + " " + std::to_string(sendable) +
+                      " " + (state.owns_socket_path ? "1" : "0");
+  if (!send_message(channel, hello, state.listen_fd))
+    return false;
+  if (state.telemetry_page_fd >= 0 &&
+      !send_message(channel, kPageTag, state.telemetry_page_fd))
+    return false;
+
+  size_t next_skipped = 0;
+  for (size_t i = 0; i < client_messages.size(); ++i) {
+    if (next_skipped < skipped_clients->size() &&
+        (*skipped_clients)[next_skipped] == i) {
+      ++next_skipped;
+      continue;
+    }
+    if (!send_message(channel, client_messages[i], state.clients[i].fd))
+      return false;
+  }
+
+  return send_message(channel, std::string(kFanTag) + "\n" + state.fan_state) &&
+         send_message(channel, std::string(kDocumentTag) + "\n" +
+                                   state.state_document) &&
+         send_message(channel, kEndTag);
+}
+
+bool handoff_await_ack(int channel, std::chrono::milliseconds timeout) {
+  pollfd pfd = {channel, POLLIN, 0};
+  int ready;
+  do {
+    ready = poll(&pfd, 1, static_cast<int>(timeout.count()));
+  } while (ready < 0 && errno == EINTR);
+  if (ready <= 0)
+    return false;
+
+  char reply[8];
+  ssize_t length = recv(channel, reply, sizeof(reply), MSG_DONTWAIT);
+  return length == static_cast<ssize_t>(kAck.size()) &&
+         std::string_view(reply, kAck.size()) == kAck;
+}
+
+int handoff_receive(HandoffState *state) {
+  sockaddr_un addr;
+  if (!fill_address(&addr))
+    return -1;
+
+  int channel = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (channel < 0)
+    return -1;
+  timeval timeout = {kReceiveTimeoutSeconds, 0};
+  setsockopt(channel, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  if (connect(channel, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+    LOG_ERROR << "handoff: no running daemon at " << kHandoffSocketPath << ": "
+              << strerror(errno);
+    close(channel);
+    return -1;
+  }
+
+  auto fail = [&](const char *reason) {
+    LOG_ERROR << "handoff: " << reason;
+    handoff_close(state);
+    close(channel);
+    return -1;
+  };
+
+  std::string message;
+  int fd = -1;
+  std::vector<uint64_t> numbers;
+  std::string_view body;
+  if (!receive_message(channel, &message, &fd))
+    return fail("no reply from the running daemon");
+  state->listen_fd = fd;
+  if (!parse_header(message, kHello, &numbers, &body) || numbers.size() != 2 ||
+      fd < 0)
+    return fail("unsupported handoff from the running daemon");
+  size_t client_count = numbers[0];
+  state->owns_socket_path = numbers[1] != 0;
+
+  while (true) {
+    if (!receive_message(channel, &message, &fd))
+      return fail("connection lost during handoff");
+
+    if (message == kEndTag) {
+      if (fd >= 0)
+        close(fd);
+      break;
+    }
+    if (message == kPageTag && fd >= 0 && state->telemetry_page_fd < 0) {
+      state->telemetry_page_fd = fd;
+      continue;
+    }
+    if (message.rfind(kClientTag, 0) == 0) {
+      HandoffClient client;
+      if (!parse_client(message, fd, &client)) {
+        if (fd >= 0)
+          close(fd);
+        return fail("malformed client record");
+      }
+      state->clients.push_back(std::move(client));
+      continue;
+    }
+
+    if (fd >= 0)
+      close(fd);
+    if (parse_header(message, kFanTag, &numbers, &body) && numbers.empty())
+      state->fan_state = std::string(body);
+    else if (parse_header(message, kDocumentTag, &numbers, &body) &&
+             numbers.empty())
+      state->state_document = std::string(body);
+    else
+      return fail("unknown handoff record");
+  }
+
+  if (state->clients.size() != client_count)
+    return fail("client records missing from handoff");
+  return channel;
+}
+
+bool handoff_acknowledge(int channel) {
+  return send_message(channel, kAck);
+}
+
+void handoff_close(HandoffState *state) {
+  if (state->listen_fd >= 0)
+    close(state->listen_fd);
+  if (state->telemetry_page_fd >= 0)
+    close(state->telemetry_page_fd);
+  for (auto &client : state->clients) {
+    if (client.fd >= 0)
+      close(client.fd);
+  }
+  state->listen_fd = -1;
+  state->telemetry_page_fd = -1;
+  state->clients.clear();
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Zero-downtime upgrade handoff between two daemons.
+//
+// A running daemon listens on kHandoffSocketPath (owner only). A new binary
+// started with --takeover connects to it. The old daemon finishes the
+// commands in flight, then sends its listening socket, every client
+// connection with the bytes it has buffered, the telemetry page and the
+// exported fan and state-document state, one SOCK_SEQPACKET message each.
+// It exits once the new daemon acknowledges; without an acknowledgement it
+// takes its fan state back and keeps serving.
+
+constexpr const char *kHandoffSocketPath =
+    "/run/victus-control/victus_backend.handoff";
+
+struct HandoffClient {
+  int fd = -1;
+  uint8_t protocol_version = 0;
+  std::string subscription; // the SUBSCRIBE command, empty if none
+  std::string input;        // received bytes not parsed yet
+  std::string output;       // framed reply bytes not sent yet
+};
+
+struct HandoffState {
+  int listen_fd = -1;
+  // Whether the daemon bound the socket path itself (and so removes it on a
+  // final shutdown) rather than getting it from socket activation.
+  bool owns_socket_path = false;
+  int telemetry_page_fd = -1;
+  std::vector<HandoffClient> clients;
+  std::string fan_state;
+  std::string state_document;
+};
+
+// Old daemon side. Returns the listening handoff socket, or -1.
+int handoff_listen();
+// Sends the state over an accepted handoff connection. Clients whose
+// buffered bytes do not fit in one message are left out; the caller closes
+// them.
+bool handoff_send(int channel, const HandoffState &state,
+                  std::vector<size_t> *skipped_clients);
+bool handoff_await_ack(int channel, std::chrono::milliseconds timeout);
+
+// New daemon side. Connects to the running daemon and receives its state;
+// returns the channel to acknowledge on, or -1 after closing any received
+// descriptors.
+int handoff_receive(HandoffState *state);
+bool handoff_acknowledge(int channel);
+
+// Closes every descriptor the state holds.
+void handoff_close(HandoffState *state);
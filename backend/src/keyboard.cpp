@@ -1,18 +1,23 @@
 #include <array>
 #include <cctype>
 #include <cerrno>
+#include <chrono>
 #include <cstdio>
 #include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
-#include <sys/stat.h>
 #include <sys/wait.h>
 #include <unistd.h>
 #include <vector>
 
 #include "keyboard.hpp"
+#include "metrics.hpp"
+#include "selfstat.hpp"
+#include "state.hpp"
+#include "trace.hpp"
+#include "util.hpp"
 #include "validation.hpp"
 
 namespace {
@@ -26,12 +31,10 @@ constexpr const char *kSingleZoneColorPath =
     "/sys/class/leds/hp::kbd_backlight/multi_intensity";
 constexpr const char *kSingleZoneBrightnessPath =
     "/sys/class/leds/hp::kbd_backlight/brightness";
-constexpr const char *kRgbZoneWriterPath = "/usr/bin/set-rgb-zone.sh";
-constexpr const char *kSudoPath = "/usr/bin/sudo";
+constexpr const char *kRgbZoneWriter = "set-rgb-zone.sh";
 
 bool omen_4zone_exists() {
-  struct stat buffer;
-  return stat(kFourZoneZone0Path, &buffer) == 0;
+  return path_exists(sysfs_path(kFourZoneZone0Path));
 }
 
 std::string trim_trailing_whitespace(std::string value) {
@@ -44,22 +47,7 @@ std::string trim_trailing_whitespace(std::string value) {
 }
 
 std::string fourzone_zone_path(int zone) {
-  return std::string(kFourZoneZonePathPrefix) + std::to_string(zone);
-}
-
-bool parse_hex_color(const std::string &hex, std::array<int, 3> *rgb) {
-  if (hex.size() != 6)
-    return false;
-
-  try {
-    (*rgb)[0] = std::stoi(hex.substr(0, 2), nullptr, 16);
-    (*rgb)[1] = std::stoi(hex.substr(2, 2), nullptr, 16);
-    (*rgb)[2] = std::stoi(hex.substr(4, 2), nullptr, 16);
-  } catch (...) {
-    return false;
-  }
-
-  return true;
+  return sysfs_path(kFourZoneZonePathPrefix) + std::to_string(zone);
 }
 
 std::string hex_to_rgb_string(const std::string &hex) {
@@ -85,6 +73,7 @@ std::string rgb_triplet_to_hex(const std::string &color) {
 }
 
 std::string read_text_file(const std::string &path) {
+  TRACE_SPAN("sysfs", "read", path);
   std::ifstream file(path);
   if (!file)
     return "";
@@ -106,11 +95,9 @@ bool is_valid_hex_color(const std::string &hex) {
   return true;
 }
 
-int run_helper_command(const std::vector<std::string> &args) {
-  if (args.empty()) {
-    errno = EINVAL;
-    return -1;
-  }
+int run_helper_command(const char *helper,
+                       const std::vector<std::string> &helper_args) {
+  std::vector<std::string> args = helper_command(helper, helper_args);
 
   std::vector<char *> argv;
   argv.reserve(args.size() + 1);
@@ -119,37 +106,56 @@ int run_helper_command(const std::vector<std::string> &args) {
   }
   argv.push_back(nullptr);
 
-  pid_t pid = fork();
-  if (pid < 0)
+  TRACE_SPAN("helper", helper);
+  auto started = std::chrono::steady_clock::now();
+  auto record = [&](bool succeeded) {
+    metrics_record_helper(helper, std::chrono::steady_clock::now() - started,
+                          succeeded);
+  };
+  pid_t pid;
+  {
+    TRACE_SPAN("helper", "fork");
+    pid = fork();
+  }
+  if (pid < 0) {
+    record(false);
     return -1;
+  }
 
   if (pid == 0) {
     execv(args.front().c_str(), argv.data());
     _exit(127);
   }
+  selfstat_record_fork();
 
+  TRACE_SPAN("helper", "wait");
   int status = 0;
   while (waitpid(pid, &status, 0) < 0) {
-    if (errno != EINTR)
+    if (errno != EINTR) {
+      record(false);
       return -1;
+    }
   }
 
+  record(status == 0);
   return status;
 }
 
 std::string write_rgb_zone_with_helper(int zone, const std::string &hex_color) {
   if (zone < 0 || zone >= kFourZoneCount)
-    return "ERROR: Invalid zone number";
+    return error_reply(ErrorKind::InvalidArgument,
+                       "ERROR: Invalid zone number");
 
   if (!is_valid_hex_color(hex_color))
-    return "ERROR: Invalid hex color value";
+    return error_reply(ErrorKind::InvalidArgument,
+                       "ERROR: Invalid hex color value");
 
-  int status = run_helper_command(
-      {kSudoPath, kRgbZoneWriterPath, std::to_string(zone), hex_color});
+  int status =
+      run_helper_command(kRgbZoneWriter, {std::to_string(zone), hex_color});
   if (status == 0)
     return "OK";
 
-  return "ERROR: Failed to set zone color";
+  return error_reply(ErrorKind::Failed, "ERROR: Failed to set zone color");
 }
 
 std::string fourzone_brightness_value() {
@@ -159,7 +165,7 @@ std::string fourzone_brightness_value() {
     std::array<int, 3> rgb;
     std::string hex = read_text_file(fourzone_zone_path(zone));
     if (hex.empty() || !parse_hex_color(hex, &rgb))
-      return "ERROR: Failed to read zone color";
+      return error_reply(ErrorKind::Failed, "ERROR: Failed to read zone color");
 
     if (rgb[0] != 0 || rgb[1] != 0 || rgb[2] != 0)
       any_enabled = true;
@@ -168,6 +174,20 @@ std::string fourzone_brightness_value() {
   return any_enabled ? "255" : "0";
 }
 
+// Records a successful 4-zone write. Zone 0 doubles as the keyboard color and
+// the brightness follows from whether any zone is still lit.
+void publish_fourzone_zone(int zone, const std::string &color) {
+  state_publish(static_cast<StateField>(
+                    static_cast<int>(StateField::Zone0Color) + zone),
+                color);
+  if (zone == 0)
+    state_publish(StateField::KeyboardColor, color);
+
+  std::string brightness = fourzone_brightness_value();
+  if (brightness.rfind("ERROR", 0) != 0)
+    state_publish(StateField::Brightness, brightness);
+}
+
 } // namespace
 
 std::string get_keyboard_type() {
@@ -176,29 +196,30 @@ std::string get_keyboard_type() {
 
 std::string get_keyboard_color() {
   if (omen_4zone_exists()) {
-    std::string hex_val = read_text_file(kFourZoneZone0Path);
+    std::string hex_val = read_text_file(sysfs_path(kFourZoneZone0Path));
     if (!hex_val.empty())
       return hex_to_rgb_string(hex_val);
   }
 
-  std::string rgb_mode = read_text_file(kSingleZoneColorPath);
+  std::string rgb_mode = read_text_file(sysfs_path(kSingleZoneColorPath));
   if (!rgb_mode.empty()) {
     return rgb_mode;
   }
 
-  return "ERROR: RGB File not found";
+  return error_reply(ErrorKind::DeviceUnavailable, "ERROR: RGB File not found");
 }
 
 std::string get_keyboard_zone_color(int zone) {
   if (zone < 0 || zone >= kFourZoneCount)
-    return "ERROR: Invalid zone";
+    return error_reply(ErrorKind::InvalidArgument, "ERROR: Invalid zone");
 
   if (omen_4zone_exists()) {
     std::string hex_val = read_text_file(fourzone_zone_path(zone));
     if (!hex_val.empty())
       return hex_to_rgb_string(hex_val);
 
-    return "ERROR: Zone file not found";
+    return error_reply(ErrorKind::DeviceUnavailable,
+                       "ERROR: Zone file not found");
   }
 
   return get_keyboard_color();
@@ -207,7 +228,7 @@ std::string get_keyboard_zone_color(int zone) {
 std::string set_keyboard_color(const std::string &color) {
   std::array<int, 3> rgb_values;
   if (!parse_rgb_triplet(color, &rgb_values))
-    return "ERROR: Invalid RGB color";
+    return error_reply(ErrorKind::InvalidArgument, "ERROR: Invalid RGB color");
 
   std::string canonical_color = std::to_string(rgb_values[0]) + " " +
                                 std::to_string(rgb_values[1]) + " " +
@@ -216,37 +237,41 @@ std::string set_keyboard_color(const std::string &color) {
   if (omen_4zone_exists()) {
     std::string hex_val = rgb_triplet_to_hex(canonical_color);
     if (hex_val.empty())
-      return "ERROR: Invalid RGB color";
+      return error_reply(ErrorKind::InvalidArgument,
+                         "ERROR: Invalid RGB color");
 
     for (int zone = 0; zone < kFourZoneCount; zone++) {
       std::string result = write_rgb_zone_with_helper(zone, hex_val);
       if (result != "OK")
         return result;
+      publish_fourzone_zone(zone, canonical_color);
     }
 
     return "OK";
   }
 
-  std::ofstream rgb(kSingleZoneColorPath);
+  TRACE_SPAN("sysfs", "write", kSingleZoneColorPath);
+  std::ofstream rgb(sysfs_path(kSingleZoneColorPath));
   if (rgb) {
     rgb << canonical_color;
     rgb.flush();
     if (rgb.fail())
-      return "ERROR: Failed to write RGB color";
+      return error_reply(ErrorKind::Failed, "ERROR: Failed to write RGB color");
 
+    state_publish(StateField::KeyboardColor, canonical_color);
     return "OK";
   }
 
-  return "ERROR: RGB File not found";
+  return error_reply(ErrorKind::DeviceUnavailable, "ERROR: RGB File not found");
 }
 
 std::string set_keyboard_zone_color(int zone, const std::string &color) {
   if (zone < 0 || zone >= kFourZoneCount)
-    return "ERROR: Invalid zone";
+    return error_reply(ErrorKind::InvalidArgument, "ERROR: Invalid zone");
 
   std::array<int, 3> rgb_values;
   if (!parse_rgb_triplet(color, &rgb_values))
-    return "ERROR: Invalid RGB color";
+    return error_reply(ErrorKind::InvalidArgument, "ERROR: Invalid RGB color");
 
   std::string canonical_color = std::to_string(rgb_values[0]) + " " +
                                 std::to_string(rgb_values[1]) + " " +
@@ -255,9 +280,13 @@ std::string set_keyboard_zone_color(int zone, const std::string &color) {
   if (omen_4zone_exists()) {
     std::string hex_val = rgb_triplet_to_hex(canonical_color);
     if (hex_val.empty())
-      return "ERROR: Invalid RGB color";
+      return error_reply(ErrorKind::InvalidArgument,
+                         "ERROR: Invalid RGB color");
 
-    return write_rgb_zone_with_helper(zone, hex_val);
+    std::string result = write_rgb_zone_with_helper(zone, hex_val);
+    if (result == "OK")
+      publish_fourzone_zone(zone, canonical_color);
+    return result;
   }
 
   return set_keyboard_color(canonical_color);
@@ -267,31 +296,37 @@ std::string get_keyboard_brightness() {
   if (omen_4zone_exists())
     return fourzone_brightness_value();
 
-  std::ifstream brightness(kSingleZoneBrightnessPath);
+  std::ifstream brightness(sysfs_path(kSingleZoneBrightnessPath));
   if (brightness) {
-    return read_text_file(kSingleZoneBrightnessPath);
+    return read_text_file(sysfs_path(kSingleZoneBrightnessPath));
   }
 
-  return "ERROR: Keyboard Brightness File not found";
+  return error_reply(ErrorKind::DeviceUnavailable,
+                     "ERROR: Keyboard Brightness File not found");
 }
 
 std::string set_keyboard_brightness(const std::string &value) {
   int brightness_value = 0;
   if (!parse_bounded_int(value, 0, 255, &brightness_value))
-    return "ERROR: Invalid keyboard brightness";
+    return error_reply(ErrorKind::InvalidArgument,
+                       "ERROR: Invalid keyboard brightness");
 
   if (omen_4zone_exists())
     return "OK";
 
-  std::ofstream brightness(kSingleZoneBrightnessPath);
+  TRACE_SPAN("sysfs", "write", kSingleZoneBrightnessPath);
+  std::ofstream brightness(sysfs_path(kSingleZoneBrightnessPath));
   if (brightness) {
     brightness << brightness_value;
     brightness.flush();
     if (brightness.fail())
-      return "ERROR: Failed to write keyboard brightness";
+      return error_reply(ErrorKind::Failed,
+                         "ERROR: Failed to write keyboard brightness");
 
+    state_publish(StateField::Brightness, std::to_string(brightness_value));
     return "OK";
   }
 
-  return "ERROR: Keyboard Brightness File not found";
+  return error_reply(ErrorKind::DeviceUnavailable,
+                     "ERROR: Keyboard Brightness File not found");
 }
@@ -1,3 +1,5 @@
+#pragma once
+
 #include <string>
 
 std::string get_keyboard_type();
@@ -0,0 +1,312 @@
+#include "log.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+// Per thread; a power of two so indices wrap with a mask.
+constexpr size_t kRingEntries = 128;
+// Lines are batched for this long after the first one arrives.
+constexpr std::chrono::milliseconds kDrainInterval{50};
+// An idle logger wakes this rarely; it also bounds a missed wakeup.
+constexpr std::chrono::seconds kIdleWait{5};
+
+struct LogEntry {
+  uint64_t sequence;
+  LogLevel level;
+  uint16_t length;
+  std::array<char, kLogMaxLine> text;
+};
+
+// Single producer (the owning thread), single consumer (the drain thread).
+struct Ring {
+  std::array<LogEntry, kRingEntries> entries;
+  std::atomic<uint64_t> head{0}; // next slot the producer fills
+  std::atomic<uint64_t> tail{0}; // next slot the consumer reads
+  std::atomic<uint64_t> dropped{0};
+  std::atomic<bool> abandoned{false};
+};
+
+std::atomic<uint64_t> next_sequence{0};
+
+// Registration happens once per thread; the drain thread is the only other
+// user of the list.
+std::mutex rings_mutex;
+std::vector<Ring *> rings;
+
+// Marks the thread's ring for the drain thread to free once it is empty.
+struct RingOwner {
+  Ring *ring = nullptr;
+  ~RingOwner() {
+    if (ring)
+      ring->abandoned.store(true, std::memory_order_release);
+    ring = nullptr;
+  }
+};
+thread_local RingOwner ring_owner;
+
+std::atomic<bool> draining{false};
+// Set by the first line pushed since the last drain.
+std::atomic<bool> drain_wanted{false};
+std::mutex drain_mutex;
+std::condition_variable drain_cv;
+bool drain_stopping = false;
+std::thread drain_thread;
+
+LogLevel initial_level() {
+  const char *value = getenv("VICTUS_LOG_LEVEL");
+  auto level = parse_log_level(value ? value : "");
+  return level ? *level : LogLevel::Info;
+}
+
+std::atomic<uint8_t> threshold{static_cast<uint8_t>(initial_level())};
+
+// journald reads a leading "<N>" as the line's syslog priority.
+const bool syslog_prefix = getenv("JOURNAL_STREAM") != nullptr;
+
+int64_t monotonic_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+int stream_for(LogLevel level) {
+  return level >= LogLevel::Warning ? STDERR_FILENO : STDOUT_FILENO;
+}
+
+void append_line(std::string *out, LogLevel level, std::string_view text) {
+  if (syslog_prefix) {
+    static constexpr std::array<const char *, 4> kPriority = {"<7>", "<6>",
+                                                              "<4>", "<3>"};
+    *out += kPriority[static_cast<size_t>(level)];
+  }
+  *out += text;
+  *out += '\n';
+}
+
+void write_all(int fd, std::string_view data) {
+  while (!data.empty()) {
+    ssize_t written = write(fd, data.data(), data.size());
+    if (written < 0 && errno == EINTR)
+      continue;
+    if (written <= 0)
+      return;
+    data.remove_prefix(static_cast<size_t>(written));
+  }
+}
+
+void write_line(LogLevel level, std::string_view text) {
+  std::string line;
+  append_line(&line, level, text);
+  write_all(stream_for(level), line);
+}
+
+Ring *thread_ring() {
+  if (!ring_owner.ring) {
+    ring_owner.ring = new Ring();
+    std::lock_guard<std::mutex> lock(rings_mutex);
+    rings.push_back(ring_owner.ring);
+  }
+  return ring_owner.ring;
+}
+
+void push(LogLevel level, std::string_view text) {
+  Ring *ring = thread_ring();
+  uint64_t head = ring->head.load(std::memory_order_relaxed);
+  uint64_t tail = ring->tail.load(std::memory_order_acquire);
+  if (head - tail >= kRingEntries) {
+    ring->dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  LogEntry &entry = ring->entries[head & (kRingEntries - 1)];
+  entry.sequence = next_sequence.fetch_add(1, std::memory_order_relaxed);
+  entry.level = level;
+  entry.length = static_cast<uint16_t>(text.size());
+  std::memcpy(entry.text.data(), text.data(), text.size());
+  ring->head.store(head + 1, std::memory_order_release);
+
+  // Wake the drain thread for the first line of a batch, and again when the
+  // ring is nearly full. No lock is taken, so a wakeup can be missed; the
+  // timed waits bound the delay.
+  if ((!drain_wanted.load(std::memory_order_relaxed) &&
+       !drain_wanted.exchange(true, std::memory_order_acq_rel)) ||
+      head + 1 - tail >= kRingEntries * 3 / 4)
+    drain_cv.notify_one();
+}
+
+// Moves every ring's pending lines out in sequence order.
+void drain_once() {
+  std::vector<LogEntry> batch;
+  std::vector<uint64_t> dropped;
+  {
+    std::lock_guard<std::mutex> lock(rings_mutex);
+    for (auto it = rings.begin(); it != rings.end();) {
+      Ring *ring = *it;
+      bool abandoned = ring->abandoned.load(std::memory_order_acquire);
+      uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+      uint64_t head = ring->head.load(std::memory_order_acquire);
+      for (; tail != head; ++tail)
+        batch.push_back(ring->entries[tail & (kRingEntries - 1)]);
+      ring->tail.store(tail, std::memory_order_release);
+      if (uint64_t lost = ring->dropped.exchange(0, std::memory_order_relaxed))
+        dropped.push_back(lost);
+
+      if (abandoned) {
+        delete ring;
+        it = rings.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  std::sort(batch.begin(), batch.end(),
+            [](const LogEntry &a, const LogEntry &b) {
+              return a.sequence < b.sequence;
+            });
+  std::string out;
+  std::string errors;
+  for (const LogEntry &entry : batch) {
+    append_line(stream_for(entry.level) == STDERR_FILENO ? &errors : &out,
+                entry.level, std::string_view(entry.text.data(), entry.length));
+  }
+  for (uint64_t lost : dropped) {
+    append_line(&errors, LogLevel::Warning,
+                "log: dropped " + std::to_string(lost) +
+                    " lines, a thread logged faster than they were written");
+  }
+  write_all(STDOUT_FILENO, out);
+  write_all(STDERR_FILENO, errors);
+}
+
+void drain_loop() {
+  std::unique_lock<std::mutex> lock(drain_mutex);
+  while (!drain_stopping) {
+    // Sleeps until there is something to write rather than polling, so an
+    // idle daemon is not woken 20 times a second.
+    drain_cv.wait_for(lock, kIdleWait, [] {
+      return drain_stopping || drain_wanted.load(std::memory_order_acquire);
+    });
+    if (!drain_stopping)
+      drain_cv.wait_for(lock, kDrainInterval);
+    drain_wanted.store(false, std::memory_order_release);
+    lock.unlock();
+    drain_once();
+    lock.lock();
+  }
+}
+
+} // namespace
+
+bool log_enabled(LogLevel level) {
+  return static_cast<uint8_t>(level) >=
+         threshold.load(std::memory_order_relaxed);
+}
+
+void log_set_level(LogLevel level) {
+  threshold.store(static_cast<uint8_t>(level), std::memory_order_relaxed);
+}
+
+LogLevel log_level() {
+  return static_cast<LogLevel>(threshold.load(std::memory_order_relaxed));
+}
+
+std::optional<LogLevel> parse_log_level(std::string_view name) {
+  std::string lower(name);
+  for (char &ch : lower)
+    ch = static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+  for (LogLevel level : {LogLevel::Debug, LogLevel::Info, LogLevel::Warning,
+                         LogLevel::Error}) {
+    if (lower == log_level_name(level))
+      return level;
+  }
+  return std::nullopt;
+}
+
+std::string_view log_level_name(LogLevel level) {
+  switch (level) {
+  case LogLevel::Debug:
+    return "debug";
+  case LogLevel::Info:
+    return "info";
+  case LogLevel::Warning:
+    return "warning";
+  case LogLevel::Error:
+    return "error";
+  }
+  return "info";
+}
+
+void log_start() {
+  std::lock_guard<std::mutex> lock(drain_mutex);
+  if (drain_thread.joinable())
+    return;
+  drain_stopping = false;
+  drain_thread = std::thread(drain_loop);
+  draining.store(true, std::memory_order_release);
+}
+
+void log_shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(drain_mutex);
+    if (!drain_thread.joinable())
+      return;
+    draining.store(false, std::memory_order_release);
+    drain_stopping = true;
+  }
+  drain_cv.notify_one();
+  drain_thread.join();
+  // Lines pushed while the thread was stopping.
+  drain_once();
+}
+
+bool LogSite::admit() {
+  int64_t now = monotonic_ns();
+  int64_t start = window_start.load(std::memory_order_relaxed);
+  if (now - start >= kLogWindowNs &&
+      window_start.compare_exchange_strong(start, now,
+                                           std::memory_order_relaxed))
+    in_window.store(0, std::memory_order_relaxed);
+
+  if (in_window.fetch_add(1, std::memory_order_relaxed) < kLogBurst)
+    return true;
+  suppressed.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+LogLine::LogLine(LogLevel level, LogSite &site)
+    : level(level), site(site), admitted(site.admit()) {}
+
+LogLine::~LogLine() {
+  if (!admitted)
+    return;
+  if (uint64_t skipped = site.take_suppressed()) {
+    *this << " (" << skipped << " similar lines suppressed)";
+  }
+  std::string_view line(text.data(), length);
+  if (draining.load(std::memory_order_acquire))
+    push(level, line);
+  else
+    write_line(level, line);
+}
+
+LogLine &LogLine::operator<<(std::string_view piece) {
+  if (!admitted)
+    return *this;
+  size_t room = text.size() - length;
+  size_t taken = std::min(room, piece.size());
+  std::memcpy(text.data() + length, piece.data(), taken);
+  length += taken;
+  return *this;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Leveled logging that stays off the latency path.
+//
+//   LOG_INFO << "better-auto: control loop started";
+//   LOG_ERROR << "Bind failed: " << strerror(errno);
+//
+// A line is formatted into a fixed buffer on the calling thread and pushed
+// into that thread's single-producer ring; a background thread drains every
+// ring in order and writes the lines out, so the caller never takes a lock,
+// flushes or blocks on the journal. A full ring drops the line and the drain
+// thread reports how many were lost. Lines are cut at kLogMaxLine bytes.
+//
+// Each call site lets through kLogBurst lines per kLogWindow; the rest are
+// counted and the next line that gets through says how many were skipped.
+//
+// Debug and Info go to stdout, Warning and Error to stderr. Under systemd the
+// lines carry a "<N>" syslog priority prefix, which journald strips.
+
+enum class LogLevel : uint8_t { Debug, Info, Warning, Error };
+
+constexpr size_t kLogMaxLine = 240;
+constexpr int kLogBurst = 5;
+constexpr int64_t kLogWindowNs = 10'000'000'000; // 10 s
+
+// Current threshold; starts at $VICTUS_LOG_LEVEL, else Info.
+bool log_enabled(LogLevel level);
+void log_set_level(LogLevel level);
+LogLevel log_level();
+// "debug", "info", "warning" or "error", case-insensitive.
+std::optional<LogLevel> parse_log_level(std::string_view name);
+std::string_view log_level_name(LogLevel level);
+
+// Starts the drain thread. Until then (and in tests) lines are written
+// synchronously. Call after any fork; log_shutdown() flushes and stops it.
+void log_start();
+void log_shutdown();
+
+// Per-call-site rate limit state; see LOG_AT.
+class LogSite {
+public:
+  bool admit();
+  // Lines skipped since the last one let through, reset by reading.
+  uint64_t take_suppressed() {
+    return suppressed.exchange(0, std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<int64_t> window_start{0};
+  std::atomic<int> in_window{0};
+  std::atomic<uint64_t> suppressed{0};
+};
+
+// One line being formatted; submitted when it goes out of scope.
+class LogLine {
+public:
+  // Asks the site whether the line is within its rate limit; a line that
+  // is not ignores everything streamed into it.
+  LogLine(LogLevel level, LogSite &site);
+  ~LogLine();
+  LogLine(const LogLine &) = delete;
+  LogLine &operator=(const LogLine &) = delete;
+
+  LogLine &operator<<(std::string_view text);
+  LogLine &operator<<(const char *text) {
+    return *this << std::string_view(text ? text : "(null)");
+  }
+  LogLine &operator<<(const std::string &text) {
+    return *this << std::string_view(text);
+  }
+  LogLine &operator<<(char ch) { return *this << std::string_view(&ch, 1); }
+  LogLine &operator<<(bool value) {
+    return *this << (value ? "true" : "false");
+  }
+  template <typename T,
+            typename = std::enable_if_t<std::is_arithmetic_v<T>>>
+  LogLine &operator<<(T value) {
+    if (!admitted)
+      return *this;
+    char number[32];
+    auto result = std::to_chars(number, number + sizeof(number), value);
+    return *this << std::string_view(number,
+                                     static_cast<size_t>(result.ptr - number));
+  }
+
+private:
+  LogLevel level;
+  LogSite &site;
+  bool admitted;
+  size_t length = 0;
+  std::array<char, kLogMaxLine> text;
+};
+
+// Makes LOG_AT an expression, so it nests under an unbraced if/else.
+struct LogVoidify {
+  void operator&(const LogLine &) {}
+};
+
+// A disabled level skips the line, arguments included; each expansion gets
+// its own static LogSite.
+#define LOG_AT(level)                                                          \
+  !log_enabled(level) ? (void)0                                                \
+                      : LogVoidify() & LogLine(level, []() -> LogSite & {      \
+                          static LogSite victus_log_site;                      \
+                          return victus_log_site;                              \
+                        }())
+
+#define LOG_DEBUG LOG_AT(LogLevel::Debug)
+#define LOG_INFO LOG_AT(LogLevel::Info)
+#define LOG_WARNING LOG_AT(LogLevel::Warning)
+#define LOG_ERROR LOG_AT(LogLevel::Error)
@@ -1,294 +1,261 @@
-#include <atomic>
+#include <cerrno>
+#include <chrono>
 #include <csignal>
-#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
 #include <cstring>
-#include <iostream>
-#include <sstream>
+#include <fcntl.h>
 #include <string>
+#include <string_view>
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/un.h>
+#include <sys/wait.h>
 #include <thread>
 #include <unistd.h>
-#include <vector>
+#include <utility>
 
 #include "fan.hpp"
+#include "handoff.hpp"
 #include "keyboard.hpp"
-#include "validation.hpp"
+#include "log.hpp"
+#include "metrics.hpp"
+#include "server.hpp"
+#include "state.hpp"
+#include "telemetry_page.hpp"
+#include "uevent.hpp"
 
 #define SOCKET_DIR "/run/victus-control"
 #define SOCKET_PATH SOCKET_DIR "/victus_backend.sock"
 
 namespace {
 
-constexpr uint32_t kMaxCommandLength = 1024;
-
-std::atomic<int> active_clients{0};
-std::atomic<bool> server_running{true};
-int g_server_socket = -1;
-
-void on_client_connected() {
-  int current = active_clients.fetch_add(1) + 1;
-  std::cout << "Client connected (active: " << current << ")" << std::endl;
-}
+// First descriptor systemd passes to socket-activated services.
+constexpr int kListenFdsStart = 3;
+
+void signal_handler(int) { request_server_stop(); }
+
+// Returns the listening socket handed over by systemd socket activation
+// (LISTEN_PID/LISTEN_FDS, see sd_listen_fds(3)), or -1 when the daemon was
+// started directly. Parsed by hand to avoid a libsystemd dependency.
+int take_activated_socket() {
+  const char *pid_env = getenv("LISTEN_PID");
+  const char *fds_env = getenv("LISTEN_FDS");
+  if (!pid_env || !fds_env)
+    return -1;
+
+  // The variables are only meant for us; do not leak them to the helpers.
+  std::string pid_str = pid_env;
+  std::string fds_str = fds_env;
+  unsetenv("LISTEN_PID");
+  unsetenv("LISTEN_FDS");
+  unsetenv("LISTEN_FDNAMES");
+
+  if (pid_str != std::to_string(getpid()))
+    return -1;
+  if (fds_str != "1") {
+    LOG_ERROR << "Expected exactly one activated socket, got LISTEN_FDS="
+              << fds_str;
+    return -1;
+  }
 
-void on_client_disconnected() {
-  int previous = active_clients.fetch_sub(1);
-  int current = previous - 1;
-  if (previous <= 0) {
-    active_clients.store(0);
-    current = 0;
+  int fd = kListenFdsStart;
+  int type = 0;
+  int listening = 0;
+  socklen_t len = sizeof(type);
+  if (getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &len) < 0 ||
+      type != SOCK_STREAM) {
+    LOG_ERROR << "Activated descriptor is not a stream socket";
+    return -1;
   }
-  std::cout << "Client disconnected (active: " << current << ")" << std::endl;
-
-  if (current == 0) {
-    auto result = ensure_better_auto_mode();
-    if (result != "OK") {
-      std::cerr
-          << "Failed to enforce BETTER_AUTO mode after client disconnect: "
-          << result << std::endl;
-    }
+  len = sizeof(listening);
+  if (getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &len) < 0 ||
+      !listening) {
+    LOG_ERROR << "Activated socket is not listening";
+    return -1;
   }
-}
 
-void signal_handler(int) {
-  server_running.store(false, std::memory_order_release);
-  if (g_server_socket >= 0) {
-    close(g_server_socket);
-    g_server_socket = -1;
-  }
+  fcntl(fd, F_SETFD, FD_CLOEXEC);
+  return fd;
 }
 
-bool send_all(int socket, const void *buffer, size_t length) {
-  const char *ptr = static_cast<const char *>(buffer);
-  while (length > 0) {
-    ssize_t bytes_sent = send(socket, ptr, length, 0);
-    if (bytes_sent < 0) {
-      if (errno == EINTR)
-        continue;
-      std::cerr << "Failed to send data: " << strerror(errno) << std::endl;
-      return false;
-    }
-    if (bytes_sent == 0) {
-      std::cerr << "Socket closed while sending data" << std::endl;
-      return false;
-    }
-    ptr += bytes_sent;
-    length -= static_cast<size_t>(bytes_sent);
-  }
-  return true;
-}
+int bind_socket() {
+  struct sockaddr_un server_addr;
 
-bool read_all(int socket, void *buffer, size_t length) {
-  char *ptr = static_cast<char *>(buffer);
-  while (length > 0) {
-    ssize_t bytes_read = read(socket, ptr, length);
-    if (bytes_read < 0) {
-      if (errno == EINTR)
-        continue;
-      return false;
-    }
-    if (bytes_read == 0)
-      return false;
-    ptr += bytes_read;
-    length -= static_cast<size_t>(bytes_read);
+  unlink(SOCKET_PATH);
+
+  int server_socket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (server_socket < 0) {
+    LOG_ERROR << "Error creating socket: " << strerror(errno);
+    return -1;
   }
-  return true;
-}
 
-bool send_u32_le(int socket, uint32_t value) {
-  unsigned char bytes[4] = {
-      static_cast<unsigned char>(value & 0xFF),
-      static_cast<unsigned char>((value >> 8) & 0xFF),
-      static_cast<unsigned char>((value >> 16) & 0xFF),
-      static_cast<unsigned char>((value >> 24) & 0xFF),
-  };
-  return send_all(socket, bytes, sizeof(bytes));
-}
+  memset(&server_addr, 0, sizeof(server_addr));
+  server_addr.sun_family = AF_UNIX;
+  strncpy(server_addr.sun_path, SOCKET_PATH, sizeof(server_addr.sun_path) - 1);
 
-bool read_u32_le(int socket, uint32_t *value) {
-  if (!value)
-    return false;
+  if (bind(server_socket, (struct sockaddr *)&server_addr,
+           sizeof(server_addr)) < 0) {
+    LOG_ERROR << "Bind failed: " << strerror(errno);
+    close(server_socket);
+    return -1;
+  }
 
-  unsigned char bytes[4];
-  if (!read_all(socket, bytes, sizeof(bytes)))
-    return false;
+  if (chmod(SOCKET_PATH, 0660) < 0) {
+    LOG_ERROR << "Failed to set socket permissions: " << strerror(errno);
+    close(server_socket);
+    return -1;
+  }
 
-  *value = static_cast<uint32_t>(bytes[0]) |
-           (static_cast<uint32_t>(bytes[1]) << 8) |
-           (static_cast<uint32_t>(bytes[2]) << 16) |
-           (static_cast<uint32_t>(bytes[3]) << 24);
-  return true;
+  if (listen(server_socket, SOMAXCONN) < 0) {
+    LOG_ERROR << "Listen failed: " << strerror(errno);
+    close(server_socket);
+    return -1;
+  }
+  return server_socket;
 }
 
-std::string trim(const std::string &input) {
-  size_t start = input.find_first_not_of(" \t\r\n");
-  if (start == std::string::npos)
-    return "";
+// sd_notify(3), also by hand. Only needed for the MAINPID hint of a takeover.
+void notify_systemd(const std::string &message) {
+  const char *path = getenv("NOTIFY_SOCKET");
+  if (!path || (path[0] != '/' && path[0] != '@'))
+    return;
 
-  size_t end = input.find_last_not_of(" \t\r\n");
-  return input.substr(start, end - start + 1);
-}
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  size_t length = strlen(path);
+  if (length >= sizeof(addr.sun_path))
+    return;
+  memcpy(addr.sun_path, path, length);
+  if (addr.sun_path[0] == '@')
+    addr.sun_path[0] = '\0'; // abstract namespace
 
-bool has_extra_tokens(std::stringstream &ss) {
-  std::string extra;
-  return static_cast<bool>(ss >> extra);
+  int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return;
+  sendto(fd, message.data(), message.size(), MSG_NOSIGNAL,
+         (struct sockaddr *)&addr,
+         static_cast<socklen_t>(offsetof(struct sockaddr_un, sun_path) +
+                                length));
+  close(fd);
 }
 
-void send_response(int client_socket, const std::string &response) {
-  uint32_t len = static_cast<uint32_t>(response.size());
-  if (!send_u32_le(client_socket, len))
-    return;
-  if (!send_all(client_socket, response.data(), len))
+// `victus-backend --takeover` runs as the unit's ExecReload, which has to
+// return. The child becomes the new daemon; the parent exits with the
+// outcome once the running daemon has handed over. Returns in the child.
+void detach_for_reload(int *ready_pipe) {
+  *ready_pipe = -1;
+  if (!getenv("NOTIFY_SOCKET"))
     return;
-}
 
-void handle_command(const std::string &command_str, int client_socket) {
-  std::stringstream ss(command_str);
-  std::string command;
-  ss >> command;
-
-  std::string response;
-
-  if (command == "GET_FAN_SPEED") {
-    std::string fan_num;
-    ss >> fan_num;
-    if (!fan_num.empty() && !has_extra_tokens(ss)) {
-      response = get_fan_speed(fan_num);
-    } else {
-      response = "ERROR: Invalid GET_FAN_SPEED command format";
-    }
-  } else if (command == "GET_FAN_MAX_SPEED") {
-    std::string fan_num;
-    ss >> fan_num;
-    if (!fan_num.empty() && !has_extra_tokens(ss)) {
-      response = get_fan_max_speed(fan_num);
-    } else {
-      response = "ERROR: Invalid GET_FAN_MAX_SPEED command format";
-    }
-  } else if (command == "SET_FAN_SPEED") {
-    std::string fan_num;
-    std::string speed;
-    ss >> fan_num >> speed;
-    if (!fan_num.empty() && !speed.empty() && !has_extra_tokens(ss)) {
-      response = set_fan_speed(fan_num, speed, true, true);
-    } else {
-      response = "ERROR: Invalid SET_FAN_SPEED command format";
-    }
-  } else if (command == "SET_FAN_MODE") {
-    std::string remainder;
-    std::getline(ss, remainder);
-    remainder = trim(remainder);
-    if (remainder.empty()) {
-      response = "ERROR: Invalid SET_FAN_MODE command format";
-    } else {
-      std::string mode = normalize_mode(remainder);
-      response = set_fan_mode(mode);
-      if (response == "OK")
-        fan_mode_trigger(mode);
-    }
-  } else if (command == "GET_FAN_MODE") {
-    if (!has_extra_tokens(ss)) {
-      response = get_fan_mode();
-    } else {
-      response = "ERROR: Invalid GET_FAN_MODE command format";
-    }
-  } else if (command == "GET_CPU_TEMP") {
-    if (!has_extra_tokens(ss)) {
-      response = get_cpu_temperature();
-    } else {
-      response = "ERROR: Invalid GET_CPU_TEMP command format";
-    }
-  } else if (command == "GET_KEYBOARD_COLOR") {
-    if (!has_extra_tokens(ss)) {
-      response = get_keyboard_color();
-    } else {
-      response = "ERROR: Invalid GET_KEYBOARD_COLOR command format";
-    }
-  } else if (command == "SET_KEYBOARD_COLOR") {
-    std::string r, g, b;
-    ss >> r >> g >> b;
-    if (!r.empty() && !g.empty() && !b.empty() && !has_extra_tokens(ss)) {
-      response = set_keyboard_color(r + " " + g + " " + b);
-    } else {
-      response = "ERROR: Invalid SET_KEYBOARD_COLOR command format";
-    }
-  } else if (command == "SET_KEYBOARD_ZONE_COLOR") {
-    std::string zone_str, r, g, b;
-    ss >> zone_str >> r >> g >> b;
-    int zone = 0;
-    if (!zone_str.empty() && !r.empty() && !g.empty() && !b.empty() &&
-        !has_extra_tokens(ss) &&
-        parse_bounded_int(zone_str, 0, 3, &zone)) {
-      response = set_keyboard_zone_color(zone, r + " " + g + " " + b);
-    } else {
-      response = "ERROR: Invalid SET_KEYBOARD_ZONE_COLOR command format";
-    }
-  } else if (command == "GET_KEYBOARD_ZONE_COLOR") {
-    std::string zone_str;
-    int zone = 0;
-    ss >> zone_str;
-    if (!zone_str.empty() && !has_extra_tokens(ss) &&
-        parse_bounded_int(zone_str, 0, 3, &zone)) {
-      response = get_keyboard_zone_color(zone);
-    } else {
-      response = "ERROR: Invalid GET_KEYBOARD_ZONE_COLOR command format";
-    }
-  } else if (command == "GET_KEYBOARD_TYPE") {
-    if (!has_extra_tokens(ss)) {
-      response = get_keyboard_type();
-    } else {
-      response = "ERROR: Invalid GET_KEYBOARD_TYPE command format";
-    }
-  } else if (command == "GET_KBD_BRIGHTNESS") {
-    if (!has_extra_tokens(ss)) {
-      response = get_keyboard_brightness();
-    } else {
-      response = "ERROR: Invalid GET_KBD_BRIGHTNESS command format";
-    }
-  } else if (command == "SET_KBD_BRIGHTNESS") {
-    std::string value;
-    ss >> value;
-    if (!value.empty() && !has_extra_tokens(ss)) {
-      response = set_keyboard_brightness(value);
-    } else {
-      response = "ERROR: Invalid SET_KBD_BRIGHTNESS command format";
-    }
-  } else {
-    response = "ERROR: Unknown command";
+  int fds[2];
+  if (pipe2(fds, O_CLOEXEC) < 0)
+    return;
+  pid_t child = fork();
+  if (child < 0) {
+    close(fds[0]);
+    close(fds[1]);
+    return;
+  }
+  if (child == 0) {
+    close(fds[0]);
+    *ready_pipe = fds[1];
+    return;
   }
 
-  send_response(client_socket, response);
+  close(fds[1]);
+  char ready = 0;
+  ssize_t got;
+  do {
+    got = read(fds[0], &ready, 1);
+  } while (got < 0 && errno == EINTR);
+  if (got != 1) {
+    int status = 0;
+    waitpid(child, &status, 0);
+  }
+  _exit(got == 1 ? 0 : 1);
 }
 
-void handle_client(int client_socket) {
-  on_client_connected();
-
-  while (server_running.load(std::memory_order_acquire)) {
-    uint32_t cmd_len = 0;
-    if (!read_u32_le(client_socket, &cmd_len))
-      break;
+// Receives the running daemon's sockets and state. systemd learns the new
+// main PID before the old daemon is told to exit, so the unit stays up.
+bool take_over_running_daemon(HandoffState *state) {
+  int channel = handoff_receive(state);
+  if (channel < 0)
+    return false;
 
-    if (cmd_len == 0 || cmd_len > kMaxCommandLength) {
-      std::cerr << "Command too long or empty (" << cmd_len
-                << " bytes). Closing connection.\n";
-      break;
-    }
+  notify_systemd("MAINPID=" + std::to_string(getpid()));
+  if (!handoff_acknowledge(channel)) {
+    LOG_ERROR << "handoff: the running daemon gave up waiting";
+    struct ucred peer;
+    socklen_t length = sizeof(peer);
+    if (getsockopt(channel, SOL_SOCKET, SO_PEERCRED, &peer, &length) == 0)
+      notify_systemd("MAINPID=" + std::to_string(peer.pid));
+    close(channel);
+    handoff_close(state);
+    return false;
+  }
+  close(channel);
+
+  if (!state_import(state->state_document))
+    LOG_WARNING << "handoff: ignoring malformed state document";
+  if (state->telemetry_page_fd >= 0 &&
+      !telemetry_page_adopt(std::exchange(state->telemetry_page_fd, -1)))
+    LOG_ERROR << "handoff: failed to adopt the telemetry page";
+  auto result = resume_fan_controller(state->fan_state);
+  if (result != "OK") {
+    LOG_ERROR << "handoff: " << result;
+    result = ensure_better_auto_mode();
+    if (result != "OK")
+      LOG_ERROR << "Failed to enforce BETTER_AUTO mode: " << result;
+  }
+  LOG_INFO << "Took over " << state->clients.size()
+           << " connections from the running daemon";
+  return true;
+}
 
-    std::vector<char> buffer(cmd_len);
-    if (!read_all(client_socket, buffer.data(), cmd_len))
-      break;
+// Seeds the state document with what the hardware reports at startup;
+// afterwards the setters keep it current.
+void prime_state_document() {
+  auto publish = [](StateField field, const std::string &value) {
+    if (value.rfind("ERROR", 0) != 0)
+      state_publish(field, value);
+  };
 
-    handle_command(std::string(buffer.begin(), buffer.end()), client_socket);
+  std::string keyboard_type = get_keyboard_type();
+  publish(StateField::KeyboardType, keyboard_type);
+  publish(StateField::KeyboardColor, get_keyboard_color());
+  if (keyboard_type == "FOUR_ZONE") {
+    for (int zone = 0; zone < 4; ++zone)
+      publish(static_cast<StateField>(
+                  static_cast<int>(StateField::Zone0Color) + zone),
+              get_keyboard_zone_color(zone));
   }
-
-  close(client_socket);
-  on_client_disconnected();
+  publish(StateField::Brightness, get_keyboard_brightness());
+  publish(StateField::Mode, get_fan_mode());
+  publish(StateField::BetterAutoLevel, std::to_string(get_better_auto_level()));
 }
 
+// Log lines go through the drain thread while main() runs and are flushed
+// on every way out of it.
+struct LogSession {
+  LogSession() { log_start(); }
+  ~LogSession() { log_shutdown(); }
+  LogSession(const LogSession &) = delete;
+  LogSession &operator=(const LogSession &) = delete;
+};
+
 } // namespace
 
-int main() {
+int main(int argc, char **argv) {
+  const auto started_at = std::chrono::steady_clock::now();
+  bool takeover = argc > 1 && std::string_view(argv[1]) == "--takeover";
+  int ready_pipe = -1;
+  if (takeover)
+    detach_for_reload(&ready_pipe);
+  // After the fork, which would leave the child without the drain thread.
+  LogSession log_session;
+
   struct sigaction sa = {};
   sa.sa_handler = signal_handler;
   sigemptyset(&sa.sa_mask);
@@ -296,73 +263,78 @@ int main() {
   sigaction(SIGTERM, &sa, nullptr);
   sigaction(SIGINT, &sa, nullptr);
 
-  int server_socket;
-  struct sockaddr_un server_addr;
-
-  unlink(SOCKET_PATH);
-
-  server_socket = socket(AF_UNIX, SOCK_STREAM, 0);
-  if (server_socket < 0) {
-    std::cerr << "Error creating socket: " << strerror(errno) << std::endl;
-    return 1;
-  }
-  g_server_socket = server_socket;
-
-  memset(&server_addr, 0, sizeof(server_addr));
-  server_addr.sun_family = AF_UNIX;
-  strncpy(server_addr.sun_path, SOCKET_PATH, sizeof(server_addr.sun_path) - 1);
-
-  if (bind(server_socket, (struct sockaddr *)&server_addr,
-           sizeof(server_addr)) < 0) {
-    std::cerr << "Bind failed: " << strerror(errno) << std::endl;
-    close(server_socket);
-    g_server_socket = -1;
-    return 1;
-  }
-
-  if (chmod(SOCKET_PATH, 0660) < 0) {
-    std::cerr << "Failed to set socket permissions: " << strerror(errno)
-              << std::endl;
-    close(server_socket);
-    g_server_socket = -1;
-    return 1;
-  }
-
-  if (listen(server_socket, 5) < 0) {
-    std::cerr << "Listen failed: " << strerror(errno) << std::endl;
-    close(server_socket);
-    g_server_socket = -1;
-    return 1;
+  // Device paths are cached only while uevents can invalidate them.
+  uevent_start();
+
+  ServerOptions options;
+  options.started_at = started_at;
+  HandoffState adopted;
+  int server_socket = -1;
+  std::thread startup_mode;
+
+  if (takeover) {
+    if (!take_over_running_daemon(&adopted))
+      return 1;
+    server_socket = std::exchange(adopted.listen_fd, -1);
+    options.adopted = &adopted;
+    options.owns_socket_path = adopted.owns_socket_path;
+  } else {
+    server_socket = take_activated_socket();
+    bool activated = server_socket >= 0;
+    if (!activated)
+      server_socket = bind_socket();
+    if (server_socket < 0)
+      return 1;
+    // A socket-activated path belongs to systemd and must survive restarts.
+    options.owns_socket_path = !activated;
+
+    LOG_INFO << (activated ? "Using socket passed by systemd"
+                           : "Server is listening...");
+
+    // Enforcing the startup mode forks the sudo helpers and runs hardware
+    // discovery; do it off the main thread so clients are served right away.
+    startup_mode = std::thread([]() {
+      auto ensure_result = ensure_better_auto_mode();
+      if (ensure_result != "OK") {
+        LOG_ERROR << "Failed to enforce initial BETTER_AUTO mode: "
+                  << ensure_result;
+      }
+      prime_state_document();
+    });
   }
 
-  std::cout << "Server is listening..." << std::endl;
-
-  auto ensure_result = ensure_better_auto_mode();
-  if (ensure_result != "OK") {
-    std::cerr << "Failed to enforce initial BETTER_AUTO mode: " << ensure_result
-              << std::endl;
+  // Metrics are opt-in: node_exporter picks up the file when its textfile
+  // collector points at that directory.
+  const char *metrics_file = getenv("VICTUS_METRICS_FILE");
+  if (metrics_file && *metrics_file && !metrics_start(metrics_file))
+    LOG_WARNING << "Metrics disabled.";
+
+  // Upgrades are optional; the daemon serves clients either way.
+  options.handoff_socket = handoff_listen();
+  if (ready_pipe >= 0) {
+    char ready = 1;
+    ssize_t ignored = write(ready_pipe, &ready, 1);
+    (void)ignored;
+    close(ready_pipe);
   }
 
-  while (server_running.load(std::memory_order_acquire)) {
-    int client_socket = accept(server_socket, nullptr, nullptr);
-    if (client_socket < 0) {
-      if (!server_running.load(std::memory_order_acquire))
-        break;
-      if (errno == EINTR)
-        continue;
-      perror("accept");
-      continue;
-    }
-
-    std::thread(handle_client, client_socket).detach();
-  }
+  int exit_code = run_server(server_socket, options);
+  bool handed_off = server_handed_off();
 
-  if (g_server_socket >= 0) {
-    close(g_server_socket);
-    g_server_socket = -1;
+  close(server_socket);
+  handoff_close(&adopted);
+  if (options.handoff_socket >= 0) {
+    close(options.handoff_socket);
+    if (!handed_off)
+      unlink(kHandoffSocketPath);
   }
+  if (startup_mode.joinable())
+    startup_mode.join();
   shutdown_fan_controller();
-  unlink(SOCKET_PATH);
-  std::cout << "Server shut down." << std::endl;
-  return 0;
+  uevent_shutdown();
+  if (!handed_off && options.owns_socket_path)
+    unlink(SOCKET_PATH);
+  LOG_INFO << (handed_off ? "Handed off to the new daemon."
+                          : "Server shut down.");
+  return exit_code;
 }
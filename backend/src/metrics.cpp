@@ -0,0 +1,286 @@
+#include "metrics.hpp"
+
+#include <array>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <unistd.h>
+
+#include "log.hpp"
+#include "selfstat.hpp"
+#include "stats.hpp"
+#include "telemetry.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// node_exporter scrapes every 15 s by default.
+constexpr int kRewriteSeconds = 5;
+// Better Auto takes a snapshot every tick plus the 10 s gap when it moves
+// the fans; older values are left out rather than reported as current.
+constexpr std::chrono::seconds kSnapshotMaxAge{30};
+
+constexpr std::array<const char *, 4> kModes = {"AUTO", "MANUAL", "MAX",
+                                                "BETTER_AUTO"};
+
+struct HelperCounters {
+  uint64_t runs = 0;
+  uint64_t failures = 0;
+  double seconds = 0.0;
+};
+
+std::mutex metrics_mutex;
+std::array<std::optional<int>, 2> fan_rpm;
+std::array<std::optional<int>, 2> fan_target_rpm;
+std::string fan_mode;
+int better_auto_level = 0;
+int cooldown_level = 0;
+std::optional<double> sampled_cpu_temp_c;
+ThermalSnapshot snapshot;
+Clock::time_point snapshot_at = Clock::time_point::min();
+std::map<std::string, HelperCounters, std::less<>> helpers;
+uint64_t mode_reasserts = 0;
+uint64_t mode_reassert_failures = 0;
+
+std::string metrics_path;
+bool write_failed = false;
+
+void append_header(std::string *out, const char *name, const char *type,
+                   const char *help) {
+  *out += "# HELP ";
+  *out += name;
+  *out += " ";
+  *out += help;
+  *out += "\n# TYPE ";
+  *out += name;
+  *out += " ";
+  *out += type;
+  *out += "\n";
+}
+
+void append_value(std::string *out, const char *name, std::string_view labels,
+                  double value) {
+  char number[32];
+  std::snprintf(number, sizeof(number), "%.9g", value);
+  *out += name;
+  *out += labels;
+  *out += " ";
+  *out += number;
+  *out += "\n";
+}
+
+void append_count(std::string *out, const char *name, std::string_view labels,
+                  uint64_t value) {
+  char number[32];
+  std::snprintf(number, sizeof(number), "%" PRIu64, value);
+  *out += name;
+  *out += labels;
+  *out += " ";
+  *out += number;
+  *out += "\n";
+}
+
+std::string label(const char *key, std::string_view value) {
+  return std::string("{") + key + "=\"" + std::string(value) + "\"}";
+}
+
+void append_fans(std::string *out, const char *name, const char *help,
+                 const std::array<std::optional<int>, 2> &rpm) {
+  append_header(out, name, "gauge", help);
+  for (size_t i = 0; i < rpm.size(); ++i) {
+    if (rpm[i])
+      append_value(out, name, label("fan", std::to_string(i + 1)), *rpm[i]);
+  }
+}
+
+void write_file() {
+  std::string text = metrics_render();
+  std::string temporary = metrics_path + ".tmp";
+
+  int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                0644);
+  bool written = fd >= 0 &&
+                 write(fd, text.data(), text.size()) ==
+                     static_cast<ssize_t>(text.size());
+  int saved_errno = errno;
+  if (fd >= 0)
+    close(fd);
+  if (written && rename(temporary.c_str(), metrics_path.c_str()) == 0) {
+    write_failed = false;
+    return;
+  }
+  if (!written)
+    errno = saved_errno;
+
+  // Logged once per run of failures, not every few seconds.
+  if (!write_failed) {
+    LOG_ERROR << "metrics: failed to write " << metrics_path << ": "
+              << strerror(errno);
+  }
+  write_failed = true;
+  unlink(temporary.c_str());
+}
+
+} // namespace
+
+bool metrics_start(const std::string &path) {
+  metrics_path = path;
+  write_file();
+  if (write_failed)
+    return false;
+
+  telemetry_add_local_timer(kRewriteSeconds, write_file);
+  return true;
+}
+
+void metrics_record_fan_rpm(size_t fan_index, int rpm) {
+  std::lock_guard<std::mutex> lock(metrics_mutex);
+  if (fan_index < fan_rpm.size())
+    fan_rpm[fan_index] = rpm;
+}
+
+void metrics_record_cpu_temp(int millicelsius) {
+  std::lock_guard<std::mutex> lock(metrics_mutex);
+  sampled_cpu_temp_c = millicelsius / 1000.0;
+}
+
+void metrics_record_mode(std::string_view mode, int level) {
+  std::lock_guard<std::mutex> lock(metrics_mutex);
+  fan_mode = mode;
+  better_auto_level = level;
+}
+
+void metrics_record_snapshot(const ThermalSnapshot &value) {
+  std::lock_guard<std::mutex> lock(metrics_mutex);
+  snapshot = value;
+  snapshot_at = Clock::now();
+}
+
+void metrics_record_cooldown(int level) {
+  std::lock_guard<std::mutex> lock(metrics_mutex);
+  cooldown_level = level;
+}
+
+void metrics_record_fan_target(size_t fan_index, int rpm) {
+  std::lock_guard<std::mutex> lock(metrics_mutex);
+  if (fan_index < fan_target_rpm.size())
+    fan_target_rpm[fan_index] = rpm;
+}
+
+void metrics_record_helper(std::string_view helper, Clock::duration elapsed,
+                           bool succeeded) {
+  std::lock_guard<std::mutex> lock(metrics_mutex);
+  auto it = helpers.find(helper);
+  if (it == helpers.end())
+    it = helpers.emplace(std::string(helper), HelperCounters{}).first;
+  ++it->second.runs;
+  it->second.failures += succeeded ? 0 : 1;
+  it->second.seconds += std::chrono::duration<double>(elapsed).count();
+}
+
+void metrics_record_mode_reassert(bool succeeded) {
+  std::lock_guard<std::mutex> lock(metrics_mutex);
+  ++mode_reasserts;
+  mode_reassert_failures += succeeded ? 0 : 1;
+}
+
+std::string metrics_render() {
+  std::string out;
+  std::lock_guard<std::mutex> lock(metrics_mutex);
+
+  append_fans(&out, "victus_fan_rpm", "Fan speed reported by hp-wmi.",
+              fan_rpm);
+  append_fans(&out, "victus_fan_target_rpm",
+              "Last fan speed the daemon applied.", fan_target_rpm);
+
+  append_header(&out, "victus_fan_mode", "gauge",
+                "1 for the fan mode currently requested.");
+  for (const char *mode : kModes)
+    append_value(&out, "victus_fan_mode", label("mode", mode),
+                 fan_mode == mode ? 1 : 0);
+
+  append_header(&out, "victus_better_auto_level", "gauge",
+                "Better Auto level applied to the fans, 0 when inactive.");
+  append_value(&out, "victus_better_auto_level", "", better_auto_level);
+  append_header(&out, "victus_better_auto_cooldown_level", "gauge",
+                "Level Better Auto holds after a hot spell, 0 when none.");
+  append_value(&out, "victus_better_auto_cooldown_level", "", cooldown_level);
+
+  bool fresh = snapshot_at >= Clock::now() - kSnapshotMaxAge;
+  std::optional<double> cpu_temp_c =
+      fresh && snapshot.cpu_temp_c ? snapshot.cpu_temp_c : sampled_cpu_temp_c;
+  append_header(&out, "victus_temperature_celsius", "gauge",
+                "Sensor temperature.");
+  if (cpu_temp_c)
+    append_value(&out, "victus_temperature_celsius", label("sensor", "cpu"),
+                 *cpu_temp_c);
+  if (fresh && snapshot.gpu_temp_c)
+    append_value(&out, "victus_temperature_celsius", label("sensor", "gpu"),
+                 *snapshot.gpu_temp_c);
+  append_header(&out, "victus_usage_ratio", "gauge",
+                "Busy share sampled by Better Auto, 0 to 1.");
+  if (fresh && snapshot.cpu_usage_pct)
+    append_value(&out, "victus_usage_ratio", label("device", "cpu"),
+                 *snapshot.cpu_usage_pct / 100.0);
+  if (fresh && snapshot.gpu_usage_pct)
+    append_value(&out, "victus_usage_ratio", label("device", "gpu"),
+                 *snapshot.gpu_usage_pct / 100.0);
+
+  append_header(&out, "victus_helper_duration_seconds", "summary",
+                "Time spent in the privileged helper scripts.");
+  for (const auto &[helper, counters] : helpers) {
+    append_count(&out, "victus_helper_duration_seconds_count",
+                 label("helper", helper), counters.runs);
+    append_value(&out, "victus_helper_duration_seconds_sum",
+                 label("helper", helper), counters.seconds);
+  }
+  append_header(&out, "victus_helper_failures_total", "counter",
+                "Helper runs that did not exit 0.");
+  for (const auto &[helper, counters] : helpers)
+    append_count(&out, "victus_helper_failures_total", label("helper", helper),
+                 counters.failures);
+
+  append_header(&out, "victus_mode_reasserts_total", "counter",
+                "Fan mode rewrites that keep the firmware from reverting.");
+  append_count(&out, "victus_mode_reasserts_total", "", mode_reasserts);
+  append_header(&out, "victus_mode_reassert_failures_total", "counter",
+                "Mode reasserts that failed.");
+  append_count(&out, "victus_mode_reassert_failures_total", "",
+               mode_reassert_failures);
+
+  append_header(&out, "victus_commands_total", "counter",
+                "Commands answered, by command.");
+  for (const auto &[command, count] : stats_command_counts())
+    append_count(&out, "victus_commands_total", label("command", command),
+                 count);
+
+  SelfStat self = selfstat_sample();
+  append_header(&out, "victus_self_cpu_seconds_total", "counter",
+                "CPU time the daemon used, all threads.");
+  append_value(&out, "victus_self_cpu_seconds_total", label("mode", "user"),
+               self.cpu_user_s);
+  append_value(&out, "victus_self_cpu_seconds_total", label("mode", "system"),
+               self.cpu_system_s);
+  append_header(&out, "victus_self_context_switches_total", "counter",
+                "Context switches; the rate of voluntary ones is the wakeup "
+                "rate.");
+  append_count(&out, "victus_self_context_switches_total",
+               label("kind", "voluntary"), self.voluntary_switches);
+  append_count(&out, "victus_self_context_switches_total",
+               label("kind", "involuntary"), self.involuntary_switches);
+  append_header(&out, "victus_self_threads", "gauge", "Live threads.");
+  append_value(&out, "victus_self_threads", "", self.threads);
+  append_header(&out, "victus_self_resident_memory_bytes", "gauge",
+                "Resident set size.");
+  append_count(&out, "victus_self_resident_memory_bytes", "", self.rss_bytes);
+  append_header(&out, "victus_self_forks_total", "counter",
+                "Helper processes started.");
+  append_count(&out, "victus_self_forks_total", "", self.forks);
+  return out;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+#include "fan.hpp"
+
+// Prometheus metrics for node_exporter's textfile collector.
+//
+// With VICTUS_METRICS_FILE=/var/lib/node_exporter/textfile/victus.prom the
+// daemon rewrites that file every few seconds; the new text goes to a
+// ".tmp" sibling first and is renamed over the old file, so a scrape never
+// sees a half-written one. Rewriting only formats what the daemon recorded
+// while doing its work: the Better Auto loop's thermal snapshot, the writes
+// it makes, the fan mode it requested, and fan speeds and temperatures read
+// for clients (commands, subscriptions, the telemetry page). Nothing is read
+// from sysfs for the metrics alone, so a fan speed nobody read is left out
+// and one read a while ago is reported as it was. The victus_self_* figures
+// come from getrusage and /proc/self (selfstat.hpp).
+
+// Starts rewriting `path`; returns false if it cannot be written.
+bool metrics_start(const std::string &path);
+
+// Called by the hardware layer with what it just read or did.
+void metrics_record_fan_rpm(size_t fan_index, int rpm);
+void metrics_record_cpu_temp(int millicelsius);
+void metrics_record_mode(std::string_view mode, int better_auto_level);
+void metrics_record_snapshot(const ThermalSnapshot &snapshot);
+void metrics_record_cooldown(int cooldown_level);
+void metrics_record_fan_target(size_t fan_index, int rpm);
+void metrics_record_helper(std::string_view helper,
+                           std::chrono::steady_clock::duration elapsed,
+                           bool succeeded);
+void metrics_record_mode_reassert(bool succeeded);
+
+// The current exposition text; what metrics_start() writes.
+std::string metrics_render();
@@ -0,0 +1,271 @@
+#include "protocol_v2.hpp"
+
+#include <array>
+
+#include "coalesce.hpp"
+#include "fan.hpp"
+#include "keyboard.hpp"
+#include "util.hpp"
+#include "validation.hpp"
+
+namespace {
+
+constexpr std::string_view kHelloPrefix = "HELLO ";
+constexpr std::string_view kInvalidArguments = "ERROR: Invalid arguments";
+
+void append_u32_le(std::string &out, uint32_t value) {
+  out.push_back(static_cast<char>(value & 0xFF));
+  out.push_back(static_cast<char>((value >> 8) & 0xFF));
+  out.push_back(static_cast<char>((value >> 16) & 0xFF));
+  out.push_back(static_cast<char>((value >> 24) & 0xFF));
+}
+
+uint32_t read_u32_le(const unsigned char *bytes) {
+  return static_cast<uint32_t>(bytes[0]) |
+         (static_cast<uint32_t>(bytes[1]) << 8) |
+         (static_cast<uint32_t>(bytes[2]) << 16) |
+         (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+std::string status_reply(BinaryStatus status) {
+  return std::string(1, static_cast<char>(status));
+}
+
+std::string invalid_arguments() {
+  return binary_status_reply(BinaryStatus::InvalidArgument, kInvalidArguments);
+}
+
+// The hardware layer reports failures as "ERROR: ..." strings built with
+// error_reply(), which records why alongside the text.
+std::string reply_from_result(std::string_view result) {
+  if (result == "OK")
+    return status_reply(BinaryStatus::Ok);
+
+  BinaryStatus status = BinaryStatus::Failed;
+  switch (error_kind(result)) {
+  case ErrorKind::InvalidArgument:
+    status = BinaryStatus::InvalidArgument;
+    break;
+  case ErrorKind::DeviceUnavailable:
+    status = BinaryStatus::DeviceUnavailable;
+    break;
+  case ErrorKind::Failed:
+    break;
+  }
+  return binary_status_reply(status, result);
+}
+
+std::string rgb_reply(const std::string &result) {
+  std::array<int, 3> rgb;
+  if (!parse_rgb_triplet(result, &rgb))
+    return reply_from_result(result);
+
+  std::string reply = status_reply(BinaryStatus::Ok);
+  for (int channel : rgb)
+    reply.push_back(static_cast<char>(channel));
+  return reply;
+}
+
+std::string rgb_argument(const unsigned char *bytes) {
+  return std::to_string(bytes[0]) + " " + std::to_string(bytes[1]) + " " +
+         std::to_string(bytes[2]);
+}
+
+const char *fan_mode_name(BinaryFanMode mode) {
+  switch (mode) {
+  case BinaryFanMode::Auto:
+    return "AUTO";
+  case BinaryFanMode::Manual:
+    return "MANUAL";
+  case BinaryFanMode::Max:
+    return "MAX";
+  case BinaryFanMode::BetterAuto:
+    return "BETTER_AUTO";
+  }
+  return nullptr;
+}
+
+std::string fan_mode_reply(const std::string &mode) {
+  BinaryFanMode encoded;
+  if (mode == "AUTO")
+    encoded = BinaryFanMode::Auto;
+  else if (mode == "MANUAL")
+    encoded = BinaryFanMode::Manual;
+  else if (mode == "MAX")
+    encoded = BinaryFanMode::Max;
+  else if (mode == "BETTER_AUTO")
+    encoded = BinaryFanMode::BetterAuto;
+  else
+    return reply_from_result(mode);
+
+  std::string reply = status_reply(BinaryStatus::Ok);
+  reply.push_back(static_cast<char>(encoded));
+  return reply;
+}
+
+} // namespace
+
+bool is_protocol_hello(std::string_view payload) {
+  return payload.substr(0, kHelloPrefix.size()) == kHelloPrefix;
+}
+
+std::string negotiate_protocol(std::string_view payload, uint8_t *version) {
+  int requested = 0;
+  std::string value(payload.substr(kHelloPrefix.size()));
+  if (!parse_bounded_int(value, kProtocolTextVersion, 255, &requested))
+    return "ERROR: Invalid HELLO command format";
+
+  uint8_t agreed = requested >= kProtocolBinaryVersion ? kProtocolBinaryVersion
+                                                       : kProtocolTextVersion;
+  if (version)
+    *version = agreed;
+  return "HELLO " + std::to_string(agreed);
+}
+
+bool binary_command_may_block(std::string_view payload) {
+  if (payload.empty())
+    return false;
+
+  switch (static_cast<BinaryOpcode>(payload[0])) {
+  case BinaryOpcode::SetFanSpeed:
+  case BinaryOpcode::SetFanMode:
+  case BinaryOpcode::SetKeyboardColor:
+  case BinaryOpcode::SetKeyboardZoneColor:
+  case BinaryOpcode::SetKbdBrightness:
+    return true;
+  default:
+    return false;
+  }
+}
+
+std::string binary_status_reply(BinaryStatus status, std::string_view message) {
+  std::string reply = status_reply(status);
+  reply.append(message);
+  return reply;
+}
+
+std::string handle_binary_command(std::string_view payload) {
+  if (payload.empty())
+    return binary_status_reply(BinaryStatus::InvalidArgument, "Empty request");
+
+  const auto *args = reinterpret_cast<const unsigned char *>(payload.data()) + 1;
+  const size_t arg_len = payload.size() - 1;
+  auto opcode = static_cast<BinaryOpcode>(payload[0]);
+
+  auto require_args = [arg_len](size_t expected) { return arg_len == expected; };
+  auto fan_index = [](unsigned char fan) -> int {
+    return (fan == 1 || fan == 2) ? fan - 1 : -1;
+  };
+
+  switch (opcode) {
+  case BinaryOpcode::GetFanSpeed: {
+    if (!require_args(1) || fan_index(args[0]) < 0)
+      return invalid_arguments();
+    int rpm = 0;
+    std::string error;
+    if (!read_fan_speed_rpm(static_cast<size_t>(fan_index(args[0])), &rpm,
+                            &error))
+      return reply_from_result(error);
+    std::string reply = status_reply(BinaryStatus::Ok);
+    append_u32_le(reply, static_cast<uint32_t>(rpm < 0 ? 0 : rpm));
+    return reply;
+  }
+  case BinaryOpcode::GetFanMaxSpeed: {
+    if (!require_args(1) || fan_index(args[0]) < 0)
+      return invalid_arguments();
+    std::string reply = status_reply(BinaryStatus::Ok);
+    append_u32_le(reply, static_cast<uint32_t>(fan_max_rpm(
+                             static_cast<size_t>(fan_index(args[0])))));
+    return reply;
+  }
+  case BinaryOpcode::SetFanSpeed: {
+    if (!require_args(5) || fan_index(args[0]) < 0)
+      return invalid_arguments();
+    uint32_t rpm = read_u32_le(args + 1);
+    if (rpm > 0x7FFFFFFF)
+      return invalid_arguments();
+    // Binary connections are one request at a time, so there is nothing to
+    // merge; the writes still share the per-target rate limit.
+    return reply_from_result(
+        coalesce_write(0, "fan" + std::to_string(args[0]), 0, [&] {
+          return set_fan_speed(std::to_string(args[0]), std::to_string(rpm),
+                               true, true);
+        }));
+  }
+  case BinaryOpcode::GetFanMode:
+    if (!require_args(0))
+      return invalid_arguments();
+    return fan_mode_reply(get_fan_mode());
+  case BinaryOpcode::SetFanMode: {
+    const char *mode =
+        require_args(1) ? fan_mode_name(static_cast<BinaryFanMode>(args[0]))
+                        : nullptr;
+    if (!mode)
+      return invalid_arguments();
+    std::string result = set_fan_mode(mode);
+    if (result == "OK")
+      fan_mode_trigger(mode);
+    return reply_from_result(result);
+  }
+  case BinaryOpcode::GetCpuTemp: {
+    if (!require_args(0))
+      return invalid_arguments();
+    int millicelsius = 0;
+    if (!read_cpu_temperature_millicelsius(&millicelsius))
+      return binary_status_reply(BinaryStatus::DeviceUnavailable,
+                                 "ERROR: CPU temperature unavailable");
+    std::string reply = status_reply(BinaryStatus::Ok);
+    append_u32_le(reply, static_cast<uint32_t>(millicelsius));
+    return reply;
+  }
+  case BinaryOpcode::GetKeyboardType: {
+    if (!require_args(0))
+      return invalid_arguments();
+    std::string reply = status_reply(BinaryStatus::Ok);
+    reply.push_back(static_cast<char>(get_keyboard_type() == "FOUR_ZONE"
+                                          ? BinaryKeyboardType::FourZone
+                                          : BinaryKeyboardType::SingleZone));
+    return reply;
+  }
+  case BinaryOpcode::GetKeyboardColor:
+    if (!require_args(0))
+      return invalid_arguments();
+    return rgb_reply(get_keyboard_color());
+  case BinaryOpcode::SetKeyboardColor:
+    if (!require_args(3))
+      return invalid_arguments();
+    return reply_from_result(coalesce_write(0, "color", 0, [&] {
+      return set_keyboard_color(rgb_argument(args));
+    }));
+  case BinaryOpcode::GetKeyboardZoneColor:
+    if (!require_args(1) || args[0] > 3)
+      return invalid_arguments();
+    return rgb_reply(get_keyboard_zone_color(args[0]));
+  case BinaryOpcode::SetKeyboardZoneColor:
+    if (!require_args(4) || args[0] > 3)
+      return invalid_arguments();
+    return reply_from_result(
+        coalesce_write(0, "zone" + std::to_string(args[0]), 0, [&] {
+          return set_keyboard_zone_color(args[0], rgb_argument(args + 1));
+        }));
+  case BinaryOpcode::GetKbdBrightness: {
+    if (!require_args(0))
+      return invalid_arguments();
+    std::string result = get_keyboard_brightness();
+    int brightness = 0;
+    if (!parse_bounded_int(result, 0, 255, &brightness))
+      return reply_from_result(result);
+    std::string reply = status_reply(BinaryStatus::Ok);
+    reply.push_back(static_cast<char>(brightness));
+    return reply;
+  }
+  case BinaryOpcode::SetKbdBrightness:
+    if (!require_args(1))
+      return invalid_arguments();
+    return reply_from_result(coalesce_write(0, "brightness", 0, [&] {
+      return set_keyboard_brightness(std::to_string(args[0]));
+    }));
+  }
+
+  return binary_status_reply(BinaryStatus::UnknownOpcode, "Unknown opcode");
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Binary protocol v2.
+//
+// Framing is unchanged: every message is a little-endian u32 length followed
+// by the payload. A connection starts in the text protocol; the client opts
+// in by sending the text frame "HELLO 2", to which the backend answers
+// "HELLO 2" (or "HELLO 1" if it only speaks text). After that every payload
+// on the connection is binary:
+//
+//   request:  u8 opcode, then the opcode's fixed-width arguments
+//   response: u8 status, then the opcode's fixed-width result on success or
+//             a UTF-8 diagnostic message on failure
+//
+// All integers are little-endian. RPMs are u32, temperatures are i32
+// millidegrees Celsius, colors are three u8 (red, green, blue).
+
+constexpr uint8_t kProtocolTextVersion = 1;
+constexpr uint8_t kProtocolBinaryVersion = 2;
+
+enum class BinaryOpcode : uint8_t {
+  GetFanSpeed = 0x01,          // u8 fan (1-2)          -> u32 rpm
+  GetFanMaxSpeed = 0x02,       // u8 fan                -> u32 rpm
+  SetFanSpeed = 0x03,          // u8 fan, u32 rpm       -> -
+  GetFanMode = 0x04,           // -                     -> u8 BinaryFanMode
+  SetFanMode = 0x05,           // u8 BinaryFanMode      -> -
+  GetCpuTemp = 0x06,           // -                     -> i32 millidegrees
+  GetKeyboardType = 0x07,      // -                     -> u8 BinaryKeyboardType
+  GetKeyboardColor = 0x08,     // -                     -> u8 r, u8 g, u8 b
+  SetKeyboardColor = 0x09,     // u8 r, u8 g, u8 b      -> -
+  GetKeyboardZoneColor = 0x0A, // u8 zone (0-3)         -> u8 r, u8 g, u8 b
+  SetKeyboardZoneColor = 0x0B, // u8 zone, u8 r, g, b   -> -
+  GetKbdBrightness = 0x0C,     // -                     -> u8 brightness
+  SetKbdBrightness = 0x0D,     // u8 brightness         -> -
+};
+
+enum class BinaryStatus : uint8_t {
+  Ok = 0,
+  InvalidArgument = 1,
+  UnknownOpcode = 2,
+  DeviceUnavailable = 3,
+  Failed = 4,
+  Busy = 5,
+};
+
+enum class BinaryFanMode : uint8_t {
+  Auto = 0,
+  Manual = 1,
+  Max = 2,
+  BetterAuto = 3,
+};
+
+enum class BinaryKeyboardType : uint8_t {
+  SingleZone = 0,
+  FourZone = 1,
+};
+
+// True for a text "HELLO <version>" frame.
+bool is_protocol_hello(std::string_view payload);
+
+// Answers a HELLO frame and stores the version the connection switches to.
+std::string negotiate_protocol(std::string_view payload, uint8_t *version);
+
+// Runs one binary request. Blocking like handle_command().
+std::string handle_binary_command(std::string_view payload);
+
+// Binary counterpart of command_may_block(): true for the Set* opcodes.
+bool binary_command_may_block(std::string_view payload);
+
+// Builds a status-only reply, e.g. for a rejected request.
+std::string binary_status_reply(BinaryStatus status, std::string_view message);
@@ -0,0 +1,103 @@
+#include "selfstat.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <string_view>
+#include <sys/resource.h>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Close enough to exec for uptime and the first wakeup rate.
+const Clock::time_point started_at = Clock::now();
+
+std::atomic<uint64_t> fork_count{0};
+
+std::mutex report_mutex;
+Clock::time_point last_report_at = started_at;
+uint64_t last_report_switches = 0;
+
+double seconds(const timeval &time) {
+  return static_cast<double>(time.tv_sec) +
+         static_cast<double>(time.tv_usec) / 1e6;
+}
+
+// The process's own files, not the simulated tree under VICTUS_SYSFS_ROOT.
+int read_thread_count() {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  constexpr std::string_view kKey = "Threads:";
+  while (std::getline(status, line)) {
+    if (line.compare(0, kKey.size(), kKey) == 0)
+      return std::atoi(line.c_str() + kKey.size());
+  }
+  return 0;
+}
+
+uint64_t read_rss_bytes() {
+  std::ifstream statm("/proc/self/statm");
+  uint64_t size_pages = 0;
+  uint64_t resident_pages = 0;
+  if (!(statm >> size_pages >> resident_pages))
+    return 0;
+  return resident_pages * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+}
+
+} // namespace
+
+SelfStat selfstat_sample() {
+  SelfStat stat;
+  stat.uptime_s =
+      std::chrono::duration<double>(Clock::now() - started_at).count();
+
+  rusage usage{};
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+    stat.cpu_user_s = seconds(usage.ru_utime);
+    stat.cpu_system_s = seconds(usage.ru_stime);
+    stat.voluntary_switches = static_cast<uint64_t>(usage.ru_nvcsw);
+    stat.involuntary_switches = static_cast<uint64_t>(usage.ru_nivcsw);
+  }
+  stat.threads = read_thread_count();
+  stat.rss_bytes = read_rss_bytes();
+  stat.forks = fork_count.load(std::memory_order_relaxed);
+  return stat;
+}
+
+void selfstat_record_fork() {
+  fork_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::string selfstat_report() {
+  SelfStat stat = selfstat_sample();
+  double wakeups_per_s = 0.0;
+  {
+    std::lock_guard<std::mutex> lock(report_mutex);
+    auto now = Clock::now();
+    double interval = std::chrono::duration<double>(now - last_report_at).count();
+    if (interval > 0.0 && stat.voluntary_switches >= last_report_switches)
+      wakeups_per_s = static_cast<double>(stat.voluntary_switches -
+                                          last_report_switches) /
+                      interval;
+    last_report_at = now;
+    last_report_switches = stat.voluntary_switches;
+  }
+
+  char reply[320];
+  std::snprintf(reply, sizeof(reply),
+                "SELFSTAT uptime_s=%.1f cpu_user_s=%.3f cpu_system_s=%.3f "
+                "voluntary_switches=%llu involuntary_switches=%llu "
+                "wakeups_per_s=%.2f threads=%d rss_kb=%llu forks=%llu",
+                stat.uptime_s, stat.cpu_user_s, stat.cpu_system_s,
+                static_cast<unsigned long long>(stat.voluntary_switches),
+                static_cast<unsigned long long>(stat.involuntary_switches),
+                wakeups_per_s, stat.threads,
+                static_cast<unsigned long long>(stat.rss_bytes / 1024),
+                static_cast<unsigned long long>(stat.forks));
+  return reply;
+}
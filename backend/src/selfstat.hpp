@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// What the daemon itself costs the machine, for the SELFSTAT command and the
+// victus_self_* metrics. The Better Auto loop, the fan mode reasserts and the
+// gap waits all sleep in 1 s slices, so on a laptop the interesting numbers
+// are wakeups and CPU time while idle.
+//
+// Everything comes from getrusage(RUSAGE_SELF), which sums every thread, and
+// /proc/self; nothing is sampled in the background.
+struct SelfStat {
+  double uptime_s = 0.0;
+  double cpu_user_s = 0.0;
+  double cpu_system_s = 0.0;
+  // A voluntary switch is the thread going to sleep, so each one is paired
+  // with a later wakeup.
+  uint64_t voluntary_switches = 0;
+  uint64_t involuntary_switches = 0;
+  int threads = 0;
+  uint64_t rss_bytes = 0;
+  // Helper scripts started (the set-*.sh helpers).
+  uint64_t forks = 0;
+};
+
+SelfStat selfstat_sample();
+
+// Called after each successful fork() of a helper.
+void selfstat_record_fork();
+
+// "SELFSTAT uptime_s=... cpu_user_s=... cpu_system_s=... voluntary_switches=...
+// involuntary_switches=... wakeups_per_s=... threads=... rss_kb=... forks=..."
+//
+// wakeups_per_s is voluntary switches per second since the previous report,
+// or since startup for the first one; Prometheus gets the counter instead.
+std::string selfstat_report();
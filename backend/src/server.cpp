@@ -0,0 +1,1129 @@
+#include "server.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <iterator>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "coalesce.hpp"
+#include "commands.hpp"
+#include "fan.hpp"
+#include "handoff.hpp"
+#include "log.hpp"
+#include "protocol_v2.hpp"
+#include "state.hpp"
+#include "stats.hpp"
+#include "telemetry.hpp"
+#include "telemetry_page.hpp"
+#include "trace.hpp"
+#include "validation.hpp"
+#include "victus_commands.hpp"
+#include "worker_pool.hpp"
+
+namespace {
+
+constexpr uint32_t kMaxCommandLength = kVictusMaxRequestLength;
+constexpr size_t kFrameHeaderSize = 4;
+constexpr size_t kWorkerCount = 4;
+constexpr size_t kWorkQueueCapacity = 64;
+// SET_* commands run the sudo helpers and may wait out kFanApplyGap, so they
+// get their own workers and never hold up reads.
+constexpr size_t kSlowWorkerCount = 2;
+constexpr size_t kSlowQueueCapacity = 32;
+// Tagged ("#<tag> <command>") requests a connection may have in flight.
+constexpr size_t kMaxTaggedInFlight = 16;
+constexpr size_t kMaxBufferedInput = 16 * 1024;
+// Telemetry frames are dropped for subscribers that stop reading.
+constexpr size_t kMaxPendingPushOutput = 64 * 1024;
+constexpr int kMaxEvents = 32;
+constexpr std::string_view kGetTelemetryFdCommand = "GET_TELEMETRY_FD";
+constexpr std::chrono::seconds kStatusReportInterval{30};
+// An upgrade waits this long for running commands to finish, and for the new
+// daemon to confirm it took over, before this daemon carries on serving.
+constexpr std::chrono::seconds kHandoffDrainTimeout{10};
+constexpr std::chrono::seconds kHandoffAckTimeout{10};
+
+// epoll user data for the fixed descriptors; client connections use ids
+// starting at kFirstConnectionId so they can never collide.
+constexpr uint64_t kListenToken = 0;
+constexpr uint64_t kWakeToken = 1;
+constexpr uint64_t kHandoffToken = 2;
+constexpr uint64_t kFirstConnectionId = 16;
+
+// Both buffers are allocated once and reused for the life of the connection.
+struct Connection {
+  int fd = -1;
+  // Bytes [input_begin, input_end) are received but not yet parsed.
+  std::vector<char> input;
+  size_t input_begin = 0;
+  size_t input_end = 0;
+  // Reply bytes the socket did not take yet; empty in the common case where
+  // a reply goes out in the writev that framed it.
+  std::vector<char> output;
+  size_t output_offset = 0;
+  bool write_failed = false;
+  // The client shut down its sending side; what it sent is still answered.
+  bool read_closed = false;
+  uint32_t events = 0;
+  uint8_t protocol_version = kProtocolTextVersion;
+  bool busy = false; // an untagged command is running
+  size_t tagged_in_flight = 0;
+  bool subscribed = false;
+  std::string subscription; // the SUBSCRIBE command, passed on in a handoff
+  // Descriptor sent as SCM_RIGHTS with the reply frame at pending_fd_offset.
+  int pending_fd = -1;
+  size_t pending_fd_offset = 0;
+};
+
+size_t buffered_input(const Connection &conn) {
+  return conn.input_end - conn.input_begin;
+}
+
+// Dispatch pauses while a command runs or a descriptor waits to be sent.
+bool dispatch_blocked(const Connection &conn) {
+  return conn.busy || conn.pending_fd >= 0;
+}
+
+// A client that stopped sending is closed once every command it sent has
+// been answered and the replies have gone out. Subscribers keep receiving
+// frames until the socket fails.
+bool answered_after_eof(const Connection &conn) {
+  return conn.read_closed && !conn.subscribed && !dispatch_blocked(conn) &&
+         conn.tagged_in_flight == 0 && conn.output_offset == conn.output.size();
+}
+
+enum class CompletionKind {
+  Reply,       // answer to the connection's untagged command
+  TaggedReply, // answer to one of its tagged commands
+  Push,        // telemetry frame
+};
+
+struct Completion {
+  uint64_t connection_id;
+  std::string response;
+  CompletionKind kind = CompletionKind::Reply;
+  std::optional<CommandTiming> timing; // worker replies; recorded once sent
+};
+
+// A parked "GET_STATE_SINCE <version> <wait_ms>" request. It holds the
+// connection's dispatch like a running command until it is answered.
+struct StateWaiter {
+  uint64_t connection_id;
+  std::string tag; // empty for an untagged request
+  uint64_t since;
+  std::chrono::steady_clock::time_point deadline;
+};
+
+std::atomic<bool> server_running{true};
+std::atomic<bool> handed_off{false};
+std::atomic<int> wake_fd{-1};
+
+std::mutex completion_mutex;
+std::vector<Completion> completions;
+
+void wake_loop() {
+  int fd = wake_fd.load(std::memory_order_acquire);
+  if (fd < 0)
+    return;
+
+  uint64_t one = 1;
+  ssize_t ignored = write(fd, &one, sizeof(one));
+  (void)ignored;
+}
+
+void post_completion(uint64_t connection_id, std::string response,
+                     CompletionKind kind = CompletionKind::Reply,
+                     std::optional<CommandTiming> timing = std::nullopt) {
+  {
+    std::lock_guard<std::mutex> lock(completion_mutex);
+    completions.push_back({connection_id, std::move(response), kind, timing});
+  }
+  wake_loop();
+}
+
+// Runs a command on a worker and posts its reply with the timing STATS needs.
+template <typename Handler>
+void run_timed_command(uint64_t connection_id, CommandTiming timing,
+                       CompletionKind kind, std::string reply_prefix,
+                       Handler &&handler) {
+  std::string reply;
+  {
+    StatsCommandScope scope(&timing);
+    reply = handler();
+  }
+  TRACE_COMPLETE("command", "queue", timing.submitted, timing.started);
+  TRACE_COMPLETE("command", stats_slot_name(timing.slot), timing.started,
+                 timing.finished);
+  post_completion(connection_id, std::move(reply_prefix) + reply, kind, timing);
+}
+
+void post_push(uint64_t connection_id, std::string frame) {
+  post_completion(connection_id, std::move(frame), CompletionKind::Push);
+}
+
+// Claims before queueing, so a newer write to the same target supersedes this
+// one even while both still wait for a worker. The loop thread is the only
+// producer, so a lane with room now will accept the task; a write that is
+// rejected as busy must not merge away the ones already queued.
+WriteTicket claim_write_ticket_if_queued(uint64_t id, const WorkerPool &lane,
+                                         std::string_view command) {
+  if (lane.queue_depth() >= lane.queue_capacity())
+    return {};
+  return claim_write_ticket(id, command);
+}
+
+long long milliseconds_since(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+bool set_nonblocking(int fd) {
+  int flags = fcntl(fd, F_GETFL, 0);
+  if (flags < 0)
+    return false;
+  return fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+uint32_t read_u32_le(const char *data) {
+  const auto *bytes = reinterpret_cast<const unsigned char *>(data);
+  return static_cast<uint32_t>(bytes[0]) |
+         (static_cast<uint32_t>(bytes[1]) << 8) |
+         (static_cast<uint32_t>(bytes[2]) << 16) |
+         (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+// Untagged commands run one at a time, so a burst of SETs from a client that
+// does not tag its requests waits here in the receive buffer rather than in
+// the worker pools. True if a later complete untagged frame already buffered
+// writes the same target as `command`; that one answers for it.
+bool superseded_by_buffered(const Connection &conn, std::string_view command) {
+  if (buffered_input(conn) < kFrameHeaderSize)
+    return false;
+  std::string target = command_write_target(command);
+  if (target.empty())
+    return false;
+
+  size_t offset = conn.input_begin;
+  while (conn.input_end - offset >= kFrameHeaderSize) {
+    uint32_t length = read_u32_le(conn.input.data() + offset);
+    if (length == 0 || length > kMaxCommandLength ||
+        conn.input_end - offset - kFrameHeaderSize < length)
+      return false;
+    std::string_view later(conn.input.data() + offset + kFrameHeaderSize,
+                           length);
+    if (later.front() != '#' && command_write_target(later) == target)
+      return true;
+    offset += kFrameHeaderSize + length;
+  }
+  return false;
+}
+
+void encode_u32_le(char *out, uint32_t value) {
+  out[0] = static_cast<char>(value & 0xFF);
+  out[1] = static_cast<char>((value >> 8) & 0xFF);
+  out[2] = static_cast<char>((value >> 16) & 0xFF);
+  out[3] = static_cast<char>((value >> 24) & 0xFF);
+}
+
+// Sends the first byte of the frame at pending_fd_offset together with the
+// descriptor, so the client receives it with the "OK" reply.
+ssize_t send_with_fd(int socket_fd, const char *data, size_t length, int fd) {
+  iovec iov = {const_cast<char *>(data), length};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+
+  msghdr msg = {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  std::memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+  return sendmsg(socket_fd, &msg, MSG_NOSIGNAL);
+}
+
+class EventLoop {
+public:
+  EventLoop(int listen_socket, int epoll_fd, const ServerOptions &options)
+      : listen_socket(listen_socket), epoll_fd(epoll_fd),
+        started_at(options.started_at),
+        handoff_socket(options.handoff_socket),
+        owns_socket_path(options.owns_socket_path),
+        pool(kWorkerCount, kWorkQueueCapacity),
+        slow_pool(kSlowWorkerCount, kSlowQueueCapacity) {}
+
+  void adopt_clients(HandoffState &adopted);
+  void run();
+  void shutdown();
+
+private:
+  void accept_clients();
+  void accept_handoff();
+  bool handoff_pending() const { return handoff_channel >= 0; }
+  void finish_handoff_if_drained();
+  void abort_handoff(const char *reason, const std::string *fan_state);
+  void handle_client_event(uint64_t id, uint32_t events);
+  void drain_completions();
+  void deliver(Completion &completion);
+  bool park_state_wait(uint64_t id, Connection &conn, std::string_view tag,
+                       std::string_view command);
+  void resolve_state_waiters();
+
+  bool read_input(Connection &conn);
+  bool dispatch_next(uint64_t id, Connection &conn);
+  bool dispatch_tagged(uint64_t id, Connection &conn,
+                       std::string_view frame);
+  void queue_response(Connection &conn, std::string_view response);
+  void queue_telemetry_fd(Connection &conn);
+  bool flush_output(Connection &conn);
+  void update_interest(uint64_t id, Connection &conn);
+  void close_connection(uint64_t id);
+
+  void mark_stats_dirty() { stats_dirty = true; }
+  int next_timeout_ms();
+  void report_status_if_due();
+
+  int listen_socket;
+  int epoll_fd;
+  std::chrono::steady_clock::time_point started_at;
+  bool first_response_logged = false;
+  int handoff_socket;
+  bool owns_socket_path;
+  // Accepted handoff connection; while it is open the loop drains instead
+  // of dispatching.
+  int handoff_channel = -1;
+  std::chrono::steady_clock::time_point handoff_deadline;
+  WorkerPool pool;
+  WorkerPool slow_pool;
+  std::unordered_map<uint64_t, Connection> connections;
+  // Swapped with `completions` on every drain so neither vector reallocates.
+  std::vector<Completion> ready_completions;
+  std::vector<StateWaiter> state_waiters;
+  uint64_t next_connection_id = kFirstConnectionId;
+
+  bool stats_dirty = false;
+  size_t peak_connections = 0;
+  size_t peak_queue_depth = 0;
+  std::chrono::steady_clock::time_point next_report =
+      std::chrono::steady_clock::now();
+};
+
+void EventLoop::run() {
+  epoll_event events[kMaxEvents];
+  LOG_INFO << "server: accepting clients " << milliseconds_since(started_at)
+           << " ms after startup";
+
+  while (server_running.load(std::memory_order_acquire)) {
+    int ready = epoll_wait(epoll_fd, events, kMaxEvents, next_timeout_ms());
+    if (ready < 0) {
+      if (errno == EINTR)
+        continue;
+      LOG_ERROR << "epoll_wait failed: " << strerror(errno);
+      break;
+    }
+
+    for (int i = 0; i < ready; ++i) {
+      uint64_t token = events[i].data.u64;
+      if (token == kListenToken) {
+        accept_clients();
+      } else if (token == kHandoffToken) {
+        accept_handoff();
+      } else if (token == kWakeToken) {
+        uint64_t counter = 0;
+        ssize_t ignored = read(wake_fd.load(), &counter, sizeof(counter));
+        (void)ignored;
+      } else {
+        handle_client_event(token, events[i].events);
+      }
+    }
+
+    drain_completions();
+    resolve_state_waiters();
+    if (handoff_pending())
+      finish_handoff_if_drained();
+    report_status_if_due();
+  }
+}
+
+void EventLoop::shutdown() {
+  if (handoff_pending())
+    close(handoff_channel);
+  pool.shutdown();
+  slow_pool.shutdown();
+  for (auto &[id, conn] : connections) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn.fd, nullptr);
+    if (conn.pending_fd >= 0)
+      close(conn.pending_fd);
+    close(conn.fd);
+  }
+  connections.clear();
+}
+
+void EventLoop::accept_clients() {
+  while (true) {
+    int client_socket =
+        accept4(listen_socket, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (client_socket < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno != EAGAIN && errno != EWOULDBLOCK)
+        perror("accept");
+      return;
+    }
+
+    uint64_t id = next_connection_id++;
+    Connection &conn = connections[id];
+    conn.fd = client_socket;
+    conn.events = EPOLLIN;
+
+    epoll_event ev = {};
+    ev.events = conn.events;
+    ev.data.u64 = id;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_socket, &ev) < 0) {
+      LOG_ERROR << "Failed to register client: " << strerror(errno);
+      close(client_socket);
+      connections.erase(id);
+      continue;
+    }
+
+    peak_connections = std::max(peak_connections, connections.size());
+    mark_stats_dirty();
+  }
+}
+
+// Takes over the previous daemon's connections exactly where it left them:
+// unparsed input is dispatched and unsent replies are flushed as if nothing
+// happened.
+void EventLoop::adopt_clients(HandoffState &adopted) {
+  std::vector<uint64_t> ids;
+  for (auto &client : adopted.clients) {
+    uint64_t id = next_connection_id++;
+    Connection &conn = connections[id];
+    conn.fd = std::exchange(client.fd, -1);
+    conn.events = EPOLLIN;
+    conn.protocol_version = client.protocol_version;
+    if (!client.input.empty()) {
+      conn.input.resize(std::max(kMaxBufferedInput, client.input.size()));
+      std::memcpy(conn.input.data(), client.input.data(), client.input.size());
+      conn.input_end = client.input.size();
+    }
+    conn.output.assign(client.output.begin(), client.output.end());
+
+    epoll_event ev = {};
+    ev.events = conn.events;
+    ev.data.u64 = id;
+    bool registered = set_nonblocking(conn.fd) &&
+                      epoll_ctl(epoll_fd, EPOLL_CTL_ADD, conn.fd, &ev) == 0;
+    if (registered && !client.subscription.empty()) {
+      // A subscriber whose topics no longer parse would otherwise start
+      // executing whatever it writes.
+      conn.subscribed = telemetry_subscribe(id, client.subscription) == "OK";
+      conn.subscription = std::move(client.subscription);
+      registered = conn.subscribed;
+    }
+    if (!registered) {
+      LOG_ERROR << "Failed to adopt client connection";
+      close_connection(id);
+      continue;
+    }
+    ids.push_back(id);
+  }
+  adopted.clients.clear();
+
+  for (uint64_t id : ids) {
+    Connection &conn = connections[id];
+    if (!flush_output(conn) || !dispatch_next(id, conn)) {
+      close_connection(id);
+      continue;
+    }
+    update_interest(id, conn);
+  }
+  peak_connections = std::max(peak_connections, connections.size());
+  mark_stats_dirty();
+}
+
+void EventLoop::handle_client_event(uint64_t id, uint32_t events) {
+  auto it = connections.find(id);
+  if (it == connections.end())
+    return;
+  Connection &conn = it->second;
+
+  if (events & (EPOLLERR | EPOLLHUP)) {
+    close_connection(id);
+    return;
+  }
+
+  if ((events & EPOLLOUT) && !flush_output(conn)) {
+    close_connection(id);
+    return;
+  }
+
+  if ((events & EPOLLIN) && !read_input(conn)) {
+    close_connection(id);
+    return;
+  }
+  // Also runs after EPOLLOUT, which may have released a pending descriptor.
+  if (!dispatch_next(id, conn) ||
+      (!handoff_pending() && answered_after_eof(conn))) {
+    close_connection(id);
+    return;
+  }
+
+  update_interest(id, conn);
+}
+
+// Receives straight into the connection buffer; one recv typically brings in
+// every frame the client has pipelined so far.
+bool EventLoop::read_input(Connection &conn) {
+  if (conn.input.empty())
+    conn.input.resize(kMaxBufferedInput);
+
+  while (true) {
+    if (conn.input_end == conn.input.size()) {
+      if (conn.input_begin == 0)
+        return true; // full; dispatch has to make room first
+      std::memmove(conn.input.data(), conn.input.data() + conn.input_begin,
+                   buffered_input(conn));
+      conn.input_end -= conn.input_begin;
+      conn.input_begin = 0;
+    }
+
+    ssize_t bytes_read = recv(conn.fd, conn.input.data() + conn.input_end,
+                              conn.input.size() - conn.input_end, 0);
+    if (bytes_read < 0) {
+      if (errno == EINTR)
+        continue;
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    if (bytes_read == 0) {
+      conn.read_closed = true;
+      return true;
+    }
+    conn.input_end += static_cast<size_t>(bytes_read);
+  }
+}
+
+// Hands complete frames to the worker pools. Untagged commands run one at a
+// time per connection so their replies keep the order the client expects;
+// tagged "#<tag> <command>" frames run concurrently and are answered with
+// "#<tag> <response>" as each one finishes. An untagged frame waits until the
+// tagged ones before it have been answered.
+bool EventLoop::dispatch_next(uint64_t id, Connection &conn) {
+  bool answered_inline = false;
+
+  // During a handoff, input stays buffered for the next daemon.
+  while (!handoff_pending() && !dispatch_blocked(conn) &&
+         buffered_input(conn) >= kFrameHeaderSize) {
+    const char *frame = conn.input.data() + conn.input_begin;
+    uint32_t cmd_len = read_u32_le(frame);
+    if (cmd_len == 0 || cmd_len > kMaxCommandLength) {
+      LOG_ERROR << "Command too long or empty (" << cmd_len
+                << " bytes). Closing connection.";
+      return false;
+    }
+    if (buffered_input(conn) < kFrameHeaderSize + cmd_len)
+      break;
+
+    bool text = conn.protocol_version == kProtocolTextVersion;
+    bool tagged = text && frame[kFrameHeaderSize] == '#';
+    if (!conn.subscribed &&
+        (tagged ? conn.tagged_in_flight >= kMaxTaggedInFlight
+                : conn.tagged_in_flight > 0))
+      break;
+
+    // Views the receive buffer, which stays untouched until read_input().
+    std::string_view command(frame + kFrameHeaderSize, cmd_len);
+    conn.input_begin += kFrameHeaderSize + cmd_len;
+    if (conn.input_begin == conn.input_end)
+      conn.input_begin = conn.input_end = 0;
+
+    // A subscribed connection is a one-way push stream.
+    if (conn.subscribed)
+      continue;
+
+    if (tagged) {
+      answered_inline |= !dispatch_tagged(id, conn, command);
+      continue;
+    }
+
+    // The handshake, SUBSCRIBE and GET_TELEMETRY_FD only touch connection
+    // state, so answer them inline.
+    if (text && is_protocol_hello(command)) {
+      queue_response(conn,
+                     negotiate_protocol(command, &conn.protocol_version));
+      answered_inline = true;
+      continue;
+    }
+    if (text && is_subscribe_command(command)) {
+      std::string reply = telemetry_subscribe(id, command);
+      conn.subscribed = reply == "OK";
+      if (conn.subscribed)
+        conn.subscription = command;
+      queue_response(conn, reply);
+      answered_inline = true;
+      continue;
+    }
+    if (text && command == kGetTelemetryFdCommand) {
+      queue_telemetry_fd(conn);
+      answered_inline = true;
+      continue;
+    }
+
+    if (text && park_state_wait(id, conn, {}, command))
+      continue;
+
+    if (text && superseded_by_buffered(conn, command)) {
+      queue_response(conn, kMergedReply);
+      answered_inline = true;
+      continue;
+    }
+
+    bool binary = !text;
+    bool may_block = binary ? binary_command_may_block(command)
+                            : command_may_block(command);
+    WorkerPool &lane = may_block ? slow_pool : pool;
+    WriteTicket ticket =
+        binary ? WriteTicket{} : claim_write_ticket_if_queued(id, lane, command);
+    CommandTiming timing;
+    if (binary)
+      timing.slot = kStatsBinarySlot;
+    conn.busy = lane.try_submit(
+        [id, binary, ticket, timing, command = std::string(command)]() {
+          run_timed_command(id, timing, CompletionKind::Reply, {}, [&] {
+            return binary ? handle_binary_command(command)
+                          : handle_command(command, ticket);
+          });
+        });
+    if (!conn.busy) {
+      queue_response(conn, binary ? binary_status_reply(BinaryStatus::Busy,
+                                                        "Server busy")
+                                  : "ERROR: Server busy");
+      answered_inline = true;
+    }
+  }
+
+  if (conn.busy || conn.tagged_in_flight > 0) {
+    peak_queue_depth = std::max(peak_queue_depth, pool.queue_depth());
+    mark_stats_dirty();
+  }
+  return !answered_inline || flush_output(conn);
+}
+
+// Connection-state commands (HELLO, SUBSCRIBE, GET_TELEMETRY_FD) must stay
+// untagged; tagged they fall through to handle_command like any unknown
+// command. Returns false if the frame was answered inline instead of queued.
+bool EventLoop::dispatch_tagged(uint64_t id, Connection &conn,
+                                std::string_view frame) {
+  std::string_view tag_view;
+  std::string_view command_view;
+  if (!split_request_tag(frame, &tag_view, &command_view)) {
+    queue_response(conn, "ERROR: Invalid request tag");
+    return false;
+  }
+
+  if (park_state_wait(id, conn, tag_view, command_view))
+    return true;
+
+  std::string tag(tag_view);
+  std::string command(command_view);
+  WorkerPool &lane = command_may_block(command) ? slow_pool : pool;
+  WriteTicket ticket = claim_write_ticket_if_queued(id, lane, command);
+  bool queued = lane.try_submit([id, tag, ticket, timing = CommandTiming(),
+                                 command = std::move(command)]() {
+    run_timed_command(id, timing, CompletionKind::TaggedReply, "#" + tag + " ",
+                      [&] { return handle_command(command, ticket); });
+  });
+  if (!queued) {
+    queue_response(conn, "#" + tag + " ERROR: Server busy");
+    return false;
+  }
+  ++conn.tagged_in_flight;
+  return true;
+}
+
+// Frames the reply and, when nothing is queued ahead of it, writes header and
+// payload with a single writev. Only bytes the socket does not take are
+// copied into the output buffer for flush_output().
+void EventLoop::queue_response(Connection &conn, std::string_view response) {
+  if (!first_response_logged) {
+    first_response_logged = true;
+    LOG_INFO << "server: first response " << milliseconds_since(started_at)
+             << " ms after startup";
+  }
+
+  char header[kFrameHeaderSize];
+  encode_u32_le(header, static_cast<uint32_t>(response.size()));
+
+  size_t sent = 0;
+  bool idle = conn.output_offset == conn.output.size() && conn.pending_fd < 0;
+  if (idle && !conn.write_failed) {
+    iovec iov[2] = {{header, sizeof(header)},
+                    {const_cast<char *>(response.data()), response.size()}};
+    msghdr msg = {};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+
+    ssize_t bytes_sent;
+    do {
+      bytes_sent = sendmsg(conn.fd, &msg, MSG_NOSIGNAL);
+    } while (bytes_sent < 0 && errno == EINTR);
+
+    if (bytes_sent >= 0) {
+      sent = static_cast<size_t>(bytes_sent);
+    } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+      LOG_ERROR << "Failed to send data: " << strerror(errno);
+      conn.write_failed = true;
+      return;
+    }
+  }
+
+  if (sent < sizeof(header))
+    conn.output.insert(conn.output.end(), header + sent, std::end(header));
+  size_t payload_sent = sent > sizeof(header) ? sent - sizeof(header) : 0;
+  conn.output.insert(conn.output.end(), response.begin() + payload_sent,
+                     response.end());
+}
+
+void EventLoop::queue_telemetry_fd(Connection &conn) {
+  int fd = telemetry_page_fd();
+  if (fd < 0) {
+    queue_response(conn, "ERROR: Telemetry page unavailable");
+    return;
+  }
+  conn.pending_fd = fd;
+  conn.pending_fd_offset = conn.output.size();
+  queue_response(conn, "OK");
+}
+
+bool EventLoop::flush_output(Connection &conn) {
+  if (conn.write_failed)
+    return false;
+
+  while (conn.output_offset < conn.output.size()) {
+    bool attach_fd =
+        conn.pending_fd >= 0 && conn.output_offset == conn.pending_fd_offset;
+    size_t end = conn.output.size();
+    if (conn.pending_fd >= 0 && conn.output_offset < conn.pending_fd_offset)
+      end = conn.pending_fd_offset;
+
+    const char *data = conn.output.data() + conn.output_offset;
+    size_t length = end - conn.output_offset;
+    ssize_t bytes_sent =
+        attach_fd ? send_with_fd(conn.fd, data, length, conn.pending_fd)
+                  : send(conn.fd, data, length, MSG_NOSIGNAL);
+    if (bytes_sent < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return true;
+      LOG_ERROR << "Failed to send data: " << strerror(errno);
+      return false;
+    }
+    if (attach_fd) {
+      close(conn.pending_fd);
+      conn.pending_fd = -1;
+    }
+    conn.output_offset += static_cast<size_t>(bytes_sent);
+  }
+
+  conn.output.clear();
+  conn.output_offset = 0;
+  return true;
+}
+
+// Reads from a client until kMaxBufferedInput bytes of unparsed input are
+// buffered, whether or not its dispatch is blocked, or until it stops
+// sending, and only asks for EPOLLOUT while a reply is pending.
+void EventLoop::update_interest(uint64_t id, Connection &conn) {
+  uint32_t wanted = 0;
+  if (!conn.read_closed && buffered_input(conn) < kMaxBufferedInput)
+    wanted |= EPOLLIN;
+  if (conn.output_offset < conn.output.size())
+    wanted |= EPOLLOUT;
+
+  if (wanted == conn.events)
+    return;
+
+  epoll_event ev = {};
+  ev.events = wanted;
+  ev.data.u64 = id;
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn.fd, &ev) == 0)
+    conn.events = wanted;
+}
+
+void EventLoop::drain_completions() {
+  std::vector<Completion> &ready = ready_completions;
+  {
+    std::lock_guard<std::mutex> lock(completion_mutex);
+    ready.swap(completions);
+  }
+
+  for (auto &completion : ready)
+    deliver(completion);
+  if (!ready.empty())
+    mark_stats_dirty();
+  ready.clear();
+}
+
+void EventLoop::deliver(Completion &completion) {
+  auto it = connections.find(completion.connection_id);
+  if (it == connections.end())
+    return; // client went away while the command ran
+
+  Connection &conn = it->second;
+  switch (completion.kind) {
+  case CompletionKind::Push:
+    if (conn.output.size() - conn.output_offset > kMaxPendingPushOutput)
+      return;
+    break;
+  case CompletionKind::TaggedReply:
+    --conn.tagged_in_flight;
+    break;
+  case CompletionKind::Reply:
+    conn.busy = false;
+    break;
+  }
+  queue_response(conn, completion.response);
+  if (completion.timing)
+    stats_record(*completion.timing, std::chrono::steady_clock::now());
+  if (!flush_output(conn) || !dispatch_next(completion.connection_id, conn) ||
+      (!handoff_pending() && answered_after_eof(conn))) {
+    close_connection(completion.connection_id);
+    return;
+  }
+  update_interest(completion.connection_id, conn);
+}
+
+// Parks a GET_STATE_SINCE that asks to wait while nothing has changed since
+// its version. Returns false if the request should run like any other.
+bool EventLoop::park_state_wait(uint64_t id, Connection &conn,
+                                std::string_view tag,
+                                std::string_view command) {
+  auto request = state_wait_request(command);
+  if (!request || request->since != state_version())
+    return false;
+
+  state_waiters.push_back({id, std::string(tag), request->since,
+                           std::chrono::steady_clock::now() + request->timeout});
+  if (tag.empty())
+    conn.busy = true;
+  else
+    ++conn.tagged_in_flight;
+  return true;
+}
+
+// Answers waiters whose version is out of date or whose wait ran out; the
+// state lives in memory, so this runs on the loop thread.
+void EventLoop::resolve_state_waiters() {
+  if (state_waiters.empty())
+    return;
+
+  auto now = std::chrono::steady_clock::now();
+  uint64_t version = state_version();
+  std::vector<Completion> answered;
+  auto ready = [&](const StateWaiter &waiter) {
+    if (waiter.since == version && waiter.deadline > now)
+      return false;
+    std::string reply = state_since(waiter.since);
+    if (waiter.tag.empty())
+      answered.push_back(
+          {waiter.connection_id, std::move(reply), CompletionKind::Reply, {}});
+    else
+      answered.push_back({waiter.connection_id,
+                          "#" + waiter.tag + " " + reply,
+                          CompletionKind::TaggedReply,
+                          {}});
+    return true;
+  };
+  state_waiters.erase(
+      std::remove_if(state_waiters.begin(), state_waiters.end(), ready),
+      state_waiters.end());
+
+  for (auto &completion : answered)
+    deliver(completion);
+}
+
+// A new daemon connected to take over. Stop accepting and dispatching, and
+// answer parked state waits now; the handoff goes out once the commands
+// already running have been answered.
+void EventLoop::accept_handoff() {
+  int channel = accept4(handoff_socket, nullptr, nullptr, SOCK_CLOEXEC);
+  if (channel < 0)
+    return;
+  if (handoff_pending()) {
+    close(channel); // one upgrade at a time
+    return;
+  }
+
+  LOG_INFO << "server: handing off to a new daemon";
+  timeval send_timeout = {kHandoffAckTimeout.count(), 0};
+  setsockopt(channel, SOL_SOCKET, SO_SNDTIMEO, &send_timeout,
+             sizeof(send_timeout));
+  handoff_channel = channel;
+  auto now = std::chrono::steady_clock::now();
+  handoff_deadline = now + kHandoffDrainTimeout;
+  epoll_ctl(epoll_fd, EPOLL_CTL_DEL, listen_socket, nullptr);
+
+  for (auto &waiter : state_waiters)
+    waiter.deadline = now;
+  resolve_state_waiters();
+}
+
+void EventLoop::finish_handoff_if_drained() {
+  bool drained = std::none_of(connections.begin(), connections.end(),
+                              [](const auto &entry) {
+                                const Connection &conn = entry.second;
+                                return conn.busy || conn.tagged_in_flight > 0 ||
+                                       conn.pending_fd >= 0;
+                              });
+  if (!drained) {
+    if (std::chrono::steady_clock::now() >= handoff_deadline)
+      abort_handoff("commands still running", nullptr);
+    return;
+  }
+
+  HandoffState state;
+  state.listen_fd = listen_socket;
+  state.owns_socket_path = owns_socket_path;
+  for (auto &[id, conn] : connections) {
+    if (!flush_output(conn))
+      continue; // broken anyway; closed when this daemon exits
+    HandoffClient client;
+    client.fd = conn.fd;
+    client.protocol_version = conn.protocol_version;
+    client.subscription = conn.subscription;
+    client.input.assign(conn.input.data() + conn.input_begin,
+                        buffered_input(conn));
+    client.output.assign(conn.output.begin() +
+                             static_cast<std::ptrdiff_t>(conn.output_offset),
+                         conn.output.end());
+    state.clients.push_back(std::move(client));
+  }
+
+  std::string fan_state = export_fan_controller_state();
+  state.fan_state = fan_state;
+  state.telemetry_page_fd = telemetry_page_hand_off();
+  state.state_document = state_export();
+
+  std::vector<size_t> skipped;
+  if (!handoff_send(handoff_channel, state, &skipped) ||
+      !handoff_await_ack(handoff_channel, kHandoffAckTimeout)) {
+    abort_handoff("the new daemon did not take over", &fan_state);
+    return;
+  }
+
+  LOG_INFO << "server: handed off " << state.clients.size() - skipped.size()
+           << " connections (dropped " << skipped.size()
+           << " with oversized buffers)";
+  close(handoff_channel);
+  handoff_channel = -1;
+  handed_off.store(true, std::memory_order_release);
+  server_running.store(false, std::memory_order_release);
+}
+
+// Picks up where the handoff interrupted: takes the fans and the page back
+// if they were exported, accepts again and dispatches what clients sent
+// meanwhile.
+void EventLoop::abort_handoff(const char *reason,
+                              const std::string *fan_state) {
+  LOG_ERROR << "server: handoff failed: " << reason;
+  close(handoff_channel);
+  handoff_channel = -1;
+
+  if (fan_state) {
+    telemetry_page_resume();
+    auto result = resume_fan_controller(*fan_state);
+    if (result != "OK")
+      LOG_ERROR << "Failed to resume fan control: " << result;
+  }
+
+  epoll_event listen_ev = {};
+  listen_ev.events = EPOLLIN;
+  listen_ev.data.u64 = kListenToken;
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_socket, &listen_ev);
+
+  std::vector<uint64_t> ids;
+  for (const auto &entry : connections)
+    ids.push_back(entry.first);
+  for (uint64_t id : ids) {
+    auto it = connections.find(id);
+    if (it == connections.end())
+      continue;
+    if (!dispatch_next(id, it->second)) {
+      close_connection(id);
+      continue;
+    }
+    update_interest(id, it->second);
+  }
+}
+
+void EventLoop::close_connection(uint64_t id) {
+  auto it = connections.find(id);
+  if (it == connections.end())
+    return;
+
+  if (it->second.subscribed)
+    telemetry_unsubscribe(id);
+  coalesce_forget_client(id);
+  state_waiters.erase(std::remove_if(state_waiters.begin(), state_waiters.end(),
+                                     [id](const StateWaiter &waiter) {
+                                       return waiter.connection_id == id;
+                                     }),
+                      state_waiters.end());
+  epoll_ctl(epoll_fd, EPOLL_CTL_DEL, it->second.fd, nullptr);
+  if (it->second.pending_fd >= 0)
+    close(it->second.pending_fd);
+  close(it->second.fd);
+  connections.erase(it);
+  mark_stats_dirty();
+
+  if (!connections.empty())
+    return;
+
+  bool queued = slow_pool.try_submit([]() {
+    auto result = ensure_better_auto_mode();
+    if (result != "OK") {
+      LOG_ERROR << "Failed to enforce BETTER_AUTO mode after client disconnect: "
+                << result;
+    }
+  });
+  if (!queued) {
+    LOG_ERROR << "Failed to schedule BETTER_AUTO enforcement: work queue full";
+  }
+}
+
+// Sleep indefinitely while nothing changed; otherwise wake up in time for the
+// next status line, the first parked state wait to expire or a stalled
+// handoff to give up, so an idle daemon does not tick.
+int EventLoop::next_timeout_ms() {
+  std::optional<std::chrono::steady_clock::time_point> wake_at;
+  if (stats_dirty)
+    wake_at = next_report;
+  if (handoff_pending() && (!wake_at || handoff_deadline < *wake_at))
+    wake_at = handoff_deadline;
+  for (const auto &waiter : state_waiters) {
+    if (!wake_at || waiter.deadline < *wake_at)
+      wake_at = waiter.deadline;
+  }
+  if (!wake_at)
+    return -1;
+
+  auto remaining = *wake_at - std::chrono::steady_clock::now();
+  // Rounded up so a deadline is never polled for just before it passes.
+  auto ms = std::chrono::ceil<std::chrono::milliseconds>(remaining).count();
+  return ms > 0 ? static_cast<int>(ms) : 0;
+}
+
+void EventLoop::report_status_if_due() {
+  if (!stats_dirty)
+    return;
+
+  auto now = std::chrono::steady_clock::now();
+  if (now < next_report)
+    return;
+
+  LOG_INFO << "server: " << connections.size() << " connections (peak "
+           << peak_connections << "), work queue " << pool.queue_depth()
+           << "/" << pool.queue_capacity() << " (peak " << peak_queue_depth
+           << "), slow lane " << slow_pool.queue_depth() << "/"
+           << slow_pool.queue_capacity();
+
+  stats_dirty = false;
+  peak_connections = connections.size();
+  peak_queue_depth = pool.queue_depth();
+  next_report = now + kStatusReportInterval;
+}
+
+} // namespace
+
+bool server_handed_off() {
+  return handed_off.load(std::memory_order_acquire);
+}
+
+void request_server_stop() {
+  server_running.store(false, std::memory_order_release);
+  wake_loop();
+}
+
+int run_server(int listen_socket, const ServerOptions &options) {
+  if (!set_nonblocking(listen_socket)) {
+    LOG_ERROR << "Failed to make listening socket non-blocking: "
+              << strerror(errno);
+    return 1;
+  }
+
+  int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd < 0) {
+    LOG_ERROR << "epoll_create1 failed: " << strerror(errno);
+    return 1;
+  }
+
+  int event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (event_fd < 0) {
+    LOG_ERROR << "eventfd failed: " << strerror(errno);
+    close(epoll_fd);
+    return 1;
+  }
+  wake_fd.store(event_fd, std::memory_order_release);
+
+  epoll_event listen_ev = {};
+  listen_ev.events = EPOLLIN;
+  listen_ev.data.u64 = kListenToken;
+  epoll_event wake_ev = {};
+  wake_ev.events = EPOLLIN;
+  wake_ev.data.u64 = kWakeToken;
+  epoll_event handoff_ev = {};
+  handoff_ev.events = EPOLLIN;
+  handoff_ev.data.u64 = kHandoffToken;
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_socket, &listen_ev) < 0 ||
+      epoll_ctl(epoll_fd, EPOLL_CTL_ADD, event_fd, &wake_ev) < 0 ||
+      (options.handoff_socket >= 0 &&
+       epoll_ctl(epoll_fd, EPOLL_CTL_ADD, options.handoff_socket,
+                 &handoff_ev) < 0)) {
+    LOG_ERROR << "Failed to register server descriptors: " << strerror(errno);
+    wake_fd.store(-1, std::memory_order_release);
+    close(event_fd);
+    close(epoll_fd);
+    return 1;
+  }
+
+  telemetry_set_sink(post_push);
+  state_set_listener(wake_loop);
+
+  {
+    EventLoop loop(listen_socket, epoll_fd, options);
+    if (options.adopted)
+      loop.adopt_clients(*options.adopted);
+    // A stop requested before the eventfd existed would otherwise be missed.
+    if (server_running.load(std::memory_order_acquire))
+      loop.run();
+    telemetry_shutdown();
+    loop.shutdown();
+  }
+
+  wake_fd.store(-1, std::memory_order_release);
+  close(event_fd);
+  close(epoll_fd);
+  return 0;
+}
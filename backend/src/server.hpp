@@ -0,0 +1,31 @@
+#pragma once
+
+#include <chrono>
+
+struct HandoffState;
+
+struct ServerOptions {
+  // The time from here to the first reply sent is logged once.
+  std::chrono::steady_clock::time_point started_at =
+      std::chrono::steady_clock::now();
+  // Listening handoff socket (see handoff.hpp), or -1 to refuse upgrades.
+  int handoff_socket = -1;
+  // Clients taken over from the previous daemon; the server owns their
+  // descriptors from here on.
+  HandoffState *adopted = nullptr;
+  // Passed on to the next daemon in a handoff.
+  bool owns_socket_path = false;
+};
+
+// Runs the epoll event loop on an already bound and listening socket until
+// request_server_stop() is called or the daemon hands itself off. All client
+// sockets are multiplexed on one thread; commands are executed on a bounded
+// worker pool.
+int run_server(int listen_socket, const ServerOptions &options = {});
+
+// Whether run_server() returned because a new daemon took over. The listening
+// socket, its path and the fans belong to that daemon now.
+bool server_handed_off();
+
+// Async-signal-safe: may be called from a signal handler.
+void request_server_stop();
@@ -5,10 +5,13 @@
 
 set -euo pipefail
 
-if [[ $# -ne 1 ]]; then
-    echo "Usage: $0 <AUTO|MANUAL|MAX>" >&2
+source "$(dirname "${BASH_SOURCE[0]}")/victus-helper-common.sh"
+
+if [[ $# -lt 1 || $# -gt 2 ]]; then
+    echo "Usage: $0 <AUTO|MANUAL|MAX> [hwmonN]" >&2
     exit 1
 fi
+hwmon_name="${2:-}"
 
 mode="${1^^}"
 case "$mode" in
@@ -25,8 +28,7 @@ case "$mode" in
         ;;
 esac
 
-HWMON_BASE="/sys/devices/platform/hp-wmi/hwmon"
-HWMON_PATH=$(find "$HWMON_BASE" -mindepth 1 -maxdepth 1 -type d -name "hwmon*" | head -n 1 || true)
+HWMON_PATH=$(find_hwmon_path "$hwmon_name")
 
 if [[ -z "${HWMON_PATH}" ]]; then
     echo "Error: Hwmon directory not found under $HWMON_BASE." >&2
@@ -5,13 +5,16 @@
 
 set -euo pipefail
 
-if [ "$#" -ne 2 ]; then
-    echo "Usage: $0 <fan_number> <speed>"
+source "$(dirname "${BASH_SOURCE[0]}")/victus-helper-common.sh"
+
+if [ "$#" -lt 2 ] || [ "$#" -gt 3 ]; then
+    echo "Usage: $0 <fan_number> <speed> [hwmonN]"
     exit 1
 fi
 
 FAN_NUM=$1
 SPEED=$2
+HWMON_NAME=${3:-}
 
 if ! [[ "$FAN_NUM" =~ ^[0-9]+$ ]]; then
     echo "Error: Fan number must be a positive integer"
@@ -23,8 +26,7 @@ if ! [[ "$SPEED" =~ ^[0-9]+$ ]]; then
     exit 1
 fi
 
-HWMON_BASE="/sys/devices/platform/hp-wmi/hwmon"
-HWMON_PATH=$(find "$HWMON_BASE" -mindepth 1 -type d -name "hwmon*" | head -n 1)
+HWMON_PATH=$(find_hwmon_path "$HWMON_NAME")
 
 if [ -z "$HWMON_PATH" ]; then
     echo "Error: Hwmon directory not found."
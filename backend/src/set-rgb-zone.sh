@@ -1,6 +1,8 @@
 #!/bin/bash
 # Helper script to set RGB zone color with root privileges
 
+source "$(dirname "${BASH_SOURCE[0]}")/victus-helper-common.sh"
+
 if [ "$#" -ne 2 ]; then
     echo "Usage: $0 <zone_number> <hex_color>"
     exit 1
@@ -25,7 +27,7 @@ fi
 COLOR=$(echo "$COLOR" | tr '[:lower:]' '[:upper:]')
 
 # Write to zone file
-ZONE_FILE="/sys/devices/platform/hp-wmi/rgb_zones/zone0${ZONE}"
+ZONE_FILE="$HP_WMI_DIR/rgb_zones/zone0${ZONE}"
 
 if [ ! -f "$ZONE_FILE" ]; then
     echo "Error: Zone file $ZONE_FILE not found"
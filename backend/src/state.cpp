@@ -0,0 +1,124 @@
+#include "state.hpp"
+
+#include <array>
+#include <charconv>
+#include <mutex>
+
+namespace {
+
+constexpr size_t kFieldCount = static_cast<size_t>(StateField::Count);
+
+// Indexed by StateField.
+constexpr std::array<std::string_view, kFieldCount> kFieldKeys = {
+    "mode",          "fan1_target",    "fan2_target", "level",
+    "keyboard_type", "keyboard_color", "zone0",       "zone1",
+    "zone2",         "zone3",          "brightness"};
+
+struct FieldState {
+  std::string value;
+  uint64_t version = 0; // 0 until the field is first published
+};
+
+std::mutex state_mutex;
+uint64_t current_version = 0;
+std::array<FieldState, kFieldCount> fields;
+std::function<void()> change_listener;
+
+} // namespace
+
+void state_publish(StateField field, std::string value) {
+  std::function<void()> listener;
+  {
+    std::lock_guard<std::mutex> lock(state_mutex);
+    FieldState &entry = fields[static_cast<size_t>(field)];
+    if (entry.version != 0 && entry.value == value)
+      return;
+    entry.value = std::move(value);
+    entry.version = ++current_version;
+    listener = change_listener;
+  }
+  if (listener)
+    listener();
+}
+
+uint64_t state_version() {
+  std::lock_guard<std::mutex> lock(state_mutex);
+  return current_version;
+}
+
+std::string state_since(uint64_t since) {
+  std::lock_guard<std::mutex> lock(state_mutex);
+  if (since > current_version)
+    since = 0;
+
+  std::string reply = "STATE " + std::to_string(current_version);
+  for (size_t i = 0; i < kFieldCount; ++i) {
+    if (fields[i].version <= since)
+      continue;
+    reply += '\n';
+    reply += kFieldKeys[i];
+    reply += '=';
+    reply += fields[i].value;
+  }
+  return reply;
+}
+
+// One line per field: "<index> <version> <value>", after a first line with
+// the current version.
+std::string state_export() {
+  std::lock_guard<std::mutex> lock(state_mutex);
+  std::string exported = std::to_string(current_version);
+  for (size_t i = 0; i < kFieldCount; ++i) {
+    if (fields[i].version == 0)
+      continue;
+    exported += '\n' + std::to_string(i) + ' ' +
+                std::to_string(fields[i].version) + ' ' + fields[i].value;
+  }
+  return exported;
+}
+
+bool state_import(std::string_view exported) {
+  auto parse_number = [](std::string_view *text, uint64_t *value) {
+    auto [end, ec] =
+        std::from_chars(text->data(), text->data() + text->size(), *value);
+    if (ec != std::errc())
+      return false;
+    text->remove_prefix(static_cast<size_t>(end - text->data()));
+    return true;
+  };
+
+  uint64_t version = 0;
+  std::array<FieldState, kFieldCount> imported;
+  if (!parse_number(&exported, &version))
+    return false;
+
+  while (!exported.empty()) {
+    if (exported[0] != '\n')
+      return false;
+    exported.remove_prefix(1);
+    size_t newline = exported.find('\n');
+    std::string_view line = exported.substr(0, newline);
+    exported.remove_prefix(line.size());
+
+    uint64_t index = 0;
+    uint64_t field_version = 0;
+    if (!parse_number(&line, &index) || index >= kFieldCount ||
+        line.empty() || line[0] != ' ')
+      return false;
+    line.remove_prefix(1);
+    if (!parse_number(&line, &field_version) || field_version == 0 ||
+        field_version > version || line.empty() || line[0] != ' ')
+      return false;
+    imported[index] = {std::string(line.substr(1)), field_version};
+  }
+
+  std::lock_guard<std::mutex> lock(state_mutex);
+  current_version = version;
+  fields = std::move(imported);
+  return true;
+}
+
+void state_set_listener(std::function<void()> listener) {
+  std::lock_guard<std::mutex> lock(state_mutex);
+  change_listener = std::move(listener);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+// Versioned document of the settings the frontend displays. Every change
+// bumps a global version and stamps the field with it, so
+// "GET_STATE_SINCE <version>" can answer with just the fields that changed:
+//
+//   STATE 42
+//   mode=MANUAL
+//   fan1_target=3200
+//
+// The first line carries the current version; each following line is one
+// changed field. A version the daemon has not reached yet (from a previous
+// run) is answered with the whole document, as is version 0.
+
+enum class StateField {
+  Mode,
+  Fan1Target,
+  Fan2Target,
+  BetterAutoLevel,
+  KeyboardType,
+  KeyboardColor,
+  Zone0Color,
+  Zone1Color,
+  Zone2Color,
+  Zone3Color,
+  Brightness,
+  Count
+};
+
+// Records a field's value; a no-op when it did not change. Cheap enough to
+// call from the hardware layer after every successful write.
+void state_publish(StateField field, std::string value);
+
+uint64_t state_version();
+std::string state_since(uint64_t since);
+
+// Upgrade handoff: the whole document with its versions, so clients' versions
+// stay valid across the upgrade. Import returns false on malformed input.
+std::string state_export();
+bool state_import(std::string_view exported);
+
+// Runs after every version bump on the publishing thread; must not block.
+void state_set_listener(std::function<void()> listener);
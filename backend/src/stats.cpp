@@ -0,0 +1,181 @@
+#include "stats.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <string_view>
+
+namespace {
+
+enum Phase : uint8_t { Queue, Parse, LockWait, Io, Send, Total, kPhaseCount };
+
+constexpr std::array<std::string_view, kPhaseCount> kPhaseNames = {
+    "queue", "parse", "lock_wait", "io", "send", "total"};
+
+// Log-linear buckets in microseconds: exact below 8, then 8 sub-buckets per
+// power of two up to 2^40 us (about 12 days); anything longer lands in the
+// last bucket.
+constexpr unsigned kSubBucketBits = 3;
+constexpr uint64_t kSubBuckets = 1u << kSubBucketBits;
+constexpr unsigned kMaxExponent = 39;
+constexpr size_t kBucketCount =
+    kSubBuckets + (kMaxExponent - kSubBucketBits + 1) * kSubBuckets;
+
+size_t bucket_index(uint64_t us) {
+  if (us < kSubBuckets)
+    return static_cast<size_t>(us);
+  unsigned exponent = static_cast<unsigned>(std::bit_width(us)) - 1;
+  if (exponent > kMaxExponent)
+    return kBucketCount - 1;
+  uint64_t sub = (us >> (exponent - kSubBucketBits)) & (kSubBuckets - 1);
+  return kSubBuckets + (exponent - kSubBucketBits) * kSubBuckets + sub;
+}
+
+uint64_t bucket_upper_bound(size_t index) {
+  if (index < kSubBuckets)
+    return index;
+  unsigned shift = static_cast<unsigned>((index - kSubBuckets) / kSubBuckets);
+  uint64_t sub = (index - kSubBuckets) % kSubBuckets;
+  uint64_t lower = (kSubBuckets + sub) << shift;
+  return lower + (uint64_t{1} << shift) - 1;
+}
+
+struct Histogram {
+  std::atomic<uint64_t> count;
+  std::atomic<uint64_t> max;
+  // Stored inverted so the zero-initialised value means "no sample yet".
+  std::atomic<uint64_t> inverted_min;
+  std::array<std::atomic<uint64_t>, kBucketCount> buckets;
+};
+
+// Zero-initialised static storage; rows nobody uses are never touched.
+Histogram histograms[kStatsSlotCount][kPhaseCount];
+
+thread_local CommandTiming *current_command = nullptr;
+
+void raise_to(std::atomic<uint64_t> &slot, uint64_t value) {
+  uint64_t seen = slot.load(std::memory_order_relaxed);
+  while (seen < value &&
+         !slot.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {
+  }
+}
+
+void add_sample(Histogram &histogram, StatsClock::duration elapsed) {
+  auto us = std::chrono::duration_cast<std::chrono::microseconds>(elapsed);
+  uint64_t value = us.count() > 0 ? static_cast<uint64_t>(us.count()) : 0;
+  histogram.buckets[bucket_index(value)].fetch_add(1,
+                                                   std::memory_order_relaxed);
+  raise_to(histogram.max, value);
+  raise_to(histogram.inverted_min, ~value);
+  histogram.count.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Samples land in the buckets before the count moves, so a report taken
+// while workers record works from the bucket total it actually sees.
+void append_row(std::string *reply, std::string_view name,
+                std::string_view phase, const Histogram &histogram) {
+  std::array<uint64_t, kBucketCount> buckets;
+  uint64_t total = 0;
+  for (size_t i = 0; i < kBucketCount; ++i) {
+    buckets[i] = histogram.buckets[i].load(std::memory_order_relaxed);
+    total += buckets[i];
+  }
+  uint64_t max = histogram.max.load(std::memory_order_relaxed);
+  uint64_t min = ~histogram.inverted_min.load(std::memory_order_relaxed);
+
+  auto percentile = [&](uint64_t per_mille) {
+    uint64_t rank = (total * per_mille + 999) / 1000;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBucketCount; ++i) {
+      seen += buckets[i];
+      if (seen >= rank && seen > 0)
+        return std::min(bucket_upper_bound(i), max);
+    }
+    return max;
+  };
+
+  *reply += "\n";
+  *reply += name;
+  *reply += " ";
+  *reply += phase;
+  *reply += " count=" + std::to_string(total) +
+            " min_us=" + std::to_string(min) +
+            " p50_us=" + std::to_string(percentile(500)) +
+            " p99_us=" + std::to_string(percentile(990)) +
+            " p999_us=" + std::to_string(percentile(999)) +
+            " max_us=" + std::to_string(max);
+}
+
+} // namespace
+
+StatsCommandScope::StatsCommandScope(CommandTiming *timing) : timing(timing) {
+  timing->started = StatsClock::now();
+  current_command = timing;
+}
+
+StatsCommandScope::~StatsCommandScope() {
+  timing->finished = StatsClock::now();
+  current_command = nullptr;
+}
+
+CommandTiming *stats_current_command() { return current_command; }
+
+StatsLockWait::~StatsLockWait() {
+  if (current_command)
+    current_command->lock_wait += StatsClock::now() - start;
+}
+
+void stats_record(const CommandTiming &timing, StatsClock::time_point sent) {
+  auto &row = histograms[timing.slot < kStatsSlotCount
+                             ? timing.slot
+                             : static_cast<uint8_t>(kStatsUnknownSlot)];
+  StatsClock::duration handler = timing.finished - timing.started;
+  StatsClock::duration io = handler - timing.parse - timing.lock_wait;
+
+  add_sample(row[Queue], timing.started - timing.submitted);
+  add_sample(row[Parse], timing.parse);
+  add_sample(row[LockWait], timing.lock_wait);
+  add_sample(row[Io], io);
+  add_sample(row[Send], sent - timing.finished);
+  add_sample(row[Total], sent - timing.submitted);
+}
+
+std::string_view stats_slot_name(size_t slot) {
+  if (slot < VICTUS_COMMAND_COUNT)
+    return kVictusCommands[slot].name;
+  switch (slot) {
+  case kStatsBatchSlot:
+    return "BATCH";
+  case kStatsBinarySlot:
+    return "BINARY";
+  default:
+    return "UNKNOWN";
+  }
+}
+
+std::string stats_report() {
+  std::string rows;
+  size_t row_count = 0;
+  for (size_t slot = 0; slot < kStatsSlotCount; ++slot) {
+    if (histograms[slot][Total].count.load(std::memory_order_relaxed) == 0)
+      continue;
+    for (size_t phase = 0; phase < kPhaseCount; ++phase) {
+      append_row(&rows, stats_slot_name(slot), kPhaseNames[phase],
+                 histograms[slot][phase]);
+      ++row_count;
+    }
+  }
+  return "STATS " + std::to_string(row_count) + rows;
+}
+
+std::vector<std::pair<std::string_view, uint64_t>> stats_command_counts() {
+  std::vector<std::pair<std::string_view, uint64_t>> counts;
+  for (size_t slot = 0; slot < kStatsSlotCount; ++slot) {
+    uint64_t count =
+        histograms[slot][Total].count.load(std::memory_order_relaxed);
+    if (count > 0)
+      counts.emplace_back(stats_slot_name(slot), count);
+  }
+  return counts;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "victus_commands.hpp"
+
+// Per-command latency histograms, reported by the STATS command.
+//
+// Every command the server hands to a worker is timed from submission to the
+// moment its reply is written, split into phases:
+//
+//   queue      waiting for a worker
+//   parse      schema lookup and argument checks
+//   lock_wait  fan_apply_mutex, the gap between fan writes, and the
+//              per-target write queue and rate limit (coalesce.hpp)
+//   io         the rest of the handler: sysfs reads and the sudo helpers
+//   send       from the worker's reply to the socket write
+//   total      all of the above
+//
+// Recording is a handful of relaxed atomic increments, so workers and the
+// event loop never contend on a lock for it.
+
+using StatsClock = std::chrono::steady_clock;
+
+// Histogram rows beyond the text commands.
+enum StatsSlot : uint8_t {
+  kStatsBatchSlot = VICTUS_COMMAND_COUNT,
+  kStatsBinarySlot,
+  kStatsUnknownSlot, // requests the schema rejected
+  kStatsSlotCount
+};
+
+struct CommandTiming {
+  StatsClock::time_point submitted = StatsClock::now();
+  StatsClock::time_point started;
+  StatsClock::time_point finished;
+  StatsClock::duration parse{};
+  StatsClock::duration lock_wait{};
+  uint8_t slot = kStatsUnknownSlot;
+};
+
+// Makes `timing` the calling thread's current command while the handler
+// runs, and stamps its start and finish.
+class StatsCommandScope {
+public:
+  explicit StatsCommandScope(CommandTiming *timing);
+  ~StatsCommandScope();
+  StatsCommandScope(const StatsCommandScope &) = delete;
+  StatsCommandScope &operator=(const StatsCommandScope &) = delete;
+
+private:
+  CommandTiming *timing;
+};
+
+// The command running on this thread, or nullptr (Better Auto, tests).
+CommandTiming *stats_current_command();
+
+// Charges the scope's lifetime to the current command's lock_wait.
+class StatsLockWait {
+public:
+  StatsLockWait() : start(StatsClock::now()) {}
+  ~StatsLockWait();
+  StatsLockWait(const StatsLockWait &) = delete;
+  StatsLockWait &operator=(const StatsLockWait &) = delete;
+
+private:
+  StatsClock::time_point start;
+};
+
+// Adds a finished command whose reply was written at `sent`.
+void stats_record(const CommandTiming &timing, StatsClock::time_point sent);
+
+// "STATS <rows>" followed by one line per command and phase that has run:
+//
+//   SET_FAN_SPEED lock_wait count=12 min_us=3 p50_us=9500000 p99_us=...
+//
+// with p50_us, p99_us, p999_us and max_us. Percentiles are bucket upper
+// bounds, within 1/8 of the true value.
+std::string stats_report();
+
+// The command name for a CommandTiming::slot, or BATCH, BINARY, UNKNOWN.
+std::string_view stats_slot_name(size_t slot);
+
+// How many replies each row has sent, for rows that have any (metrics.hpp).
+std::vector<std::pair<std::string_view, uint64_t>> stats_command_counts();
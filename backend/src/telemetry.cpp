@@ -0,0 +1,291 @@
+#include "telemetry.hpp"
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "fan.hpp"
+#include "validation.hpp"
+#include "victus_commands.hpp"
+
+namespace {
+
+constexpr std::string_view kSubscribePrefix = "SUBSCRIBE ";
+constexpr int kMaxIntervalSeconds = kVictusMaxSubscribeInterval;
+
+constexpr uint32_t kTopicFan = 1u << 0;
+constexpr uint32_t kTopicMode = 1u << 1;
+constexpr uint32_t kTopicTemp = 1u << 2;
+constexpr uint32_t kTopicLevel = 1u << 3;
+constexpr uint32_t kTopicAll = kTopicFan | kTopicMode | kTopicTemp | kTopicLevel;
+// Topics whose changes are pushed without waiting for the next tick.
+constexpr uint32_t kEventTopics = kTopicMode | kTopicLevel;
+
+using Clock = std::chrono::steady_clock;
+
+struct Subscriber {
+  uint32_t topics = 0;
+  Clock::duration interval{};
+  Clock::time_point next_due{};
+  std::function<void(const TelemetrySample &)> local_consumer;
+};
+
+// Local subscribers share the map with connections; give them ids that can
+// never be handed out to a connection.
+constexpr uint64_t kFirstLocalSubscriberId = UINT64_MAX / 2;
+uint64_t next_local_subscriber_id = kFirstLocalSubscriberId;
+
+std::mutex hub_mutex;
+std::condition_variable hub_cv;
+std::unordered_map<uint64_t, Subscriber> subscribers;
+TelemetrySink sink;
+std::thread hub_thread;
+bool wake_pending = false;
+bool state_changed = false;
+bool stopping = false;
+bool listener_installed = false;
+
+std::optional<uint32_t> parse_topics(std::string_view list) {
+  uint32_t topics = 0;
+  while (!list.empty()) {
+    size_t comma = list.find(',');
+    std::string_view topic = list.substr(0, comma);
+    list.remove_prefix(comma == std::string_view::npos ? list.size()
+                                                       : comma + 1);
+    if (topic == "fan")
+      topics |= kTopicFan;
+    else if (topic == "mode")
+      topics |= kTopicMode;
+    else if (topic == "temp")
+      topics |= kTopicTemp;
+    else if (topic == "level")
+      topics |= kTopicLevel;
+    else if (topic == "all")
+      topics |= kTopicAll;
+    else
+      return std::nullopt;
+  }
+  if (topics == 0)
+    return std::nullopt;
+  return topics;
+}
+
+TelemetrySample take_sample(uint32_t topics) {
+  TelemetrySample sample;
+  if (topics & kTopicFan) {
+    for (size_t i = 0; i < sample.fan_rpm.size(); ++i) {
+      int rpm = 0;
+      if (read_fan_speed_rpm(i, &rpm))
+        sample.fan_rpm[i] = rpm;
+    }
+  }
+  if (topics & kTopicMode)
+    sample.mode = get_fan_mode();
+  if (topics & kTopicTemp) {
+    int millicelsius = 0;
+    if (read_cpu_temperature_millicelsius(&millicelsius))
+      sample.cpu_temp_millicelsius = millicelsius;
+  }
+  if (topics & kTopicLevel)
+    sample.level = get_better_auto_level();
+  return sample;
+}
+
+void append_value(std::string &frame, const char *key,
+                  const std::optional<int> &value) {
+  frame += ' ';
+  frame += key;
+  frame += '=';
+  frame += value ? std::to_string(*value) : "NA";
+}
+
+std::string format_frame(const TelemetrySample &sample, uint32_t topics) {
+  std::string frame = "TELEMETRY";
+  if (topics & kTopicFan) {
+    append_value(frame, "fan1", sample.fan_rpm[0]);
+    append_value(frame, "fan2", sample.fan_rpm[1]);
+  }
+  if (topics & kTopicMode) {
+    frame += " mode=";
+    frame += sample.mode.rfind("ERROR", 0) == 0 ? "NA" : sample.mode;
+  }
+  if (topics & kTopicTemp) {
+    std::optional<int> celsius;
+    if (sample.cpu_temp_millicelsius)
+      celsius = (*sample.cpu_temp_millicelsius + 500) / 1000;
+    append_value(frame, "cpu_temp", celsius);
+  }
+  if (topics & kTopicLevel)
+    append_value(frame, "level", sample.level);
+  return frame;
+}
+
+void hub_loop() {
+  std::unique_lock<std::mutex> lock(hub_mutex);
+
+  while (!stopping) {
+    auto now = Clock::now();
+    std::vector<std::pair<uint64_t, uint32_t>> due;
+    std::vector<std::function<void(const TelemetrySample &)>> local_due;
+    uint32_t needed = 0;
+    std::optional<Clock::time_point> earliest;
+
+    for (auto &[id, subscriber] : subscribers) {
+      bool event_push = state_changed && (subscriber.topics & kEventTopics);
+      if (subscriber.next_due <= now || event_push) {
+        if (subscriber.local_consumer)
+          local_due.push_back(subscriber.local_consumer);
+        else
+          due.emplace_back(id, subscriber.topics);
+        needed |= subscriber.topics;
+        if (subscriber.next_due <= now)
+          subscriber.next_due = now + subscriber.interval;
+      }
+      if (!earliest || subscriber.next_due < *earliest)
+        earliest = subscriber.next_due;
+    }
+    state_changed = false;
+
+    if (due.empty() && local_due.empty()) {
+      // No subscribers means no timer at all, so an idle daemon stays asleep.
+      auto woken = [] { return stopping || wake_pending; };
+      if (earliest)
+        hub_cv.wait_until(lock, *earliest, woken);
+      else
+        hub_cv.wait(lock, woken);
+      wake_pending = false;
+      continue;
+    }
+
+    TelemetrySink deliver = sink;
+    lock.unlock();
+
+    TelemetrySample sample = take_sample(needed);
+    if (deliver) {
+      for (const auto &[id, topics] : due)
+        deliver(id, format_frame(sample, topics));
+    }
+    for (const auto &consumer : local_due)
+      consumer(sample);
+
+    lock.lock();
+  }
+}
+
+void on_fan_state_changed() {
+  {
+    std::lock_guard<std::mutex> lock(hub_mutex);
+    state_changed = true;
+    wake_pending = true;
+  }
+  hub_cv.notify_one();
+}
+
+// Topics 0 takes an empty sample, so the consumer costs no hardware reads.
+void add_local_subscriber(
+    uint32_t topics, int interval_seconds,
+    std::function<void(const TelemetrySample &)> consumer) {
+  {
+    std::lock_guard<std::mutex> lock(hub_mutex);
+    if (stopping)
+      return;
+
+    Subscriber &subscriber = subscribers[next_local_subscriber_id++];
+    subscriber.topics = topics;
+    subscriber.interval = std::chrono::seconds(interval_seconds);
+    subscriber.next_due = Clock::now();
+    subscriber.local_consumer = std::move(consumer);
+    wake_pending = true;
+
+    if (!hub_thread.joinable())
+      hub_thread = std::thread(hub_loop);
+  }
+  hub_cv.notify_one();
+}
+
+} // namespace
+
+void telemetry_set_sink(TelemetrySink new_sink) {
+  bool install_listener = false;
+  {
+    std::lock_guard<std::mutex> lock(hub_mutex);
+    sink = std::move(new_sink);
+    install_listener = !listener_installed;
+    listener_installed = true;
+  }
+  if (install_listener)
+    add_fan_state_listener(on_fan_state_changed);
+}
+
+bool is_subscribe_command(std::string_view payload) {
+  return payload.substr(0, kSubscribePrefix.size()) == kSubscribePrefix;
+}
+
+std::string telemetry_subscribe(uint64_t connection_id,
+                                std::string_view command) {
+  std::string_view args = command.substr(kSubscribePrefix.size());
+  std::string_view topic_list = next_token(&args);
+  std::string_view interval_str = next_token(&args);
+  if (topic_list.empty() || interval_str.empty() || !next_token(&args).empty())
+    return "ERROR: Invalid SUBSCRIBE command format";
+
+  auto topics = parse_topics(topic_list);
+  if (!topics)
+    return "ERROR: Invalid SUBSCRIBE topics";
+
+  int interval_seconds = 0;
+  if (!parse_bounded_int(interval_str, 1, kMaxIntervalSeconds,
+                         &interval_seconds))
+    return "ERROR: Invalid SUBSCRIBE interval";
+
+  {
+    std::lock_guard<std::mutex> lock(hub_mutex);
+    if (stopping)
+      return "ERROR: Server shutting down";
+
+    Subscriber &subscriber = subscribers[connection_id];
+    subscriber.topics = *topics;
+    subscriber.interval = std::chrono::seconds(interval_seconds);
+    subscriber.next_due = Clock::now();
+    wake_pending = true;
+
+    if (!hub_thread.joinable())
+      hub_thread = std::thread(hub_loop);
+  }
+  hub_cv.notify_one();
+  return "OK";
+}
+
+void telemetry_add_local_subscriber(
+    int interval_seconds, std::function<void(const TelemetrySample &)> consumer) {
+  add_local_subscriber(kTopicAll, interval_seconds, std::move(consumer));
+}
+
+void telemetry_add_local_timer(int interval_seconds,
+                               std::function<void()> tick) {
+  add_local_subscriber(0, interval_seconds,
+                       [tick = std::move(tick)](const TelemetrySample &) {
+                         tick();
+                       });
+}
+
+void telemetry_unsubscribe(uint64_t connection_id) {
+  std::lock_guard<std::mutex> lock(hub_mutex);
+  subscribers.erase(connection_id);
+}
+
+void telemetry_shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(hub_mutex);
+    stopping = true;
+    subscribers.clear();
+  }
+  hub_cv.notify_all();
+  if (hub_thread.joinable())
+    hub_thread.join();
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Push telemetry for "SUBSCRIBE <topics> <interval>" connections.
+//
+// <topics> is a comma-separated list of fan, mode, temp and level (or "all"),
+// <interval> the push period in seconds (1-3600). After the "OK" reply the
+// connection only receives frames of the form
+//
+//   TELEMETRY fan1=3200 fan2=3400 mode=BETTER_AUTO cpu_temp=61 level=4
+//
+// carrying the subscribed keys; unavailable values are reported as "NA".
+// A single thread samples the hardware once per due tick and fans the frame
+// out to every subscriber. Mode and Better Auto level changes are pushed
+// immediately to subscribers of those topics.
+
+struct TelemetrySample {
+  std::array<std::optional<int>, 2> fan_rpm;
+  std::string mode;
+  std::optional<int> cpu_temp_millicelsius;
+  int level = 0;
+};
+
+// Hands a frame to the connection; called from the telemetry thread.
+using TelemetrySink =
+    std::function<void(uint64_t connection_id, std::string frame)>;
+
+void telemetry_set_sink(TelemetrySink sink);
+
+bool is_subscribe_command(std::string_view payload);
+
+// Registers the connection and returns "OK", or an "ERROR: ..." reply.
+std::string telemetry_subscribe(uint64_t connection_id,
+                                std::string_view command);
+void telemetry_unsubscribe(uint64_t connection_id);
+
+// In-process consumer of every topic, fed by the same samples as the socket
+// subscribers (used by the shared-memory page).
+void telemetry_add_local_subscriber(
+    int interval_seconds, std::function<void(const TelemetrySample &)> consumer);
+// Runs `tick` on the telemetry thread every interval without sampling
+// anything.
+void telemetry_add_local_timer(int interval_seconds, std::function<void()> tick);
+
+// Stops the sampling thread; pending pushes are dropped.
+void telemetry_shutdown();
@@ -0,0 +1,235 @@
+#include "telemetry_page.hpp"
+
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <mutex>
+#include <new>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "log.hpp"
+#include "telemetry.hpp"
+#include "victus_telemetry_page.hpp"
+
+namespace {
+
+// Matches the Better Auto sampling period.
+constexpr int kPageRefreshSeconds = 2;
+
+std::mutex page_mutex;
+int page_memfd = -1;
+VictusTelemetryPage *page = nullptr;
+VictusTelemetrySnapshot current = {};
+// Set while another daemon takes the page over.
+bool page_handed_off = false;
+
+int32_t to_fixed(const std::optional<double> &value, double scale) {
+  if (!value)
+    return kVictusTelemetryUnavailable;
+  return static_cast<int32_t>(std::lround(*value * scale));
+}
+
+int32_t encode_mode(const std::string &mode) {
+  if (mode == "AUTO")
+    return VICTUS_TELEMETRY_MODE_AUTO;
+  if (mode == "MANUAL")
+    return VICTUS_TELEMETRY_MODE_MANUAL;
+  if (mode == "MAX")
+    return VICTUS_TELEMETRY_MODE_MAX;
+  if (mode == "BETTER_AUTO")
+    return VICTUS_TELEMETRY_MODE_BETTER_AUTO;
+  return kVictusTelemetryUnavailable;
+}
+
+uint64_t monotonic_ns() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull +
+         static_cast<uint64_t>(ts.tv_nsec);
+}
+
+// Seqlock write of `current`; page_mutex serializes writers.
+void write_page_locked() {
+  if (page_handed_off)
+    return;
+  constexpr auto relaxed = std::memory_order_relaxed;
+  current.updated_ns = monotonic_ns();
+
+  uint32_t sequence = page->sequence.load(relaxed);
+  page->sequence.store(sequence + 1, relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  for (int i = 0; i < 2; ++i) {
+    page->fan_rpm[i].store(current.fan_rpm[i], relaxed);
+    page->fan_target_rpm[i].store(current.fan_target_rpm[i], relaxed);
+  }
+  page->cpu_temp_millicelsius.store(current.cpu_temp_millicelsius, relaxed);
+  page->gpu_temp_millicelsius.store(current.gpu_temp_millicelsius, relaxed);
+  page->cpu_usage_permille.store(current.cpu_usage_permille, relaxed);
+  page->gpu_usage_permille.store(current.gpu_usage_permille, relaxed);
+  page->fan_mode.store(current.fan_mode, relaxed);
+  page->better_auto_level.store(current.better_auto_level, relaxed);
+  page->updated_ns.store(current.updated_ns, relaxed);
+
+  page->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void publish_sample(const TelemetrySample &sample) {
+  std::lock_guard<std::mutex> lock(page_mutex);
+  for (size_t i = 0; i < sample.fan_rpm.size(); ++i)
+    current.fan_rpm[i] = sample.fan_rpm[i].value_or(kVictusTelemetryUnavailable);
+  current.fan_mode = encode_mode(sample.mode);
+  current.better_auto_level = sample.level;
+  if (sample.cpu_temp_millicelsius)
+    current.cpu_temp_millicelsius = *sample.cpu_temp_millicelsius;
+  write_page_locked();
+}
+
+bool map_page_locked(int fd) {
+  void *mapping = mmap(nullptr, sizeof(VictusTelemetryPage),
+                       PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (mapping == MAP_FAILED) {
+    LOG_ERROR << "telemetry page: mmap failed: " << strerror(errno);
+    return false;
+  }
+  page = static_cast<VictusTelemetryPage *>(mapping);
+  page_memfd = fd;
+  return true;
+}
+
+bool create_page_locked() {
+  int fd = memfd_create("victus-telemetry", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (fd < 0) {
+    LOG_ERROR << "telemetry page: memfd_create failed: " << strerror(errno);
+    return false;
+  }
+
+  // memfds start out 0777, which would let a client reopen its read-only
+  // descriptor through /proc/<pid>/fd for writing. F_SEAL_FUTURE_WRITE is not
+  // used because a daemon adopting the page on upgrade has to map it
+  // writable again; that works through this descriptor, opened O_RDWR.
+  if (ftruncate(fd, sizeof(VictusTelemetryPage)) < 0 ||
+      fchmod(fd, S_IRUSR | S_IRGRP | S_IROTH) < 0 ||
+      fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) {
+    LOG_ERROR << "telemetry page: setup failed: " << strerror(errno);
+    close(fd);
+    return false;
+  }
+
+  if (!map_page_locked(fd)) {
+    close(fd);
+    return false;
+  }
+
+  page = new (page) VictusTelemetryPage();
+  page->magic = kVictusTelemetryMagic;
+  page->layout_version = kVictusTelemetryLayoutVersion;
+
+  current.fan_rpm[0] = current.fan_rpm[1] = kVictusTelemetryUnavailable;
+  current.fan_target_rpm[0] = current.fan_target_rpm[1] =
+      kVictusTelemetryUnavailable;
+  current.cpu_temp_millicelsius = kVictusTelemetryUnavailable;
+  current.gpu_temp_millicelsius = kVictusTelemetryUnavailable;
+  current.cpu_usage_permille = kVictusTelemetryUnavailable;
+  current.gpu_usage_permille = kVictusTelemetryUnavailable;
+  current.fan_mode = kVictusTelemetryUnavailable;
+  current.better_auto_level = 0;
+  write_page_locked();
+  return true;
+}
+
+} // namespace
+
+int telemetry_page_fd() {
+  bool created = false;
+  int fd = -1;
+  {
+    std::lock_guard<std::mutex> lock(page_mutex);
+    if (!page) {
+      if (!create_page_locked())
+        return -1;
+      created = true;
+    }
+    fd = page_memfd;
+  }
+
+  // Clients get their own read-only open of the memfd. The page is mode 0444,
+  // so reopening it for writing is refused too, except to root.
+  std::string proc_path = "/proc/self/fd/" + std::to_string(fd);
+  int read_only = open(proc_path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (read_only < 0) {
+    LOG_ERROR << "telemetry page: failed to reopen read-only: "
+              << strerror(errno);
+  }
+
+  if (created)
+    telemetry_add_local_subscriber(kPageRefreshSeconds, publish_sample);
+  return read_only;
+}
+
+void telemetry_page_publish_thermal(std::optional<double> cpu_temp_c,
+                                    std::optional<double> gpu_temp_c,
+                                    std::optional<double> cpu_usage_pct,
+                                    std::optional<double> gpu_usage_pct) {
+  std::lock_guard<std::mutex> lock(page_mutex);
+  if (!page)
+    return;
+
+  current.cpu_temp_millicelsius = to_fixed(cpu_temp_c, 1000.0);
+  current.gpu_temp_millicelsius = to_fixed(gpu_temp_c, 1000.0);
+  current.cpu_usage_permille = to_fixed(cpu_usage_pct, 10.0);
+  current.gpu_usage_permille = to_fixed(gpu_usage_pct, 10.0);
+  write_page_locked();
+}
+
+void telemetry_page_publish_fan_target(size_t fan_index, int rpm) {
+  std::lock_guard<std::mutex> lock(page_mutex);
+  if (!page || fan_index > 1)
+    return;
+
+  current.fan_target_rpm[fan_index] = rpm;
+  write_page_locked();
+}
+
+int telemetry_page_hand_off() {
+  std::lock_guard<std::mutex> lock(page_mutex);
+  page_handed_off = page != nullptr;
+  return page_memfd;
+}
+
+void telemetry_page_resume() {
+  std::lock_guard<std::mutex> lock(page_mutex);
+  page_handed_off = false;
+  if (page)
+    write_page_locked();
+}
+
+bool telemetry_page_adopt(int fd) {
+  {
+    std::lock_guard<std::mutex> lock(page_mutex);
+    struct stat info;
+    if (page || fstat(fd, &info) < 0 ||
+        static_cast<size_t>(info.st_size) < sizeof(VictusTelemetryPage) ||
+        !map_page_locked(fd)) {
+      close(fd);
+      return false;
+    }
+    if (page->magic != kVictusTelemetryMagic ||
+        page->layout_version != kVictusTelemetryLayoutVersion ||
+        !victus_telemetry_read(page, &current)) {
+      munmap(page, sizeof(VictusTelemetryPage));
+      page = nullptr;
+      page_memfd = -1;
+      close(fd);
+      return false;
+    }
+  }
+
+  telemetry_add_local_subscriber(kPageRefreshSeconds, publish_sample);
+  return true;
+}
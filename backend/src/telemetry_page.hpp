@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+
+// Backend side of the shared-memory telemetry page described in
+// victus_telemetry_page.hpp. The page is created on the first request and
+// then kept current by the telemetry thread and the Better Auto loop.
+
+// Returns a new read-only descriptor for the page (the caller owns it), or -1.
+int telemetry_page_fd();
+
+// Publishes values the Better Auto loop sampled anyway. No-op until a client
+// asked for the page.
+void telemetry_page_publish_thermal(std::optional<double> cpu_temp_c,
+                                    std::optional<double> gpu_temp_c,
+                                    std::optional<double> cpu_usage_pct,
+                                    std::optional<double> gpu_usage_pct);
+void telemetry_page_publish_fan_target(size_t fan_index, int rpm);
+
+// Upgrade handoff. Hand off stops writing to the page and returns its
+// writable memfd (still owned by this module), or -1 while there is no page;
+// resume undoes it when the handoff fails. The new daemon adopts the page so
+// clients' mappings keep updating; adopt takes ownership of `fd`.
+int telemetry_page_hand_off();
+void telemetry_page_resume();
+bool telemetry_page_adopt(int fd);
@@ -0,0 +1,195 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+#ifdef VICTUS_TRACING
+
+// Each slot is a seqlock: the writer makes `sequence` odd, fills the fields
+// and makes it even again; the dump skips slots that changed under it, or
+// that hold a span from an older lap of the ring (a writer that stalled
+// while a newer one reused its slot). All fields are atomics so a torn read
+// is only ever discarded, never undefined.
+struct TraceSlot {
+  std::atomic<uint64_t> sequence{0};
+  std::atomic<const char *> category{nullptr};
+  std::atomic<const char *> name{nullptr};
+  std::atomic<uint32_t> name_length{0};
+  std::atomic<uint32_t> thread_id{0};
+  std::atomic<int64_t> start_ns{0};
+  std::atomic<int64_t> duration_ns{0};
+  std::atomic<uint32_t> detail_length{0};
+  std::array<std::atomic<uint64_t>, kTraceDetailMax / 8> detail{};
+};
+
+static_assert((kTraceCapacity & (kTraceCapacity - 1)) == 0,
+              "kTraceCapacity must be a power of two");
+static_assert(kTraceDetailMax % 8 == 0);
+
+std::array<TraceSlot, kTraceCapacity> ring;
+std::atomic<uint64_t> next_slot{0};
+
+struct Span {
+  const char *category;
+  std::string_view name;
+  uint32_t thread_id;
+  int64_t start_ns;
+  int64_t duration_ns;
+  std::string detail;
+};
+
+const bool enabled_at_startup = [] {
+  const char *value = getenv("VICTUS_TRACE");
+  if (value && std::strcmp(value, "1") == 0)
+    trace_active.store(true, std::memory_order_relaxed);
+  return true;
+}();
+
+uint32_t current_thread_id() {
+  thread_local const uint32_t id = static_cast<uint32_t>(syscall(SYS_gettid));
+  return id;
+}
+
+int64_t to_ns(TraceClock::time_point time) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             time.time_since_epoch())
+      .count();
+}
+
+bool read_slot(const TraceSlot &slot, uint64_t index, Span *span) {
+  uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+  if (sequence != 2 * index + 2)
+    return false;
+
+  span->category = slot.category.load(std::memory_order_relaxed);
+  span->name = std::string_view(slot.name.load(std::memory_order_relaxed),
+                                slot.name_length.load(std::memory_order_relaxed));
+  span->thread_id = slot.thread_id.load(std::memory_order_relaxed);
+  span->start_ns = slot.start_ns.load(std::memory_order_relaxed);
+  span->duration_ns = slot.duration_ns.load(std::memory_order_relaxed);
+  std::array<uint64_t, kTraceDetailMax / 8> words;
+  for (size_t i = 0; i < words.size(); ++i)
+    words[i] = slot.detail[i].load(std::memory_order_relaxed);
+  size_t length = std::min<size_t>(
+      slot.detail_length.load(std::memory_order_relaxed), kTraceDetailMax);
+
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (slot.sequence.load(std::memory_order_relaxed) != sequence)
+    return false;
+  span->detail.assign(reinterpret_cast<const char *>(words.data()), length);
+  return true;
+}
+
+void append_escaped(std::string *out, std::string_view text) {
+  for (char ch : text) {
+    if (ch == '"' || ch == '\\') {
+      *out += '\\';
+      *out += ch;
+    } else if (static_cast<unsigned char>(ch) < 0x20) {
+      char escaped[8];
+      std::snprintf(escaped, sizeof(escaped), "\\u%04x", ch);
+      *out += escaped;
+    } else {
+      *out += ch;
+    }
+  }
+}
+
+#endif
+
+} // namespace
+
+bool trace_compiled_in() {
+#ifdef VICTUS_TRACING
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool trace_set_enabled(bool enabled) {
+  if (!trace_compiled_in())
+    return false;
+  trace_active.store(enabled, std::memory_order_relaxed);
+  return true;
+}
+
+#ifdef VICTUS_TRACING
+
+void trace_record(const char *category, std::string_view name,
+                  TraceClock::time_point start, TraceClock::time_point end,
+                  std::string_view detail) {
+  uint64_t index = next_slot.fetch_add(1, std::memory_order_relaxed);
+  TraceSlot &slot = ring[index & (kTraceCapacity - 1)];
+
+  slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.category.store(category, std::memory_order_relaxed);
+  slot.name.store(name.data(), std::memory_order_relaxed);
+  slot.name_length.store(static_cast<uint32_t>(name.size()),
+                         std::memory_order_relaxed);
+  slot.thread_id.store(current_thread_id(), std::memory_order_relaxed);
+  slot.start_ns.store(to_ns(start), std::memory_order_relaxed);
+  slot.duration_ns.store(to_ns(end) - to_ns(start), std::memory_order_relaxed);
+
+  std::array<uint64_t, kTraceDetailMax / 8> words = {};
+  size_t length = std::min(detail.size(), kTraceDetailMax);
+  std::memcpy(words.data(), detail.data(), length);
+  for (size_t i = 0; i < words.size(); ++i)
+    slot.detail[i].store(words[i], std::memory_order_relaxed);
+  slot.detail_length.store(static_cast<uint32_t>(length),
+                           std::memory_order_relaxed);
+  slot.sequence.store(2 * index + 2, std::memory_order_release);
+}
+
+std::string trace_dump_json() {
+  uint64_t end = next_slot.load(std::memory_order_acquire);
+  uint64_t begin = end > kTraceCapacity ? end - kTraceCapacity : 0;
+  int pid = static_cast<int>(getpid());
+
+  std::string out = "{\"traceEvents\":[";
+  bool first = true;
+  Span span;
+  for (uint64_t index = begin; index < end; ++index) {
+    if (!read_slot(ring[index & (kTraceCapacity - 1)], index, &span))
+      continue;
+
+    char numbers[128];
+    std::snprintf(numbers, sizeof(numbers),
+                  "\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%u",
+                  span.start_ns / 1000.0, span.duration_ns / 1000.0, pid,
+                  span.thread_id);
+    out += first ? "\n" : ",\n";
+    first = false;
+    out += "{\"name\":\"";
+    append_escaped(&out, span.name);
+    out += "\",\"cat\":\"";
+    append_escaped(&out, span.category);
+    out += "\",";
+    out += numbers;
+    if (!span.detail.empty()) {
+      out += ",\"args\":{\"detail\":\"";
+      append_escaped(&out, span.detail);
+      out += "\"}";
+    }
+    out += "}";
+  }
+  out += "\n],\"displayTimeUnit\":\"ms\"}\n";
+  return out;
+}
+
+#else
+
+void trace_record(const char *, std::string_view, TraceClock::time_point,
+                  TraceClock::time_point, std::string_view) {}
+
+std::string trace_dump_json() { return "{\"traceEvents\":[]}\n"; }
+
+#endif
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <string_view>
+
+// Span tracing for looking at one slow request end to end, dumped as Chrome
+// trace JSON (chrome://tracing, ui.perfetto.dev) by "TRACE dump".
+//
+//   TRACE_SPAN("sysfs", "read", path);
+//
+// records the enclosing scope as a span with an optional detail string. Spans
+// land in a fixed ring of kTraceCapacity entries; the oldest are overwritten.
+//
+// Built only with -Dtracing=true (VICTUS_TRACING); otherwise TRACE_SPAN
+// expands to nothing and its arguments are never evaluated. When built in,
+// tracing starts off ("TRACE on", or VICTUS_TRACE=1 at startup) and a span is
+// one relaxed load until it is turned on. Recording takes no lock.
+
+using TraceClock = std::chrono::steady_clock;
+
+constexpr size_t kTraceCapacity = 8192;
+// Longer details are cut.
+constexpr size_t kTraceDetailMax = 48;
+
+// False when built without VICTUS_TRACING.
+bool trace_compiled_in();
+
+inline std::atomic<bool> trace_active{false};
+
+inline bool trace_enabled() {
+  return trace_active.load(std::memory_order_relaxed);
+}
+
+// Returns false when tracing is not compiled in.
+bool trace_set_enabled(bool enabled);
+
+// `category` and `name` must outlive the ring: string literals, or names
+// from kVictusCommands.
+void trace_record(const char *category, std::string_view name,
+                  TraceClock::time_point start, TraceClock::time_point end,
+                  std::string_view detail = {});
+
+// {"traceEvents":[...]} with every span still in the ring, oldest first.
+std::string trace_dump_json();
+
+class TraceSpan {
+public:
+  TraceSpan(const char *category, const char *name,
+            std::string_view detail = {})
+      : category(category), name(name), detail(detail) {
+    if (trace_enabled())
+      start = TraceClock::now();
+  }
+  ~TraceSpan() {
+    if (start != TraceClock::time_point{})
+      trace_record(category, name, start, TraceClock::now(), detail);
+  }
+  TraceSpan(const TraceSpan &) = delete;
+  TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+  const char *category;
+  const char *name;
+  // Callers pass paths that outlive the scope.
+  std::string_view detail;
+  TraceClock::time_point start{};
+};
+
+#define VICTUS_TRACE_CONCAT_(a, b) a##b
+#define VICTUS_TRACE_CONCAT(a, b) VICTUS_TRACE_CONCAT_(a, b)
+
+// TRACE_COMPLETE records a span whose start and end were already measured.
+#ifdef VICTUS_TRACING
+#define TRACE_SPAN(...)                                                        \
+  TraceSpan VICTUS_TRACE_CONCAT(victus_trace_span_, __LINE__)(__VA_ARGS__)
+#define TRACE_COMPLETE(...)                                                    \
+  (trace_enabled() ? trace_record(__VA_ARGS__) : static_cast<void>(0))
+#else
+#define TRACE_SPAN(...) static_cast<void>(0)
+#define TRACE_COMPLETE(...) static_cast<void>(0)
+#endif
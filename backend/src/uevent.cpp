@@ -0,0 +1,177 @@
+#include "uevent.hpp"
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <linux/netlink.h>
+#include <poll.h>
+#include <string>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+#include "log.hpp"
+#include "util.hpp"
+
+namespace {
+
+// Kernel events only; udev's rebroadcasts go to group 2.
+constexpr unsigned kKernelEventGroup = 1;
+constexpr int kReceiveBufferBytes = 256 * 1024;
+
+int netlink_fd = -1;
+int stop_fd = -1;
+std::thread listener;
+
+bool is_watched(std::string_view subsystem, std::string_view devpath) {
+  return subsystem == "hwmon" || subsystem == "thermal" || subsystem == "drm" ||
+         devpath.find("hp-wmi") != std::string_view::npos ||
+         devpath.find("hp_wmi") != std::string_view::npos;
+}
+
+// Any local process with CAP_NET_ADMIN can multicast to the uevent groups;
+// only the kernel sends from port 0 with root credentials.
+bool from_kernel(const msghdr &msg) {
+  const auto *sender = static_cast<const sockaddr_nl *>(msg.msg_name);
+  if (msg.msg_namelen != sizeof(sockaddr_nl) || sender->nl_pid != 0 ||
+      (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)))
+    return false;
+
+  const cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  if (!cmsg || cmsg->cmsg_level != SOL_SOCKET ||
+      cmsg->cmsg_type != SCM_CREDENTIALS)
+    return false;
+  ucred credentials;
+  std::memcpy(&credentials, CMSG_DATA(cmsg), sizeof(credentials));
+  return credentials.uid == 0;
+}
+
+void listen_loop() {
+  // Fits any single uevent; the kernel caps them at 2 KiB of environment.
+  std::array<char, 8192> buffer;
+  pollfd fds[2] = {{netlink_fd, POLLIN, 0}, {stop_fd, POLLIN, 0}};
+  for (;;) {
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    if (fds[1].revents & POLLIN)
+      break;
+
+    sockaddr_nl sender = {};
+    iovec iov = {buffer.data(), buffer.size()};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(ucred))];
+    msghdr msg = {};
+    msg.msg_name = &sender;
+    msg.msg_namelen = sizeof(sender);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t length = recvmsg(netlink_fd, &msg, 0);
+    if (length < 0) {
+      // The socket overflowed and events were lost; one of them may have
+      // been ours.
+      if (errno == ENOBUFS)
+        invalidate_device_paths();
+      continue;
+    }
+    if (!from_kernel(msg))
+      continue;
+
+    std::string_view message(buffer.data(), static_cast<size_t>(length));
+    if (uevent_invalidates_paths(message)) {
+      LOG_INFO << "uevent: " << message.substr(0, message.find('\0'))
+               << "; rediscovering device paths";
+      invalidate_device_paths();
+    }
+  }
+}
+
+} // namespace
+
+bool uevent_invalidates_paths(std::string_view message) {
+  std::string_view action;
+  std::string_view devpath;
+  std::string_view subsystem;
+
+  // The "ACTION@DEVPATH" header comes first, then KEY=VALUE fields.
+  size_t at = message.find('\0');
+  while (at != std::string_view::npos && at + 1 < message.size()) {
+    size_t end = message.find('\0', at + 1);
+    std::string_view field = message.substr(
+        at + 1, end == std::string_view::npos ? std::string_view::npos
+                                              : end - at - 1);
+    if (field.rfind("ACTION=", 0) == 0)
+      action = field.substr(7);
+    else if (field.rfind("DEVPATH=", 0) == 0)
+      devpath = field.substr(8);
+    else if (field.rfind("SUBSYSTEM=", 0) == 0)
+      subsystem = field.substr(10);
+    at = end;
+  }
+
+  // "change" and the bind/unbind pair leave device paths where they were.
+  if (action != "add" && action != "remove" && action != "move")
+    return false;
+  return is_watched(subsystem, devpath);
+}
+
+bool uevent_start() {
+  if (!sysfs_root().empty())
+    return false;
+
+  netlink_fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC,
+                      NETLINK_KOBJECT_UEVENT);
+  if (netlink_fd == -1) {
+    LOG_WARNING << "uevent: cannot open netlink socket: " << strerror(errno);
+    return false;
+  }
+
+  // Module reloads arrive as a burst; a larger buffer keeps it intact.
+  setsockopt(netlink_fd, SOL_SOCKET, SO_RCVBUF, &kReceiveBufferBytes,
+             sizeof(kReceiveBufferBytes));
+  int pass_credentials = 1;
+  setsockopt(netlink_fd, SOL_SOCKET, SO_PASSCRED, &pass_credentials,
+             sizeof(pass_credentials));
+
+  sockaddr_nl addr = {};
+  addr.nl_family = AF_NETLINK;
+  addr.nl_groups = kKernelEventGroup;
+  stop_fd = eventfd(0, EFD_CLOEXEC);
+  if (stop_fd == -1 ||
+      bind(netlink_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) ==
+          -1) {
+    LOG_WARNING << "uevent: cannot listen for device events: "
+                << strerror(errno);
+    close(netlink_fd);
+    netlink_fd = -1;
+    if (stop_fd != -1)
+      close(stop_fd);
+    stop_fd = -1;
+    return false;
+  }
+
+  // Anything resolved before the socket was bound may already be stale.
+  invalidate_device_paths();
+  set_device_path_caching(true);
+  listener = std::thread(listen_loop);
+  return true;
+}
+
+void uevent_shutdown() {
+  if (!listener.joinable())
+    return;
+
+  set_device_path_caching(false);
+  uint64_t one = 1;
+  ssize_t ignored = write(stop_fd, &one, sizeof(one));
+  (void)ignored;
+  listener.join();
+  close(netlink_fd);
+  close(stop_fd);
+  netlink_fd = stop_fd = -1;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string_view>
+
+// Kernel uevents (NETLINK_KOBJECT_UEVENT) for the devices whose sysfs paths
+// the daemon resolves: the hp-wmi platform device and module, and hwmon,
+// thermal and DRM devices. An add, remove or move of one of them (for
+// example victus-healthcheck.sh reloading hp_wmi, which renumbers its hwmon
+// directory) calls invalidate_device_paths(), so the next lookup rescans.
+// Resolved paths are only cached while the listener runs.
+//
+// Not started under VICTUS_SYSFS_ROOT: the kernel sends no events for a
+// simulated tree, so lookups there keep scanning every time.
+
+// Returns false if the netlink socket cannot be opened; lookups then scan
+// every time, as before.
+bool uevent_start();
+void uevent_shutdown();
+
+// One datagram: "ACTION@DEVPATH\0ACTION=...\0DEVPATH=...\0SUBSYSTEM=...\0".
+bool uevent_invalidates_paths(std::string_view message);
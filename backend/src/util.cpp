@@ -1,14 +1,93 @@
 #include "util.hpp"
+#include "trace.hpp"
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
 #include <dirent.h>
+#include <fcntl.h>
+#include <linux/magic.h>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <unistd.h>
+#include <unordered_map>
 
-std::string find_hwmon_directory(const std::string &base_path)
+namespace
+{
+
+struct LookupCache
+{
+	std::unordered_map<std::string, std::string> hwmon_directories;
+	std::unordered_map<std::string, bool> existing_paths;
+};
+
+thread_local LookupCache *active_cache = nullptr;
+
+// Far more than the attributes polled; reaching it means an old hwmon
+// instance left its paths behind.
+constexpr size_t kMaxCachedAttributes = 64;
+
+// Closed when the last reader lets go, so an invalidated descriptor number
+// is never reused under a pread() still running on another thread.
+struct AttributeFd
+{
+	explicit AttributeFd(int fd) : fd(fd) {}
+	~AttributeFd()
+	{
+		int saved_errno = errno;
+		close(fd);
+		errno = saved_errno;
+	}
+
+	AttributeFd(const AttributeFd &) = delete;
+	AttributeFd &operator=(const AttributeFd &) = delete;
+
+	int fd;
+};
+
+std::mutex attribute_mutex;
+std::unordered_map<std::string, std::shared_ptr<AttributeFd>> attribute_fds;
+
+std::atomic<uint64_t> current_generation{1};
+std::atomic<bool> caching_device_paths{false};
+
+struct ResolvedPath
+{
+	uint64_t generation;
+	std::string path;
+};
+
+std::mutex resolved_mutex;
+std::unordered_map<std::string, ResolvedPath> resolved_hwmon_directories;
+
+struct RecordedError
+{
+	ErrorKind kind = ErrorKind::Failed;
+	std::string message;
+};
+
+thread_local RecordedError last_error;
+
+constexpr const char *kSudoPath = "/usr/bin/sudo";
+constexpr const char *kInstalledHelperDir = "/usr/bin";
+
+std::string environment_or(const char *name, const char *fallback)
+{
+	const char *value = getenv(name);
+	return value && *value ? value : fallback;
+}
+
+std::string scan_hwmon_directory(const std::string &base_path)
 {
 	DIR *dir;
 	struct dirent *ent;
 	std::string hwmon_path;
 	int max_hwmon = -1;
 
+	TRACE_SPAN("sysfs", "scan", base_path);
 	if ((dir = opendir(base_path.c_str())) != nullptr)
 	{
 		while ((ent = readdir(dir)) != nullptr)
@@ -35,3 +114,263 @@ std::string find_hwmon_directory(const std::string &base_path)
 	}
 	return hwmon_path;
 }
+
+// sysfs and procfs build the value again on every read from offset 0.
+bool regenerates_on_reread(int fd)
+{
+	struct statfs fs;
+	if (fstatfs(fd, &fs) != 0)
+		return false;
+	return fs.f_type == SYSFS_MAGIC || fs.f_type == PROC_SUPER_MAGIC;
+}
+
+std::shared_ptr<AttributeFd> open_attribute(const std::string &path, bool *cached)
+{
+	{
+		std::lock_guard<std::mutex> lock(attribute_mutex);
+		auto it = attribute_fds.find(path);
+		if (it != attribute_fds.end())
+		{
+			*cached = true;
+			return it->second;
+		}
+	}
+
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+		return nullptr;
+
+	auto attribute = std::make_shared<AttributeFd>(fd);
+	*cached = regenerates_on_reread(fd);
+	if (*cached)
+	{
+		std::lock_guard<std::mutex> lock(attribute_mutex);
+		if (attribute_fds.size() >= kMaxCachedAttributes)
+			attribute_fds.clear();
+		// A thread that raced us here keeps using its own descriptor once.
+		attribute_fds.emplace(path, attribute);
+	}
+	return attribute;
+}
+
+void forget_attribute(const std::string &path, const std::shared_ptr<AttributeFd> &stale)
+{
+	std::lock_guard<std::mutex> lock(attribute_mutex);
+	auto it = attribute_fds.find(path);
+	if (it != attribute_fds.end() && it->second == stale)
+		attribute_fds.erase(it);
+}
+
+} // namespace
+
+// Nested scopes share the outermost cache.
+LookupCacheScope::LookupCacheScope() : owns_cache(active_cache == nullptr)
+{
+	if (owns_cache)
+		active_cache = new LookupCache();
+}
+
+LookupCacheScope::~LookupCacheScope()
+{
+	if (owns_cache)
+	{
+		delete active_cache;
+		active_cache = nullptr;
+	}
+}
+
+std::string find_hwmon_directory(const std::string &base_path)
+{
+	if (active_cache)
+	{
+		auto it = active_cache->hwmon_directories.find(base_path);
+		if (it != active_cache->hwmon_directories.end())
+			return it->second;
+	}
+
+	std::string hwmon_path;
+	if (caching_device_paths.load(std::memory_order_relaxed))
+	{
+		// Read before the scan: an invalidation racing it leaves the entry
+		// stale rather than wrongly current.
+		uint64_t generation = current_generation.load();
+		bool resolved = false;
+		{
+			std::lock_guard<std::mutex> lock(resolved_mutex);
+			auto it = resolved_hwmon_directories.find(base_path);
+			if (it != resolved_hwmon_directories.end() && it->second.generation == generation)
+			{
+				hwmon_path = it->second.path;
+				resolved = true;
+			}
+		}
+		if (!resolved)
+		{
+			hwmon_path = scan_hwmon_directory(base_path);
+			std::lock_guard<std::mutex> lock(resolved_mutex);
+			resolved_hwmon_directories[base_path] = {generation, hwmon_path};
+		}
+	}
+	else
+	{
+		hwmon_path = scan_hwmon_directory(base_path);
+	}
+
+	if (active_cache)
+		active_cache->hwmon_directories.emplace(base_path, hwmon_path);
+	return hwmon_path;
+}
+
+uint64_t device_generation()
+{
+	return current_generation.load();
+}
+
+void invalidate_device_paths()
+{
+	current_generation.fetch_add(1);
+	{
+		std::lock_guard<std::mutex> lock(resolved_mutex);
+		resolved_hwmon_directories.clear();
+	}
+	std::lock_guard<std::mutex> lock(attribute_mutex);
+	attribute_fds.clear();
+}
+
+void set_device_path_caching(bool enabled)
+{
+	caching_device_paths.store(enabled);
+}
+
+bool path_exists(const std::string &path)
+{
+	if (active_cache)
+	{
+		auto it = active_cache->existing_paths.find(path);
+		if (it != active_cache->existing_paths.end())
+			return it->second;
+	}
+
+	struct stat buffer;
+	bool exists = stat(path.c_str(), &buffer) == 0;
+	if (active_cache)
+		active_cache->existing_paths.emplace(path, exists);
+	return exists;
+}
+
+ssize_t read_attribute(const std::string &path, char *buffer, size_t size)
+{
+	if (size == 0)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	TRACE_SPAN("sysfs", "read", path);
+	// A second attempt only after dropping a descriptor whose device went away.
+	for (int attempt = 0; attempt < 2; ++attempt)
+	{
+		bool cached = false;
+		auto attribute = open_attribute(path, &cached);
+		if (!attribute)
+			return -1;
+
+		ssize_t length;
+		do
+		{
+			length = pread(attribute->fd, buffer, size - 1, 0);
+		} while (length < 0 && errno == EINTR);
+
+		if (length >= 0)
+		{
+			buffer[length] = '\0';
+			return length;
+		}
+		if (!cached || (errno != ENODEV && errno != ESTALE))
+			return -1;
+		forget_attribute(path, attribute);
+	}
+	return -1;
+}
+
+std::optional<long long> read_attribute_integer(const std::string &path)
+{
+	char buffer[32];
+	if (read_attribute(path, buffer, sizeof(buffer)) <= 0)
+		return std::nullopt;
+	return parse_attribute_integer(buffer);
+}
+
+std::optional<long long> parse_attribute_integer(const char *text)
+{
+	const char *at = text;
+	while (*at == ' ' || *at == '\t' || *at == '\n')
+		++at;
+	bool negative = *at == '-';
+	if (negative || *at == '+')
+		++at;
+	if (*at < '0' || *at > '9')
+		return std::nullopt;
+
+	long long value = 0;
+	for (; *at >= '0' && *at <= '9'; ++at)
+	{
+		if (value > (LLONG_MAX - 9) / 10)
+			return std::nullopt;
+		value = value * 10 + (*at - '0');
+	}
+	return negative ? -value : value;
+}
+
+size_t cached_attribute_count()
+{
+	std::lock_guard<std::mutex> lock(attribute_mutex);
+	return attribute_fds.size();
+}
+
+const std::string &sysfs_root()
+{
+	static const std::string root = [] {
+		std::string value = environment_or("VICTUS_SYSFS_ROOT", "");
+		while (!value.empty() && value.back() == '/')
+			value.pop_back();
+		return value;
+	}();
+	return root;
+}
+
+std::string sysfs_path(const std::string &path)
+{
+	return sysfs_root() + path;
+}
+
+std::vector<std::string> helper_command(const std::string &helper,
+                                        const std::vector<std::string> &args)
+{
+	std::vector<std::string> command;
+	if (sysfs_root().empty())
+	{
+		command.push_back(kSudoPath);
+		command.push_back(std::string(kInstalledHelperDir) + "/" + helper);
+	}
+	else
+	{
+		static const std::string helper_dir =
+			environment_or("VICTUS_HELPER_DIR", kInstalledHelperDir);
+		command.push_back(helper_dir + "/" + helper);
+	}
+	command.insert(command.end(), args.begin(), args.end());
+	return command;
+}
+
+std::string error_reply(ErrorKind kind, std::string message)
+{
+	last_error.kind = kind;
+	last_error.message = message;
+	return message;
+}
+
+ErrorKind error_kind(std::string_view reply)
+{
+	return reply == last_error.message ? last_error.kind : ErrorKind::Failed;
+}
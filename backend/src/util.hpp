@@ -1,3 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <vector>
+
+std::string find_hwmon_directory(const std::string &base_path);
+bool path_exists(const std::string &path);
+
+// Device paths found by scanning sysfs (find_hwmon_directory() and the
+// sensor lookups in fan.cpp) belong to one device generation. While caching
+// is on, which the uevent listener (uevent.hpp) turns on while it runs,
+// find_hwmon_directory() keeps its answers across calls until
+// invalidate_device_paths() starts a new generation. That also drops the
+// descriptors read_attribute() holds.
+uint64_t device_generation();
+void invalidate_device_paths();
+void set_device_path_caching(bool enabled);
+
+// Every /sys and /proc path goes through sysfs_path(), which prefixes it with
+// $VICTUS_SYSFS_ROOT (read once; unset on real hardware) so the daemon can run
+// against a simulated device tree.
+const std::string &sysfs_root();
+std::string sysfs_path(const std::string &path);
+
+// Reads of the attributes polled every control tick (fan*_input,
+// pwm1_enable, temp*_input, gpu_busy_percent, /proc/stat). On sysfs and
+// procfs the descriptor is opened once and reread with pread() at offset 0,
+// which regenerates the value. It is reopened if the read fails with ENODEV
+// or ESTALE, e.g. after hp_wmi is reloaded. Files on other filesystems (the
+// simulator's tree, test fixtures) are replaced by rename, so they are
+// opened for every read.
+//
+// read_attribute() fills `buffer` with at most size - 1 bytes plus a NUL and
+// returns the length, or -1 with errno set.
+ssize_t read_attribute(const std::string &path, char *buffer, size_t size);
+// The leading decimal integer of the attribute, e.g. 2450 for "2450\n".
+std::optional<long long> read_attribute_integer(const std::string &path);
+std::optional<long long> parse_attribute_integer(const char *text);
+// Descriptors currently held open.
+size_t cached_attribute_count();
+
+// argv for one of the set-*.sh helpers. On real hardware it runs from
+// /usr/bin through sudo. Under a sysfs root it runs directly, from
+// $VICTUS_HELPER_DIR if set, because sudo would drop the root from the
+// environment and the simulated tree needs no privileges.
+std::vector<std::string> helper_command(const std::string &helper,
+                                        const std::vector<std::string> &args);
+
+// While an instance is alive, find_hwmon_directory() and path_exists() on the
+// same thread remember their answers instead of rescanning sysfs. Batched
+// commands use this so every item sees the same device layout.
+class LookupCacheScope
+{
+public:
+	LookupCacheScope();
+	~LookupCacheScope();
+
+	LookupCacheScope(const LookupCacheScope &) = delete;
+	LookupCacheScope &operator=(const LookupCacheScope &) = delete;
+
+private:
+	bool owns_cache;
+};
+
+// Why a handler failed, for replies that carry a numeric status (the binary
+// protocol, protocol_v2.hpp). Handlers build their "ERROR: ..." text with
+// error_reply(), which remembers the kind for the calling thread; the caller
+// gets it back with error_kind() on the text it was handed. Text that was not
+// the thread's latest error_reply() counts as Failed.
+enum class ErrorKind : uint8_t { InvalidArgument, DeviceUnavailable, Failed };
 
-std::string find_hwmon_directory(const std::string &base_path);
\ No newline at end of file
+std::string error_reply(ErrorKind kind, std::string message);
+ErrorKind error_kind(std::string_view reply);
@@ -1,20 +1,27 @@
 #include "validation.hpp"
 
 #include <cctype>
-#include <sstream>
+#include <charconv>
 
-std::string normalize_mode(std::string mode) {
-  for (char &ch : mode) {
+namespace {
+
+constexpr std::string_view kWhitespace = " \t\r\n\v\f";
+
+} // namespace
+
+std::string normalize_mode(std::string_view mode) {
+  std::string normalized(mode);
+  for (char &ch : normalized) {
     if (ch == '-' || ch == ' ') {
       ch = '_';
     } else {
       ch = static_cast<char>(std::toupper(static_cast<unsigned char>(ch)));
     }
   }
-  return mode;
+  return normalized;
 }
 
-std::optional<size_t> fan_index_from_string(const std::string &fan_num) {
+std::optional<size_t> fan_index_from_string(std::string_view fan_num) {
   if (fan_num == "1")
     return 0;
   if (fan_num == "2")
@@ -22,24 +29,28 @@ std::optional<size_t> fan_index_from_string(const std::string &fan_num) {
   return std::nullopt;
 }
 
-bool parse_strict_int(const std::string &value, int *parsed) {
+bool parse_strict_int(std::string_view value, int *parsed) {
   if (!parsed || value.empty())
     return false;
 
-  size_t position = 0;
-  try {
-    int parsed_value = std::stoi(value, &position);
-    if (position != value.size())
+  // std::stoi, which this replaced, accepted an explicit plus sign.
+  if (value[0] == '+') {
+    value.remove_prefix(1);
+    if (value.empty() || value[0] == '-')
       return false;
+  }
 
-    *parsed = parsed_value;
-    return true;
-  } catch (...) {
+  int parsed_value = 0;
+  const char *end = value.data() + value.size();
+  auto [ptr, ec] = std::from_chars(value.data(), end, parsed_value);
+  if (ec != std::errc() || ptr != end)
     return false;
-  }
+
+  *parsed = parsed_value;
+  return true;
 }
 
-bool parse_bounded_int(const std::string &value, int min_value, int max_value,
+bool parse_bounded_int(std::string_view value, int min_value, int max_value,
                        int *parsed) {
   int parsed_value = 0;
   if (!parse_strict_int(value, &parsed_value))
@@ -53,24 +64,87 @@ bool parse_bounded_int(const std::string &value, int min_value, int max_value,
   return true;
 }
 
-bool parse_rgb_triplet(const std::string &color, std::array<int, 3> *rgb) {
+bool parse_rgb_triplet(std::string_view color, std::array<int, 3> *rgb) {
   if (!rgb)
     return false;
 
-  std::stringstream ss(color);
-  int red = 0;
-  int green = 0;
-  int blue = 0;
-  char extra = '\0';
+  std::array<int, 3> parsed = {};
+  for (int &channel : parsed) {
+    if (!parse_bounded_int(next_token(&color), 0, 255, &channel))
+      return false;
+  }
+  if (!trim_whitespace(color).empty())
+    return false;
 
-  if (!(ss >> red >> green >> blue))
+  *rgb = parsed;
+  return true;
+}
+
+bool parse_hex_color(std::string_view hex, std::array<int, 3> *rgb) {
+  if (!rgb || hex.size() != 6)
     return false;
-  if (ss >> extra)
+
+  std::array<int, 3> parsed = {};
+  for (size_t i = 0; i < parsed.size(); ++i) {
+    const char *begin = hex.data() + i * 2;
+    // from_chars would accept a leading '-'.
+    if (!std::isxdigit(static_cast<unsigned char>(begin[0])))
+      return false;
+    auto [ptr, ec] = std::from_chars(begin, begin + 2, parsed[i], 16);
+    if (ec != std::errc() || ptr != begin + 2)
+      return false;
+  }
+
+  *rgb = parsed;
+  return true;
+}
+
+std::string_view trim_whitespace(std::string_view text) {
+  size_t start = text.find_first_not_of(kWhitespace);
+  if (start == std::string_view::npos)
+    return {};
+
+  size_t end = text.find_last_not_of(kWhitespace);
+  return text.substr(start, end - start + 1);
+}
+
+std::string_view next_token(std::string_view *text) {
+  size_t start = text->find_first_not_of(kWhitespace);
+  if (start == std::string_view::npos) {
+    *text = {};
+    return {};
+  }
+
+  size_t end = text->find_first_of(kWhitespace, start);
+  if (end == std::string_view::npos)
+    end = text->size();
+
+  std::string_view token = text->substr(start, end - start);
+  text->remove_prefix(end);
+  return token;
+}
+
+bool split_request_tag(std::string_view frame, std::string_view *tag,
+                       std::string_view *command) {
+  constexpr size_t kMaxTagLength = 32;
+  if (frame.empty() || frame[0] != '#')
     return false;
-  if (red < 0 || red > 255 || green < 0 || green > 255 || blue < 0 ||
-      blue > 255)
+
+  size_t space = frame.find(' ');
+  if (space == std::string_view::npos || space == 1 ||
+      space - 1 > kMaxTagLength || space + 1 >= frame.size())
     return false;
 
-  *rgb = {red, green, blue};
+  std::string_view parsed_tag = frame.substr(1, space - 1);
+  for (char ch : parsed_tag) {
+    if (!std::isalnum(static_cast<unsigned char>(ch)) && ch != '_' &&
+        ch != '.' && ch != '-')
+      return false;
+  }
+
+  if (tag)
+    *tag = parsed_tag;
+  if (command)
+    *command = frame.substr(space + 1);
   return true;
 }
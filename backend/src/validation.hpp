@@ -4,12 +4,29 @@
 #include <cstddef>
 #include <optional>
 #include <string>
+#include <string_view>
 
-std::string normalize_mode(std::string mode);
-std::optional<size_t> fan_index_from_string(const std::string &fan_num);
+// Parsers for untrusted text from clients and sysfs. They work on views and
+// never throw or allocate; invalid input is reported by returning false.
 
-bool parse_strict_int(const std::string &value, int *parsed);
-bool parse_bounded_int(const std::string &value, int min_value, int max_value,
+std::string normalize_mode(std::string_view mode);
+std::optional<size_t> fan_index_from_string(std::string_view fan_num);
+
+bool parse_strict_int(std::string_view value, int *parsed);
+bool parse_bounded_int(std::string_view value, int min_value, int max_value,
                        int *parsed);
 
-bool parse_rgb_triplet(const std::string &color, std::array<int, 3> *rgb);
+bool parse_rgb_triplet(std::string_view color, std::array<int, 3> *rgb);
+// "RRGGBB" as used by the 4-zone sysfs files.
+bool parse_hex_color(std::string_view hex, std::array<int, 3> *rgb);
+
+// Whitespace tokenizing for the text protocol; the returned views point into
+// the input.
+std::string_view trim_whitespace(std::string_view text);
+// Pops the next whitespace-separated token off *text; empty at the end.
+std::string_view next_token(std::string_view *text);
+
+// Splits a pipelined "#<tag> <command>" frame. The tag is 1-32 characters of
+// [A-Za-z0-9_.-]; returns false for a malformed tag or a missing command.
+bool split_request_tag(std::string_view frame, std::string_view *tag,
+                       std::string_view *command);
@@ -0,0 +1,18 @@
+# Sourced by the set-*.sh helpers; not run on its own.
+
+# Set only when the backend drives a simulated tree without sudo (see
+# helper_command() in util.hpp); sudo strips it from the environment.
+HP_WMI_DIR="${VICTUS_SYSFS_ROOT:-}/sys/devices/platform/hp-wmi"
+HWMON_BASE="$HP_WMI_DIR/hwmon"
+
+# Prints the hp-wmi hwmon directory, or nothing. The backend passes the
+# "hwmonN" it already resolved as $1; only a name of that form is taken, so
+# the path cannot leave $HWMON_BASE. Without one, the first match is used.
+find_hwmon_path() {
+    local name="${1:-}"
+    if [[ "$name" =~ ^hwmon[0-9]+$ && -d "$HWMON_BASE/$name" ]]; then
+        echo "$HWMON_BASE/$name"
+    else
+        find "$HWMON_BASE" -mindepth 1 -maxdepth 1 -type d -name "hwmon*" 2>/dev/null | head -n 1 || true
+    fi
+}
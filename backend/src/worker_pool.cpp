@@ -0,0 +1,69 @@
+#include "worker_pool.hpp"
+
+#include <exception>
+
+#include "log.hpp"
+
+WorkerPool::WorkerPool(size_t worker_count, size_t queue_capacity)
+    : capacity(queue_capacity) {
+  workers.reserve(worker_count);
+  for (size_t i = 0; i < worker_count; ++i)
+    workers.emplace_back(&WorkerPool::worker_loop, this);
+}
+
+WorkerPool::~WorkerPool() { shutdown(); }
+
+bool WorkerPool::try_submit(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    if (stopping || tasks.size() >= capacity)
+      return false;
+    tasks.push_back(std::move(task));
+  }
+  queue_cv.notify_one();
+  return true;
+}
+
+size_t WorkerPool::queue_depth() const {
+  std::lock_guard<std::mutex> lock(queue_mutex);
+  return tasks.size();
+}
+
+void WorkerPool::shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    if (stopping && workers.empty())
+      return;
+    stopping = true;
+    tasks.clear();
+  }
+  queue_cv.notify_all();
+
+  for (auto &worker : workers) {
+    if (worker.joinable())
+      worker.join();
+  }
+  workers.clear();
+}
+
+void WorkerPool::worker_loop() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(queue_mutex);
+      queue_cv.wait(lock, [this] { return stopping || !tasks.empty(); });
+      if (stopping)
+        return;
+      task = std::move(tasks.front());
+      tasks.pop_front();
+    }
+
+    try {
+      task();
+    } catch (const std::exception &ex) {
+      LOG_ERROR << "worker: task failed: " << ex.what();
+    } catch (...) {
+      LOG_ERROR << "worker: task failed with unknown error";
+    }
+  }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads that run blocking hardware work (sysfs access, sudo
+// helpers) on behalf of the event loop. The queue is bounded so a burst of
+// clients cannot grow memory without limit; callers get a rejection instead.
+class WorkerPool {
+public:
+  WorkerPool(size_t worker_count, size_t queue_capacity);
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool &operator=(const WorkerPool &) = delete;
+
+  // Returns false when the queue is full or the pool is shutting down.
+  bool try_submit(std::function<void()> task);
+
+  size_t queue_depth() const;
+  size_t queue_capacity() const { return capacity; }
+
+  // Stops accepting work, drops queued tasks and joins the workers once their
+  // current task has finished.
+  void shutdown();
+
+private:
+  void worker_loop();
+
+  size_t capacity;
+  mutable std::mutex queue_mutex;
+  std::condition_variable queue_cv;
+  std::deque<std::function<void()>> tasks;
+  std::vector<std::thread> workers;
+  bool stopping = false;
+};
@@ -0,0 +1,86 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "util.hpp"
+
+namespace {
+
+bool expect(bool condition, const char *message) {
+  if (condition)
+    return true;
+
+  std::cerr << "FAILED: " << message << std::endl;
+  return false;
+}
+
+// Replaced whole, the way the simulator publishes sensor values.
+void publish(const std::string &path, const std::string &value) {
+  std::string temporary = path + ".tmp";
+  std::ofstream(temporary) << value;
+  std::rename(temporary.c_str(), path.c_str());
+}
+
+} // namespace
+
+int main() {
+  bool ok = true;
+  std::string path = "/tmp/victus-attribute-test-" + std::to_string(getpid());
+
+  publish(path, "2450\n");
+  ok &= expect(read_attribute_integer(path) == 2450,
+               "an integer attribute should be parsed");
+  publish(path, "2600\n");
+  ok &= expect(read_attribute_integer(path) == 2600 &&
+                   cached_attribute_count() == 0,
+               "files outside sysfs and procfs should be reopened per read");
+
+  publish(path, "-5000\n");
+  ok &= expect(read_attribute_integer(path) == -5000,
+               "negative values should be parsed");
+  publish(path, "N/A\n");
+  ok &= expect(!read_attribute_integer(path),
+               "a value that is not a number should be rejected");
+  ok &= expect(!parse_attribute_integer("99999999999999999999"),
+               "an out-of-range value should be rejected");
+  unlink(path.c_str());
+  char buffer[64];
+  ok &= expect(read_attribute(path, buffer, sizeof(buffer)) == -1 &&
+                   errno == ENOENT,
+               "a missing attribute should fail with errno set");
+
+  ok &= expect(read_attribute("/proc/stat", buffer, 8) == 7 &&
+                   std::strlen(buffer) == 7 &&
+                   std::strncmp(buffer, "cpu ", 4) == 0,
+               "a read should stop one byte short of the buffer and end in a "
+               "NUL");
+  ok &= expect(read_attribute("/proc/stat", buffer, sizeof(buffer)) > 0 &&
+                   cached_attribute_count() == 1,
+               "procfs attributes should keep their descriptor");
+
+  std::vector<std::thread> readers;
+  std::vector<int> failures(4, 0);
+  for (size_t t = 0; t < failures.size(); ++t) {
+    readers.emplace_back([&failures, t] {
+      char local[256];
+      for (int i = 0; i < 2000; ++i) {
+        if (read_attribute("/proc/stat", local, sizeof(local)) <= 0 ||
+            std::strncmp(local, "cpu ", 4) != 0)
+          ++failures[t];
+      }
+    });
+  }
+  for (auto &reader : readers)
+    reader.join();
+  ok &= expect(failures == std::vector<int>(4, 0) &&
+                   cached_attribute_count() == 1,
+               "concurrent readers should share one descriptor");
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,122 @@
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+#include "coalesce.hpp"
+#include "commands.hpp"
+
+namespace {
+
+bool expect(bool condition, const char *message) {
+  if (condition)
+    return true;
+
+  std::cerr << "FAILED: " << message << std::endl;
+  return false;
+}
+
+} // namespace
+
+int main() {
+  namespace fs = std::filesystem;
+  fs::path root = fs::temp_directory_path() /
+                  ("victus-coalesce-test-" + std::to_string(getpid()));
+  fs::path brightness = root / "sys/class/leds/hp::kbd_backlight/brightness";
+  fs::create_directories(brightness.parent_path());
+  std::ofstream(brightness) << "0\n";
+  setenv("VICTUS_SYSFS_ROOT", root.c_str(), 1);
+
+  bool ok = true;
+  int writes = 0;
+  auto write = [&writes] {
+    ++writes;
+    return std::string("OK");
+  };
+
+  uint64_t first = coalesce_claim(1, "fan1");
+  uint64_t second = coalesce_claim(1, "fan1");
+  ok &= expect(first != 0 && second != 0 && first != second,
+               "claims should hand out distinct non-zero tickets");
+  ok &= expect(coalesce_write(1, "fan1", first, write) == kMergedReply &&
+                   writes == 0,
+               "a superseded write should be merged without running");
+  ok &= expect(coalesce_write(1, "fan1", second, write) == "OK" && writes == 1,
+               "the newest write should run");
+
+  coalesce_claim(2, "fan1");
+  auto started = std::chrono::steady_clock::now();
+  ok &= expect(coalesce_write(0, "fan1", 0, write) == "OK" && writes == 2,
+               "unclaimed writes should never be merged");
+  ok &= expect(std::chrono::steady_clock::now() - started >=
+                   kMinWriteInterval - std::chrono::milliseconds(5),
+               "writes to one target should be rate limited");
+
+  uint64_t other_target = coalesce_claim(1, "zone0");
+  coalesce_claim(1, "zone1");
+  ok &= expect(coalesce_write(1, "zone0", other_target, write) == "OK",
+               "claims for other targets should not supersede a write");
+
+  uint64_t forgotten = coalesce_claim(3, "brightness");
+  coalesce_forget_client(3);
+  ok &= expect(coalesce_write(3, "brightness", forgotten, write) ==
+                   kMergedReply,
+               "writes of a client that went away should be merged");
+
+  // A write waiting behind a slow one is released as soon as it is
+  // superseded, without waiting for the slow write to finish.
+  std::thread slow([] {
+    coalesce_write(0, "color", 0, [] {
+      std::this_thread::sleep_for(std::chrono::milliseconds(300));
+      return std::string("OK");
+    });
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  uint64_t waiting = coalesce_claim(1, "color");
+  std::string waiting_reply;
+  std::thread waiter([&] {
+    waiting_reply = coalesce_write(1, "color", waiting, write);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  started = std::chrono::steady_clock::now();
+  coalesce_claim(1, "color");
+  waiter.join();
+  ok &= expect(waiting_reply == kMergedReply &&
+                   std::chrono::steady_clock::now() - started <
+                       std::chrono::milliseconds(150),
+               "a waiting write should be merged as soon as it is superseded");
+  slow.join();
+
+  ok &= expect(command_write_target("SET_FAN_SPEED 2 3000") == "fan2" &&
+                   command_write_target("SET_KBD_BRIGHTNESS 10") ==
+                       "brightness" &&
+                   command_write_target("GET_FAN_SPEED 2").empty() &&
+                   command_write_target("SET_FAN_SPEED 2").empty() &&
+                   command_write_target("BATCH\nSET_KBD_BRIGHTNESS 10").empty(),
+               "only valid SET commands should name a write target");
+
+  auto read_brightness = [&brightness] {
+    std::string value;
+    std::ifstream(brightness) >> value;
+    return value;
+  };
+  ok &= expect(handle_command("BATCH\nSET_KBD_BRIGHTNESS 10\n"
+                              "SET_KBD_BRIGHTNESS 20\nSET_KBD_BRIGHTNESS 30") ==
+                       "BATCH 3\nOK\tOK: MERGED\nOK\tOK: MERGED\nOK\tOK" &&
+                   read_brightness() == "30",
+               "earlier SETs to a target in one BATCH should be merged into "
+               "the last");
+  ok &= expect(handle_command("BATCH\nSET_KBD_BRIGHTNESS 40\n"
+                              "SET_FAN_SPEED 1 -5\nSET_FAN_SPEED 3 0") ==
+                       "BATCH 3\nOK\tOK\nERR\tERROR: Invalid fan speed\n"
+                       "ERR\tERROR: Invalid fan number" &&
+                   read_brightness() == "40",
+               "a SET without a later write to its target should be applied");
+
+  fs::remove_all(root);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,233 @@
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "commands.hpp"
+#include "fan.hpp"
+#include "util.hpp"
+#include "validation.hpp"
+
+// Timings for the functions every command or Better Auto tick goes through.
+// Sysfs reads run against a fixture tree built under a temporary
+// VICTUS_SYSFS_ROOT, so the numbers do not depend on the machine's hardware.
+//
+// Each benchmark prints one JSON object per line:
+//
+//   {"benchmark":"normalize_mode","iterations":2097152,"ns_per_op":11.9,...}
+//
+// ns_per_op is the median of several timed runs, which keeps one noisy run
+// from looking like a regression. Options: --filter <substring> and
+// --min-time-ms <ms> per run (default 50).
+
+namespace {
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+constexpr int kRuns = 5;
+
+struct Options {
+  std::string filter;
+  std::chrono::milliseconds min_time{50};
+};
+
+// Keeps the compiler from discarding a result it can see is unused.
+template <typename T> void keep(const T &value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+template <typename Fn>
+void run_benchmark(const Options &options, const char *name, Fn &&body) {
+  if (!options.filter.empty() &&
+      std::string_view(name).find(options.filter) == std::string_view::npos)
+    return;
+
+  // Doubles the batch until one batch takes min_time.
+  uint64_t iterations = 1;
+  while (true) {
+    auto start = Clock::now();
+    for (uint64_t i = 0; i < iterations; ++i)
+      body();
+    if (Clock::now() - start >= options.min_time || iterations >= (1ull << 40))
+      break;
+    iterations *= 2;
+  }
+
+  std::array<double, kRuns> per_op;
+  for (double &sample : per_op) {
+    auto start = Clock::now();
+    for (uint64_t i = 0; i < iterations; ++i)
+      body();
+    std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+    sample = elapsed.count() / static_cast<double>(iterations);
+  }
+  std::sort(per_op.begin(), per_op.end());
+
+  std::printf("{\"benchmark\":\"%s\",\"iterations\":%llu,\"runs\":%d,"
+              "\"ns_per_op\":%.1f,\"min_ns\":%.1f,\"max_ns\":%.1f}\n",
+              name, static_cast<unsigned long long>(iterations), kRuns,
+              per_op[kRuns / 2], per_op.front(), per_op.back());
+  std::fflush(stdout);
+}
+
+void write_file(const fs::path &path, const std::string &content) {
+  fs::create_directories(path.parent_path());
+  std::ofstream(path) << content << "\n";
+}
+
+// The layout victus-sim maintains, frozen at one sample.
+void build_fixture(const fs::path &root) {
+  fs::path hp = root / "sys/devices/platform/hp-wmi/hwmon/hwmon3";
+  write_file(hp / "pwm1_enable", "2");
+  write_file(hp / "fan1_input", "3120");
+  write_file(hp / "fan2_input", "3340");
+  write_file(hp / "fan1_max", "5800");
+  write_file(hp / "fan2_max", "6100");
+  // Decoys the hwmon scan has to skip.
+  write_file(root / "sys/devices/platform/hp-wmi/hwmon/hwmon1/name", "hp");
+  write_file(root / "sys/devices/platform/hp-wmi/hwmon/power/control", "auto");
+
+  for (int i = 0; i < 4; ++i) {
+    fs::path hwmon = root / "sys/class/hwmon" / ("hwmon" + std::to_string(i));
+    write_file(hwmon / "name", "acpitz");
+    write_file(hwmon / "temp1_input", "40000");
+  }
+  fs::path cpu = root / "sys/class/hwmon/hwmon4";
+  write_file(cpu / "name", "coretemp");
+  write_file(cpu / "temp1_label", "Package id 0");
+  write_file(cpu / "temp1_input", "61000");
+  fs::path gpu = root / "sys/class/hwmon/hwmon5";
+  write_file(gpu / "name", "amdgpu");
+  write_file(gpu / "temp1_label", "edge");
+  write_file(gpu / "temp1_input", "52000");
+
+  write_file(root / "sys/class/thermal/thermal_zone0/type", "x86_pkg_temp");
+  write_file(root / "sys/class/thermal/thermal_zone0/temp", "61000");
+  write_file(root / "sys/class/drm/card0/device/gpu_busy_percent", "37");
+  write_file(root / "proc/stat",
+             "cpu  415305 1071 96543 8123487 7384 0 2147 0 0 0\n"
+             "cpu0 51928 135 12068 1015411 923 0 1788 0 0 0");
+}
+
+bool parse_options(int argc, char **argv, Options *options) {
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string_view arg = argv[i];
+    if (arg == "--filter") {
+      options->filter = argv[i + 1];
+    } else if (arg == "--min-time-ms") {
+      int ms = 0;
+      if (!parse_bounded_int(argv[i + 1], 1, 60000, &ms))
+        return false;
+      options->min_time = std::chrono::milliseconds(ms);
+    } else {
+      return false;
+    }
+  }
+  return argc % 2 == 1;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parse_options(argc, argv, &options)) {
+    std::cerr << "Usage: " << argv[0]
+              << " [--filter SUBSTRING] [--min-time-ms MS]" << std::endl;
+    return 2;
+  }
+
+  char root_template[] = "/tmp/victus-benchmark-XXXXXX";
+  if (!mkdtemp(root_template)) {
+    std::cerr << "mkdtemp failed: " << std::strerror(errno) << std::endl;
+    return 1;
+  }
+  fs::path root = root_template;
+  build_fixture(root);
+  // Read once by the backend, so it has to be set before the first lookup.
+  setenv("VICTUS_SYSFS_ROOT", root.c_str(), 1);
+
+  const std::array<std::string_view, 6> modes = {
+      "auto", "Manual", "MAX", "better_auto", "bogus", " AUTO"};
+  size_t next_mode = 0;
+  run_benchmark(options, "normalize_mode", [&] {
+    keep(normalize_mode(modes[next_mode++ % modes.size()]).size());
+  });
+
+  int parsed = 0;
+  run_benchmark(options, "parse_bounded_int", [&] {
+    keep(parse_bounded_int("4200", 0, 6000, &parsed));
+    keep(parsed);
+  });
+  std::array<int, 3> rgb = {};
+  run_benchmark(options, "parse_rgb_triplet", [&] {
+    keep(parse_rgb_triplet("255 128 0", &rgb));
+    keep(rgb);
+  });
+  run_benchmark(options, "parse_hex_color", [&] {
+    keep(parse_hex_color("FF8000", &rgb));
+    keep(rgb);
+  });
+  std::string_view tag;
+  std::string_view command;
+  run_benchmark(options, "split_request_tag", [&] {
+    keep(split_request_tag("#42 SET_FAN_SPEED 1 3200", &tag, &command));
+    keep(command.size());
+  });
+
+  std::string hwmon_base = sysfs_path("/sys/devices/platform/hp-wmi/hwmon");
+  run_benchmark(options, "find_hwmon_directory", [&] {
+    keep(find_hwmon_directory(hwmon_base).size());
+  });
+
+  run_benchmark(options, "read_cpu_usage_pct",
+                [] { keep(read_cpu_usage_pct()); });
+  int millicelsius = 0;
+  run_benchmark(options, "read_cpu_temperature", [&] {
+    keep(read_cpu_temperature_millicelsius(&millicelsius));
+  });
+  int rpm = 0;
+  run_benchmark(options, "read_fan_speed_rpm",
+                [&] { keep(read_fan_speed_rpm(0, &rpm)); });
+  run_benchmark(options, "collect_snapshot", [] {
+    ThermalSnapshot snapshot = collect_snapshot();
+    keep(snapshot);
+  });
+
+  const std::array<ThermalSnapshot, 3> snapshots = {
+      ThermalSnapshot{61.0, 52.0, 37.0, 12.0},
+      ThermalSnapshot{84.5, std::nullopt, 91.0, std::nullopt},
+      ThermalSnapshot{std::nullopt, std::nullopt, std::nullopt, 4.0}};
+  size_t next_snapshot = 0;
+  int level = 3;
+  run_benchmark(options, "level_from_snapshot", [&] {
+    level = level_from_snapshot(snapshots[next_snapshot++ % snapshots.size()],
+                                level);
+    keep(level);
+  });
+
+  // Dispatch through the schema, parser and handler; the rejected command
+  // measures the path that never reaches sysfs.
+  run_benchmark(options, "handle_command_get_fan_mode",
+                [] { keep(handle_command("GET_FAN_MODE").size()); });
+  run_benchmark(options, "handle_command_get_fan_speed",
+                [] { keep(handle_command("GET_FAN_SPEED 1").size()); });
+  run_benchmark(options, "handle_command_get_cpu_temp",
+                [] { keep(handle_command("GET_CPU_TEMP").size()); });
+  run_benchmark(options, "handle_command_rejected",
+                [] { keep(handle_command("SET_FAN_SPEED 3 100").size()); });
+
+  fs::remove_all(root);
+  return 0;
+}
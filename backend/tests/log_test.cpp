@@ -0,0 +1,124 @@
+#include <cstdio>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "log.hpp"
+
+namespace {
+
+bool expect(bool condition, const char *message) {
+  if (condition)
+    return true;
+
+  std::cerr << "FAILED: " << message << std::endl;
+  return false;
+}
+
+// Points stdout at a temporary file and hands back what was written to it.
+class CapturedStdout {
+public:
+  CapturedStdout() {
+    std::fflush(stdout);
+    saved = dup(STDOUT_FILENO);
+    file = std::tmpfile();
+    dup2(fileno(file), STDOUT_FILENO);
+  }
+  ~CapturedStdout() {
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    std::fclose(file);
+  }
+
+  std::string text() {
+    std::string captured;
+    char buffer[4096];
+    std::rewind(file);
+    size_t got;
+    while ((got = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+      captured.append(buffer, got);
+    return captured;
+  }
+
+private:
+  int saved;
+  FILE *file;
+};
+
+size_t count_lines(const std::string &text, const std::string &needle) {
+  size_t count = 0;
+  for (size_t at = text.find(needle); at != std::string::npos;
+       at = text.find(needle, at + 1))
+    ++count;
+  return count;
+}
+
+} // namespace
+
+int main() {
+  bool ok = true;
+
+  ok &= expect(parse_log_level("WARNING") == LogLevel::Warning &&
+                   parse_log_level("debug") == LogLevel::Debug &&
+                   !parse_log_level("verbose"),
+               "level names should parse case-insensitively");
+
+  {
+    CapturedStdout captured;
+    log_set_level(LogLevel::Info);
+    LOG_DEBUG << "hidden " << 1;
+    LOG_INFO << "fan " << 2 << " at " << 3120 << " rpm, " << 61.5 << " C";
+    log_set_level(LogLevel::Debug);
+    LOG_DEBUG << "now shown";
+    ok &= expect(captured.text() == "fan 2 at 3120 rpm, 61.5 C\nnow shown\n",
+                 "lines below the level should be skipped, others written "
+                 "synchronously before log_start()");
+  }
+
+  {
+    CapturedStdout captured;
+    for (int i = 0; i < 20; ++i)
+      LOG_INFO << "repeated " << i;
+    ok &= expect(count_lines(captured.text(), "repeated ") == kLogBurst,
+                 "a call site should be limited to kLogBurst lines per window");
+  }
+
+  {
+    CapturedStdout captured;
+    log_start();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+      threads.emplace_back([t] {
+        // One line per call site per thread, inside the burst allowance.
+        LOG_INFO << "thread " << t << " line 0";
+        LOG_INFO << "thread " << t << " line 1";
+        LOG_INFO << "thread " << t << " line 2";
+        LOG_INFO << "thread " << t << " line 3";
+      });
+    }
+    for (auto &thread : threads)
+      thread.join();
+    LOG_INFO << "main thread";
+    log_shutdown();
+
+    std::string text = captured.text();
+    ok &= expect(count_lines(text, "line ") == 16 &&
+                     count_lines(text, "main thread") == 1,
+                 "the drain thread should write every thread's lines");
+    ok &= expect(text.find("thread 2 line 0") < text.find("thread 2 line 3"),
+                 "a thread's lines should stay in order");
+  }
+
+  std::string long_line(kLogMaxLine * 2, 'x');
+  {
+    CapturedStdout captured;
+    LOG_INFO << long_line;
+    ok &= expect(captured.text().size() == kLogMaxLine + 1,
+                 "long lines should be cut at kLogMaxLine");
+  }
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,117 @@
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+#include "metrics.hpp"
+#include "telemetry.hpp"
+
+namespace {
+
+bool expect(bool condition, const char *message) {
+  if (condition)
+    return true;
+
+  std::cerr << "FAILED: " << message << std::endl;
+  return false;
+}
+
+bool has_line(const std::string &text, const std::string &line) {
+  return ("\n" + text).find("\n" + line + "\n") != std::string::npos;
+}
+
+std::string read_file(const std::filesystem::path &path) {
+  std::ifstream in(path);
+  std::stringstream text;
+  text << in.rdbuf();
+  return text.str();
+}
+
+} // namespace
+
+int main() {
+  // A fan that reads 2450 RPM, to show the metrics file never reads it.
+  namespace fs = std::filesystem;
+  fs::path root = fs::temp_directory_path() /
+                  ("victus-metrics-test-" + std::to_string(getpid()));
+  fs::path hwmon = root / "sys/devices/platform/hp-wmi/hwmon/hwmon1";
+  fs::create_directories(hwmon);
+  std::ofstream(hwmon / "fan1_input") << "2450\n";
+  setenv("VICTUS_SYSFS_ROOT", root.c_str(), 1);
+
+  bool ok = true;
+
+  fs::path metrics_file = root / "victus.prom";
+  ok &= expect(metrics_start(metrics_file.string()),
+               "the metrics file should be writable");
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  std::string empty = read_file(metrics_file);
+  ok &= expect(has_line(empty, "# TYPE victus_fan_rpm gauge") &&
+                   empty.find("victus_fan_rpm{") == std::string::npos,
+               "fans nobody sampled yet should have no value");
+  ok &= expect(has_line(empty, "victus_mode_reasserts_total 0"),
+               "counters should start at zero");
+
+  int rpm = 0;
+  ok &= expect(read_fan_speed_rpm(0, &rpm) && rpm == 2450 &&
+                   has_line(metrics_render(),
+                            "victus_fan_rpm{fan=\"1\"} 2450"),
+               "a speed read for a client should be reported");
+  telemetry_shutdown();
+  fs::remove_all(root);
+
+  metrics_record_fan_rpm(0, 3120);
+  metrics_record_mode("BETTER_AUTO", 4);
+  metrics_record_cpu_temp(61500);
+  metrics_record_fan_target(0, 3300);
+  metrics_record_cooldown(5);
+  metrics_record_snapshot({72.0, 55.5, 37.0, std::nullopt});
+  metrics_record_helper("set-fan-speed.sh", std::chrono::milliseconds(250),
+                        true);
+  metrics_record_helper("set-fan-speed.sh", std::chrono::milliseconds(750),
+                        false);
+  metrics_record_mode_reassert(true);
+  metrics_record_mode_reassert(false);
+
+  std::string text = metrics_render();
+  ok &= expect(has_line(text, "victus_fan_rpm{fan=\"1\"} 3120") &&
+                   text.find("victus_fan_rpm{fan=\"2\"}") == std::string::npos,
+               "an unreadable fan should be left out, not reported as 0");
+  ok &= expect(has_line(text, "victus_fan_target_rpm{fan=\"1\"} 3300"),
+               "applied targets should be reported");
+  ok &= expect(has_line(text, "victus_fan_mode{mode=\"BETTER_AUTO\"} 1") &&
+                   has_line(text, "victus_fan_mode{mode=\"AUTO\"} 0"),
+               "the mode should be one-hot");
+  ok &= expect(has_line(text, "victus_better_auto_level 4") &&
+                   has_line(text, "victus_better_auto_cooldown_level 5"),
+               "Better Auto level and cooldown should be reported");
+  ok &= expect(
+      has_line(text, "victus_temperature_celsius{sensor=\"cpu\"} 72") &&
+          has_line(text, "victus_temperature_celsius{sensor=\"gpu\"} 55.5"),
+      "a fresh Better Auto snapshot should supply the temperatures");
+  ok &= expect(has_line(text, "victus_usage_ratio{device=\"cpu\"} 0.37") &&
+                   text.find("device=\"gpu\"") == std::string::npos,
+               "usage should be a ratio and missing sensors left out");
+  ok &= expect(
+      has_line(text, "victus_helper_duration_seconds_count{helper=\"set-fan-"
+                     "speed.sh\"} 2") &&
+          has_line(text, "victus_helper_duration_seconds_sum{helper=\"set-fan-"
+                         "speed.sh\"} 1") &&
+          has_line(text,
+                   "victus_helper_failures_total{helper=\"set-fan-speed.sh\"} 1"),
+      "helper runs, time and failures should be counted");
+  ok &= expect(has_line(text, "victus_mode_reasserts_total 2") &&
+                   has_line(text, "victus_mode_reassert_failures_total 1"),
+               "mode reasserts should be counted");
+  ok &= expect(text.find("victus_self_threads ") != std::string::npos &&
+                   text.find("victus_self_context_switches_total{kind="
+                             "\"voluntary\"}") != std::string::npos,
+               "the daemon's own cost should be reported");
+
+  return ok ? 0 : 1;
+}
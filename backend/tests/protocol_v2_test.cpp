@@ -0,0 +1,120 @@
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+#include "keyboard.hpp"
+#include "protocol_v2.hpp"
+#include "util.hpp"
+
+namespace {
+
+bool expect(bool condition, const char *message) {
+  if (condition)
+    return true;
+
+  std::cerr << "FAILED: " << message << std::endl;
+  return false;
+}
+
+std::string request(BinaryOpcode opcode, std::string args = "") {
+  return std::string(1, static_cast<char>(opcode)) + args;
+}
+
+BinaryStatus status_of(const std::string &reply) {
+  return reply.empty() ? BinaryStatus::Failed
+                       : static_cast<BinaryStatus>(reply[0]);
+}
+
+} // namespace
+
+int main() {
+  // An empty sysfs tree; the hp-wmi hwmon directory is added further down.
+  namespace fs = std::filesystem;
+  fs::path root = fs::temp_directory_path() /
+                  ("victus-protocol-v2-test-" + std::to_string(getpid()));
+  fs::create_directories(root);
+  setenv("VICTUS_SYSFS_ROOT", root.c_str(), 1);
+
+  bool ok = true;
+
+  uint8_t version = kProtocolTextVersion;
+  ok &= expect(is_protocol_hello("HELLO 2"), "HELLO frames should be detected");
+  ok &= expect(!is_protocol_hello("GET_FAN_MODE"),
+               "regular text commands are not handshakes");
+  ok &= expect(negotiate_protocol("HELLO 2", &version) == "HELLO 2" &&
+                   version == kProtocolBinaryVersion,
+               "HELLO 2 should switch the connection to binary");
+  ok &= expect(negotiate_protocol("HELLO 9", &version) == "HELLO 2" &&
+                   version == kProtocolBinaryVersion,
+               "newer clients should be offered the highest known version");
+  ok &= expect(negotiate_protocol("HELLO 1", &version) == "HELLO 1" &&
+                   version == kProtocolTextVersion,
+               "HELLO 1 should keep the text protocol");
+  version = kProtocolTextVersion;
+  ok &= expect(negotiate_protocol("HELLO two", &version).rfind("ERROR", 0) ==
+                       0 &&
+                   version == kProtocolTextVersion,
+               "malformed HELLO should be rejected without switching");
+
+  ok &= expect(status_of(handle_binary_command(std::string(1, '\x7f'))) ==
+                   BinaryStatus::UnknownOpcode,
+               "unknown opcodes should report UnknownOpcode");
+  ok &= expect(status_of(handle_binary_command("")) ==
+                   BinaryStatus::InvalidArgument,
+               "empty requests should be rejected");
+  ok &= expect(status_of(handle_binary_command(
+                   request(BinaryOpcode::GetFanSpeed, std::string(1, '\3')))) ==
+                   BinaryStatus::InvalidArgument,
+               "fan numbers outside 1-2 should be rejected");
+  ok &= expect(status_of(handle_binary_command(
+                   request(BinaryOpcode::GetFanSpeed))) ==
+                   BinaryStatus::InvalidArgument,
+               "missing fixed-width arguments should be rejected");
+  ok &= expect(status_of(handle_binary_command(request(
+                   BinaryOpcode::SetKeyboardZoneColor, std::string("\4abc")))) ==
+                   BinaryStatus::InvalidArgument,
+               "zone numbers outside 0-3 should be rejected");
+  ok &= expect(status_of(handle_binary_command(
+                   request(BinaryOpcode::SetFanMode, std::string(1, '\x09')))) ==
+                   BinaryStatus::InvalidArgument,
+               "unknown fan modes should be rejected");
+
+  std::string max_reply = handle_binary_command(
+      request(BinaryOpcode::GetFanMaxSpeed, std::string(1, '\1')));
+  ok &= expect(status_of(max_reply) == BinaryStatus::Ok &&
+                   max_reply.size() == 5,
+               "fan max speed should be a status byte plus a u32");
+
+  // Handler failures carry the kind they were reported with, not one guessed
+  // from the wording.
+  ok &= expect(error_kind(set_keyboard_color("300 0 0")) ==
+                   ErrorKind::InvalidArgument,
+               "handlers should report bad values as InvalidArgument");
+  ok &= expect(error_kind("ERROR: Invalid fan number") == ErrorKind::Failed,
+               "text that no handler just reported should count as Failed");
+  std::string fan1 = request(BinaryOpcode::GetFanSpeed, std::string(1, '\1'));
+  ok &= expect(status_of(handle_binary_command(fan1)) ==
+                   BinaryStatus::DeviceUnavailable,
+               "a missing hwmon device should report DeviceUnavailable");
+  fs::create_directories(root / "sys/devices/platform/hp-wmi/hwmon/hwmon2");
+  ok &= expect(status_of(handle_binary_command(fan1)) == BinaryStatus::Failed,
+               "an unreadable fan speed should report Failed");
+  ok &= expect(status_of(handle_binary_command(
+                   request(BinaryOpcode::GetCpuTemp))) ==
+                   BinaryStatus::DeviceUnavailable,
+               "a missing CPU sensor should report DeviceUnavailable");
+
+  ok &= expect(binary_command_may_block(request(BinaryOpcode::SetFanSpeed)) &&
+                   binary_command_may_block(
+                       request(BinaryOpcode::SetKbdBrightness)),
+               "set opcodes should go to the slow lane");
+  ok &= expect(!binary_command_may_block(request(BinaryOpcode::GetFanSpeed)) &&
+                   !binary_command_may_block(""),
+               "reads should stay on the fast lane");
+
+  fs::remove_all(root);
+  return ok ? 0 : 1;
+}
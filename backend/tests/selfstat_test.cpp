@@ -0,0 +1,67 @@
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "selfstat.hpp"
+
+namespace {
+
+bool expect(bool condition, const char *message) {
+  if (condition)
+    return true;
+
+  std::cerr << "FAILED: " << message << std::endl;
+  return false;
+}
+
+double field(const std::string &report, const std::string &key) {
+  size_t at = report.find(" " + key + "=");
+  if (at == std::string::npos)
+    return -1.0;
+  return std::stod(report.substr(at + key.size() + 2));
+}
+
+} // namespace
+
+int main() {
+  bool ok = true;
+
+  SelfStat before = selfstat_sample();
+  ok &= expect(before.threads == 1 && before.rss_bytes > 0,
+               "a fresh process should have one thread and some memory");
+
+  selfstat_record_fork();
+  selfstat_record_fork();
+  std::thread sleeper([] {
+    for (int i = 0; i < 20; ++i)
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  });
+  SelfStat during = selfstat_sample();
+  sleeper.join();
+  SelfStat after = selfstat_sample();
+
+  ok &= expect(during.threads == 2, "live threads should be counted");
+  ok &= expect(after.forks == before.forks + 2, "forks should be counted");
+  ok &= expect(after.voluntary_switches >= before.voluntary_switches + 20,
+               "every sleep should count as a voluntary switch, from any "
+               "thread");
+  ok &= expect(after.uptime_s >= 0.1 && after.cpu_user_s >= 0.0,
+               "uptime should cover the sleeps");
+
+  std::string report = selfstat_report();
+  ok &= expect(report.rfind("SELFSTAT uptime_s=", 0) == 0 &&
+                   field(report, "forks") == 2 &&
+                   field(report, "threads") == 1 &&
+                   field(report, "wakeups_per_s") > 0,
+               "the report should carry every field");
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  report = selfstat_report();
+  ok &= expect(field(report, "wakeups_per_s") < 100,
+               "the wakeup rate should cover only the time since the last "
+               "report");
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,147 @@
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "fan.hpp"
+#include "server.hpp"
+
+namespace {
+
+bool expect(bool condition, const char *message) {
+  if (condition)
+    return true;
+
+  std::cerr << "FAILED: " << message << std::endl;
+  return false;
+}
+
+bool write_frame(int fd, const std::string &payload) {
+  std::string frame(4, '\0');
+  for (int i = 0; i < 4; ++i)
+    frame[i] = static_cast<char>((payload.size() >> (8 * i)) & 0xFF);
+  frame += payload;
+  return send(fd, frame.data(), frame.size(), MSG_NOSIGNAL) ==
+         static_cast<ssize_t>(frame.size());
+}
+
+// Every reply until the server closes the connection.
+std::vector<std::string> read_until_closed(int fd) {
+  std::vector<std::string> replies;
+  std::string received;
+  char chunk[4096];
+  ssize_t got;
+  while ((got = recv(fd, chunk, sizeof(chunk), 0)) > 0)
+    received.append(chunk, static_cast<size_t>(got));
+
+  size_t offset = 0;
+  while (received.size() - offset >= 4) {
+    const auto *header =
+        reinterpret_cast<const unsigned char *>(received.data() + offset);
+    size_t length = header[0] | (header[1] << 8) | (header[2] << 16) |
+                    (static_cast<size_t>(header[3]) << 24);
+    if (received.size() - offset - 4 < length)
+      break;
+    replies.push_back(received.substr(offset + 4, length));
+    offset += 4 + length;
+  }
+  return replies;
+}
+
+int connect_to(const std::string &path) {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+  if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+} // namespace
+
+int main() {
+  // An empty sysfs tree, so the commands below touch no hardware.
+  namespace fs = std::filesystem;
+  fs::path root = fs::temp_directory_path() /
+                  ("victus-server-test-" + std::to_string(getpid()));
+  fs::create_directories(root);
+  setenv("VICTUS_SYSFS_ROOT", root.c_str(), 1);
+  setenv("VICTUS_HELPER_DIR", root.c_str(), 1);
+
+  std::string path = (root / "backend.sock").string();
+  int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+  bind(listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+  listen(listen_fd, 8);
+  std::thread server([listen_fd] { run_server(listen_fd); });
+
+  bool ok = true;
+
+  // A client that sends its requests and then shuts down its sending side,
+  // like `socat` reading a script, still gets every reply before EOF.
+  int fd = connect_to(path);
+  ok &= expect(write_frame(fd, "GET_STATE_SINCE 0") &&
+                   write_frame(fd, "NOPE") &&
+                   write_frame(fd, "GET_STATE_SINCE 0 abc"),
+               "requests should be sent");
+  shutdown(fd, SHUT_WR);
+  std::vector<std::string> replies = read_until_closed(fd);
+  close(fd);
+  ok &= expect(replies.size() == 3 && replies[0].rfind("STATE ", 0) == 0 &&
+                   replies[1] == "ERROR: Unknown command" &&
+                   replies[2] == "ERROR: Invalid wait time",
+               "buffered untagged requests should be answered after EOF");
+
+  fd = connect_to(path);
+  write_frame(fd, "#a GET_STATE_SINCE 0");
+  write_frame(fd, "#b NOPE");
+  shutdown(fd, SHUT_WR);
+  replies = read_until_closed(fd);
+  close(fd);
+  ok &= expect(replies.size() == 2 &&
+                   (replies[0].rfind("#a STATE ", 0) == 0 ||
+                    replies[1].rfind("#a STATE ", 0) == 0),
+               "tagged requests in flight at EOF should be answered");
+
+  // Malformed SUBSCRIBE requests are refused without subscribing.
+  fd = connect_to(path);
+  write_frame(fd, "SUBSCRIBE fan 3601");
+  write_frame(fd, "SUBSCRIBE fan 1x");
+  write_frame(fd, "SUBSCRIBE fan,,mode 1");
+  write_frame(fd, "SUBSCRIBE fan 1 extra");
+  write_frame(fd, "SUBSCRIBE fan");
+  shutdown(fd, SHUT_WR);
+  replies = read_until_closed(fd);
+  close(fd);
+  ok &= expect(replies.size() == 5 &&
+                   replies[0] == "ERROR: Invalid SUBSCRIBE interval" &&
+                   replies[1] == "ERROR: Invalid SUBSCRIBE interval" &&
+                   replies[2] == "ERROR: Invalid SUBSCRIBE topics" &&
+                   replies[3] == "ERROR: Invalid SUBSCRIBE command format" &&
+                   replies[4] == "ERROR: Invalid SUBSCRIBE command format",
+               "malformed SUBSCRIBE requests should be rejected");
+
+  fd = connect_to(path);
+  shutdown(fd, SHUT_WR);
+  ok &= expect(read_until_closed(fd).empty(),
+               "an idle client that stops sending should be closed");
+  close(fd);
+
+  request_server_stop();
+  server.join();
+  shutdown_fan_controller();
+  close(listen_fd);
+  fs::remove_all(root);
+  return ok ? 0 : 1;
+}
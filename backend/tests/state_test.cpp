@@ -0,0 +1,100 @@
+#include <iostream>
+#include <string>
+
+#include "commands.hpp"
+#include "fan.hpp"
+#include "state.hpp"
+
+namespace {
+
+bool expect(bool condition, const char *message) {
+  if (condition)
+    return true;
+
+  std::cerr << "FAILED: " << message << std::endl;
+  return false;
+}
+
+} // namespace
+
+int main() {
+  bool ok = true;
+
+  int notifications = 0;
+  state_set_listener([&notifications] { ++notifications; });
+
+  ok &= expect(state_since(0) == "STATE 0",
+               "an empty document should only carry its version");
+
+  state_publish(StateField::Mode, "MANUAL");
+  state_publish(StateField::Fan1Target, "3200");
+  ok &= expect(state_version() == 2 && notifications == 2,
+               "each change should bump the version and notify");
+
+  state_publish(StateField::Mode, "MANUAL");
+  ok &= expect(state_version() == 2 && notifications == 2,
+               "republishing the same value should not bump the version");
+
+  ok &= expect(state_since(0) == "STATE 2\nmode=MANUAL\nfan1_target=3200",
+               "version 0 should return every known field");
+  ok &= expect(state_since(1) == "STATE 2\nfan1_target=3200",
+               "only fields changed after the version should be returned");
+  ok &= expect(state_since(2) == "STATE 2",
+               "an up to date client should get no fields");
+
+  state_publish(StateField::Mode, "MAX");
+  ok &= expect(state_since(2) == "STATE 3\nmode=MAX",
+               "a changed field should be reported again");
+  ok &= expect(state_since(99) == "STATE 3\nmode=MAX\nfan1_target=3200",
+               "a version from a previous run should get the whole document");
+
+  ok &= expect(handle_command("GET_STATE_SINCE 2") == state_since(2),
+               "GET_STATE_SINCE should return the delta");
+  ok &= expect(handle_command("GET_STATE_SINCE 2 500") == state_since(2),
+               "the wait argument should be optional");
+  ok &= expect(handle_command("GET_STATE_SINCE") ==
+                   "ERROR: Invalid GET_STATE_SINCE command format",
+               "the version should be required");
+  ok &= expect(handle_command("GET_STATE_SINCE 1 2 3") ==
+                   "ERROR: Invalid GET_STATE_SINCE command format",
+               "extra arguments should be rejected");
+  ok &= expect(handle_command("GET_STATE_SINCE -1") ==
+                   "ERROR: Invalid state version",
+               "negative versions should be rejected");
+  ok &= expect(handle_command("GET_STATE_SINCE 0 60001") ==
+                   "ERROR: Invalid wait time",
+               "waits above a minute should be rejected");
+
+  auto wait = state_wait_request("GET_STATE_SINCE 3 250");
+  ok &= expect(wait && wait->since == 3 && wait->timeout.count() == 250,
+               "a request with a wait should be parked by the server");
+  ok &= expect(!state_wait_request("GET_STATE_SINCE 3") &&
+                   !state_wait_request("GET_STATE_SINCE 3 0") &&
+                   !state_wait_request("GET_STATE_SINCE x 10") &&
+                   !state_wait_request("GET_FAN_MODE"),
+               "only valid requests with a non-zero wait should be parked");
+
+  // An upgrade handoff carries the versions over, so a client's version stays
+  // valid against the new daemon.
+  std::string exported = state_export();
+  ok &= expect(!state_import("3\n42 1 x") && !state_import("3\n0 4 x") &&
+                   !state_import("junk"),
+               "malformed exports should be rejected");
+  ok &= expect(state_version() == 3,
+               "a rejected import should leave the document alone");
+  state_publish(StateField::Mode, "AUTO");
+  ok &= expect(state_import(exported) && state_version() == 3 &&
+                   state_since(1) == "STATE 3\nmode=MAX\nfan1_target=3200",
+               "an import should restore the exported document");
+
+  // Once the fan state is exported the new daemon owns the fans; writes still
+  // queued on this one must not reach the hardware.
+  export_fan_controller_state();
+  ok &= expect(handle_command("SET_FAN_SPEED 1 3000") ==
+                       "ERROR: Fan control was handed off" &&
+                   handle_command("SET_FAN_MODE MAX") ==
+                       "ERROR: Fan control was handed off",
+               "fan writes should be refused after a handoff");
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,107 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "stats.hpp"
+
+namespace {
+
+bool expect(bool condition, const char *message) {
+  if (condition)
+    return true;
+
+  std::cerr << "FAILED: " << message << std::endl;
+  return false;
+}
+
+// The "<key>=<value>" number on the report line for `row`, or -1.
+long long report_value(const std::string &report, std::string_view row,
+                       std::string_view key) {
+  size_t line = report.find("\n" + std::string(row) + " ");
+  if (line == std::string::npos)
+    return -1;
+  size_t end = report.find('\n', line + 1);
+  std::string_view text = std::string_view(report).substr(
+      line, end == std::string::npos ? std::string::npos : end - line);
+  size_t at = text.find(" " + std::string(key) + "=");
+  if (at == std::string_view::npos)
+    return -1;
+  return std::stoll(std::string(text.substr(at + key.size() + 2)));
+}
+
+} // namespace
+
+int main() {
+  bool ok = true;
+  using std::chrono::microseconds;
+
+  ok &= expect(stats_report() == "STATS 0",
+               "nothing should be reported before a command ran");
+
+  auto t0 = StatsClock::now();
+  CommandTiming timing;
+  timing.slot = SET_FAN_SPEED;
+  timing.submitted = t0;
+  timing.started = t0 + microseconds(100);
+  timing.parse = microseconds(5);
+  timing.lock_wait = microseconds(9000);
+  timing.finished = t0 + microseconds(10100);
+  stats_record(timing, t0 + microseconds(10300));
+
+  std::string report = stats_report();
+  ok &= expect(report.rfind("STATS 6\n", 0) == 0,
+               "one command should report one row per phase");
+  ok &= expect(report_value(report, "SET_FAN_SPEED queue", "count") == 1 &&
+                   report_value(report, "SET_FAN_SPEED queue", "max_us") == 100,
+               "queue time should run from submission to the worker");
+  ok &= expect(report_value(report, "SET_FAN_SPEED lock_wait", "p50_us") ==
+                   9000,
+               "lock waits should get their own row");
+  ok &= expect(report_value(report, "SET_FAN_SPEED io", "min_us") == 995,
+               "io should be the handler time left after parse and lock wait");
+  ok &= expect(report_value(report, "SET_FAN_SPEED send", "p999_us") == 200,
+               "send should run from the handler's return to the write");
+  ok &= expect(report_value(report, "SET_FAN_SPEED total", "max_us") == 10300,
+               "total should cover submission to the write");
+
+  for (int us = 1; us <= 1000; ++us) {
+    CommandTiming sample;
+    sample.slot = GET_FAN_MODE;
+    sample.submitted = sample.started = sample.finished = t0;
+    stats_record(sample, t0 + microseconds(us));
+  }
+  report = stats_report();
+  long long p50 = report_value(report, "GET_FAN_MODE send", "p50_us");
+  long long p99 = report_value(report, "GET_FAN_MODE send", "p99_us");
+  ok &= expect(report_value(report, "GET_FAN_MODE send", "count") == 1000 &&
+                   report_value(report, "GET_FAN_MODE send", "min_us") == 1 &&
+                   report_value(report, "GET_FAN_MODE send", "max_us") == 1000,
+               "count, min and max should be exact");
+  ok &= expect(p50 >= 500 && p50 <= 500 + 500 / 8,
+               "p50 should be within a bucket of the true median");
+  ok &= expect(p99 >= 990 && p99 <= 1000,
+               "p99 should be within a bucket and capped at the maximum");
+
+  {
+    StatsLockWait ignored;
+  }
+  ok &= expect(stats_current_command() == nullptr,
+               "a lock wait outside a command should be a no-op");
+
+  CommandTiming scoped;
+  {
+    StatsCommandScope scope(&scoped);
+    ok &= expect(stats_current_command() == &scoped,
+                 "the scope should make its command current");
+    StatsLockWait waiting;
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  ok &= expect(stats_current_command() == nullptr &&
+                   scoped.lock_wait >= std::chrono::milliseconds(5) &&
+                   scoped.finished - scoped.started >= scoped.lock_wait,
+               "lock waits should be charged to the command in scope");
+
+  return ok ? 0 : 1;
+}
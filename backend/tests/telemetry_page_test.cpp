@@ -0,0 +1,105 @@
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "telemetry.hpp"
+#include "telemetry_page.hpp"
+#include "victus_telemetry_page.hpp"
+
+namespace {
+
+bool expect(bool condition, const char *message) {
+  if (condition)
+    return true;
+
+  std::cerr << "FAILED: " << message << std::endl;
+  return false;
+}
+
+bool maps_writable(int fd) {
+  void *mapping = mmap(nullptr, sizeof(VictusTelemetryPage),
+                       PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (mapping == MAP_FAILED)
+    return false;
+  munmap(mapping, sizeof(VictusTelemetryPage));
+  return true;
+}
+
+bool reopens_writable(int fd) {
+  std::string path = "/proc/self/fd/" + std::to_string(fd);
+  int reopened = open(path.c_str(), O_RDWR | O_CLOEXEC);
+  if (reopened < 0)
+    return false;
+  close(reopened);
+  return true;
+}
+
+// Root may open anything, so the reopen is tried as an unprivileged user the
+// way a desktop client would.
+bool client_reopens_writable(int fd) {
+  if (geteuid() != 0)
+    return reopens_writable(fd);
+
+  pid_t child = fork();
+  if (child == 0) {
+    if (setgid(65534) != 0 || setuid(65534) != 0)
+      _exit(2);
+    // Changing uid hides /proc/self/fd from the process itself otherwise.
+    prctl(PR_SET_DUMPABLE, 1);
+    _exit(reopens_writable(fd) ? 1 : 0);
+  }
+  int status = 0;
+  waitpid(child, &status, 0);
+  return !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+}
+
+} // namespace
+
+int main() {
+  // An empty sysfs tree, so the page's refreshes touch no hardware.
+  namespace fs = std::filesystem;
+  fs::path root = fs::temp_directory_path() /
+                  ("victus-telemetry-page-test-" + std::to_string(getpid()));
+  fs::create_directories(root);
+  setenv("VICTUS_SYSFS_ROOT", root.c_str(), 1);
+
+  bool ok = true;
+
+  int fd = telemetry_page_fd();
+  ok &= expect(fd >= 0, "the page should be created on request");
+
+  void *mapping =
+      mmap(nullptr, sizeof(VictusTelemetryPage), PROT_READ, MAP_SHARED, fd, 0);
+  ok &= expect(mapping != MAP_FAILED &&
+                   static_cast<VictusTelemetryPage *>(mapping)->magic ==
+                       kVictusTelemetryMagic,
+               "clients should be able to map the page for reading");
+  if (mapping != MAP_FAILED)
+    munmap(mapping, sizeof(VictusTelemetryPage));
+
+  ok &= expect(!maps_writable(fd),
+               "a client's descriptor should not map writable");
+  ok &= expect(!client_reopens_writable(fd),
+               "a client should not reopen the page for writing");
+  ok &= expect(ftruncate(fd, 0) < 0,
+               "a client should not be able to resize the page");
+
+  // The upgrade handoff passes the backend's own descriptor, which the new
+  // daemon still has to map writable.
+  int writable = telemetry_page_hand_off();
+  ok &= expect(maps_writable(writable),
+               "the handed-off descriptor should still map writable");
+  telemetry_page_resume();
+
+  close(fd);
+  telemetry_shutdown();
+  fs::remove_all(root);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,81 @@
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "trace.hpp"
+
+namespace {
+
+bool expect(bool condition, const char *message) {
+  if (condition)
+    return true;
+
+  std::cerr << "FAILED: " << message << std::endl;
+  return false;
+}
+
+size_t count_of(const std::string &text, const std::string &needle) {
+  size_t count = 0;
+  for (size_t at = text.find(needle); at != std::string::npos;
+       at = text.find(needle, at + 1))
+    ++count;
+  return count;
+}
+
+} // namespace
+
+int main() {
+  bool ok = true;
+
+  { TRACE_SPAN("sysfs", "read", "/ignored"); }
+  ok &= expect(count_of(trace_dump_json(), "\"ph\":\"X\"") == 0,
+               "spans should not be recorded until tracing is turned on");
+
+  ok &= expect(trace_set_enabled(true), "tracing should be compiled in");
+  {
+    std::string path = "/sys/devices/platform/hp-wmi/hwmon/hwmon3/fan1_input";
+    TRACE_SPAN("sysfs", "read", path);
+  }
+  { TRACE_SPAN("helper", "set-fan-speed.sh"); }
+  auto now = TraceClock::now();
+  TRACE_COMPLETE("command", "GET_FAN_SPEED", now, now, "quote \" here");
+
+  std::string dump = trace_dump_json();
+  ok &= expect(dump.rfind("{\"traceEvents\":[", 0) == 0 &&
+                   count_of(dump, "\"ph\":\"X\"") == 3,
+               "every span should be dumped as a complete event");
+  ok &= expect(dump.find("\"name\":\"read\",\"cat\":\"sysfs\"") !=
+                       std::string::npos &&
+                   dump.find("\"detail\":\"/sys/devices/platform/hp-wmi/hwmon/"
+                             "hwmon3/fan1_i\"") != std::string::npos,
+               "details should be cut at kTraceDetailMax");
+  ok &= expect(dump.find("\"detail\":\"quote \\\" here\"") != std::string::npos,
+               "details should be JSON-escaped");
+  ok &= expect(dump.find("set-fan-speed.sh") < dump.find("GET_FAN_SPEED"),
+               "spans should be dumped oldest first");
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([] {
+      for (size_t i = 0; i < kTraceCapacity; ++i) {
+        TRACE_SPAN("lock", "fan_apply_mutex");
+      }
+    });
+  }
+  for (auto &thread : threads)
+    thread.join();
+  dump = trace_dump_json();
+  // A writer that is lapped while filling its slot loses that span.
+  size_t kept = count_of(dump, "\"ph\":\"X\"");
+  ok &= expect(kept <= kTraceCapacity && kept > kTraceCapacity / 2 &&
+                   dump.find("GET_FAN_SPEED") == std::string::npos,
+               "the ring should keep only the newest kTraceCapacity spans");
+
+  trace_set_enabled(false);
+  { TRACE_SPAN("sysfs", "write", "/ignored"); }
+  ok &= expect(trace_dump_json().find("/ignored") == std::string::npos,
+               "turning tracing off should stop recording");
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,127 @@
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <linux/netlink.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+#include "uevent.hpp"
+#include "util.hpp"
+
+namespace {
+
+bool expect(bool condition, const char *message) {
+  if (condition)
+    return true;
+
+  std::cerr << "FAILED: " << message << std::endl;
+  return false;
+}
+
+// Builds a datagram the way the kernel lays it out: a header, then
+// NUL-separated KEY=value pairs.
+std::string datagram(const std::string &action, const std::string &devpath,
+                     const std::string &subsystem) {
+  std::string message = action + "@" + devpath;
+  message += '\0';
+  for (const std::string &field :
+       {"ACTION=" + action, "DEVPATH=" + devpath, "SUBSYSTEM=" + subsystem,
+        std::string("SEQNUM=4211")}) {
+    message += field;
+    message += '\0';
+  }
+  return message;
+}
+
+} // namespace
+
+int main() {
+  bool ok = true;
+
+  ok &= expect(uevent_invalidates_paths(datagram(
+                   "add", "/devices/platform/hp-wmi/hwmon/hwmon4", "hwmon")),
+               "a new hwmon device should invalidate paths");
+  ok &= expect(uevent_invalidates_paths(datagram(
+                   "remove", "/devices/platform/hp-wmi", "platform")),
+               "removing the hp-wmi platform device should invalidate paths");
+  ok &= expect(uevent_invalidates_paths(
+                   datagram("remove", "/module/hp_wmi", "module")),
+               "unloading the hp_wmi module should invalidate paths");
+  ok &= expect(uevent_invalidates_paths(datagram(
+                   "move", "/devices/virtual/thermal/thermal_zone3", "thermal")),
+               "a renamed thermal zone should invalidate paths");
+  ok &= expect(!uevent_invalidates_paths(datagram(
+                   "change", "/devices/pci0000:00/0000:01:00.0/drm/card1",
+                   "drm")),
+               "a DRM change (hotplug, mode set) should not invalidate paths");
+  ok &= expect(!uevent_invalidates_paths(datagram(
+                   "bind", "/devices/platform/hp-wmi", "platform")),
+               "driver binds should not invalidate paths");
+  ok &= expect(!uevent_invalidates_paths(
+                   datagram("add", "/devices/pci0000:00/usb1/1-2", "usb")),
+               "unrelated devices should not invalidate paths");
+
+  namespace fs = std::filesystem;
+  fs::path root = fs::temp_directory_path() /
+                  ("victus-uevent-test-" + std::to_string(getpid()));
+  std::string base = root.string();
+  fs::create_directories(root / "hwmon3");
+
+  ok &= expect(find_hwmon_directory(base) == (root / "hwmon3").string(),
+               "the highest hwmonN directory should be found");
+  fs::rename(root / "hwmon3", root / "hwmon4");
+  ok &= expect(find_hwmon_directory(base) == (root / "hwmon4").string(),
+               "without caching every lookup should rescan");
+
+  set_device_path_caching(true);
+  ok &= expect(find_hwmon_directory(base) == (root / "hwmon4").string(),
+               "the first cached lookup should scan");
+  fs::rename(root / "hwmon4", root / "hwmon5");
+  ok &= expect(find_hwmon_directory(base) == (root / "hwmon4").string(),
+               "later lookups should reuse the resolved path");
+
+  char buffer[64];
+  read_attribute("/proc/stat", buffer, sizeof(buffer));
+  uint64_t generation = device_generation();
+  invalidate_device_paths();
+  ok &= expect(device_generation() == generation + 1 &&
+                   cached_attribute_count() == 0,
+               "invalidation should start a new generation and drop "
+               "attribute descriptors");
+  ok &= expect(find_hwmon_directory(base) == (root / "hwmon5").string(),
+               "lookups after an invalidation should rescan");
+
+  fs::remove_all(root);
+  ok &= expect(find_hwmon_directory(base) == (root / "hwmon5").string(),
+               "a vanished device should be noticed only after invalidation");
+  invalidate_device_paths();
+  ok &= expect(find_hwmon_directory(base).empty(),
+               "a missing device should resolve to nothing");
+  set_device_path_caching(false);
+
+  // Only the kernel's own events count, not another process multicasting to
+  // the same group. Skipped where netlink is unavailable or sending to the
+  // group needs privileges the test lacks.
+  if (uevent_start()) {
+    int sender = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC,
+                        NETLINK_KOBJECT_UEVENT);
+    sockaddr_nl group = {};
+    group.nl_family = AF_NETLINK;
+    group.nl_groups = 1;
+    std::string forged =
+        datagram("add", "/devices/platform/hp-wmi/hwmon/hwmon9", "hwmon");
+    uint64_t before = device_generation();
+    if (sendto(sender, forged.data(), forged.size(), 0,
+               reinterpret_cast<sockaddr *>(&group), sizeof(group)) > 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      ok &= expect(device_generation() == before,
+                   "uevents from user space should be ignored");
+    }
+    close(sender);
+    uevent_shutdown();
+  }
+
+  return ok ? 0 : 1;
+}
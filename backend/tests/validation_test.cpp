@@ -1,5 +1,7 @@
 #include <array>
 #include <iostream>
+#include <string>
+#include <string_view>
 
 #include "validation.hpp"
 
@@ -41,6 +43,13 @@ int main() {
                "strict integer parsing should reject trailing characters");
   ok &= expect(!parse_strict_int("", &parsed_value),
                "strict integer parsing should reject empty strings");
+  ok &= expect(parse_strict_int("+7", &parsed_value) && parsed_value == 7,
+               "strict integer parsing should accept an explicit plus sign");
+  ok &= expect(!parse_strict_int("+-7", &parsed_value) &&
+                   !parse_strict_int(" 7", &parsed_value),
+               "strict integer parsing should reject stray signs and spaces");
+  ok &= expect(!parse_strict_int("99999999999", &parsed_value),
+               "strict integer parsing should reject out-of-range values");
 
   ok &= expect(parse_bounded_int("0", 0, 255, &parsed_value) &&
                    parsed_value == 0,
@@ -63,6 +72,49 @@ int main() {
                "rgb parsing should reject out-of-range values");
   ok &= expect(!parse_rgb_triplet("12 34 56 78", &rgb),
                "rgb parsing should reject extra tokens");
+  ok &= expect(parse_rgb_triplet(" 1\t2  3\n", &rgb) &&
+                   rgb == std::array<int, 3>{1, 2, 3},
+               "rgb parsing should accept any whitespace between channels");
+  ok &= expect(!parse_rgb_triplet("12 34 56x", &rgb),
+               "rgb parsing should reject trailing characters");
+
+  ok &= expect(parse_hex_color("FF8000", &rgb) &&
+                   rgb == std::array<int, 3>{255, 128, 0},
+               "hex colors should parse into channels");
+  ok &= expect(parse_hex_color("ff8000", &rgb),
+               "hex colors should accept lowercase digits");
+  ok &= expect(!parse_hex_color("-F8000", &rgb) &&
+                   !parse_hex_color("FF80G0", &rgb) &&
+                   !parse_hex_color("FF800", &rgb),
+               "malformed hex colors should be rejected");
+
+  std::string_view text = "  SET_FAN_SPEED\t1   2000 ";
+  ok &= expect(next_token(&text) == "SET_FAN_SPEED" &&
+                   next_token(&text) == "1" && next_token(&text) == "2000" &&
+                   next_token(&text).empty() && text.empty(),
+               "the tokenizer should skip runs of whitespace");
+  ok &= expect(trim_whitespace("\r\n better auto \n") == "better auto",
+               "trimming should keep inner whitespace");
+
+  std::string_view tag;
+  std::string_view tagged_command;
+  ok &= expect(split_request_tag("#17 GET_FAN_SPEED 1", &tag,
+                                 &tagged_command) &&
+                   tag == "17" && tagged_command == "GET_FAN_SPEED 1",
+               "request tags should split off the command");
+  ok &= expect(split_request_tag("#a.b-c_9 BATCH\nGET_FAN_MODE\n", &tag,
+                                 &tagged_command) &&
+                   tagged_command == "BATCH\nGET_FAN_MODE\n",
+               "request tags should keep multi-line commands intact");
+  ok &= expect(!split_request_tag("# GET_FAN_MODE", &tag, &tagged_command),
+               "empty request tags should be rejected");
+  ok &= expect(!split_request_tag("#12", &tag, &tagged_command),
+               "request tags without a command should be rejected");
+  ok &= expect(!split_request_tag("#1/2 GET_FAN_MODE", &tag, &tagged_command),
+               "request tags with unexpected characters should be rejected");
+  ok &= expect(!split_request_tag("#" + std::string(33, '1') + " GET_FAN_MODE",
+                                  &tag, &tagged_command),
+               "overlong request tags should be rejected");
 
   return ok ? 0 : 1;
 }
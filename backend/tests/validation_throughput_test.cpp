@@ -0,0 +1,186 @@
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "validation.hpp"
+
+// Compares the string_view/from_chars parsers with the stoi/stringstream
+// versions they replaced. The numbers are informational; the test fails only
+// if the two implementations disagree on the corpus.
+
+namespace {
+
+bool expect(bool condition, const char *message) {
+  if (condition)
+    return true;
+
+  std::cerr << "FAILED: " << message << std::endl;
+  return false;
+}
+
+bool legacy_parse_strict_int(const std::string &value, int *parsed) {
+  if (!parsed || value.empty())
+    return false;
+
+  size_t position = 0;
+  try {
+    int parsed_value = std::stoi(value, &position);
+    if (position != value.size())
+      return false;
+
+    *parsed = parsed_value;
+    return true;
+  } catch (...) {
+    return false;
+  }
+}
+
+bool legacy_parse_rgb_triplet(const std::string &color,
+                              std::array<int, 3> *rgb) {
+  std::stringstream ss(color);
+  int red = 0;
+  int green = 0;
+  int blue = 0;
+  char extra = '\0';
+
+  if (!(ss >> red >> green >> blue))
+    return false;
+  if (ss >> extra)
+    return false;
+  if (red < 0 || red > 255 || green < 0 || green > 255 || blue < 0 ||
+      blue > 255)
+    return false;
+
+  *rgb = {red, green, blue};
+  return true;
+}
+
+bool legacy_parse_hex_color(const std::string &hex, std::array<int, 3> *rgb) {
+  if (hex.size() != 6)
+    return false;
+
+  try {
+    (*rgb)[0] = std::stoi(hex.substr(0, 2), nullptr, 16);
+    (*rgb)[1] = std::stoi(hex.substr(2, 2), nullptr, 16);
+    (*rgb)[2] = std::stoi(hex.substr(4, 2), nullptr, 16);
+  } catch (...) {
+    return false;
+  }
+
+  return true;
+}
+
+size_t legacy_count_tokens(const std::string &command) {
+  std::stringstream ss(command);
+  std::string token;
+  size_t count = 0;
+  while (ss >> token)
+    ++count;
+  return count;
+}
+
+size_t count_tokens(std::string_view command) {
+  size_t count = 0;
+  while (!next_token(&command).empty())
+    ++count;
+  return count;
+}
+
+constexpr int kIterations = 200000;
+
+template <typename Fn> double nanoseconds_per_call(Fn &&fn) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kIterations; ++i)
+    fn(i);
+  std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / kIterations;
+}
+
+// Keeps results observable so the loops are not optimized away.
+volatile int sink = 0;
+
+void report(const char *name, double legacy_ns, double current_ns) {
+  std::printf("%-18s legacy %8.1f ns  current %8.1f ns  speedup %5.1fx\n",
+              name, legacy_ns, current_ns,
+              current_ns > 0 ? legacy_ns / current_ns : 0.0);
+}
+
+} // namespace
+
+int main() {
+  bool ok = true;
+
+  const std::vector<std::string> ints = {"0",   "255",  "-1",   "2000",
+                                         "abc", "12x",  "",     "+5",
+                                         "-0",  "6100", "9999999999"};
+  const std::vector<std::string> colors = {"0 0 0", "255 128 7", "12 34",
+                                           "1 2 3 4", "12 34 256", "a b c"};
+  const std::vector<std::string> hexes = {"FF8000", "00ff7f", "GG0000",
+                                          "12345", "abcdef"};
+  const std::vector<std::string> commands = {
+      "GET_FAN_SPEED 1", "SET_FAN_SPEED 2 4200",
+      "SET_KEYBOARD_ZONE_COLOR 3 255 0 128", "GET_FAN_MODE"};
+
+  for (const auto &value : ints) {
+    int legacy = 0;
+    int current = 0;
+    bool legacy_ok = legacy_parse_strict_int(value, &legacy);
+    bool current_ok = parse_strict_int(value, &current);
+    ok &= expect(legacy_ok == current_ok && (!legacy_ok || legacy == current),
+                 "integer parsers should agree");
+  }
+  for (const auto &value : colors) {
+    std::array<int, 3> legacy = {};
+    std::array<int, 3> current = {};
+    bool legacy_ok = legacy_parse_rgb_triplet(value, &legacy);
+    bool current_ok = parse_rgb_triplet(value, &current);
+    ok &= expect(legacy_ok == current_ok && (!legacy_ok || legacy == current),
+                 "rgb parsers should agree");
+  }
+  for (const auto &value : hexes) {
+    std::array<int, 3> legacy = {};
+    std::array<int, 3> current = {};
+    bool legacy_ok = legacy_parse_hex_color(value, &legacy);
+    bool current_ok = parse_hex_color(value, &current);
+    ok &= expect(legacy_ok == current_ok && (!legacy_ok || legacy == current),
+                 "hex parsers should agree");
+  }
+  for (const auto &command : commands)
+    ok &= expect(legacy_count_tokens(command) == count_tokens(command),
+                 "tokenizers should agree");
+
+  int value = 0;
+  std::array<int, 3> rgb = {};
+  report("parse_strict_int", nanoseconds_per_call([&](int i) {
+           sink = legacy_parse_strict_int(ints[i % ints.size()], &value);
+         }),
+         nanoseconds_per_call([&](int i) {
+           sink = parse_strict_int(ints[i % ints.size()], &value);
+         }));
+  report("parse_rgb_triplet", nanoseconds_per_call([&](int i) {
+           sink = legacy_parse_rgb_triplet(colors[i % colors.size()], &rgb);
+         }),
+         nanoseconds_per_call([&](int i) {
+           sink = parse_rgb_triplet(colors[i % colors.size()], &rgb);
+         }));
+  report("parse_hex_color", nanoseconds_per_call([&](int i) {
+           sink = legacy_parse_hex_color(hexes[i % hexes.size()], &rgb);
+         }),
+         nanoseconds_per_call([&](int i) {
+           sink = parse_hex_color(hexes[i % hexes.size()], &rgb);
+         }));
+  report("tokenize", nanoseconds_per_call([&](int i) {
+           sink = static_cast<int>(
+               legacy_count_tokens(commands[i % commands.size()]));
+         }),
+         nanoseconds_per_call([&](int i) {
+           sink = static_cast<int>(count_tokens(commands[i % commands.size()]));
+         }));
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,516 @@
+// victus-bench: load generator for the backend socket.
+//
+// Opens N connections, replays a weighted mix of commands on each for a fixed
+// time and reports throughput and latency percentiles per command. Frames are
+// the same u32 little-endian length prefix plus payload that
+// VictusSocketClient sends; with --depth above 1 each connection keeps that
+// many tagged ("#<tag> <command>") requests in flight.
+//
+// Point the backend at a fake sysfs tree to run this on any Linux machine.
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+#include "victus_commands.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr const char *kDefaultSocketPath =
+    "/run/victus-control/victus_backend.sock";
+constexpr size_t kFrameHeaderSize = 4;
+// Matches the backend's per-connection limit on tagged requests.
+constexpr size_t kMaxDepth = 16;
+
+// Reads only, plus a brightness write every so often to exercise the slow
+// lane and write coalescing.
+constexpr const char *kDefaultMix =
+    "GET_FAN_MODE:4,GET_FAN_SPEED 1:4,GET_CPU_TEMP:4,GET_KEYBOARD_COLOR:2,"
+    "GET_STATE_SINCE 0:2,SET_KBD_BRIGHTNESS 128:1";
+
+struct MixEntry {
+  std::string command;
+  unsigned weight;
+};
+
+struct Options {
+  std::string socket_path = kDefaultSocketPath;
+  size_t connections = 8;
+  size_t depth = 1;
+  std::chrono::duration<double> duration{10.0};
+  std::chrono::duration<double> warmup{1.0};
+  uint64_t seed = 1;
+  bool json = false;
+  std::vector<MixEntry> mix;
+};
+
+// What one connection measured, per mix entry.
+struct CommandStats {
+  std::vector<uint64_t> latencies_ns;
+  uint64_t errors = 0;
+};
+
+struct ConnectionResult {
+  std::vector<CommandStats> commands;
+  bool failed = false;
+  std::string failure;
+};
+
+void print_usage(const char *argv0) {
+  std::cerr
+      << "Usage: " << argv0 << " [options]\n"
+      << "  --socket PATH       backend socket (default " << kDefaultSocketPath
+      << ")\n"
+      << "  --connections N     concurrent connections (default 8)\n"
+      << "  --depth N           requests in flight per connection, 1-"
+      << kMaxDepth << "; above 1 uses tagged frames (default 1)\n"
+      << "  --duration SECONDS  measured run time (default 10)\n"
+      << "  --warmup SECONDS    unmeasured time before it (default 1)\n"
+      << "  --mix LIST          weighted commands, \"CMD:weight,...\"\n"
+      << "                      (default \"" << kDefaultMix << "\")\n"
+      << "  --seed N            command order seed (default 1)\n"
+      << "  --json              print the report as one JSON object\n";
+}
+
+template <typename T> bool parse_number(std::string_view text, T *value) {
+  auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), *value);
+  return ec == std::errc() && end == text.data() + text.size();
+}
+
+bool parse_seconds(const char *text, std::chrono::duration<double> *value) {
+  char *end = nullptr;
+  errno = 0;
+  double seconds = std::strtod(text, &end);
+  if (errno != 0 || end == text || *end != '\0' || seconds < 0)
+    return false;
+  *value = std::chrono::duration<double>(seconds);
+  return true;
+}
+
+// "CMD:weight,CMD:weight,..."; the weight defaults to 1.
+bool parse_mix(std::string_view text, std::vector<MixEntry> *mix) {
+  mix->clear();
+  while (!text.empty()) {
+    size_t comma = text.find(',');
+    std::string_view item = text.substr(0, comma);
+    text.remove_prefix(comma == std::string_view::npos ? text.size()
+                                                       : comma + 1);
+
+    unsigned weight = 1;
+    size_t colon = item.rfind(':');
+    if (colon != std::string_view::npos) {
+      if (!parse_number(item.substr(colon + 1), &weight))
+        return false;
+      item = item.substr(0, colon);
+    }
+    if (item.empty() || weight == 0)
+      return false;
+
+    std::string_view name = item.substr(0, item.find(' '));
+    if (!victus_find_command(name))
+      std::cerr << "warning: " << name << " is not a known command"
+                << std::endl;
+    mix->push_back({std::string(item), weight});
+  }
+  return !mix->empty();
+}
+
+bool parse_options(int argc, char **argv, Options *options) {
+  std::string mix = kDefaultMix;
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg = argv[i];
+    if (arg == "--json") {
+      options->json = true;
+      continue;
+    }
+    if (arg == "--help" || arg == "-h" || i + 1 >= argc)
+      return false;
+
+    const char *value = argv[++i];
+    bool valid = true;
+    if (arg == "--socket")
+      options->socket_path = value;
+    else if (arg == "--connections")
+      valid = parse_number(value, &options->connections) &&
+              options->connections > 0;
+    else if (arg == "--depth")
+      valid = parse_number(value, &options->depth) && options->depth > 0 &&
+              options->depth <= kMaxDepth;
+    else if (arg == "--duration")
+      valid = parse_seconds(value, &options->duration) &&
+              options->duration.count() > 0;
+    else if (arg == "--warmup")
+      valid = parse_seconds(value, &options->warmup);
+    else if (arg == "--seed")
+      valid = parse_number(value, &options->seed);
+    else if (arg == "--mix")
+      mix = value;
+    else
+      valid = false;
+
+    if (!valid) {
+      std::cerr << "Invalid value for " << arg << ": " << value << std::endl;
+      return false;
+    }
+  }
+
+  if (!parse_mix(mix, &options->mix)) {
+    std::cerr << "Invalid command mix: " << mix << std::endl;
+    return false;
+  }
+  return true;
+}
+
+int connect_backend(const std::string &path) {
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return -1;
+
+  sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+  if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+bool send_frame(int fd, std::string_view payload) {
+  char header[kFrameHeaderSize];
+  for (size_t i = 0; i < kFrameHeaderSize; ++i)
+    header[i] = static_cast<char>((payload.size() >> (8 * i)) & 0xFF);
+
+  iovec iov[2] = {{header, sizeof(header)},
+                  {const_cast<char *>(payload.data()), payload.size()}};
+  size_t remaining = sizeof(header) + payload.size();
+  msghdr msg = {};
+  msg.msg_iov = iov;
+  msg.msg_iovlen = 2;
+  while (remaining > 0) {
+    ssize_t sent = sendmsg(fd, &msg, MSG_NOSIGNAL);
+    if (sent < 0 && errno == EINTR)
+      continue;
+    if (sent <= 0)
+      return false;
+    remaining -= static_cast<size_t>(sent);
+    // Skip what went out; rare enough that rebuilding the iovec is fine.
+    size_t skip = static_cast<size_t>(sent);
+    while (skip > 0 && msg.msg_iovlen > 0) {
+      size_t take = std::min(skip, msg.msg_iov[0].iov_len);
+      msg.msg_iov[0].iov_base = static_cast<char *>(msg.msg_iov[0].iov_base) + take;
+      msg.msg_iov[0].iov_len -= take;
+      skip -= take;
+      if (msg.msg_iov[0].iov_len == 0) {
+        ++msg.msg_iov;
+        --msg.msg_iovlen;
+      }
+    }
+  }
+  return true;
+}
+
+bool read_exact(int fd, char *buffer, size_t length) {
+  while (length > 0) {
+    ssize_t got = recv(fd, buffer, length, 0);
+    if (got < 0 && errno == EINTR)
+      continue;
+    if (got <= 0)
+      return false;
+    buffer += got;
+    length -= static_cast<size_t>(got);
+  }
+  return true;
+}
+
+bool read_frame(int fd, std::string *payload) {
+  unsigned char header[kFrameHeaderSize];
+  if (!read_exact(fd, reinterpret_cast<char *>(header), sizeof(header)))
+    return false;
+  uint32_t length = static_cast<uint32_t>(header[0]) |
+                    (static_cast<uint32_t>(header[1]) << 8) |
+                    (static_cast<uint32_t>(header[2]) << 16) |
+                    (static_cast<uint32_t>(header[3]) << 24);
+  payload->resize(length);
+  return read_exact(fd, payload->data(), length);
+}
+
+bool is_error_reply(std::string_view reply) {
+  return reply.rfind("ERROR", 0) == 0;
+}
+
+class CommandPicker {
+public:
+  CommandPicker(const std::vector<MixEntry> &mix, uint64_t seed)
+      : random(seed) {
+    std::vector<unsigned> weights;
+    for (const auto &entry : mix)
+      weights.push_back(entry.weight);
+    distribution = std::discrete_distribution<size_t>(weights.begin(),
+                                                      weights.end());
+  }
+
+  size_t next() { return distribution(random); }
+
+private:
+  std::mt19937_64 random;
+  std::discrete_distribution<size_t> distribution;
+};
+
+// Closed loop: a new request goes out as soon as an answer comes back, until
+// the end of the run. Only requests sent after the warmup are measured.
+void run_connection(const Options &options, size_t index,
+                    Clock::time_point measure_from, Clock::time_point stop_at,
+                    ConnectionResult *result) {
+  result->commands.resize(options.mix.size());
+  int fd = connect_backend(options.socket_path);
+  if (fd < 0) {
+    result->failed = true;
+    result->failure = std::string("connect: ") + std::strerror(errno);
+    return;
+  }
+
+  CommandPicker picker(options.mix, options.seed + index);
+  bool tagged = options.depth > 1;
+  struct InFlight {
+    size_t command;
+    Clock::time_point sent_at;
+  };
+  std::unordered_map<uint64_t, InFlight> in_flight;
+  uint64_t next_tag = 1;
+  std::string frame;
+  std::string reply;
+
+  auto send_next = [&]() {
+    size_t command = picker.next();
+    uint64_t tag = next_tag++;
+    if (tagged)
+      frame = "#" + std::to_string(tag) + " " + options.mix[command].command;
+    in_flight[tag] = {command, Clock::now()};
+    return send_frame(fd, tagged ? std::string_view(frame)
+                                 : std::string_view(options.mix[command].command));
+  };
+
+  bool ok = true;
+  for (size_t i = 0; i < options.depth && ok; ++i)
+    ok = send_next();
+
+  while (ok && !in_flight.empty()) {
+    if (!read_frame(fd, &reply)) {
+      ok = false;
+      break;
+    }
+    auto now = Clock::now();
+
+    uint64_t tag = next_tag - 1;
+    std::string_view body = reply;
+    if (tagged) {
+      size_t space = body.find(' ');
+      if (body.empty() || body[0] != '#' || space == std::string_view::npos ||
+          !parse_number(body.substr(1, space - 1), &tag)) {
+        result->failure = "unexpected reply: " + reply;
+        ok = false;
+        break;
+      }
+      body.remove_prefix(space + 1);
+    }
+
+    auto it = in_flight.find(tag);
+    if (it == in_flight.end()) {
+      result->failure = "reply for an unknown tag: " + reply;
+      ok = false;
+      break;
+    }
+    if (it->second.sent_at >= measure_from) {
+      CommandStats &stats = result->commands[it->second.command];
+      stats.latencies_ns.push_back(static_cast<uint64_t>(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+              now - it->second.sent_at)
+              .count()));
+      if (is_error_reply(body))
+        ++stats.errors;
+    }
+    in_flight.erase(it);
+
+    if (now < stop_at)
+      ok = send_next();
+  }
+
+  if (!ok) {
+    result->failed = true;
+    if (result->failure.empty())
+      result->failure = "connection closed by the backend";
+  }
+  close(fd);
+}
+
+struct Summary {
+  std::string command;
+  uint64_t count = 0;
+  uint64_t errors = 0;
+  double per_second = 0;
+  double p50_us = 0;
+  double p99_us = 0;
+  double p999_us = 0;
+  double max_us = 0;
+};
+
+// Nearest-rank percentile of sorted samples.
+double percentile_us(const std::vector<uint64_t> &sorted, double fraction) {
+  if (sorted.empty())
+    return 0;
+  size_t rank = static_cast<size_t>(fraction * static_cast<double>(sorted.size()));
+  return static_cast<double>(sorted[std::min(rank, sorted.size() - 1)]) / 1000.0;
+}
+
+Summary summarize(std::string command, std::vector<uint64_t> latencies,
+                  uint64_t errors, double seconds) {
+  std::sort(latencies.begin(), latencies.end());
+  Summary summary;
+  summary.command = std::move(command);
+  summary.count = latencies.size();
+  summary.errors = errors;
+  summary.per_second = static_cast<double>(latencies.size()) / seconds;
+  summary.p50_us = percentile_us(latencies, 0.50);
+  summary.p99_us = percentile_us(latencies, 0.99);
+  summary.p999_us = percentile_us(latencies, 0.999);
+  summary.max_us = latencies.empty() ? 0 : static_cast<double>(latencies.back()) / 1000.0;
+  return summary;
+}
+
+std::string json_string(std::string_view text) {
+  std::string out = "\"";
+  for (char c : text) {
+    if (c == '"' || c == '\\')
+      out += '\\';
+    out += c;
+  }
+  return out + "\"";
+}
+
+void print_json(const Options &options, const std::vector<Summary> &summaries,
+                const Summary &total) {
+  auto object = [](const Summary &s) {
+    char numbers[256];
+    std::snprintf(numbers, sizeof(numbers),
+                  "\"count\":%llu,\"errors\":%llu,\"per_second\":%.1f,"
+                  "\"p50_us\":%.1f,\"p99_us\":%.1f,\"p999_us\":%.1f,"
+                  "\"max_us\":%.1f}",
+                  static_cast<unsigned long long>(s.count),
+                  static_cast<unsigned long long>(s.errors), s.per_second,
+                  s.p50_us, s.p99_us, s.p999_us, s.max_us);
+    return "{\"command\":" + json_string(s.command) + "," + numbers;
+  };
+
+  std::cout << "{\"connections\":" << options.connections
+            << ",\"depth\":" << options.depth
+            << ",\"duration_s\":" << options.duration.count()
+            << ",\"total\":" << object(total) << ",\"commands\":[";
+  for (size_t i = 0; i < summaries.size(); ++i)
+    std::cout << (i ? "," : "") << object(summaries[i]);
+  std::cout << "]}" << std::endl;
+}
+
+void print_table(const Options &options, const std::vector<Summary> &summaries,
+                 const Summary &total) {
+  std::printf("%zu connections, depth %zu, %.1f s measured\n\n",
+              options.connections, options.depth, options.duration.count());
+  std::printf("%-28s %9s %9s %7s %9s %9s %9s %9s\n", "command", "count",
+              "req/s", "errors", "p50 us", "p99 us", "p99.9 us", "max us");
+  auto row = [](const Summary &s) {
+    std::printf("%-28s %9llu %9.0f %7llu %9.1f %9.1f %9.1f %9.1f\n",
+                s.command.c_str(), static_cast<unsigned long long>(s.count),
+                s.per_second, static_cast<unsigned long long>(s.errors),
+                s.p50_us, s.p99_us, s.p999_us, s.max_us);
+  };
+  for (const auto &summary : summaries)
+    row(summary);
+  row(total);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parse_options(argc, argv, &options)) {
+    print_usage(argv[0]);
+    return 2;
+  }
+
+  auto start = Clock::now();
+  auto measure_from =
+      start + std::chrono::duration_cast<Clock::duration>(options.warmup);
+  auto stop_at =
+      measure_from + std::chrono::duration_cast<Clock::duration>(options.duration);
+
+  std::vector<ConnectionResult> results(options.connections);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < options.connections; ++i)
+    threads.emplace_back(run_connection, std::cref(options), i, measure_from,
+                         stop_at, &results[i]);
+  for (auto &thread : threads)
+    thread.join();
+
+  size_t failed = 0;
+  for (const auto &result : results) {
+    if (result.failed) {
+      if (failed++ == 0)
+        std::cerr << "victus-bench: " << result.failure << std::endl;
+    }
+  }
+  if (failed == results.size()) {
+    std::cerr << "victus-bench: no connection completed against "
+              << options.socket_path << std::endl;
+    return 1;
+  }
+  if (failed > 0)
+    std::cerr << "victus-bench: " << failed << " of " << results.size()
+              << " connections failed" << std::endl;
+
+  double seconds = options.duration.count();
+  std::vector<Summary> summaries;
+  std::vector<uint64_t> all_latencies;
+  uint64_t all_errors = 0;
+  for (size_t command = 0; command < options.mix.size(); ++command) {
+    std::vector<uint64_t> latencies;
+    uint64_t errors = 0;
+    for (const auto &result : results) {
+      const CommandStats &stats = result.commands[command];
+      latencies.insert(latencies.end(), stats.latencies_ns.begin(),
+                       stats.latencies_ns.end());
+      errors += stats.errors;
+    }
+    all_latencies.insert(all_latencies.end(), latencies.begin(),
+                         latencies.end());
+    all_errors += errors;
+    summaries.push_back(summarize(options.mix[command].command,
+                                  std::move(latencies), errors, seconds));
+  }
+  Summary total =
+      summarize("total", std::move(all_latencies), all_errors, seconds);
+
+  if (options.json)
+    print_json(options, summaries, total);
+  else
+    print_table(options, summaries, total);
+  return failed > 0 ? 1 : 0;
+}
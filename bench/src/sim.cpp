@@ -0,0 +1,455 @@
+// victus-sim: a simulated hp-wmi laptop under a fake sysfs root.
+//
+// Builds the files the backend reads below --root and keeps them moving:
+//
+//   sys/devices/platform/hp-wmi/hwmon/hwmon0/   fan{1,2}_{input,target,max},
+//                                               pwm1_enable
+//   sys/devices/platform/hp-wmi/rgb_zones/      zone00..zone03
+//   sys/class/leds/hp::kbd_backlight/           brightness, multi_intensity
+//   sys/class/hwmon/hwmon1/                     coretemp, temp1_input
+//   sys/class/hwmon/hwmon2/                     amdgpu, temp1_input
+//   sys/class/drm/card0/device/gpu_busy_percent
+//   proc/stat
+//
+// Fans follow their target with a first-order lag (spin-up is faster than
+// spin-down), and pwm1_enable falls back to automatic (2) when it has not been
+// rewritten for --revert seconds, like the firmware does. Temperatures and
+// utilisation follow a load script of "<seconds> <cpu %> [<gpu %>]" lines,
+// held until the next line's time, and the more the fans spin the lower the
+// temperatures settle. With --trace every tick is appended as a CSV row so
+// the control loop's latency and accuracy can be compared between builds.
+//
+// Run the backend with VICTUS_SYSFS_ROOT=<root> (and VICTUS_HELPER_DIR
+// pointing at backend/src for the set-*.sh helpers) to drive it.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <vector>
+
+namespace {
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+constexpr int kFanCount = 2;
+constexpr int kFanMax[kFanCount] = {5800, 6100};
+// Firmware curve for pwm1_enable=2: RPM fraction of max by CPU temperature.
+constexpr double kAutoCurveStartC = 45.0;
+constexpr double kAutoCurveFullC = 90.0;
+constexpr double kSpinUpSeconds = 1.5;
+constexpr double kSpinDownSeconds = 4.0;
+constexpr double kAmbientC = 35.0;
+// Steady-state temperature rise at full load with the fans stopped, and how
+// much a fan at full speed divides it by.
+constexpr double kCpuHeatC = 70.0;
+constexpr double kGpuHeatC = 55.0;
+constexpr double kFanCooling = 1.2;
+constexpr double kThermalSeconds = 6.0;
+constexpr int kCpuCount = 8;
+constexpr int kJiffiesPerSecond = 100;
+
+std::atomic<bool> running{true};
+
+void stop(int) { running.store(false); }
+
+struct LoadStep {
+  double at_seconds;
+  double cpu_pct;
+  double gpu_pct;
+};
+
+struct Options {
+  fs::path root;
+  std::string load_script;
+  fs::path trace;
+  std::chrono::milliseconds tick{100};
+  double revert_seconds = 120.0;
+  double duration_seconds = 0; // 0 runs until SIGINT/SIGTERM
+  bool loop = false;
+  bool four_zone = true;
+  uint64_t seed = 1;
+};
+
+void print_usage(const char *argv0) {
+  std::cerr
+      << "Usage: " << argv0 << " --root DIR [options]\n"
+      << "  --load FILE        load script, \"<seconds> <cpu %> [<gpu %>]\" "
+         "per line (default: 20% CPU)\n"
+      << "  --loop             restart the load script when it ends\n"
+      << "  --tick MS          simulation step (default 100)\n"
+      << "  --revert SECONDS   manual mode timeout of the firmware (default "
+         "120, 0 disables)\n"
+      << "  --duration SECONDS stop after this long (default: run until "
+         "interrupted)\n"
+      << "  --keyboard TYPE    four-zone or single-zone (default four-zone)\n"
+      << "  --trace FILE       append one CSV row per tick\n"
+      << "  --seed N           sensor noise seed (default 1)\n";
+}
+
+bool parse_options(int argc, char **argv, Options *options) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--loop") {
+      options->loop = true;
+      continue;
+    }
+    if (i + 1 >= argc)
+      return false;
+    std::string value = argv[++i];
+    try {
+      if (arg == "--root")
+        options->root = value;
+      else if (arg == "--load")
+        options->load_script = value;
+      else if (arg == "--trace")
+        options->trace = value;
+      else if (arg == "--tick")
+        options->tick = std::chrono::milliseconds(std::stoi(value));
+      else if (arg == "--revert")
+        options->revert_seconds = std::stod(value);
+      else if (arg == "--duration")
+        options->duration_seconds = std::stod(value);
+      else if (arg == "--seed")
+        options->seed = std::stoull(value);
+      else if (arg == "--keyboard" &&
+               (value == "four-zone" || value == "single-zone"))
+        options->four_zone = value == "four-zone";
+      else
+        return false;
+    } catch (const std::exception &) {
+      return false;
+    }
+  }
+  return !options->root.empty() && options->tick.count() > 0;
+}
+
+bool load_steps(const std::string &path, std::vector<LoadStep> *steps) {
+  steps->clear();
+  if (path.empty()) {
+    steps->push_back({0, 20, 5});
+    return true;
+  }
+
+  std::ifstream file(path);
+  if (!file)
+    return false;
+  std::string line;
+  while (std::getline(file, line)) {
+    line = line.substr(0, line.find('#'));
+    std::istringstream fields(line);
+    LoadStep step = {0, 0, 0};
+    if (!(fields >> step.at_seconds))
+      continue;
+    if (!(fields >> step.cpu_pct))
+      return false;
+    fields >> step.gpu_pct;
+    steps->push_back(step);
+  }
+  std::sort(steps->begin(), steps->end(),
+            [](const LoadStep &a, const LoadStep &b) {
+              return a.at_seconds < b.at_seconds;
+            });
+  return !steps->empty();
+}
+
+const LoadStep &step_at(const std::vector<LoadStep> &steps, double seconds,
+                        bool loop) {
+  double length = steps.back().at_seconds;
+  if (loop && length > 0)
+    seconds = std::fmod(seconds, length);
+  const LoadStep *current = &steps.front();
+  for (const auto &step : steps) {
+    if (step.at_seconds > seconds)
+      break;
+    current = &step;
+  }
+  return *current;
+}
+
+// Sensor files are replaced whole so the backend never reads a partial value.
+void publish(const fs::path &path, const std::string &value) {
+  fs::path temporary = path;
+  temporary += ".tmp";
+  {
+    std::ofstream file(temporary, std::ios::trunc);
+    file << value << "\n";
+  }
+  fs::rename(temporary, path);
+}
+
+// Files the backend writes are only created once, so its writes land in them.
+void create(const fs::path &path, const std::string &value) {
+  fs::create_directories(path.parent_path());
+  std::ofstream file(path, std::ios::trunc);
+  file << value << "\n";
+}
+
+bool read_int(const fs::path &path, int *value) {
+  std::ifstream file(path);
+  return file && (file >> *value);
+}
+
+// Modification time of a file the backend writes; a rewrite of the same
+// value still counts as the keep-alive the firmware expects.
+long long modification_stamp(const fs::path &path) {
+  struct stat info;
+  if (stat(path.c_str(), &info) < 0)
+    return 0;
+  return static_cast<long long>(info.st_mtim.tv_sec) * 1000000000 +
+         info.st_mtim.tv_nsec;
+}
+
+class Laptop {
+public:
+  explicit Laptop(const Options &options)
+      : options(options), noise(options.seed),
+        hwmon(options.root / "sys/devices/platform/hp-wmi/hwmon/hwmon0"),
+        cpu_hwmon(options.root / "sys/class/hwmon/hwmon1"),
+        gpu_hwmon(options.root / "sys/class/hwmon/hwmon2"),
+        gpu_busy(options.root / "sys/class/drm/card0/device/gpu_busy_percent"),
+        proc_stat(options.root / "proc/stat") {}
+
+  void build() {
+    create(hwmon / "name", "hp");
+    create(hwmon / "pwm1_enable", "2");
+    for (int i = 0; i < kFanCount; ++i) {
+      std::string fan = "fan" + std::to_string(i + 1);
+      create(hwmon / (fan + "_max"), std::to_string(kFanMax[i]));
+      create(hwmon / (fan + "_target"), "0");
+      create(hwmon / (fan + "_input"), "0");
+    }
+
+    if (options.four_zone) {
+      for (int zone = 0; zone < 4; ++zone)
+        create(options.root / "sys/devices/platform/hp-wmi/rgb_zones" /
+                   ("zone0" + std::to_string(zone)),
+               "FFFFFF");
+    }
+    fs::path leds = options.root / "sys/class/leds/hp::kbd_backlight";
+    create(leds / "brightness", "255");
+    create(leds / "max_brightness", "255");
+    create(leds / "multi_intensity", "255 255 255");
+
+    create(cpu_hwmon / "name", "coretemp");
+    create(cpu_hwmon / "temp1_label", "Package id 0");
+    create(cpu_hwmon / "temp1_input", "0");
+    create(gpu_hwmon / "name", "amdgpu");
+    create(gpu_hwmon / "temp1_label", "edge");
+    create(gpu_hwmon / "temp1_input", "0");
+    create(gpu_busy, "0");
+    create(proc_stat, "");
+
+    pwm_stamp = modification_stamp(hwmon / "pwm1_enable");
+    pwm_written_at = Clock::now();
+    write_sensors();
+  }
+
+  void step(double elapsed, double dt, const LoadStep &load) {
+    track_mode();
+
+    for (int i = 0; i < kFanCount; ++i) {
+      double target = fan_target(i);
+      double tau = target > rpm[i] ? kSpinUpSeconds : kSpinDownSeconds;
+      rpm[i] += (target - rpm[i]) * (1.0 - std::exp(-dt / tau));
+    }
+
+    double airflow = (rpm[0] / kFanMax[0] + rpm[1] / kFanMax[1]) / 2.0;
+    double cooling = 1.0 + kFanCooling * airflow;
+    double cpu_settle = kAmbientC + kCpuHeatC * load.cpu_pct / 100.0 / cooling;
+    double gpu_settle = kAmbientC + kGpuHeatC * load.gpu_pct / 100.0 / cooling;
+    double blend = 1.0 - std::exp(-dt / kThermalSeconds);
+    cpu_c += (cpu_settle - cpu_c) * blend;
+    gpu_c += (gpu_settle - gpu_c) * blend;
+    gpu_pct = load.gpu_pct;
+
+    double jiffies = dt * kJiffiesPerSecond * kCpuCount;
+    busy_jiffies += jiffies * load.cpu_pct / 100.0;
+    idle_jiffies += jiffies * (1.0 - load.cpu_pct / 100.0);
+
+    write_sensors();
+    if (trace)
+      write_trace(elapsed, load);
+  }
+
+  void open_trace(const fs::path &path) {
+    bool fresh = !fs::exists(path);
+    trace.open(path, std::ios::app);
+    if (fresh)
+      trace << "seconds,pwm1_enable,fan1_target,fan1_input,fan2_target,"
+               "fan2_input,cpu_load,gpu_load,cpu_temp,gpu_temp,reverts\n";
+  }
+
+  int reverts() const { return revert_count; }
+
+private:
+  // Any rewrite of pwm1_enable or a target keeps manual mode alive.
+  void track_mode() {
+    auto now = Clock::now();
+    auto stamp = std::max({modification_stamp(hwmon / "pwm1_enable"),
+                           modification_stamp(hwmon / "fan1_target"),
+                           modification_stamp(hwmon / "fan2_target")});
+    if (stamp != pwm_stamp) {
+      pwm_stamp = stamp;
+      pwm_written_at = now;
+    }
+
+    int value = mode;
+    if (read_int(hwmon / "pwm1_enable", &value) && value >= 0 && value <= 2)
+      mode = value;
+
+    double idle = std::chrono::duration<double>(now - pwm_written_at).count();
+    if (mode == 1 && options.revert_seconds > 0 &&
+        idle >= options.revert_seconds) {
+      mode = 2;
+      ++revert_count;
+      std::cout << "victus-sim: manual mode timed out; firmware back to "
+                   "automatic"
+                << std::endl;
+      std::ofstream(hwmon / "pwm1_enable", std::ios::trunc) << "2\n";
+      pwm_stamp = modification_stamp(hwmon / "pwm1_enable");
+    }
+  }
+
+  double fan_target(int index) {
+    switch (mode) {
+    case 0:
+      return kFanMax[index];
+    case 1: {
+      int target = 0;
+      read_int(hwmon / ("fan" + std::to_string(index + 1) + "_target"),
+               &target);
+      return std::clamp(target, 0, kFanMax[index]);
+    }
+    default: {
+      double fraction = (cpu_c - kAutoCurveStartC) /
+                        (kAutoCurveFullC - kAutoCurveStartC);
+      return kFanMax[index] * std::clamp(fraction, 0.25, 1.0);
+    }
+    }
+  }
+
+  int jitter(double value, double spread) {
+    std::normal_distribution<double> distribution(0.0, spread);
+    return static_cast<int>(std::lround(value + distribution(noise)));
+  }
+
+  void write_sensors() {
+    for (int i = 0; i < kFanCount; ++i) {
+      int measured = rpm[i] < 1 ? 0 : std::max(0, jitter(rpm[i], 15.0));
+      publish(hwmon / ("fan" + std::to_string(i + 1) + "_input"),
+              std::to_string(measured));
+    }
+    publish(cpu_hwmon / "temp1_input", std::to_string(jitter(cpu_c * 1000, 150)));
+    publish(gpu_hwmon / "temp1_input", std::to_string(jitter(gpu_c * 1000, 150)));
+    publish(gpu_busy, std::to_string(static_cast<int>(std::lround(gpu_pct))));
+
+    // user nice system idle iowait irq softirq steal
+    char line[160];
+    std::snprintf(line, sizeof(line), "cpu  %llu 0 0 %llu 0 0 0 0",
+                  static_cast<unsigned long long>(busy_jiffies),
+                  static_cast<unsigned long long>(idle_jiffies));
+    publish(proc_stat, line);
+  }
+
+  void write_trace(double elapsed, const LoadStep &load) {
+    int targets[kFanCount] = {0, 0};
+    for (int i = 0; i < kFanCount; ++i)
+      read_int(hwmon / ("fan" + std::to_string(i + 1) + "_target"),
+               &targets[i]);
+    char row[256];
+    std::snprintf(row, sizeof(row),
+                  "%.3f,%d,%d,%.0f,%d,%.0f,%.0f,%.0f,%.2f,%.2f,%d\n", elapsed,
+                  mode, targets[0], rpm[0], targets[1], rpm[1], load.cpu_pct,
+                  load.gpu_pct, cpu_c, gpu_c, revert_count);
+    trace << row << std::flush;
+  }
+
+  const Options &options;
+  std::mt19937_64 noise;
+  fs::path hwmon;
+  fs::path cpu_hwmon;
+  fs::path gpu_hwmon;
+  fs::path gpu_busy;
+  fs::path proc_stat;
+  std::ofstream trace;
+
+  int mode = 2;
+  long long pwm_stamp = 0;
+  Clock::time_point pwm_written_at;
+  int revert_count = 0;
+  double rpm[kFanCount] = {0, 0};
+  double cpu_c = kAmbientC;
+  double gpu_c = kAmbientC;
+  double gpu_pct = 0;
+  double busy_jiffies = 0;
+  double idle_jiffies = 0;
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parse_options(argc, argv, &options)) {
+    print_usage(argv[0]);
+    return 2;
+  }
+
+  std::vector<LoadStep> steps;
+  if (!load_steps(options.load_script, &steps)) {
+    std::cerr << "victus-sim: cannot read load script " << options.load_script
+              << std::endl;
+    return 1;
+  }
+
+  Laptop laptop(options);
+  try {
+    laptop.build();
+    if (!options.trace.empty())
+      laptop.open_trace(options.trace);
+  } catch (const fs::filesystem_error &error) {
+    std::cerr << "victus-sim: " << error.what() << std::endl;
+    return 1;
+  }
+
+  std::signal(SIGINT, stop);
+  std::signal(SIGTERM, stop);
+  std::cout << "victus-sim: simulating under " << options.root.string()
+            << std::endl;
+
+  auto start = Clock::now();
+  auto next_tick = start;
+  auto previous = start;
+  while (running.load()) {
+    next_tick += options.tick;
+    std::this_thread::sleep_until(next_tick);
+    auto now = Clock::now();
+    double elapsed = std::chrono::duration<double>(now - start).count();
+    double dt = std::chrono::duration<double>(now - previous).count();
+    previous = now;
+
+    try {
+      laptop.step(elapsed, dt, step_at(steps, elapsed, options.loop));
+    } catch (const fs::filesystem_error &error) {
+      std::cerr << "victus-sim: " << error.what() << std::endl;
+      return 1;
+    }
+    if (options.duration_seconds > 0 && elapsed >= options.duration_seconds)
+      break;
+  }
+
+  std::cout << "victus-sim: stopped, " << laptop.reverts()
+            << " manual mode timeouts" << std::endl;
+  return 0;
+}
@@ -0,0 +1,161 @@
+#ifndef VICTUS_CLIENT_H
+#define VICTUS_CLIENT_H
+
+#include <stddef.h>
+
+/*
+ * libvictus-client: talks to victus-backend over its control socket.
+ *
+ * One victus_client owns one connection, opened on the first call and
+ * reopened on the next call after the backend goes away. Calls from any
+ * number of threads share it: each request is a tagged frame, so replies
+ * come back in whatever order the backend finishes them and a slow
+ * SET_FAN_SPEED does not hold up a GET_FAN_MODE issued after it. Backends
+ * that predate tagged frames are spoken to one request at a time.
+ *
+ * Blocking calls return when the reply is in. Asynchronous calls and
+ * telemetry subscriptions run their callbacks only from
+ * victus_client_dispatch(), on the thread that calls it; the descriptor from
+ * victus_client_get_fd() becomes readable when there is something to
+ * dispatch. From a GLib main loop:
+ *
+ *   g_unix_fd_add(victus_client_get_fd(client), G_IO_IN, on_ready, client);
+ *   // on_ready: victus_client_dispatch(client); return G_SOURCE_CONTINUE;
+ *
+ * Functions returning int give VICTUS_CLIENT_OK or a negative
+ * VICTUS_CLIENT_E* code; victus_client_last_error() has the message for the
+ * calling thread's last failure, including the backend's "ERROR: ..." text.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+#define VICTUS_CLIENT_API __attribute__((visibility("default")))
+#else
+#define VICTUS_CLIENT_API
+#endif
+
+#define VICTUS_CLIENT_DEFAULT_SOCKET "/run/victus-control/victus_backend.sock"
+
+enum {
+  VICTUS_CLIENT_OK = 0,
+  VICTUS_CLIENT_ECONNECT = -1, /* backend not running or socket unreachable */
+  VICTUS_CLIENT_EIO = -2,      /* connection dropped mid-request */
+  VICTUS_CLIENT_EBACKEND = -3, /* backend replied "ERROR: ..." */
+  VICTUS_CLIENT_EPROTO = -4,   /* reply did not parse */
+  VICTUS_CLIENT_EINVAL = -5,   /* bad argument */
+};
+
+typedef enum {
+  VICTUS_FAN_MODE_AUTO = 0,
+  VICTUS_FAN_MODE_MANUAL = 1,
+  VICTUS_FAN_MODE_MAX = 2,
+  VICTUS_FAN_MODE_BETTER_AUTO = 3,
+} victus_fan_mode;
+
+typedef enum {
+  VICTUS_KEYBOARD_SINGLE_ZONE = 0,
+  VICTUS_KEYBOARD_FOUR_ZONE = 1,
+} victus_keyboard_type;
+
+typedef struct victus_client victus_client;
+
+/* `reply` is NUL-terminated and only valid during the call. */
+typedef void (*victus_reply_cb)(const char *reply, void *user_data);
+/* One reply per command, in the order they were given. */
+typedef void (*victus_batch_cb)(size_t count, const char *const *replies,
+                                void *user_data);
+/* One TELEMETRY frame as parallel key and value arrays ("fan1", "2450"). */
+typedef void (*victus_telemetry_cb)(size_t count, const char *const *keys,
+                                    const char *const *values,
+                                    void *user_data);
+
+/* NULL means VICTUS_CLIENT_DEFAULT_SOCKET. Does not connect yet. */
+VICTUS_CLIENT_API victus_client *victus_client_new(const char *socket_path);
+/* Fails outstanding requests; their callbacks are not run. */
+VICTUS_CLIENT_API void victus_client_free(victus_client *client);
+
+/* Thread-local; valid until the thread's next failing call. */
+VICTUS_CLIENT_API const char *victus_client_last_error(void);
+
+/* Frees a string or array returned by this library. */
+VICTUS_CLIENT_API void victus_client_free_string(char *text);
+VICTUS_CLIENT_API void victus_client_free_strings(char **texts, size_t count);
+
+/* "GET_FAN_SPEED 1" -> *reply = "2450". The reply is returned even when it
+ * is an "ERROR: ..." (with VICTUS_CLIENT_EBACKEND). */
+VICTUS_CLIENT_API int victus_client_call(victus_client *client,
+                                         const char *command, char **reply);
+
+/* Sends every command in one BATCH frame; *replies gets `count` strings. */
+VICTUS_CLIENT_API int victus_client_batch(victus_client *client,
+                                          const char *const *commands,
+                                          size_t count, char ***replies);
+
+/* A failure to send is reported through the callback as an "ERROR: ..."
+ * reply, so the callback always runs exactly once. */
+VICTUS_CLIENT_API int victus_client_call_async(victus_client *client,
+                                               const char *command,
+                                               victus_reply_cb callback,
+                                               void *user_data);
+VICTUS_CLIENT_API int victus_client_batch_async(victus_client *client,
+                                                const char *const *commands,
+                                                size_t count,
+                                                victus_batch_cb callback,
+                                                void *user_data);
+
+/* Pushes from SUBSCRIBE on a connection of their own, reopened in the
+ * background if the backend restarts. `topics` is "fan,mode,temp,level" or a
+ * subset, `interval_seconds` 1-3600. Returns a subscription id (> 0). */
+VICTUS_CLIENT_API int victus_client_subscribe(victus_client *client,
+                                              const char *topics,
+                                              int interval_seconds,
+                                              victus_telemetry_cb callback,
+                                              void *user_data);
+VICTUS_CLIENT_API void victus_client_unsubscribe(victus_client *client,
+                                                 int subscription);
+
+/* Readable while callbacks are waiting; do not read or close it. */
+VICTUS_CLIENT_API int victus_client_get_fd(victus_client *client);
+/* Runs the waiting callbacks; returns how many ran. */
+VICTUS_CLIENT_API int victus_client_dispatch(victus_client *client);
+
+/* Typed accessors; blocking. Fans are 1 and 2, zones 0-3. */
+VICTUS_CLIENT_API int victus_client_get_fan_speed(victus_client *client,
+                                                  int fan, int *rpm);
+VICTUS_CLIENT_API int victus_client_get_fan_max_speed(victus_client *client,
+                                                      int fan, int *rpm);
+VICTUS_CLIENT_API int victus_client_set_fan_speed(victus_client *client,
+                                                  int fan, int rpm);
+VICTUS_CLIENT_API int victus_client_get_fan_mode(victus_client *client,
+                                                 victus_fan_mode *mode);
+VICTUS_CLIENT_API int victus_client_set_fan_mode(victus_client *client,
+                                                 victus_fan_mode mode);
+VICTUS_CLIENT_API int victus_client_get_cpu_temp(victus_client *client,
+                                                 int *celsius);
+VICTUS_CLIENT_API int victus_client_get_keyboard_type(
+    victus_client *client, victus_keyboard_type *type);
+/* rgb is {red, green, blue}, 0-255 each. */
+VICTUS_CLIENT_API int victus_client_get_keyboard_color(victus_client *client,
+                                                       int rgb[3]);
+VICTUS_CLIENT_API int victus_client_set_keyboard_color(victus_client *client,
+                                                       const int rgb[3]);
+VICTUS_CLIENT_API int victus_client_get_keyboard_zone_color(
+    victus_client *client, int zone, int rgb[3]);
+VICTUS_CLIENT_API int victus_client_set_keyboard_zone_color(
+    victus_client *client, int zone, const int rgb[3]);
+VICTUS_CLIENT_API int victus_client_get_keyboard_brightness(
+    victus_client *client, int *brightness);
+VICTUS_CLIENT_API int victus_client_set_keyboard_brightness(
+    victus_client *client, int brightness);
+
+/* Name of a fan mode as the backend spells it ("BETTER_AUTO"). */
+VICTUS_CLIENT_API const char *victus_fan_mode_name(victus_fan_mode mode);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* VICTUS_CLIENT_H */
@@ -0,0 +1,932 @@
+#include "victus_client.h"
+
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+#include "victus_commands.hpp"
+
+namespace {
+
+// STATS and TRACE dump replies run well past a page.
+constexpr uint32_t kMaxReplyLength = 16 * 1024 * 1024;
+constexpr std::chrono::seconds kResubscribeDelay{2};
+
+thread_local std::string last_error;
+
+int fail(int code, std::string message) {
+  last_error = std::move(message);
+  return code;
+}
+
+// Status of a reply as seen by the transport; the text is the backend's
+// reply or an "ERROR: ..." made up here.
+using Completion = std::function<void(int status, std::string reply)>;
+
+int status_of(std::string_view reply) {
+  return reply.rfind("ERROR", 0) == 0 ? VICTUS_CLIENT_EBACKEND
+                                      : VICTUS_CLIENT_OK;
+}
+
+bool send_all(int fd, const char *data, size_t length) {
+  while (length > 0) {
+    ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+    if (sent < 0 && errno == EINTR)
+      continue;
+    if (sent < 1)
+      return false;
+    data += sent;
+    length -= static_cast<size_t>(sent);
+  }
+  return true;
+}
+
+bool read_all(int fd, char *data, size_t length) {
+  while (length > 0) {
+    ssize_t got = recv(fd, data, length, 0);
+    if (got < 0 && errno == EINTR)
+      continue;
+    if (got < 1)
+      return false;
+    data += got;
+    length -= static_cast<size_t>(got);
+  }
+  return true;
+}
+
+// The length header and the payload go out in one sendmsg.
+bool send_frame(int fd, std::string_view payload) {
+  unsigned char header[4] = {
+      static_cast<unsigned char>(payload.size() & 0xFF),
+      static_cast<unsigned char>((payload.size() >> 8) & 0xFF),
+      static_cast<unsigned char>((payload.size() >> 16) & 0xFF),
+      static_cast<unsigned char>((payload.size() >> 24) & 0xFF),
+  };
+  iovec iov[2] = {{header, sizeof(header)},
+                  {const_cast<char *>(payload.data()), payload.size()}};
+  msghdr msg = {};
+  msg.msg_iov = iov;
+  msg.msg_iovlen = 2;
+
+  ssize_t result;
+  do {
+    result = sendmsg(fd, &msg, MSG_NOSIGNAL);
+  } while (result < 0 && errno == EINTR);
+  if (result < 0)
+    return false;
+
+  size_t sent = static_cast<size_t>(result);
+  if (sent < sizeof(header) &&
+      !send_all(fd, reinterpret_cast<char *>(header) + sent,
+                sizeof(header) - sent))
+    return false;
+  size_t payload_sent = sent > sizeof(header) ? sent - sizeof(header) : 0;
+  return send_all(fd, payload.data() + payload_sent,
+                  payload.size() - payload_sent);
+}
+
+bool read_frame(int fd, std::string *payload) {
+  unsigned char header[4];
+  if (!read_all(fd, reinterpret_cast<char *>(header), sizeof(header)))
+    return false;
+  uint32_t length = static_cast<uint32_t>(header[0]) |
+                    (static_cast<uint32_t>(header[1]) << 8) |
+                    (static_cast<uint32_t>(header[2]) << 16) |
+                    (static_cast<uint32_t>(header[3]) << 24);
+  if (length > kMaxReplyLength)
+    return false;
+
+  payload->resize(length);
+  return read_all(fd, payload->data(), length);
+}
+
+int open_backend_socket(const std::string &path) {
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd == -1)
+    return -1;
+
+  sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+  if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == -1) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+char *copy_string(std::string_view text) {
+  char *copy = static_cast<char *>(std::malloc(text.size() + 1));
+  if (copy) {
+    std::memcpy(copy, text.data(), text.size());
+    copy[text.size()] = '\0';
+  }
+  return copy;
+}
+
+// "BATCH <n>\n" then one "OK\t<reply>" or "ERR\t<reply>" line per command.
+bool parse_batch_reply(std::string_view reply, size_t count,
+                       std::vector<std::string> *replies) {
+  if (reply.rfind("BATCH ", 0) != 0)
+    return false;
+
+  replies->clear();
+  size_t pos = reply.find('\n');
+  while (pos != std::string_view::npos && replies->size() < count) {
+    size_t next = reply.find('\n', pos + 1);
+    std::string_view line = reply.substr(
+        pos + 1, next == std::string_view::npos ? std::string_view::npos
+                                                : next - pos - 1);
+    size_t tab = line.find('\t');
+    replies->push_back(tab == std::string_view::npos
+                           ? "ERROR: Malformed batch reply"
+                           : std::string(line.substr(tab + 1)));
+    pos = next;
+  }
+  replies->resize(count, "ERROR: Missing batch reply");
+  return true;
+}
+
+std::string batch_payload(const std::vector<std::string> &commands) {
+  std::string payload = "BATCH\n";
+  for (const auto &command : commands)
+    payload += command + "\n";
+  return payload;
+}
+
+bool parse_int(std::string_view text, int *value) {
+  auto result = std::from_chars(text.data(), text.data() + text.size(), *value);
+  return result.ec == std::errc() && result.ptr == text.data() + text.size();
+}
+
+bool parse_rgb(std::string_view text, int rgb[3]) {
+  for (int i = 0; i < 3; ++i) {
+    size_t space = text.find(' ');
+    if ((i < 2) == (space == std::string_view::npos))
+      return false;
+    if (!parse_int(text.substr(0, space), &rgb[i]))
+      return false;
+    text.remove_prefix(i < 2 ? space + 1 : text.size());
+  }
+  return true;
+}
+
+bool valid_rgb(const int rgb[3]) {
+  for (int i = 0; i < 3; ++i) {
+    if (rgb[i] < 0 || rgb[i] > 255)
+      return false;
+  }
+  return true;
+}
+
+std::string rgb_args(const int rgb[3]) {
+  return std::to_string(rgb[0]) + " " + std::to_string(rgb[1]) + " " +
+         std::to_string(rgb[2]);
+}
+
+constexpr const char *kFanModeNames[] = {"AUTO", "MANUAL", "MAX",
+                                         "BETTER_AUTO"};
+
+} // namespace
+
+// A SUBSCRIBE stream on a connection of its own.
+struct VictusSubscription {
+  victus_client *client = nullptr;
+  int id = 0;
+  std::string command;
+  victus_telemetry_cb callback = nullptr;
+  void *user_data = nullptr;
+  std::atomic<bool> running{true};
+  std::atomic<int> fd{-1};
+  std::thread reader;
+
+  bool open_stream();
+  void close_stream();
+  void reader_loop();
+};
+
+struct victus_client {
+  std::string socket_path;
+  int event_fd = -1;
+
+  // The request connection. socket_mutex guards fd, pipelined, next_tag and
+  // reader; pending_mutex guards the rest.
+  std::mutex socket_mutex;
+  int fd = -1;
+  bool pipelined = false;
+  uint64_t next_tag = 1;
+  std::thread reader;
+  std::mutex pending_mutex;
+  bool reader_alive = false;
+  std::unordered_map<uint64_t, Completion> pending;
+
+  // Callbacks waiting for victus_client_dispatch().
+  std::mutex ready_mutex;
+  std::deque<std::function<void()>> ready;
+
+  std::mutex subscriptions_mutex;
+  std::map<int, std::unique_ptr<VictusSubscription>> subscriptions;
+  int next_subscription = 1;
+
+  // `on_reply` runs on the reader thread, or on the caller's when the
+  // request never reaches the backend or the backend is not pipelined.
+  void submit(const std::string &command, Completion on_reply);
+  int call(const std::string &command, std::string *reply);
+  void post(std::function<void()> callback);
+  bool subscription_active(int id);
+
+private:
+  bool connect_to_backend();
+  bool probe_pipelining();
+  void close_connection();
+  void reader_loop(int connection);
+  std::string call_serialized(const std::string &command, int *status);
+};
+
+bool victus_client::connect_to_backend() {
+  fd = open_backend_socket(socket_path);
+  if (fd == -1)
+    return false;
+
+  pipelined = probe_pipelining();
+  if (fd == -1)
+    return false;
+  if (pipelined) {
+    {
+      std::lock_guard<std::mutex> lock(pending_mutex);
+      reader_alive = true;
+    }
+    reader = std::thread(&victus_client::reader_loop, this, fd);
+  }
+  return true;
+}
+
+// Backends without tag support answer "ERROR: Unknown command" and the
+// connection stays one request at a time.
+bool victus_client::probe_pipelining() {
+  std::string reply;
+  if (!send_frame(fd, "#0 GET_FAN_MODE") || !read_frame(fd, &reply)) {
+    close_connection();
+    return false;
+  }
+  return reply.rfind("#0 ", 0) == 0;
+}
+
+void victus_client::close_connection() {
+  if (fd == -1)
+    return;
+  // Wakes the reader, which fails whatever is still pending.
+  shutdown(fd, SHUT_RDWR);
+  if (reader.joinable())
+    reader.join();
+  close(fd);
+  fd = -1;
+  pipelined = false;
+}
+
+void victus_client::reader_loop(int connection) {
+  std::string frame;
+  while (read_frame(connection, &frame)) {
+    size_t space = frame.find(' ');
+    if (frame.empty() || frame[0] != '#' || space == std::string::npos)
+      continue;
+    uint64_t tag = 0;
+    auto parsed = std::from_chars(frame.data() + 1, frame.data() + space, tag);
+    if (parsed.ptr != frame.data() + space)
+      continue;
+
+    Completion on_reply;
+    {
+      std::lock_guard<std::mutex> lock(pending_mutex);
+      auto it = pending.find(tag);
+      if (it == pending.end())
+        continue;
+      on_reply = std::move(it->second);
+      pending.erase(it);
+    }
+    std::string reply = frame.substr(space + 1);
+    int status = status_of(reply);
+    on_reply(status, std::move(reply));
+  }
+
+  std::unordered_map<uint64_t, Completion> failed;
+  {
+    std::lock_guard<std::mutex> lock(pending_mutex);
+    reader_alive = false;
+    failed.swap(pending);
+  }
+  for (auto &[tag, on_reply] : failed)
+    on_reply(VICTUS_CLIENT_EIO, "ERROR: Failed to read response");
+}
+
+// The caller holds socket_mutex.
+std::string victus_client::call_serialized(const std::string &command,
+                                           int *status) {
+  std::string reply;
+  if (!send_frame(fd, command) || !read_frame(fd, &reply)) {
+    close_connection();
+    *status = VICTUS_CLIENT_EIO;
+    return "ERROR: Failed to read response";
+  }
+  *status = status_of(reply);
+  return reply;
+}
+
+void victus_client::submit(const std::string &command, Completion on_reply) {
+  std::unique_lock<std::mutex> lock(socket_mutex);
+
+  bool reader_lost = false;
+  if (fd != -1 && pipelined) {
+    std::lock_guard<std::mutex> pending_lock(pending_mutex);
+    reader_lost = !reader_alive;
+  }
+  // The backend restarted; the reader has already exited, so this does not
+  // block.
+  if (reader_lost)
+    close_connection();
+
+  if (fd == -1 && !connect_to_backend()) {
+    lock.unlock();
+    on_reply(VICTUS_CLIENT_ECONNECT, "ERROR: No server connection");
+    return;
+  }
+
+  if (!pipelined) {
+    int status = VICTUS_CLIENT_OK;
+    std::string reply = call_serialized(command, &status);
+    lock.unlock();
+    on_reply(status, std::move(reply));
+    return;
+  }
+
+  uint64_t tag = next_tag++;
+  {
+    std::lock_guard<std::mutex> pending_lock(pending_mutex);
+    pending.emplace(tag, std::move(on_reply));
+  }
+  if (!send_frame(fd, "#" + std::to_string(tag) + " " + command)) {
+    // The reader fails the request when the connection closes.
+    close_connection();
+  }
+}
+
+int victus_client::call(const std::string &command, std::string *reply) {
+  std::promise<std::pair<int, std::string>> done;
+  auto result = done.get_future();
+  submit(command, [&done](int status, std::string text) {
+    done.set_value({status, std::move(text)});
+  });
+  auto [status, text] = result.get();
+  *reply = std::move(text);
+  if (status != VICTUS_CLIENT_OK)
+    last_error = *reply;
+  return status;
+}
+
+void victus_client::post(std::function<void()> callback) {
+  {
+    std::lock_guard<std::mutex> lock(ready_mutex);
+    ready.push_back(std::move(callback));
+  }
+  uint64_t one = 1;
+  ssize_t ignored = write(event_fd, &one, sizeof(one));
+  (void)ignored;
+}
+
+bool victus_client::subscription_active(int id) {
+  std::lock_guard<std::mutex> lock(subscriptions_mutex);
+  return subscriptions.count(id) != 0;
+}
+
+bool VictusSubscription::open_stream() {
+  int stream = open_backend_socket(client->socket_path);
+  if (stream == -1) {
+    last_error = "ERROR: No server connection";
+    return false;
+  }
+
+  std::string reply;
+  if (!send_frame(stream, command) || !read_frame(stream, &reply) ||
+      reply != "OK") {
+    last_error = reply.empty() ? "ERROR: Failed to read response" : reply;
+    close(stream);
+    return false;
+  }
+  fd.store(stream);
+  return true;
+}
+
+void VictusSubscription::close_stream() {
+  int stream = fd.exchange(-1);
+  if (stream != -1)
+    close(stream);
+}
+
+void VictusSubscription::reader_loop() {
+  std::string frame;
+  while (running.load()) {
+    if (fd.load() == -1) {
+      // Backend restarted; retry until it is back.
+      auto deadline = std::chrono::steady_clock::now() + kResubscribeDelay;
+      while (running.load() && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      if (running.load())
+        open_stream();
+      continue;
+    }
+
+    if (!read_frame(fd.load(), &frame)) {
+      close_stream();
+      continue;
+    }
+    if (frame.rfind("TELEMETRY", 0) != 0)
+      continue;
+
+    std::vector<std::string> keys;
+    std::vector<std::string> values;
+    std::string_view rest = std::string_view(frame).substr(9);
+    while (!rest.empty()) {
+      size_t space = rest.find(' ');
+      std::string_view token = rest.substr(0, space);
+      rest.remove_prefix(space == std::string_view::npos ? rest.size()
+                                                         : space + 1);
+      size_t equals = token.find('=');
+      if (equals == std::string_view::npos)
+        continue;
+      keys.emplace_back(token.substr(0, equals));
+      values.emplace_back(token.substr(equals + 1));
+    }
+
+    client->post([client = client, subscription = id, callback = callback,
+                  user_data = user_data, keys = std::move(keys),
+                  values = std::move(values)] {
+      // Frames still queued when the subscription ends are dropped.
+      if (!client->subscription_active(subscription))
+        return;
+      std::vector<const char *> key_ptrs;
+      std::vector<const char *> value_ptrs;
+      for (size_t i = 0; i < keys.size(); ++i) {
+        key_ptrs.push_back(keys[i].c_str());
+        value_ptrs.push_back(values[i].c_str());
+      }
+      callback(keys.size(), key_ptrs.data(), value_ptrs.data(), user_data);
+    });
+  }
+  close_stream();
+}
+
+extern "C" {
+
+victus_client *victus_client_new(const char *socket_path) {
+  int event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (event_fd == -1) {
+    fail(VICTUS_CLIENT_EIO, std::string("ERROR: eventfd: ") + strerror(errno));
+    return nullptr;
+  }
+  auto *client = new victus_client();
+  client->socket_path =
+      socket_path ? socket_path : VICTUS_CLIENT_DEFAULT_SOCKET;
+  client->event_fd = event_fd;
+  return client;
+}
+
+void victus_client_free(victus_client *client) {
+  if (!client)
+    return;
+
+  std::map<int, std::unique_ptr<VictusSubscription>> subscriptions;
+  {
+    std::lock_guard<std::mutex> lock(client->subscriptions_mutex);
+    subscriptions.swap(client->subscriptions);
+  }
+  for (auto &[id, subscription] : subscriptions) {
+    subscription->running.store(false);
+    int stream = subscription->fd.load();
+    if (stream != -1)
+      shutdown(stream, SHUT_RDWR);
+    if (subscription->reader.joinable())
+      subscription->reader.join();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(client->socket_mutex);
+    if (client->fd != -1) {
+      shutdown(client->fd, SHUT_RDWR);
+      if (client->reader.joinable())
+        client->reader.join();
+      close(client->fd);
+    }
+  }
+  close(client->event_fd);
+  delete client;
+}
+
+const char *victus_client_last_error(void) { return last_error.c_str(); }
+
+void victus_client_free_string(char *text) { std::free(text); }
+
+void victus_client_free_strings(char **texts, size_t count) {
+  if (!texts)
+    return;
+  for (size_t i = 0; i < count; ++i)
+    std::free(texts[i]);
+  std::free(texts);
+}
+
+int victus_client_call(victus_client *client, const char *command,
+                       char **reply) {
+  if (!client || !command)
+    return fail(VICTUS_CLIENT_EINVAL, "ERROR: Invalid argument");
+
+  std::string text;
+  int status = client->call(command, &text);
+  if (reply)
+    *reply = copy_string(text);
+  return status;
+}
+
+int victus_client_batch(victus_client *client, const char *const *commands,
+                        size_t count, char ***replies) {
+  if (!client || !commands || count == 0)
+    return fail(VICTUS_CLIENT_EINVAL, "ERROR: Invalid argument");
+
+  std::vector<std::string> items(commands, commands + count);
+  std::string reply;
+  int status = client->call(batch_payload(items), &reply);
+
+  std::vector<std::string> results;
+  if (!parse_batch_reply(reply, count, &results)) {
+    if (reply != "ERROR: Unknown command") {
+      results.assign(count, reply);
+    } else {
+      // Backend predates BATCH; one round trip per command.
+      status = VICTUS_CLIENT_OK;
+      results.resize(count);
+      for (size_t i = 0; i < count; ++i)
+        client->call(items[i], &results[i]);
+    }
+  } else {
+    status = VICTUS_CLIENT_OK;
+  }
+
+  if (replies) {
+    *replies = static_cast<char **>(std::calloc(count, sizeof(char *)));
+    for (size_t i = 0; *replies && i < count; ++i)
+      (*replies)[i] = copy_string(results[i]);
+  }
+  return status;
+}
+
+int victus_client_call_async(victus_client *client, const char *command,
+                             victus_reply_cb callback, void *user_data) {
+  if (!client || !command || !callback)
+    return fail(VICTUS_CLIENT_EINVAL, "ERROR: Invalid argument");
+
+  client->submit(command, [client, callback, user_data](int, std::string reply) {
+    client->post([callback, user_data, reply = std::move(reply)] {
+      callback(reply.c_str(), user_data);
+    });
+  });
+  return VICTUS_CLIENT_OK;
+}
+
+namespace {
+
+// Aggregates the per-command fallback for a backend without BATCH.
+struct BatchFallback {
+  std::vector<std::string> replies;
+  size_t remaining;
+  victus_batch_cb callback;
+  void *user_data;
+};
+
+void deliver_batch(victus_batch_cb callback, void *user_data,
+                   const std::vector<std::string> &replies) {
+  std::vector<const char *> pointers;
+  for (const auto &reply : replies)
+    pointers.push_back(reply.c_str());
+  callback(pointers.size(), pointers.data(), user_data);
+}
+
+} // namespace
+
+int victus_client_batch_async(victus_client *client,
+                              const char *const *commands, size_t count,
+                              victus_batch_cb callback, void *user_data) {
+  if (!client || !commands || count == 0 || !callback)
+    return fail(VICTUS_CLIENT_EINVAL, "ERROR: Invalid argument");
+
+  std::vector<std::string> items(commands, commands + count);
+  std::string payload = batch_payload(items);
+  client->submit(payload, [client, items = std::move(items), callback,
+                           user_data](int, std::string reply) {
+    std::vector<std::string> results;
+    if (parse_batch_reply(reply, items.size(), &results) ||
+        reply != "ERROR: Unknown command") {
+      if (results.empty())
+        results.assign(items.size(), reply);
+      client->post([callback, user_data, results = std::move(results)] {
+        deliver_batch(callback, user_data, results);
+      });
+      return;
+    }
+
+    // Backend predates BATCH. Sent from the dispatching thread: this one
+    // may be the reader, which must not wait on the socket.
+    client->post([client, items, callback, user_data] {
+      auto state = std::make_shared<BatchFallback>(
+          BatchFallback{std::vector<std::string>(items.size()), items.size(),
+                        callback, user_data});
+      for (size_t i = 0; i < items.size(); ++i) {
+        client->submit(items[i], [client, state, i](int, std::string text) {
+          client->post([state, i, text = std::move(text)] {
+            state->replies[i] = text;
+            if (--state->remaining == 0)
+              deliver_batch(state->callback, state->user_data, state->replies);
+          });
+        });
+      }
+    });
+  });
+  return VICTUS_CLIENT_OK;
+}
+
+int victus_client_subscribe(victus_client *client, const char *topics,
+                            int interval_seconds, victus_telemetry_cb callback,
+                            void *user_data) {
+  if (!client || !topics || !callback)
+    return fail(VICTUS_CLIENT_EINVAL, "ERROR: Invalid argument");
+  if (interval_seconds < 1 || interval_seconds > kVictusMaxSubscribeInterval)
+    return fail(VICTUS_CLIENT_EINVAL, "ERROR: Invalid SUBSCRIBE interval");
+
+  auto subscription = std::make_unique<VictusSubscription>();
+  subscription->client = client;
+  subscription->command = std::string("SUBSCRIBE ") + topics + " " +
+                          std::to_string(interval_seconds);
+  subscription->callback = callback;
+  subscription->user_data = user_data;
+  if (!subscription->open_stream())
+    return last_error == "ERROR: No server connection" ? VICTUS_CLIENT_ECONNECT
+                                                        : VICTUS_CLIENT_EBACKEND;
+
+  std::lock_guard<std::mutex> lock(client->subscriptions_mutex);
+  int id = client->next_subscription++;
+  subscription->id = id;
+  subscription->reader =
+      std::thread(&VictusSubscription::reader_loop, subscription.get());
+  client->subscriptions.emplace(id, std::move(subscription));
+  return id;
+}
+
+void victus_client_unsubscribe(victus_client *client, int id) {
+  if (!client)
+    return;
+
+  std::unique_ptr<VictusSubscription> subscription;
+  {
+    std::lock_guard<std::mutex> lock(client->subscriptions_mutex);
+    auto it = client->subscriptions.find(id);
+    if (it == client->subscriptions.end())
+      return;
+    subscription = std::move(it->second);
+    client->subscriptions.erase(it);
+  }
+
+  subscription->running.store(false);
+  // Unblocks the reader; it closes the descriptor itself.
+  int stream = subscription->fd.load();
+  if (stream != -1)
+    shutdown(stream, SHUT_RDWR);
+  if (subscription->reader.joinable())
+    subscription->reader.join();
+}
+
+int victus_client_get_fd(victus_client *client) {
+  return client ? client->event_fd : -1;
+}
+
+int victus_client_dispatch(victus_client *client) {
+  if (!client)
+    return 0;
+
+  uint64_t count = 0;
+  ssize_t ignored = read(client->event_fd, &count, sizeof(count));
+  (void)ignored;
+
+  std::deque<std::function<void()>> batch;
+  {
+    std::lock_guard<std::mutex> lock(client->ready_mutex);
+    batch.swap(client->ready);
+  }
+  for (auto &callback : batch)
+    callback();
+  return static_cast<int>(batch.size());
+}
+
+int victus_client_get_fan_speed(victus_client *client, int fan, int *rpm) {
+  if (!client || fan < 1 || fan > 2 || !rpm)
+    return fail(VICTUS_CLIENT_EINVAL, "ERROR: Invalid fan number");
+
+  std::string reply;
+  int status = client->call("GET_FAN_SPEED " + std::to_string(fan), &reply);
+  if (status != VICTUS_CLIENT_OK)
+    return status;
+  return parse_int(reply, rpm) ? VICTUS_CLIENT_OK
+                               : fail(VICTUS_CLIENT_EPROTO, reply);
+}
+
+int victus_client_get_fan_max_speed(victus_client *client, int fan, int *rpm) {
+  if (!client || fan < 1 || fan > 2 || !rpm)
+    return fail(VICTUS_CLIENT_EINVAL, "ERROR: Invalid fan number");
+
+  std::string reply;
+  int status =
+      client->call("GET_FAN_MAX_SPEED " + std::to_string(fan), &reply);
+  if (status != VICTUS_CLIENT_OK)
+    return status;
+  return parse_int(reply, rpm) ? VICTUS_CLIENT_OK
+                               : fail(VICTUS_CLIENT_EPROTO, reply);
+}
+
+int victus_client_set_fan_speed(victus_client *client, int fan, int rpm) {
+  if (!client || fan < 1 || fan > 2 || rpm < 0)
+    return fail(VICTUS_CLIENT_EINVAL, "ERROR: Invalid fan speed");
+
+  std::string reply;
+  int status = client->call(
+      "SET_FAN_SPEED " + std::to_string(fan) + " " + std::to_string(rpm),
+      &reply);
+  if (status != VICTUS_CLIENT_OK)
+    return status;
+  return victus_reply_ok(reply) ? VICTUS_CLIENT_OK
+                                : fail(VICTUS_CLIENT_EPROTO, reply);
+}
+
+int victus_client_get_fan_mode(victus_client *client, victus_fan_mode *mode) {
+  if (!client || !mode)
+    return fail(VICTUS_CLIENT_EINVAL, "ERROR: Invalid argument");
+
+  std::string reply;
+  int status = client->call("GET_FAN_MODE", &reply);
+  if (status != VICTUS_CLIENT_OK)
+    return status;
+  for (int i = 0; i < 4; ++i) {
+    if (reply == kFanModeNames[i]) {
+      *mode = static_cast<victus_fan_mode>(i);
+      return VICTUS_CLIENT_OK;
+    }
+  }
+  return fail(VICTUS_CLIENT_EPROTO, reply);
+}
+
+int victus_client_set_fan_mode(victus_client *client, victus_fan_mode mode) {
+  if (!client || mode < VICTUS_FAN_MODE_AUTO ||
+      mode > VICTUS_FAN_MODE_BETTER_AUTO)
+    return fail(VICTUS_CLIENT_EINVAL, "ERROR: Invalid fan mode");
+
+  std::string reply;
+  int status = client->call(
+      std::string("SET_FAN_MODE ") + kFanModeNames[mode], &reply);
+  if (status != VICTUS_CLIENT_OK)
+    return status;
+  return victus_reply_ok(reply) ? VICTUS_CLIENT_OK
+                                : fail(VICTUS_CLIENT_EPROTO, reply);
+}
+
+int victus_client_get_cpu_temp(victus_client *client, int *celsius) {
+  if (!client || !celsius)
+    return fail(VICTUS_CLIENT_EINVAL, "ERROR: Invalid argument");
+
+  std::string reply;
+  int status = client->call("GET_CPU_TEMP", &reply);
+  if (status != VICTUS_CLIENT_OK)
+    return status;
+  return parse_int(reply, celsius) ? VICTUS_CLIENT_OK
+                                   : fail(VICTUS_CLIENT_EPROTO, reply);
+}
+
+int victus_client_get_keyboard_type(victus_client *client,
+                                    victus_keyboard_type *type) {
+  if (!client || !type)
+    return fail(VICTUS_CLIENT_EINVAL, "ERROR: Invalid argument");
+
+  std::string reply;
+  int status = client->call("GET_KEYBOARD_TYPE", &reply);
+  if (status != VICTUS_CLIENT_OK)
+    return status;
+  if (reply == "FOUR_ZONE")
+    *type = VICTUS_KEYBOARD_FOUR_ZONE;
+  else if (reply == "SINGLE_ZONE")
+    *type = VICTUS_KEYBOARD_SINGLE_ZONE;
+  else
+    return fail(VICTUS_CLIENT_EPROTO, reply);
+  return VICTUS_CLIENT_OK;
+}
+
+int victus_client_get_keyboard_color(victus_client *client, int rgb[3]) {
+  if (!client || !rgb)
+    return fail(VICTUS_CLIENT_EINVAL, "ERROR: Invalid argument");
+
+  std::string reply;
+  int status = client->call("GET_KEYBOARD_COLOR", &reply);
+  if (status != VICTUS_CLIENT_OK)
+    return status;
+  return parse_rgb(reply, rgb) ? VICTUS_CLIENT_OK
+                               : fail(VICTUS_CLIENT_EPROTO, reply);
+}
+
+int victus_client_set_keyboard_color(victus_client *client, const int rgb[3]) {
+  if (!client || !rgb || !valid_rgb(rgb))
+    return fail(VICTUS_CLIENT_EINVAL, "ERROR: Invalid RGB color");
+
+  std::string reply;
+  int status = client->call("SET_KEYBOARD_COLOR " + rgb_args(rgb), &reply);
+  if (status != VICTUS_CLIENT_OK)
+    return status;
+  return victus_reply_ok(reply) ? VICTUS_CLIENT_OK
+                                : fail(VICTUS_CLIENT_EPROTO, reply);
+}
+
+int victus_client_get_keyboard_zone_color(victus_client *client, int zone,
+                                          int rgb[3]) {
+  if (!client || zone < 0 || zone > 3 || !rgb)
+    return fail(VICTUS_CLIENT_EINVAL, "ERROR: Invalid zone");
+
+  std::string reply;
+  int status = client->call(
+      "GET_KEYBOARD_ZONE_COLOR " + std::to_string(zone), &reply);
+  if (status != VICTUS_CLIENT_OK)
+    return status;
+  return parse_rgb(reply, rgb) ? VICTUS_CLIENT_OK
+                               : fail(VICTUS_CLIENT_EPROTO, reply);
+}
+
+int victus_client_set_keyboard_zone_color(victus_client *client, int zone,
+                                          const int rgb[3]) {
+  if (!client || zone < 0 || zone > 3 || !rgb || !valid_rgb(rgb))
+    return fail(VICTUS_CLIENT_EINVAL, "ERROR: Invalid zone color");
+
+  std::string reply;
+  int status = client->call("SET_KEYBOARD_ZONE_COLOR " +
+                                std::to_string(zone) + " " + rgb_args(rgb),
+                            &reply);
+  if (status != VICTUS_CLIENT_OK)
+    return status;
+  return victus_reply_ok(reply) ? VICTUS_CLIENT_OK
+                                : fail(VICTUS_CLIENT_EPROTO, reply);
+}
+
+int victus_client_get_keyboard_brightness(victus_client *client,
+                                          int *brightness) {
+  if (!client || !brightness)
+    return fail(VICTUS_CLIENT_EINVAL, "ERROR: Invalid argument");
+
+  std::string reply;
+  int status = client->call("GET_KBD_BRIGHTNESS", &reply);
+  if (status != VICTUS_CLIENT_OK)
+    return status;
+  return parse_int(reply, brightness) ? VICTUS_CLIENT_OK
+                                      : fail(VICTUS_CLIENT_EPROTO, reply);
+}
+
+int victus_client_set_keyboard_brightness(victus_client *client,
+                                          int brightness) {
+  if (!client || brightness < 0 || brightness > 255)
+    return fail(VICTUS_CLIENT_EINVAL, "ERROR: Invalid keyboard brightness");
+
+  std::string reply;
+  int status = client->call(
+      "SET_KBD_BRIGHTNESS " + std::to_string(brightness), &reply);
+  if (status != VICTUS_CLIENT_OK)
+    return status;
+  return victus_reply_ok(reply) ? VICTUS_CLIENT_OK
+                                : fail(VICTUS_CLIENT_EPROTO, reply);
+}
+
+const char *victus_fan_mode_name(victus_fan_mode mode) {
+  if (mode < VICTUS_FAN_MODE_AUTO || mode > VICTUS_FAN_MODE_BETTER_AUTO)
+    return "";
+  return kFanModeNames[mode];
+}
+
+} // extern "C"
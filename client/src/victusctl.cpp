@@ -0,0 +1,490 @@
+// victusctl: command-line client for the backend socket.
+//
+//   victusctl GET_FAN_SPEED 1            one command, reply on stdout
+//   victusctl < commands.txt             one command per line, streamed
+//   victusctl watch GET_CPU_TEMP "GET_FAN_SPEED 1"
+//
+// Streamed commands share one connection and go out as BATCH frames, with
+// up to --depth of them in flight; replies are printed in input order. A
+// batch is sent when it is full or when the input has nothing more ready,
+// so piping a slow producer in does not hold replies back. Blank lines and
+// lines starting with '#' are skipped.
+//
+// Exits 0 if every reply was a success, 1 if any was an error or the
+// backend could not be reached, 2 on bad usage.
+
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <iostream>
+#include <poll.h>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "victus_client.h"
+#include "victus_commands.hpp"
+
+namespace {
+
+// Matches the backend's per-connection limit on tagged requests.
+constexpr size_t kMaxDepth = 16;
+constexpr std::string_view kBatchPrefix = "BATCH\n";
+
+struct Options {
+  const char *socket_path = nullptr;
+  bool json = false;
+  size_t batch_size = kVictusMaxBatchItems;
+  size_t depth = 4;
+  const char *input_path = nullptr;
+
+  bool watch = false;
+  std::chrono::duration<double> interval{2.0};
+  uint64_t count = 0; // samples to take in watch mode; 0 runs until killed
+
+  std::vector<std::string> commands; // one joined command, or watch targets
+};
+
+void print_usage(const char *argv0) {
+  std::cerr
+      << "Usage: " << argv0 << " [options] COMMAND [ARG...]\n"
+      << "       " << argv0 << " [options] [--file PATH|-]\n"
+      << "       " << argv0
+      << " [options] watch [--interval SECONDS] [--count N] COMMAND...\n"
+      << "  --socket PATH       backend socket (default "
+      << VICTUS_CLIENT_DEFAULT_SOCKET << ")\n"
+      << "  --json              print one JSON object per reply or sample\n"
+      << "  --file PATH         read commands from PATH ('-' for stdin)\n"
+      << "  --batch N           commands per BATCH frame, 1-"
+      << kVictusMaxBatchItems << " (default " << kVictusMaxBatchItems
+      << ")\n"
+      << "  --depth N           batches in flight, 1-" << kMaxDepth
+      << " (default 4)\n"
+      << "  --interval SECONDS  watch: time between samples (default 2)\n"
+      << "  --count N           watch: stop after N samples\n";
+}
+
+template <typename T> bool parse_number(std::string_view text, T *value) {
+  auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), *value);
+  return ec == std::errc() && end == text.data() + text.size();
+}
+
+bool parse_seconds(const char *text, std::chrono::duration<double> *value) {
+  char *end = nullptr;
+  errno = 0;
+  double seconds = std::strtod(text, &end);
+  if (errno != 0 || end == text || *end != '\0' || seconds <= 0)
+    return false;
+  *value = std::chrono::duration<double>(seconds);
+  return true;
+}
+
+bool parse_options(int argc, char **argv, Options *options) {
+  int i = 1;
+  for (; i < argc; ++i) {
+    std::string_view arg = argv[i];
+    if (arg.empty() || arg[0] != '-' || arg == "-")
+      break;
+    if (arg == "--json") {
+      options->json = true;
+      continue;
+    }
+    if (arg == "--help" || arg == "-h" || i + 1 >= argc)
+      return false;
+
+    const char *value = argv[++i];
+    bool valid = true;
+    if (arg == "--socket")
+      options->socket_path = value;
+    else if (arg == "--file")
+      options->input_path = value;
+    else if (arg == "--batch")
+      valid = parse_number(value, &options->batch_size) &&
+              options->batch_size > 0 &&
+              options->batch_size <= kVictusMaxBatchItems;
+    else if (arg == "--depth")
+      valid = parse_number(value, &options->depth) && options->depth > 0 &&
+              options->depth <= kMaxDepth;
+    else
+      valid = false;
+
+    if (!valid) {
+      std::cerr << "Invalid value for " << arg << ": " << value << std::endl;
+      return false;
+    }
+  }
+
+  if (i < argc && std::string_view(argv[i]) == "-") {
+    options->input_path = "-";
+    ++i;
+  }
+  if (i < argc && std::string_view(argv[i]) == "watch") {
+    options->watch = true;
+    for (++i; i < argc; ++i) {
+      std::string_view arg = argv[i];
+      if (arg != "--interval" && arg != "--count")
+        break;
+      if (i + 1 >= argc)
+        return false;
+      const char *value = argv[++i];
+      bool valid = arg == "--interval"
+                       ? parse_seconds(value, &options->interval)
+                       : parse_number(value, &options->count);
+      if (!valid) {
+        std::cerr << "Invalid value for " << arg << ": " << value
+                  << std::endl;
+        return false;
+      }
+    }
+    // Each argument is a whole command; they are sampled as one batch.
+    for (; i < argc; ++i)
+      options->commands.emplace_back(argv[i]);
+    if (options->commands.empty() ||
+        options->commands.size() > kVictusMaxBatchItems) {
+      std::cerr << "watch takes 1-" << kVictusMaxBatchItems << " commands"
+                << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  if (i < argc) {
+    if (options->input_path) {
+      std::cerr << "A command cannot be combined with --file" << std::endl;
+      return false;
+    }
+    std::string command = argv[i];
+    for (++i; i < argc; ++i)
+      command += std::string(" ") + argv[i];
+    options->commands.push_back(std::move(command));
+  }
+  return true;
+}
+
+bool is_error(std::string_view reply) {
+  return reply.rfind("ERROR", 0) == 0;
+}
+
+std::string json_string(std::string_view text) {
+  std::string out = "\"";
+  for (char c : text) {
+    switch (c) {
+    case '"':
+      out += "\\\"";
+      break;
+    case '\\':
+      out += "\\\\";
+      break;
+    case '\n':
+      out += "\\n";
+      break;
+    case '\t':
+      out += "\\t";
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20) {
+        char escaped[8];
+        std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+        out += escaped;
+      } else {
+        out += c;
+      }
+    }
+  }
+  return out + "\"";
+}
+
+void print_reply(const Options &options, std::string_view command,
+                 std::string_view reply) {
+  if (options.json)
+    std::cout << "{\"command\":" << json_string(command)
+              << ",\"ok\":" << (is_error(reply) ? "false" : "true")
+              << ",\"reply\":" << json_string(reply) << "}\n";
+  else
+    std::cout << reply << "\n";
+}
+
+int run_single(victus_client *client, const Options &options) {
+  char *reply = nullptr;
+  int status = victus_client_call(client, options.commands[0].c_str(), &reply);
+  if (status == VICTUS_CLIENT_ECONNECT) {
+    std::cerr << "victusctl: " << victus_client_last_error() << std::endl;
+    return 1;
+  }
+  print_reply(options, options.commands[0],
+              reply ? reply : victus_client_last_error());
+  victus_client_free_string(reply);
+  std::cout.flush();
+  return status == VICTUS_CLIENT_OK ? 0 : 1;
+}
+
+// Line reader over a raw descriptor, so it can tell whether more input is
+// ready without blocking.
+class LineReader {
+public:
+  explicit LineReader(int fd) : fd(fd) {}
+
+  // False at end of input.
+  bool next(std::string *line) {
+    for (;;) {
+      size_t newline = buffer.find('\n', offset);
+      if (newline != std::string::npos) {
+        line->assign(buffer, offset, newline - offset);
+        offset = newline + 1;
+        return true;
+      }
+      if (eof) {
+        if (offset == buffer.size())
+          return false;
+        line->assign(buffer, offset, std::string::npos);
+        offset = buffer.size();
+        return true;
+      }
+      fill();
+    }
+  }
+
+  // True if next() would return without waiting on the producer.
+  bool ready() {
+    if (eof || buffer.find('\n', offset) != std::string::npos)
+      return true;
+    pollfd readable = {fd, POLLIN, 0};
+    return poll(&readable, 1, 0) > 0;
+  }
+
+private:
+  void fill() {
+    buffer.erase(0, offset);
+    offset = 0;
+    char chunk[4096];
+    ssize_t got;
+    do {
+      got = read(fd, chunk, sizeof(chunk));
+    } while (got < 0 && errno == EINTR);
+    if (got <= 0)
+      eof = true;
+    else
+      buffer.append(chunk, static_cast<size_t>(got));
+  }
+
+  int fd;
+  std::string buffer;
+  size_t offset = 0;
+  bool eof = false;
+};
+
+// One BATCH frame of the stream and, once it is back, its replies.
+struct Batch {
+  std::vector<std::string> commands;
+  std::vector<std::string> replies;
+  bool done = false;
+};
+
+void on_batch_reply(size_t count, const char *const *replies, void *data) {
+  auto *batch = static_cast<Batch *>(data);
+  batch->replies.assign(replies, replies + count);
+  batch->done = true;
+}
+
+int run_stream(victus_client *client, const Options &options) {
+  int fd = STDIN_FILENO;
+  if (options.input_path && std::strcmp(options.input_path, "-") != 0) {
+    fd = open(options.input_path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+      std::cerr << "victusctl: " << options.input_path << ": "
+                << std::strerror(errno) << std::endl;
+      return 1;
+    }
+  }
+
+  // A deque keeps each Batch in place while its callback is outstanding.
+  std::deque<Batch> in_flight;
+  bool failed = false;
+
+  auto print_finished = [&] {
+    while (!in_flight.empty() && in_flight.front().done) {
+      Batch &batch = in_flight.front();
+      for (size_t i = 0; i < batch.commands.size(); ++i) {
+        failed |= is_error(batch.replies[i]);
+        print_reply(options, batch.commands[i], batch.replies[i]);
+      }
+      in_flight.pop_front();
+    }
+    std::cout.flush();
+  };
+  auto wait_for_replies = [&] {
+    pollfd ready = {victus_client_get_fd(client), POLLIN, 0};
+    poll(&ready, 1, -1);
+    victus_client_dispatch(client);
+    print_finished();
+  };
+  auto submit = [&](Batch pending) {
+    while (in_flight.size() >= options.depth)
+      wait_for_replies();
+    in_flight.push_back(std::move(pending));
+    Batch &batch = in_flight.back();
+    std::vector<const char *> pointers;
+    for (const auto &command : batch.commands)
+      pointers.push_back(command.c_str());
+    victus_client_batch_async(client, pointers.data(), pointers.size(),
+                              on_batch_reply, &batch);
+  };
+
+  LineReader reader(fd);
+  Batch pending;
+  size_t pending_length = kBatchPrefix.size();
+  std::string line;
+  for (;;) {
+    // Keep printing replies while the producer is quiet.
+    while (!in_flight.empty() && !reader.ready()) {
+      pollfd ready[2] = {{fd, POLLIN, 0},
+                         {victus_client_get_fd(client), POLLIN, 0}};
+      poll(ready, 2, -1);
+      if (ready[1].revents & POLLIN) {
+        victus_client_dispatch(client);
+        print_finished();
+      }
+    }
+    if (!reader.next(&line))
+      break;
+
+    std::string_view command = line;
+    while (!command.empty() && std::isspace(static_cast<unsigned char>(command.back())))
+      command.remove_suffix(1);
+    while (!command.empty() && std::isspace(static_cast<unsigned char>(command.front())))
+      command.remove_prefix(1);
+    if (command.empty() || command[0] == '#')
+      continue;
+
+    if (kBatchPrefix.size() + command.size() + 1 > kVictusMaxRequestLength) {
+      // The backend would drop the connection over it; answer here, in
+      // order with the rest.
+      if (!pending.commands.empty())
+        submit(std::move(pending));
+      pending = Batch();
+      pending_length = kBatchPrefix.size();
+      Batch rejected;
+      rejected.commands.emplace_back(command);
+      rejected.replies.emplace_back("ERROR: Command too long");
+      rejected.done = true;
+      in_flight.push_back(std::move(rejected));
+      print_finished();
+      continue;
+    }
+    if (!pending.commands.empty() &&
+        pending_length + command.size() + 1 > kVictusMaxRequestLength) {
+      submit(std::move(pending));
+      pending = Batch();
+      pending_length = kBatchPrefix.size();
+    }
+    pending.commands.emplace_back(command);
+    pending_length += command.size() + 1;
+
+    if (pending.commands.size() == options.batch_size || !reader.ready()) {
+      submit(std::move(pending));
+      pending = Batch();
+      pending_length = kBatchPrefix.size();
+    }
+  }
+  if (!pending.commands.empty())
+    submit(std::move(pending));
+  while (!in_flight.empty())
+    wait_for_replies();
+
+  if (fd != STDIN_FILENO)
+    close(fd);
+  return failed ? 1 : 0;
+}
+
+int run_watch(victus_client *client, const Options &options) {
+  std::vector<const char *> pointers;
+  for (const auto &command : options.commands)
+    pointers.push_back(command.c_str());
+
+  if (!options.json) {
+    std::cout << "# time";
+    for (const auto &command : options.commands)
+      std::cout << "\t" << command;
+    std::cout << std::endl;
+  }
+
+  bool failed = false;
+  auto interval =
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          options.interval);
+  auto next_sample = std::chrono::steady_clock::now();
+  for (uint64_t sample = 0; options.count == 0 || sample < options.count;
+       ++sample) {
+    if (sample > 0) {
+      // Fixed rate: a slow round trip does not push later samples back.
+      next_sample += interval;
+      std::this_thread::sleep_until(next_sample);
+    }
+
+    char **replies = nullptr;
+    victus_client_batch(client, pointers.data(), pointers.size(), &replies);
+    double now = std::chrono::duration<double>(
+                     std::chrono::system_clock::now().time_since_epoch())
+                     .count();
+    char time[32];
+    std::snprintf(time, sizeof(time), "%.3f", now);
+
+    if (options.json)
+      std::cout << "{\"time\":" << time << ",\"replies\":{";
+    else
+      std::cout << time;
+    for (size_t i = 0; i < pointers.size(); ++i) {
+      const char *reply =
+          replies && replies[i] ? replies[i] : victus_client_last_error();
+      failed |= is_error(reply);
+      if (options.json)
+        std::cout << (i ? "," : "") << json_string(pointers[i]) << ":"
+                  << json_string(reply);
+      else
+        std::cout << "\t" << reply;
+    }
+    std::cout << (options.json ? "}}" : "") << std::endl;
+    victus_client_free_strings(replies, pointers.size());
+  }
+  return failed ? 1 : 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parse_options(argc, argv, &options)) {
+    print_usage(argv[0]);
+    return 2;
+  }
+  if (options.commands.empty() && !options.input_path &&
+      isatty(STDIN_FILENO)) {
+    print_usage(argv[0]);
+    return 2;
+  }
+
+  victus_client *client = victus_client_new(options.socket_path);
+  if (!client) {
+    std::cerr << "victusctl: " << victus_client_last_error() << std::endl;
+    return 1;
+  }
+
+  int result;
+  if (options.watch)
+    result = run_watch(client, options);
+  else if (!options.commands.empty())
+    result = run_single(client, options);
+  else
+    result = run_stream(client, options);
+
+  victus_client_free(client);
+  return result;
+}
@@ -0,0 +1,327 @@
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "victus_client.h"
+
+namespace {
+
+bool expect(bool condition, const char *message) {
+  if (condition)
+    return true;
+
+  std::cerr << "FAILED: " << message << std::endl;
+  return false;
+}
+
+bool read_exact(int fd, char *data, size_t length) {
+  while (length > 0) {
+    ssize_t got = recv(fd, data, length, 0);
+    if (got < 1)
+      return false;
+    data += got;
+    length -= static_cast<size_t>(got);
+  }
+  return true;
+}
+
+bool read_frame(int fd, std::string *payload) {
+  unsigned char header[4];
+  if (!read_exact(fd, reinterpret_cast<char *>(header), sizeof(header)))
+    return false;
+  uint32_t length = header[0] | (header[1] << 8) | (header[2] << 16) |
+                    (static_cast<uint32_t>(header[3]) << 24);
+  payload->resize(length);
+  return read_exact(fd, payload->data(), length);
+}
+
+bool write_frame(int fd, const std::string &payload) {
+  std::string frame(4, '\0');
+  for (int i = 0; i < 4; ++i)
+    frame[i] = static_cast<char>((payload.size() >> (8 * i)) & 0xFF);
+  frame += payload;
+  return send(fd, frame.data(), frame.size(), MSG_NOSIGNAL) ==
+         static_cast<ssize_t>(frame.size());
+}
+
+// Just enough of victus-backend: tagged frames (unless `legacy`), BATCH,
+// SUBSCRIBE, a slow SET_FAN_SPEED and a DROP that hangs up.
+class FakeBackend {
+public:
+  FakeBackend(std::string socket_path, bool legacy)
+      : path(std::move(socket_path)), legacy(legacy) {
+    unlink(path.c_str());
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    bind(listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    listen(listen_fd, 8);
+    acceptor = std::thread([this] { accept_loop(); });
+  }
+
+  ~FakeBackend() {
+    stopping.store(true);
+    shutdown(listen_fd, SHUT_RDWR);
+    acceptor.join();
+    for (auto &thread : connections)
+      thread.join();
+    close(listen_fd);
+    unlink(path.c_str());
+  }
+
+  std::atomic<int> accepted{0};
+
+private:
+  void accept_loop() {
+    while (!stopping.load()) {
+      pollfd ready = {listen_fd, POLLIN, 0};
+      if (poll(&ready, 1, 50) < 1)
+        continue;
+      int fd = accept(listen_fd, nullptr, nullptr);
+      if (fd == -1)
+        continue;
+      ++accepted;
+      connections.emplace_back([this, fd] { serve(fd); });
+    }
+  }
+
+  std::string answer(const std::string &command) {
+    if (command == "GET_FAN_MODE")
+      return "AUTO";
+    if (command == "GET_FAN_SPEED 1")
+      return "2450";
+    if (command == "GET_KEYBOARD_COLOR")
+      return "255 0 128";
+    if (command == "GET_KEYBOARD_TYPE")
+      return "FOUR_ZONE";
+    if (command.rfind("SET_FAN_SPEED", 0) == 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(200));
+      return "OK";
+    }
+    if (!legacy && command.rfind("BATCH\n", 0) == 0) {
+      std::vector<std::string> replies;
+      size_t pos = 6;
+      while (pos < command.size()) {
+        size_t end = command.find('\n', pos);
+        replies.push_back(answer(command.substr(pos, end - pos)));
+        pos = end + 1;
+      }
+      std::string reply = "BATCH " + std::to_string(replies.size());
+      for (const auto &item : replies)
+        reply += (item.rfind("ERROR", 0) == 0 ? "\nERR\t" : "\nOK\t") + item;
+      return reply;
+    }
+    return "ERROR: Unknown command";
+  }
+
+  void serve(int fd) {
+    std::mutex write_mutex;
+    std::vector<std::thread> slow;
+    std::string frame;
+    while (!stopping.load()) {
+      pollfd ready = {fd, POLLIN, 0};
+      if (poll(&ready, 1, 50) < 1)
+        continue;
+      if (!read_frame(fd, &frame))
+        break;
+      if (frame == "DROP" || frame.find(" DROP") != std::string::npos)
+        break;
+
+      if (frame.rfind("SUBSCRIBE ", 0) == 0) {
+        write_frame(fd, "OK");
+        while (!stopping.load() &&
+               write_frame(fd, "TELEMETRY fan1=2450 fan2=NA mode=AUTO"))
+          std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        break;
+      }
+
+      size_t space = frame.find(' ');
+      if (frame[0] != '#' || legacy) {
+        std::lock_guard<std::mutex> lock(write_mutex);
+        write_frame(fd, answer(frame));
+        continue;
+      }
+      std::string tag = frame.substr(0, space);
+      std::string command = frame.substr(space + 1);
+      slow.emplace_back([this, fd, tag, command, &write_mutex] {
+        std::string reply = tag + " " + answer(command);
+        std::lock_guard<std::mutex> lock(write_mutex);
+        write_frame(fd, reply);
+      });
+    }
+    for (auto &thread : slow)
+      thread.join();
+    close(fd);
+  }
+
+  std::string path;
+  bool legacy;
+  int listen_fd;
+  std::atomic<bool> stopping{false};
+  std::thread acceptor;
+  std::vector<std::thread> connections;
+};
+
+// Runs dispatch until `done` or about a second has gone by.
+template <typename Done> void dispatch_until(victus_client *client, Done done) {
+  for (int i = 0; i < 100 && !done(); ++i) {
+    pollfd ready = {victus_client_get_fd(client), POLLIN, 0};
+    if (poll(&ready, 1, 10) > 0)
+      victus_client_dispatch(client);
+  }
+}
+
+bool exercise(const std::string &path, bool legacy) {
+  bool ok = true;
+  FakeBackend backend(path, legacy);
+  victus_client *client = victus_client_new(path.c_str());
+
+  char *reply = nullptr;
+  ok &= expect(victus_client_call(client, "GET_FAN_SPEED 1", &reply) ==
+                       VICTUS_CLIENT_OK &&
+                   std::strcmp(reply, "2450") == 0,
+               "a call should return the backend's reply");
+  victus_client_free_string(reply);
+  ok &= expect(victus_client_call(client, "NOPE", nullptr) ==
+                       VICTUS_CLIENT_EBACKEND &&
+                   std::strcmp(victus_client_last_error(),
+                               "ERROR: Unknown command") == 0,
+               "an ERROR reply should be reported with its text");
+
+  // A fast read issued after a slow write; the fake backend takes 200 ms
+  // over SET_FAN_SPEED.
+  std::thread writer([&] { victus_client_set_fan_speed(client, 1, 3000); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  int rpm = 0;
+  auto started = std::chrono::steady_clock::now();
+  victus_client_get_fan_speed(client, 1, &rpm);
+  bool overtook =
+      std::chrono::steady_clock::now() - started < std::chrono::milliseconds(100);
+  writer.join();
+  ok &= expect(rpm == 2450 && overtook != legacy,
+               "tagged replies should not wait behind slower ones");
+
+  const char *commands[] = {"GET_FAN_MODE", "NOPE", "GET_KEYBOARD_TYPE"};
+  char **replies = nullptr;
+  ok &= expect(victus_client_batch(client, commands, 3, &replies) ==
+                       VICTUS_CLIENT_OK &&
+                   std::strcmp(replies[0], "AUTO") == 0 &&
+                   std::strcmp(replies[1], "ERROR: Unknown command") == 0 &&
+                   std::strcmp(replies[2], "FOUR_ZONE") == 0,
+               "a batch should return one reply per command, in order");
+  victus_client_free_strings(replies, 3);
+
+  int rgb[3] = {};
+  victus_fan_mode mode = VICTUS_FAN_MODE_MAX;
+  ok &= expect(victus_client_get_keyboard_color(client, rgb) ==
+                       VICTUS_CLIENT_OK &&
+                   rgb[0] == 255 && rgb[1] == 0 && rgb[2] == 128 &&
+                   victus_client_get_fan_mode(client, &mode) ==
+                       VICTUS_CLIENT_OK &&
+                   mode == VICTUS_FAN_MODE_AUTO,
+               "typed accessors should parse their replies");
+  int bad_rgb[3] = {256, 0, 0};
+  ok &= expect(victus_client_set_keyboard_color(client, bad_rgb) ==
+                   VICTUS_CLIENT_EINVAL,
+               "out-of-range arguments should be rejected before sending");
+
+  std::string async_reply;
+  std::vector<std::string> async_batch;
+  victus_client_call_async(
+      client, "GET_FAN_MODE",
+      [](const char *text, void *data) {
+        *static_cast<std::string *>(data) = text;
+      },
+      &async_reply);
+  victus_client_batch_async(
+      client, commands, 3,
+      [](size_t count, const char *const *texts, void *data) {
+        auto *out = static_cast<std::vector<std::string> *>(data);
+        out->assign(texts, texts + count);
+      },
+      &async_batch);
+  ok &= expect(async_reply.empty(),
+               "async callbacks should only run from dispatch");
+  dispatch_until(client,
+                 [&] { return !async_reply.empty() && !async_batch.empty(); });
+  ok &= expect(async_reply == "AUTO" && async_batch.size() == 3 &&
+                   async_batch[2] == "FOUR_ZONE",
+               "dispatch should run async callbacks with their replies");
+
+  auto ignore = [](size_t, const char *const *, const char *const *, void *) {};
+  ok &= expect(victus_client_subscribe(client, "fan", 0, ignore, nullptr) ==
+                       VICTUS_CLIENT_EINVAL &&
+                   victus_client_subscribe(client, "fan", 3601, ignore,
+                                           nullptr) == VICTUS_CLIENT_EINVAL,
+               "intervals the backend would refuse should be rejected");
+
+  int frames = 0;
+  std::string fan2;
+  std::pair<int *, std::string *> seen(&frames, &fan2);
+  int id = victus_client_subscribe(
+      client, "fan,mode", 1,
+      [](size_t count, const char *const *keys, const char *const *values,
+         void *data) {
+        auto *out = static_cast<std::pair<int *, std::string *> *>(data);
+        ++*out->first;
+        for (size_t i = 0; i < count; ++i) {
+          if (std::strcmp(keys[i], "fan2") == 0)
+            *out->second = values[i];
+        }
+      },
+      &seen);
+  dispatch_until(client, [&] { return frames >= 2; });
+  ok &= expect(id > 0 && frames >= 2 && fan2 == "NA",
+               "subscriptions should deliver parsed TELEMETRY frames");
+  victus_client_unsubscribe(client, id);
+  victus_client_dispatch(client);
+  int after_unsubscribe = frames;
+  std::this_thread::sleep_for(std::chrono::milliseconds(60));
+  victus_client_dispatch(client);
+  ok &= expect(frames == after_unsubscribe,
+               "no frames should be delivered after unsubscribing");
+
+  int connections = backend.accepted.load();
+  victus_client_call(client, "DROP", nullptr);
+  ok &= expect(victus_client_call(client, "GET_FAN_MODE", &reply) ==
+                       VICTUS_CLIENT_OK &&
+                   backend.accepted.load() == connections + 1,
+               "the next call after a hangup should reconnect");
+  victus_client_free_string(reply);
+
+  victus_client_free(client);
+  return ok;
+}
+
+} // namespace
+
+int main() {
+  bool ok = true;
+  std::string base = "/tmp/victus-client-test-" + std::to_string(getpid());
+
+  ok &= exercise(base + ".sock", false);
+  ok &= exercise(base + "-legacy.sock", true);
+
+  victus_client *client = victus_client_new((base + "-missing.sock").c_str());
+  ok &= expect(victus_client_call(client, "GET_FAN_MODE", nullptr) ==
+                       VICTUS_CLIENT_ECONNECT &&
+                   victus_client_subscribe(
+                       client, "fan", 1,
+                       [](size_t, const char *const *, const char *const *,
+                          void *) {},
+                       nullptr) == VICTUS_CLIENT_ECONNECT,
+               "a missing backend should be reported as ECONNECT");
+  victus_client_free(client);
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,228 @@
+#ifndef VICTUS_COMMANDS_HPP
+#define VICTUS_COMMANDS_HPP
+
+#include <array>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+// The text command set, shared by the backend dispatcher and its clients.
+//
+// Each command is "<NAME> <arg>..." with whitespace-separated arguments. A
+// Text argument takes the rest of the line. The backend checks the argument
+// count, then the bounds of each Integer argument in order, before the
+// command's handler runs. Trailing optional arguments may be left out.
+// Connection-level frames (HELLO, SUBSCRIBE, GET_TELEMETRY_FD, BATCH and
+// "#<tag>" prefixes) are not commands and are handled by the server itself.
+
+enum VictusCommand : uint8_t {
+  GET_FAN_SPEED,
+  GET_FAN_MAX_SPEED,
+  SET_FAN_SPEED,
+  GET_FAN_MODE,
+  SET_FAN_MODE,
+  GET_CPU_TEMP,
+  GET_KEYBOARD_TYPE,
+  GET_KEYBOARD_COLOR,
+  SET_KEYBOARD_COLOR,
+  GET_KEYBOARD_ZONE_COLOR,
+  SET_KEYBOARD_ZONE_COLOR,
+  GET_KBD_BRIGHTNESS,
+  SET_KBD_BRIGHTNESS,
+  GET_STATE_SINCE,
+  STATS,
+  SET_LOG_LEVEL,
+  TRACE,
+  SELFSTAT,
+  VICTUS_COMMAND_COUNT
+};
+
+constexpr size_t kVictusMaxCommandArgs = 4;
+
+// Largest request frame the backend reads, and the most commands one BATCH
+// frame may carry. Clients that batch split their work to fit.
+constexpr uint32_t kVictusMaxRequestLength = 4096;
+constexpr size_t kVictusMaxBatchItems = 32;
+
+// Longest push period "SUBSCRIBE <topics> <interval>" accepts, in seconds.
+constexpr int kVictusMaxSubscribeInterval = 3600;
+
+// Reply to a SET that a newer write to the same target superseded before it
+// ran; the newer value is applied instead. Counts as success. The newer write
+// has to come from the same connection: a tagged request still queued, an
+// untagged frame already buffered behind it, or a later item of the same
+// BATCH.
+constexpr std::string_view kVictusMergedReply = "OK: MERGED";
+
+constexpr bool victus_reply_ok(std::string_view reply) {
+  return reply == "OK" || reply == kVictusMergedReply;
+}
+
+enum class VictusArgKind : uint8_t {
+  Integer,
+  Text, // rest of the line, surrounding whitespace trimmed
+};
+
+struct VictusArgSpec {
+  VictusArgKind kind = VictusArgKind::Integer;
+  int min_value = 0;
+  int max_value = 0;
+  // Reply for an out-of-range value; empty means a command format error.
+  std::string_view invalid_error;
+};
+
+struct VictusCommandSpec {
+  VictusCommand id;
+  std::string_view name;
+  uint8_t arg_count;
+  std::array<VictusArgSpec, kVictusMaxCommandArgs> args;
+  // Runs the sudo helpers and may take seconds.
+  bool may_block;
+  // How many of the last arguments may be omitted.
+  uint8_t optional_args = 0;
+};
+
+namespace victus_schema_detail {
+
+constexpr VictusArgSpec kFanArg = {VictusArgKind::Integer, 1, 2,
+                                   "ERROR: Invalid fan number"};
+constexpr VictusArgSpec kRpmArg = {VictusArgKind::Integer, 0, INT_MAX,
+                                   "ERROR: Invalid fan speed"};
+constexpr VictusArgSpec kZoneArg = {VictusArgKind::Integer, 0, 3, {}};
+constexpr VictusArgSpec kChannelArg = {VictusArgKind::Integer, 0, 255,
+                                       "ERROR: Invalid RGB color"};
+constexpr VictusArgSpec kBrightnessArg = {
+    VictusArgKind::Integer, 0, 255, "ERROR: Invalid keyboard brightness"};
+constexpr VictusArgSpec kModeArg = {VictusArgKind::Text, 0, 0, {}};
+constexpr VictusArgSpec kStateVersionArg = {
+    VictusArgKind::Integer, 0, INT_MAX, "ERROR: Invalid state version"};
+constexpr VictusArgSpec kWaitArg = {VictusArgKind::Integer, 0, 60000,
+                                    "ERROR: Invalid wait time"};
+constexpr VictusArgSpec kLogLevelArg = {VictusArgKind::Text, 0, 0, {}};
+constexpr VictusArgSpec kTraceActionArg = {VictusArgKind::Text, 0, 0, {}};
+
+} // namespace victus_schema_detail
+
+// Indexed by VictusCommand.
+inline constexpr std::array<VictusCommandSpec, VICTUS_COMMAND_COUNT>
+    kVictusCommands = [] {
+      using namespace victus_schema_detail;
+      std::array<VictusCommandSpec, VICTUS_COMMAND_COUNT> specs = {{
+          {GET_FAN_SPEED, "GET_FAN_SPEED", 1, {kFanArg}, false},
+          {GET_FAN_MAX_SPEED, "GET_FAN_MAX_SPEED", 1, {kFanArg}, false},
+          {SET_FAN_SPEED, "SET_FAN_SPEED", 2, {kFanArg, kRpmArg}, true},
+          {GET_FAN_MODE, "GET_FAN_MODE", 0, {}, false},
+          {SET_FAN_MODE, "SET_FAN_MODE", 1, {kModeArg}, true},
+          {GET_CPU_TEMP, "GET_CPU_TEMP", 0, {}, false},
+          {GET_KEYBOARD_TYPE, "GET_KEYBOARD_TYPE", 0, {}, false},
+          {GET_KEYBOARD_COLOR, "GET_KEYBOARD_COLOR", 0, {}, false},
+          {SET_KEYBOARD_COLOR,
+           "SET_KEYBOARD_COLOR",
+           3,
+           {kChannelArg, kChannelArg, kChannelArg},
+           true},
+          {GET_KEYBOARD_ZONE_COLOR, "GET_KEYBOARD_ZONE_COLOR", 1, {kZoneArg},
+           false},
+          {SET_KEYBOARD_ZONE_COLOR,
+           "SET_KEYBOARD_ZONE_COLOR",
+           4,
+           {kZoneArg, kChannelArg, kChannelArg, kChannelArg},
+           true},
+          {GET_KBD_BRIGHTNESS, "GET_KBD_BRIGHTNESS", 0, {}, false},
+          {SET_KBD_BRIGHTNESS, "SET_KBD_BRIGHTNESS", 1, {kBrightnessArg},
+           true},
+          // GET_STATE_SINCE <version> [<wait_ms>]
+          {GET_STATE_SINCE,
+           "GET_STATE_SINCE",
+           2,
+           {kStateVersionArg, kWaitArg},
+           false,
+           1},
+          // Latency histograms; see backend/src/stats.hpp.
+          {STATS, "STATS", 0, {}, false},
+          // SET_LOG_LEVEL debug|info|warning|error
+          {SET_LOG_LEVEL, "SET_LOG_LEVEL", 1, {kLogLevelArg}, false},
+          // TRACE on|off|dump; see backend/src/trace.hpp.
+          {TRACE, "TRACE", 1, {kTraceActionArg}, false},
+          // The daemon's own CPU, wakeups and memory; see selfstat.hpp.
+          {SELFSTAT, "SELFSTAT", 0, {}, false},
+      }};
+      return specs;
+    }();
+
+constexpr bool victus_commands_are_indexed() {
+  for (size_t i = 0; i < kVictusCommands.size(); ++i) {
+    if (static_cast<size_t>(kVictusCommands[i].id) != i ||
+        kVictusCommands[i].name.empty() ||
+        kVictusCommands[i].optional_args > kVictusCommands[i].arg_count)
+      return false;
+  }
+  return true;
+}
+static_assert(victus_commands_are_indexed(),
+              "kVictusCommands must list every command in enum order");
+
+// Name lookup goes through a perfect hash whose seed is searched at compile
+// time, so dispatch costs one hash and a single confirming comparison.
+namespace victus_schema_detail {
+
+constexpr size_t kSlotCount = 32;
+constexpr uint8_t kEmptySlot = 0xFF;
+
+constexpr uint32_t hash_name(std::string_view name, uint32_t seed) {
+  uint32_t hash = 2166136261u ^ seed;
+  for (char ch : name) {
+    hash ^= static_cast<unsigned char>(ch);
+    hash *= 16777619u;
+  }
+  // The slot is taken from the low bits, which FNV-1a never mixes the
+  // seed's high bits into; fold them down so every seed is a new candidate.
+  return hash ^ (hash >> 15);
+}
+
+constexpr uint32_t find_seed() {
+  for (uint32_t seed = 0; seed < 4096; ++seed) {
+    std::array<bool, kSlotCount> used = {};
+    bool collision = false;
+    for (const auto &spec : kVictusCommands) {
+      size_t slot = hash_name(spec.name, seed) % kSlotCount;
+      collision |= used[slot];
+      used[slot] = true;
+    }
+    if (!collision)
+      return seed;
+  }
+  return UINT32_MAX;
+}
+
+constexpr uint32_t kSeed = find_seed();
+static_assert(kSeed != UINT32_MAX, "no collision-free command hash seed");
+
+constexpr std::array<uint8_t, kSlotCount> kSlots = [] {
+  std::array<uint8_t, kSlotCount> slots = {};
+  for (auto &slot : slots)
+    slot = kEmptySlot;
+  for (const auto &spec : kVictusCommands)
+    slots[hash_name(spec.name, kSeed) % kSlotCount] = spec.id;
+  return slots;
+}();
+
+} // namespace victus_schema_detail
+
+constexpr std::optional<VictusCommand>
+victus_find_command(std::string_view name) {
+  using namespace victus_schema_detail;
+  uint8_t id = kSlots[hash_name(name, kSeed) % kSlotCount];
+  if (id == kEmptySlot || kVictusCommands[id].name != name)
+    return std::nullopt;
+  return static_cast<VictusCommand>(id);
+}
+
+static_assert(victus_find_command("SET_KEYBOARD_ZONE_COLOR") ==
+                  SET_KEYBOARD_ZONE_COLOR &&
+              !victus_find_command("GET_FAN") &&
+              !victus_find_command(""));
+
+#endif // VICTUS_COMMANDS_HPP
@@ -0,0 +1,100 @@
+#ifndef VICTUS_TELEMETRY_PAGE_HPP
+#define VICTUS_TELEMETRY_PAGE_HPP
+
+#include <atomic>
+#include <cstdint>
+
+// Shared-memory telemetry page published by victus-backend.
+//
+// A client sends the text command GET_TELEMETRY_FD; the "OK" reply frame
+// carries a memfd opened read-only as SCM_RIGHTS ancillary data. Map it with
+// mmap(nullptr, sizeof(VictusTelemetryPage), PROT_READ, MAP_SHARED, fd, 0)
+// and call victus_telemetry_read() whenever fresh values are needed: no
+// syscalls and no backend wakeups per read. The memfd is mode 0444 and sealed
+// against resizing, so a client that is not root can neither map it writable
+// nor reopen it for writing.
+//
+// The page is guarded by a seqlock: the writer makes `sequence` odd, updates
+// the fields and makes it even again. Every field is a lock-free atomic so
+// the page is safe to share between processes.
+
+constexpr uint32_t kVictusTelemetryMagic = 0x54434956; // "VICT"
+constexpr uint32_t kVictusTelemetryLayoutVersion = 1;
+
+// Marks a value the backend could not read.
+constexpr int32_t kVictusTelemetryUnavailable = INT32_MIN;
+
+enum VictusTelemetryFanMode : int32_t {
+  VICTUS_TELEMETRY_MODE_AUTO = 0,
+  VICTUS_TELEMETRY_MODE_MANUAL = 1,
+  VICTUS_TELEMETRY_MODE_MAX = 2,
+  VICTUS_TELEMETRY_MODE_BETTER_AUTO = 3,
+};
+
+struct VictusTelemetrySnapshot {
+  int32_t fan_rpm[2];
+  int32_t fan_target_rpm[2];
+  int32_t cpu_temp_millicelsius;
+  int32_t gpu_temp_millicelsius;
+  int32_t cpu_usage_permille;
+  int32_t gpu_usage_permille;
+  int32_t fan_mode;          // VictusTelemetryFanMode or unavailable
+  int32_t better_auto_level; // 0 while Better Auto is inactive
+  uint64_t updated_ns;       // CLOCK_MONOTONIC time of the last update
+};
+
+struct VictusTelemetryPage {
+  uint32_t magic;
+  uint32_t layout_version;
+  std::atomic<uint32_t> sequence;
+  std::atomic<int32_t> fan_rpm[2];
+  std::atomic<int32_t> fan_target_rpm[2];
+  std::atomic<int32_t> cpu_temp_millicelsius;
+  std::atomic<int32_t> gpu_temp_millicelsius;
+  std::atomic<int32_t> cpu_usage_permille;
+  std::atomic<int32_t> gpu_usage_permille;
+  std::atomic<int32_t> fan_mode;
+  std::atomic<int32_t> better_auto_level;
+  std::atomic<uint64_t> updated_ns;
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free &&
+                  std::atomic<int32_t>::is_always_lock_free &&
+                  std::atomic<uint64_t>::is_always_lock_free,
+              "telemetry page fields must be lock-free to be shared");
+
+// Copies a consistent snapshot out of the page. Returns false if the page is
+// not a compatible telemetry page or the writer kept it busy for every try.
+inline bool victus_telemetry_read(const VictusTelemetryPage *page,
+                                  VictusTelemetrySnapshot *out,
+                                  int max_attempts = 64) {
+  if (!page || !out || page->magic != kVictusTelemetryMagic ||
+      page->layout_version != kVictusTelemetryLayoutVersion)
+    return false;
+
+  constexpr auto relaxed = std::memory_order_relaxed;
+  for (int attempt = 0; attempt < max_attempts; ++attempt) {
+    uint32_t before = page->sequence.load(std::memory_order_acquire);
+    if (before & 1u)
+      continue;
+
+    for (int i = 0; i < 2; ++i) {
+      out->fan_rpm[i] = page->fan_rpm[i].load(relaxed);
+      out->fan_target_rpm[i] = page->fan_target_rpm[i].load(relaxed);
+    }
+    out->cpu_temp_millicelsius = page->cpu_temp_millicelsius.load(relaxed);
+    out->gpu_temp_millicelsius = page->gpu_temp_millicelsius.load(relaxed);
+    out->cpu_usage_permille = page->cpu_usage_permille.load(relaxed);
+    out->gpu_usage_permille = page->gpu_usage_permille.load(relaxed);
+    out->fan_mode = page->fan_mode.load(relaxed);
+    out->better_auto_level = page->better_auto_level.load(relaxed);
+    out->updated_ns = page->updated_ns.load(relaxed);
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (page->sequence.load(relaxed) == before)
+      return true;
+  }
+  return false;
+}
+
+#endif // VICTUS_TELEMETRY_PAGE_HPP
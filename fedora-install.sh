@@ -128,6 +128,7 @@ install_helpers_and_sudoers() {
     install -m 0755 backend/src/set-fan-speed.sh /usr/bin/set-fan-speed.sh
     install -m 0755 backend/src/set-fan-mode.sh /usr/bin/set-fan-mode.sh
     install -m 0755 backend/src/set-rgb-zone.sh /usr/bin/set-rgb-zone.sh
+    install -m 0644 backend/src/victus-helper-common.sh /usr/bin/victus-helper-common.sh
     rm -f /etc/sudoers.d/victus-fan-sudoers
     install -m 0440 victus-control-sudoers /etc/sudoers.d/victus-control-sudoers
     if command -v visudo >/dev/null 2>&1; then
@@ -196,6 +197,7 @@ start_services() {
     udevadm settle || true
 
     systemctl enable --now victus-healthcheck.service || true
+    systemctl enable --now victus-backend.socket
     systemctl enable --now victus-backend.service
     sleep 2
     systemctl is-active --quiet victus-backend.service
@@ -53,15 +53,27 @@ VictusFanControl::VictusFanControl(std::shared_ptr<VictusSocketClient> client) :
     gtk_widget_set_halign(fan2_speed_label, GTK_ALIGN_START);
     gtk_box_append(GTK_BOX(fan_page), fan2_speed_label);
 
-    // Initial UI state update
-    update_ui_from_system_state();
+    // Initial UI state update; the mode comes from the backend state document
+    // when it has one.
+    auto state = socket_client->fetch_state();
+    auto mode = state.find("mode");
+    update_ui_from_system_state(mode != state.end() ? mode->second : "");
     update_fan_speeds();
 
-    // Set up a timer to periodically update fan speeds
-    g_timeout_add_seconds(2, [](gpointer data) -> gboolean {
-        static_cast<VictusFanControl*>(data)->update_fan_speeds();
-        return G_SOURCE_CONTINUE;
-    }, this);
+    // Prefer backend push updates; fall back to polling on older backends.
+    telemetry = std::make_unique<VictusTelemetrySubscription>(socket_client);
+    bool subscribed = telemetry->start("fan,mode", 2, [this](const std::map<std::string, std::string> &values) {
+        apply_telemetry(values);
+    });
+
+    if (!subscribed) {
+        telemetry.reset();
+        // Set up a timer to periodically update fan speeds
+        g_timeout_add_seconds(2, [](gpointer data) -> gboolean {
+            static_cast<VictusFanControl*>(data)->update_fan_speeds();
+            return G_SOURCE_CONTINUE;
+        }, this);
+    }
 }
 
 GtkWidget* VictusFanControl::get_page()
@@ -69,10 +81,10 @@ GtkWidget* VictusFanControl::get_page()
     return fan_page;
 }
 
-void VictusFanControl::update_ui_from_system_state()
+void VictusFanControl::update_ui_from_system_state(std::string fan_mode)
 {
-    auto response = socket_client->send_command_async(GET_FAN_MODE);
-    std::string fan_mode = response.get();
+    if (fan_mode.empty())
+        fan_mode = socket_client->send_command_async(GET_FAN_MODE).get();
 
     if (fan_mode.find("ERROR") != std::string::npos) {
         fan_mode = "AUTO"; // Default to AUTO on error
@@ -102,18 +114,37 @@ void VictusFanControl::update_ui_from_system_state()
 
 void VictusFanControl::update_fan_speeds()
 {
-    auto response1 = socket_client->send_command_async(GET_FAN_SPEED, "1");
-    std::string fan1_speed = response1.get();
+    auto responses = socket_client->send_batch_async({{GET_FAN_SPEED, "1"}, {GET_FAN_SPEED, "2"}}).get();
+    std::string fan1_speed = responses[0];
     if (fan1_speed.find("ERROR") != std::string::npos) fan1_speed = "N/A";
 
-    auto response2 = socket_client->send_command_async(GET_FAN_SPEED, "2");
-    std::string fan2_speed = response2.get();
+    std::string fan2_speed = responses[1];
     if (fan2_speed.find("ERROR") != std::string::npos) fan2_speed = "N/A";
 
     gtk_label_set_text(GTK_LABEL(fan1_speed_label), ("Fan 1 Speed: " + fan1_speed + " RPM").c_str());
     gtk_label_set_text(GTK_LABEL(fan2_speed_label), ("Fan 2 Speed: " + fan2_speed + " RPM").c_str());
 }
 
+void VictusFanControl::apply_telemetry(const std::map<std::string, std::string> &values)
+{
+    auto value_or_na = [&values](const char *key) {
+        auto it = values.find(key);
+        return (it == values.end() || it->second == "NA") ? std::string("N/A") : it->second;
+    };
+
+    if (values.count("fan1") && values.count("fan2")) {
+        gtk_label_set_text(GTK_LABEL(fan1_speed_label), ("Fan 1 Speed: " + value_or_na("fan1") + " RPM").c_str());
+        gtk_label_set_text(GTK_LABEL(fan2_speed_label), ("Fan 2 Speed: " + value_or_na("fan2") + " RPM").c_str());
+    }
+
+    // Only the label follows pushed mode changes; moving the combo box would
+    // send the mode straight back to the backend.
+    auto mode = values.find("mode");
+    if (mode != values.end() && mode->second != "NA") {
+        gtk_label_set_text(GTK_LABEL(state_label), ("Current State: " + mode->second).c_str());
+    }
+}
+
 void VictusFanControl::set_fan_rpm(int level)
 {
     if (level < 1 || level > RPM_STEPS) return;
@@ -144,7 +175,7 @@ void VictusFanControl::set_fan_rpm(int level)
             socket_client->send_command_async(SET_FAN_SPEED,
                                               "1 " + fan1_rpm_str)
                 .get();
-        if (fan1_result != "OK") {
+        if (!victus_reply_ok(fan1_result)) {
             std::cerr << "Failed to set fan 1 speed: " << fan1_result
                       << std::endl;
             return;
@@ -161,7 +192,7 @@ void VictusFanControl::set_fan_rpm(int level)
             socket_client->send_command_async(SET_FAN_SPEED,
                                               "2 " + fan2_rpm_str)
                 .get();
-        if (fan2_result != "OK") {
+        if (!victus_reply_ok(fan2_result)) {
             std::cerr << "Failed to set fan 2 speed: " << fan2_result
                       << std::endl;
         }
@@ -179,7 +210,7 @@ void VictusFanControl::on_mode_changed(GtkComboBox *widget, gpointer data)
         // Send the mode command and wait for it to complete.
         auto result = self->socket_client->send_command_async(SET_FAN_MODE, mode_str).get();
 
-        if (result == "OK") {
+        if (victus_reply_ok(result)) {
             // If we are entering manual mode, now we can safely set the fan speed.
             if (mode_str == "MANUAL") {
                 int level = static_cast<int>(gtk_range_get_value(GTK_RANGE(self->speed_slider)));
@@ -3,6 +3,8 @@
 
 #include <gtk/gtk.h>
 #include <atomic>
+#include <map>
+#include <memory>
 #include <string>
 #include "socket.hpp"
 
@@ -27,7 +29,9 @@ private:
 	GtkWidget *fan2_speed_label;
 
 	void update_fan_speeds();
-	void update_ui_from_system_state();
+	// Asks the backend for the mode unless the caller already knows it.
+	void update_ui_from_system_state(std::string fan_mode = "");
+	void apply_telemetry(const std::map<std::string, std::string> &values);
     void set_fan_rpm(int level);
 
     // Signal handlers
@@ -35,6 +39,7 @@ private:
 	static void on_speed_slider_changed(GtkRange *range, gpointer data);
 
 	std::shared_ptr<VictusSocketClient> socket_client;
+	std::unique_ptr<VictusTelemetrySubscription> telemetry;
     std::atomic<unsigned long long> manual_request_generation{0};
 };
 
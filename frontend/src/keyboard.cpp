@@ -8,6 +8,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <vector>
 
 namespace {
 
@@ -68,6 +69,15 @@ bool any_zone_has_color(const GdkRGBA zone_colors[kFourZoneCount]) {
   return false;
 }
 
+// Reads all four zone colors in a single BATCH round trip.
+std::vector<std::string> fetch_zone_colors(VictusSocketClient &client) {
+  std::vector<std::pair<ServerCommands, std::string>> commands;
+  for (int i = 0; i < kFourZoneCount; i++)
+    commands.emplace_back(GET_KEYBOARD_ZONE_COLOR, std::to_string(i));
+
+  return client.send_batch_async(commands).get();
+}
+
 std::string resolve_home_directory() {
   const char *home = getenv("HOME");
   if (home && home[0] != '\0')
@@ -112,19 +122,30 @@ VictusKeyboardControl::VictusKeyboardControl(
   keyboard_enabled = false;
   hovered_zone = -1;       // No zone hovered initially
 
+  // One GET_STATE_SINCE round trip brings the type, zone colors and
+  // brightness; whatever the backend does not report is queried on its own.
+  const auto state = socket_client->fetch_state();
+
   // Detect keyboard type first
-  detect_keyboard_type();
+  detect_keyboard_type(state);
 
   // Load presets
   load_presets();
 
   // Read initial zone colors from device
   if (keyboard_type == "FOUR_ZONE") {
+    std::vector<std::string> zone_colors_reply;
     for (int i = 0; i < kFourZoneCount; i++) {
-      auto color_future = socket_client->send_command_async(
-          GET_KEYBOARD_ZONE_COLOR, std::to_string(i));
-      std::string color_str = color_future.get();
+      auto zone = state.find("zone" + std::to_string(i));
+      if (zone == state.end())
+        break;
+      zone_colors_reply.push_back(zone->second);
+    }
+    if (zone_colors_reply.size() != static_cast<size_t>(kFourZoneCount))
+      zone_colors_reply = fetch_zone_colors(*socket_client);
 
+    for (int i = 0; i < kFourZoneCount; i++) {
+      const std::string &color_str = zone_colors_reply[i];
       if (color_str.find("ERROR") == std::string::npos)
         parse_rgb_triplet(color_str, &zone_colors[i]);
     }
@@ -140,13 +161,19 @@ VictusKeyboardControl::VictusKeyboardControl(
   build_ui_for_keyboard_type();
 
   // Update state from device
-  update_keyboard_state_from_device();
+  auto brightness = state.find("brightness");
+  update_keyboard_state_from_device(
+      brightness != state.end() ? brightness->second : "");
   update_current_color_label(this);
 }
 
-void VictusKeyboardControl::detect_keyboard_type() {
-  auto type_future = socket_client->send_command_async(GET_KEYBOARD_TYPE);
-  keyboard_type = type_future.get();
+void VictusKeyboardControl::detect_keyboard_type(
+    const std::map<std::string, std::string> &state) {
+  auto known_type = state.find("keyboard_type");
+  if (known_type != state.end())
+    keyboard_type = known_type->second;
+  else
+    keyboard_type = socket_client->send_command_async(GET_KEYBOARD_TYPE).get();
 
   if (keyboard_type.find("ERROR") != std::string::npos) {
     // Fallback to SINGLE_ZONE if error
@@ -280,7 +307,7 @@ void VictusKeyboardControl::apply_zone_color_immediately(int zone) {
   auto color_state =
       socket_client->send_command_async(SET_KEYBOARD_ZONE_COLOR, value);
   std::string result = color_state.get();
-  if (result != "OK")
+  if (!victus_reply_ok(result))
     std::cerr << "Failed to update keyboard zone " << zone
               << " color!: " << result << std::endl;
 }
@@ -579,7 +606,7 @@ void VictusKeyboardControl::update_keyboard_state(bool enabled) {
   std::string command = enabled ? "255" : "0";
   auto result = socket_client->send_command_async(SET_KBD_BRIGHTNESS, command);
 
-  if (result.get() != "OK") {
+  if (!victus_reply_ok(result.get())) {
     std::cerr << "Failed to update keyboard state!" << std::endl;
     return;
   }
@@ -587,9 +614,11 @@ void VictusKeyboardControl::update_keyboard_state(bool enabled) {
   update_keyboard_state_from_device();
 }
 
-void VictusKeyboardControl::update_keyboard_state_from_device() {
-  auto keyboard_state = socket_client->send_command_async(GET_KBD_BRIGHTNESS);
-  std::string szkeyboard_state = keyboard_state.get();
+void VictusKeyboardControl::update_keyboard_state_from_device(
+    std::string szkeyboard_state) {
+  if (szkeyboard_state.empty())
+    szkeyboard_state =
+        socket_client->send_command_async(GET_KBD_BRIGHTNESS).get();
 
   if (szkeyboard_state.find("ERROR") == std::string::npos) {
     keyboard_enabled = (szkeyboard_state != "0");
@@ -616,7 +645,7 @@ void VictusKeyboardControl::update_keyboard_color(const GdkRGBA &color) {
       socket_client->send_command_async(SET_KEYBOARD_COLOR, value);
   std::string result = color_state.get();
 
-  if (result != "OK")
+  if (!victus_reply_ok(result))
     std::cerr << "Failed to update keyboard color!: " << result << std::endl;
   else
     update_current_color_label(this);
@@ -704,10 +733,9 @@ void VictusKeyboardControl::update_current_color_label(gpointer data) {
   if (self->keyboard_type == "FOUR_ZONE") {
     std::string label = "Current Colors:";
 
+    auto zone_colors_reply = fetch_zone_colors(*self->socket_client);
     for (int i = 0; i < kFourZoneCount; i++) {
-      auto zone_color = self->socket_client->send_command_async(
-          GET_KEYBOARD_ZONE_COLOR, std::to_string(i));
-      label += " Z" + std::to_string(i) + " " + zone_color.get();
+      label += " Z" + std::to_string(i) + " " + zone_colors_reply[i];
     }
 
     gtk_label_set_text(self->current_color_label, label.c_str());
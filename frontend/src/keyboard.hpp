@@ -46,12 +46,13 @@ private:
   bool keyboard_enabled;
 
   void update_keyboard_state(bool enabled);
-  void update_keyboard_state_from_device();
+  // Asks the backend for the brightness unless the caller already knows it.
+  void update_keyboard_state_from_device(std::string brightness = "");
 
   void update_keyboard_color(const GdkRGBA &color);
 
   // New methods
-  void detect_keyboard_type();
+  void detect_keyboard_type(const std::map<std::string, std::string> &state);
   void build_ui_for_keyboard_type();
   void update_keyboard_visual();
   void load_presets();
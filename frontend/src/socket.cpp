@@ -1,194 +1,159 @@
 #include "socket.hpp"
-#include <cstdint>
-#include <sys/socket.h>
-#include <sys/un.h>
-#include <unistd.h>
+#include <glib-unix.h>
+#include <cstdlib>
 #include <iostream>
-#include <cstring>
-#include <vector>
-#include <cerrno>
-#include <future>
-#include <mutex>
-
-bool send_all(int socket, const void *buffer, size_t length) {
-  const char *ptr = static_cast<const char *>(buffer);
-  while (length > 0) {
-    ssize_t bytes_sent = send(socket, ptr, length, 0);
-    if (bytes_sent < 1) {
-      return false;
-    }
-    ptr += bytes_sent;
-    length -= bytes_sent;
-  }
-  return true;
-}
+#include <sstream>
 
-bool read_all(int socket, void *buffer, size_t length) {
-  char *ptr = static_cast<char *>(buffer);
-  while (length > 0) {
-    ssize_t bytes_read = recv(socket, ptr, length, 0);
-    if (bytes_read < 1) {
-      return false;
-    }
-    ptr += bytes_read;
-    length -= bytes_read;
+VictusSocketClient::VictusSocketClient(const std::string &path) : socket_path(path)
+{
+  // The library connects on the first command.
+  handle = victus_client_new(socket_path.c_str());
+  if (!handle) {
+    std::cerr << "Cannot create client: " << victus_client_last_error() << std::endl;
+    return;
   }
-  return true;
-}
 
-bool send_u32_le(int socket, uint32_t value) {
-  unsigned char bytes[4] = {
-      static_cast<unsigned char>(value & 0xFF),
-      static_cast<unsigned char>((value >> 8) & 0xFF),
-      static_cast<unsigned char>((value >> 16) & 0xFF),
-      static_cast<unsigned char>((value >> 24) & 0xFF),
-  };
-  return send_all(socket, bytes, sizeof(bytes));
+  dispatch_source = g_unix_fd_add(victus_client_get_fd(handle), G_IO_IN,
+      [](gint, GIOCondition, gpointer data) -> gboolean {
+        victus_client_dispatch(static_cast<victus_client *>(data));
+        return G_SOURCE_CONTINUE;
+      }, handle);
 }
 
-bool read_u32_le(int socket, uint32_t *value) {
-  if (!value)
-    return false;
-
-  unsigned char bytes[4];
-  if (!read_all(socket, bytes, sizeof(bytes)))
-    return false;
-
-  *value = static_cast<uint32_t>(bytes[0]) |
-           (static_cast<uint32_t>(bytes[1]) << 8) |
-           (static_cast<uint32_t>(bytes[2]) << 16) |
-           (static_cast<uint32_t>(bytes[3]) << 24);
-  return true;
+VictusSocketClient::~VictusSocketClient()
+{
+  if (dispatch_source)
+    g_source_remove(dispatch_source);
+	victus_client_free(handle);
 }
 
-
-VictusSocketClient::VictusSocketClient(const std::string &path) : socket_path(path), sockfd(-1)
+std::string VictusSocketClient::send_command(const std::string &command)
 {
-  command_prefix_map = {
-      {GET_FAN_SPEED, "GET_FAN_SPEED"},
-      {SET_FAN_SPEED, "SET_FAN_SPEED"},
-      {SET_FAN_MODE, "SET_FAN_MODE"},
-      {GET_FAN_MODE, "GET_FAN_MODE"},
-      {GET_KEYBOARD_COLOR, "GET_KEYBOARD_COLOR"},
-      {SET_KEYBOARD_COLOR, "SET_KEYBOARD_COLOR"},
-      {SET_KEYBOARD_ZONE_COLOR, "SET_KEYBOARD_ZONE_COLOR"},
-      {GET_KEYBOARD_ZONE_COLOR, "GET_KEYBOARD_ZONE_COLOR"},
-      {GET_KBD_BRIGHTNESS, "GET_KBD_BRIGHTNESS"},
-      {SET_KBD_BRIGHTNESS, "SET_KBD_BRIGHTNESS"},
-      {GET_KEYBOARD_TYPE, "GET_KEYBOARD_TYPE"},
-  };
-
-  // Don't connect here, connect on first command
+  if (!handle)
+    return "ERROR: No server connection";
+
+  char *reply = nullptr;
+  victus_client_call(handle, command.c_str(), &reply);
+  std::string result = reply ? reply : victus_client_last_error();
+  victus_client_free_string(reply);
+  return result;
 }
 
-VictusSocketClient::~VictusSocketClient()
+std::string VictusSocketClient::build_command(ServerCommands type, const std::string &command) const
 {
-	close_socket();
+  if (type >= VICTUS_COMMAND_COUNT)
+    return "";
+
+  std::string full_command(kVictusCommands[type].name);
+  if (!command.empty())
+  {
+    full_command += " ";
+    full_command += command;
+  }
+  return full_command;
 }
 
-bool VictusSocketClient::connect_to_server()
+std::future<std::string> VictusSocketClient::send_command_async(ServerCommands type, const std::string &command)
 {
-  if (sockfd != -1) {
-    return true;
-  }
+	return std::async(std::launch::async, [this, type, command]()
+					  {
+    std::string full_command = build_command(type, command);
+    if (full_command.empty())
+      return std::string("ERROR: Unknown command type");
+
+    std::cout << "Sending command: " << full_command << std::endl;
+    auto result = send_command(full_command);
+    std::cout << "Received response: " << result << std::endl;
+    return result; });
+}
 
-  std::cout << "Connecting to server..." << std::endl;
+std::future<std::vector<std::string>> VictusSocketClient::send_batch_async(
+    const std::vector<std::pair<ServerCommands, std::string>> &commands)
+{
+  return std::async(std::launch::async, [this, commands]()
+                    {
+    std::vector<std::string> full_commands;
+    std::vector<const char *> pointers;
+    for (const auto &[type, args] : commands)
+      full_commands.push_back(build_command(type, args));
+    for (const auto &full_command : full_commands)
+      pointers.push_back(full_command.c_str());
+
+    std::cout << "Sending batch of " << full_commands.size() << " commands" << std::endl;
+    std::vector<std::string> results(full_commands.size(), "ERROR: No server connection");
+    char **replies = nullptr;
+    if (handle && !pointers.empty() &&
+        victus_client_batch(handle, pointers.data(), pointers.size(), &replies) != VICTUS_CLIENT_EINVAL &&
+        replies) {
+      for (size_t i = 0; i < results.size(); ++i) {
+        if (replies[i])
+          results[i] = replies[i];
+      }
+    }
+    victus_client_free_strings(replies, full_commands.size());
+    return results; });
+}
 
-  sockfd = socket(AF_UNIX, SOCK_STREAM, 0);
-	if (sockfd == -1)
-	{
-    std::cerr << "Cannot create socket: " << strerror(errno) << std::endl;
-    return false;
+std::map<std::string, std::string> VictusSocketClient::fetch_state(uint64_t since, uint64_t *version)
+{
+  std::map<std::string, std::string> fields;
+  std::string reply = send_command(build_command(GET_STATE_SINCE, std::to_string(since)));
+
+  std::istringstream lines(reply);
+  std::string line;
+  if (!std::getline(lines, line) || line.rfind("STATE ", 0) != 0)
+    return fields;
+  if (version)
+    *version = std::strtoull(line.c_str() + 6, nullptr, 10);
+
+  while (std::getline(lines, line)) {
+    size_t equals = line.find('=');
+    if (equals != std::string::npos)
+      fields[line.substr(0, equals)] = line.substr(equals + 1);
   }
+  return fields;
+}
 
-  struct sockaddr_un addr;
-  memset(&addr, 0, sizeof(addr));
-  addr.sun_family = AF_UNIX;
-  strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
-
-  // Try to connect with a timeout
-	if (connect(sockfd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
-	{
-		std::cerr << "Failed to connect to the server: " << strerror(errno) << std::endl;
-    close(sockfd);
-    sockfd = -1;
-    return false;
-  }
 
-  std::cout << "Connection to server successful." << std::endl;
-  return true;
+VictusTelemetrySubscription::VictusTelemetrySubscription(std::shared_ptr<VictusSocketClient> socket_client)
+    : client(std::move(socket_client))
+{
 }
 
-void VictusSocketClient::close_socket()
+VictusTelemetrySubscription::~VictusTelemetrySubscription()
 {
-  if (sockfd != -1) {
-    std::cout << "Closing the connection..." << std::endl;
-    close(sockfd);
-    sockfd = -1;
-    std::cout << "Connection closed." << std::endl;
-  }
+  stop();
 }
 
-std::string VictusSocketClient::send_command(const std::string &command)
+bool VictusTelemetrySubscription::start(const std::string &topics, int interval_seconds, FrameCallback on_frame)
 {
-  std::lock_guard<std::mutex> lock(socket_mutex);
+  stop();
 
-  if (sockfd == -1) {
-    if (!connect_to_server()) {
-      return "ERROR: No server connection";
-    }
-  }
-
-  uint32_t len = static_cast<uint32_t>(command.length());
-  if (!send_u32_le(sockfd, len) || !send_all(sockfd, command.c_str(), len)) {
-    std::cerr << "Failed to send command, closing socket." << std::endl;
-    close_socket();
-    return "ERROR: Failed to send command";
-  }
-
-  uint32_t response_len = 0;
-  if (!read_u32_le(sockfd, &response_len)) {
-    std::cerr << "Failed to read response length, closing socket." << std::endl;
-    close_socket();
-    return "ERROR: Failed to read response length";
-  }
-
-  if (response_len > 4096) { // Sanity check
-        std::cerr << "Response too long (" << response_len << " bytes), closing socket." << std::endl;
-    close_socket();
-    return "ERROR: Response too long";
-  }
+  callback = std::move(on_frame);
+  if (!client->get_handle())
+    return false;
 
-  std::vector<char> buffer(response_len);
-  if (!read_all(sockfd, buffer.data(), response_len)) {
-    std::cerr << "Failed to read response, closing socket." << std::endl;
-    close_socket();
-    return "ERROR: Failed to read response";
+  subscription = victus_client_subscribe(client->get_handle(), topics.c_str(), interval_seconds,
+      [](size_t count, const char *const *keys, const char *const *values, void *data) {
+        auto *self = static_cast<VictusTelemetrySubscription *>(data);
+        std::map<std::string, std::string> frame;
+        for (size_t i = 0; i < count; ++i)
+          frame[keys[i]] = values[i];
+        if (self->callback)
+          self->callback(frame);
+      }, this);
+
+  if (subscription < 0) {
+    std::cerr << "Telemetry subscription rejected: " << victus_client_last_error() << std::endl;
+    subscription = 0;
+    return false;
   }
-
-  return std::string(buffer.begin(), buffer.end());
+  return true;
 }
 
-std::future<std::string> VictusSocketClient::send_command_async(ServerCommands type, const std::string &command)
+void VictusTelemetrySubscription::stop()
 {
-	return std::async(std::launch::async, [this, type, command]()
-					  {
-    auto it = command_prefix_map.find(type);
-		if (it != command_prefix_map.end())
-		{
-      std::string full_command = it->second;
-			if (!command.empty())
-			{
-				if (it->second.back() != ' ')
-				{
-          full_command += " ";
-        }
-        full_command += command;
-      }
-      std::cout << "Sending command: " << full_command << std::endl;
-      auto result = send_command(full_command);
-      std::cout << "Received response: " << result << std::endl;
-      return result;
-    }
-		return std::string("ERROR: Unknown command type"); });
+  if (subscription > 0)
+    victus_client_unsubscribe(client->get_handle(), subscription);
+  subscription = 0;
 }
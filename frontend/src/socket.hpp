@@ -3,25 +3,25 @@
 
 #include <string>
 #include <future>
-#include <unordered_map>
 #include <functional>
-#include <mutex>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
 
-enum ServerCommands
-{
-  GET_FAN_SPEED,
-  SET_FAN_SPEED,
-  SET_FAN_MODE,
-  GET_FAN_MODE,
-  GET_KEYBOARD_COLOR,
-  SET_KEYBOARD_COLOR,
-  SET_KEYBOARD_ZONE_COLOR,
-  GET_KEYBOARD_ZONE_COLOR,
-  GET_KBD_BRIGHTNESS,
-  SET_KBD_BRIGHTNESS,
-  GET_KEYBOARD_TYPE
-};
+#include <glib.h>
+
+#include "victus_client.h"
+#include "victus_commands.hpp"
+
+// Command names, arity and argument bounds come from the schema shared with
+// the backend.
+using ServerCommands = VictusCommand;
 
+// Thin C++ face of libvictus-client. The library's dispatch descriptor is
+// watched from the default GLib main context, so subscription callbacks run
+// on the GTK thread.
 class VictusSocketClient
 {
 public:
@@ -30,17 +30,47 @@ public:
 
   std::future<std::string> send_command_async(ServerCommands type, const std::string &command = "");
 
+  // Sends every command in one BATCH frame and returns the responses in the
+  // same order. Falls back to one round trip per command on older backends.
+  std::future<std::vector<std::string>> send_batch_async(
+      const std::vector<std::pair<ServerCommands, std::string>> &commands);
+
+  // Fields of the backend state document ("mode", "zone0", "brightness", ...)
+  // that changed after `since`, in one GET_STATE_SINCE round trip. Empty if
+  // the backend predates the command.
+  std::map<std::string, std::string> fetch_state(uint64_t since = 0, uint64_t *version = nullptr);
+
+  const std::string &get_socket_path() const { return socket_path; }
+  victus_client *get_handle() const { return handle; }
+
 private:
   std::string send_command(const std::string &command);
+  std::string build_command(ServerCommands type, const std::string &command) const;
+
   std::string socket_path;
+  victus_client *handle;
+  guint dispatch_source = 0;
+};
+
+// SUBSCRIBE push frames from the backend instead of polling. The callback
+// runs on the GTK main loop with the key/value pairs of each TELEMETRY frame.
+class VictusTelemetrySubscription
+{
+public:
+  using FrameCallback = std::function<void(const std::map<std::string, std::string> &values)>;
 
-  bool connect_to_server();
-  void close_socket();
+  VictusTelemetrySubscription(std::shared_ptr<VictusSocketClient> client);
+  ~VictusTelemetrySubscription();
 
-  int sockfd;
-  std::mutex socket_mutex;
+  // Returns false if the backend is unreachable or rejects the subscription;
+  // once started, dropped connections are re-established in the background.
+  bool start(const std::string &topics, int interval_seconds, FrameCallback callback);
+  void stop();
 
-  std::unordered_map<ServerCommands, std::string> command_prefix_map;
+private:
+  std::shared_ptr<VictusSocketClient> client;
+  FrameCallback callback;
+  int subscription = 0;
 };
 
 #endif // VICTUS_SOCKET_HPP